@@ -0,0 +1,46 @@
+#!/bin/bash
+
+# This script measures the speed/accuracy tradeoff of evaluating the neural net
+# only on every n'th frame at test time (--frame-subsampling-factor option of
+# nnet-latgen-faster).  It decodes dev93 with an existing p-norm system for
+# several subsampling factors, with and without interpolation of the skipped
+# frames, and prints the real-time factor and best WER for each.
+
+dir=exp/nnet5d   # directory containing final.mdl
+factors="1 2 3"
+nj=10
+
+. cmd.sh
+. ./path.sh
+. utils/parse_options.sh
+
+for f in $dir/final.mdl exp/tri4b/graph_bd_tgpr/HCLG.fst; do
+  [ ! -f $f ] && echo "$0: no such file $f" && exit 1;
+done
+
+for n in $factors; do
+  for interp in false true; do
+    [ $n -eq 1 ] && [ $interp == true ] && continue;
+    decode_dir=$dir/decode_bd_tgpr_dev93_fs${n}
+    $interp && decode_dir=${decode_dir}_interp
+    steps/nnet2/decode.sh --cmd "$decode_cmd" --nj $nj \
+      --frame-subsampling-factor $n --subsampling-interpolate $interp \
+      --transform-dir exp/tri4b/decode_bd_tgpr_dev93 \
+      exp/tri4b/graph_bd_tgpr data/test_dev93 $decode_dir || exit 1;
+  done
+done
+
+echo "# factor  interpolate  RTF  WER"
+for n in $factors; do
+  for interp in false true; do
+    [ $n -eq 1 ] && [ $interp == true ] && continue;
+    decode_dir=$dir/decode_bd_tgpr_dev93_fs${n}
+    $interp && decode_dir=${decode_dir}_interp
+    # average the per-job real-time factors printed by nnet-latgen-faster.
+    rtf=$(grep -h 'real-time factor' $decode_dir/log/decode.*.log | \
+      awk '{for(i=1;i<NF;i++) if ($i == "is") x=$(i+1); tot+=x; n++;}
+           END{if (n > 0) printf("%.3f", tot/n); else print "N/A";}')
+    wer=$(grep WER $decode_dir/wer_* | utils/best_wer.sh | awk '{print $2}')
+    echo "  $n  $interp  $rtf  $wer"
+  done
+done
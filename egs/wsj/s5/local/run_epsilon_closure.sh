@@ -0,0 +1,52 @@
+#!/bin/bash
+
+# This script measures how much of the decoding time the table of epsilon
+# closures (--epsilon-closure-max-states option of gmm-latgen-faster) saves.
+# It decodes the first utterances of dev93 with tri2b on one core, with and
+# without the table, checks that the lattices are the same, and prints the
+# real-time factor for each setting.  If Kaldi was compiled with
+# -DKALDI_PROFILE (see base/kaldi-profile.h) it also prints the total time
+# spent in LatticeFasterDecoder::ProcessNonemitting.
+
+dir=exp/tri2b
+graphdir=exp/tri2b/graph_bd_tgpr
+data=data/test_dev93
+num_utts=100
+max_states="5 20 50"
+max_cost=15.0
+decode_opts="--beam=13.0 --lattice-beam=6.0 --max-active=7000 --acoustic-scale=0.083333"
+
+. ./path.sh
+. utils/parse_options.sh
+
+for f in $dir/final.mdl $dir/final.mat $graphdir/HCLG.fst $data/feats.scp; do
+  [ ! -f $f ] && echo "$0: no such file $f" && exit 1;
+done
+
+tmpdir=$dir/epsilon_closure
+mkdir -p $tmpdir
+splice_opts=`cat $dir/splice_opts 2>/dev/null`
+cmvn_opts=`cat $dir/cmvn_opts 2>/dev/null`
+head -n $num_utts $data/feats.scp > $tmpdir/feats.scp
+feats="ark,s,cs:apply-cmvn $cmvn_opts --utt2spk=ark:$data/utt2spk scp:$data/cmvn.scp scp:$tmpdir/feats.scp ark:- | splice-feats $splice_opts ark:- ark:- | transform-feats $dir/final.mat ark:- ark:- |"
+
+for n in 0 $max_states; do
+  KALDI_PROFILE_OUTPUT=$tmpdir/profile.$n \
+    gmm-latgen-faster $decode_opts --epsilon-closure-max-states=$n \
+      --epsilon-closure-max-cost=$max_cost $dir/final.mdl $graphdir/HCLG.fst \
+      "$feats" ark:$tmpdir/lat.$n 2>$tmpdir/log.$n || exit 1;
+done
+
+echo "# max-states  RTF  ProcessNonemitting-seconds  table-MB  same-lattices"
+for n in 0 $max_states; do
+  rtf=$(grep 'real-time factor' $tmpdir/log.$n | awk '{print $NF}')
+  nonemitting=$(grep '^LatticeFasterDecoder::ProcessNonemitting' \
+    $tmpdir/profile.$n 2>/dev/null | awk '{print $3}')
+  mem=$(grep 'Memory used is' $tmpdir/log.$n | \
+    awk '{for(i=1;i<NF;i++) if ($i == "is") x=$(i+1); print x;}')
+  same=yes
+  if [ $n -ne 0 ]; then
+    lattice-equivalent ark:$tmpdir/lat.0 ark:$tmpdir/lat.$n 2>/dev/null || same=no
+  fi
+  echo "  $n  $rtf  ${nonemitting:-N/A}  ${mem:-0}  $same"
+done
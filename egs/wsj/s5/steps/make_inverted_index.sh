@@ -0,0 +1,94 @@
+#!/bin/bash
+
+# Copyright 2015  Johns Hopkins University
+# Apache 2.0
+
+# This is like make_index.sh, but creates the inverted n-gram index of
+# lattice-to-kws-inverted-index, which is much faster to build and to search
+# for large archives (see steps/search_inverted_index.sh).  The per-job
+# indexes are merged and split into --num-shards shards at the end.
+
+# Begin configuration section.  
+model= # You can specify the model to use
+cmd=run.pl
+acwt=0.083333
+lmwt=1.0
+max_silence_frames=50
+max_order=3
+min_posterior=0.001
+max_expand=180 # limit memory blowup in lattice-align-words
+num_threads=1
+parallel_opts=  # If you supply num-threads, you should supply this too.
+num_shards=1
+strict=true
+word_ins_penalty=0
+silence_word=  # Specify this only if you did so in kws_setup
+# End configuration section.
+
+echo "$0 $@"  # Print the command line for logging
+
+[ -f ./path.sh ] && . ./path.sh; # source the path.
+. parse_options.sh || exit 1;
+
+if [ $# != 4 ]; then
+   echo "Usage: steps/make_inverted_index.sh [options] <kws-data-dir> <lang-dir> <decode-dir> <kws-dir>"
+   echo "... where <decode-dir> is where you have the lattices, and is assumed to be"
+   echo " a sub-directory of the directory where the model is."
+   echo "e.g.: steps/make_inverted_index.sh data/kws data/lang exp/sgmm2_5a_mmi/decode/ exp/sgmm2_5a_mmi/decode/kws/"
+   echo ""
+   echo "main options (for others, see top of script file)"
+   echo "  --acwt <float>                                   # acoustic scale used for lattice"
+   echo "  --cmd (utils/run.pl|utils/queue.pl <queue opts>) # how to run jobs."
+   echo "  --lmwt <float>                                   # lm scale used for lattice"
+   echo "  --model <model>                                  # which model to use"
+   echo "  --max-order <int>                                # longest n-gram to index"
+   echo "  --num-shards <int>                               # number of shards of the index"
+   echo "  --num-threads <int>                              # threads per indexing job"
+   exit 1;
+fi
+
+
+kwsdatadir=$1;
+langdir=$2;
+decodedir=$3;
+kwsdir=$4;
+srcdir=`dirname $decodedir`; # The model directory is one level up from decoding directory.
+
+mkdir -p $kwsdir/log;
+nj=`cat $decodedir/num_jobs` || exit 1;
+word_boundary=$langdir/phones/word_boundary.int
+utter_id=$kwsdatadir/utter_id
+
+if [ -z "$model" ]; then # if --model <mdl> was not specified on the command line...
+  model=$srcdir/final.mdl; 
+fi
+
+for f in $word_boundary $model $decodedir/lat.1.gz; do
+  [ ! -f $f ] && echo "make_inverted_index.sh: no such file $f" && exit 1;
+done
+
+echo "Using model: $model"
+
+if [ ! -z $silence_word ]; then
+  silence_int=`grep -w $silence_word $langdir/words.txt | awk '{print $2}'`
+  [ -z $silence_int ] && \
+    echo "Error: could not find integer representation of silence word $silence_word" && exit 1;
+  silence_opt="--silence-label=$silence_int"
+fi
+
+$cmd $parallel_opts JOB=1:$nj $kwsdir/log/inverted_index.JOB.log \
+  lattice-add-penalty --word-ins-penalty=$word_ins_penalty "ark:gzip -cdf $decodedir/lat.JOB.gz|" ark:- \| \
+    lattice-align-words $silence_opt --max-expand=$max_expand $word_boundary $model  ark:- ark:- \| \
+    lattice-scale --acoustic-scale=$acwt --lm-scale=$lmwt ark:- ark:- \| \
+    lattice-to-kws-inverted-index --max-order=$max_order --min-posterior=$min_posterior \
+    --max-silence-frames=$max_silence_frames --num-threads=$num_threads --strict=$strict \
+    ark:$utter_id ark:- $kwsdir/inverted_index.JOB || exit 1
+
+$cmd $kwsdir/log/shard_index.log \
+  kws-index-shard --num-shards=$num_shards \
+    $(for n in `seq $nj`; do echo $kwsdir/inverted_index.$n; done) \
+    ark,scp:$kwsdir/inverted_index.ark,$kwsdir/inverted_index.scp || exit 1
+
+rm $kwsdir/inverted_index.[0-9]*
+
+exit 0;
@@ -26,6 +26,9 @@ skip_scoring=false
 feat_type=
 online_ivector_dir=
 minimize=false
+frame_subsampling_factor=1 # if >1, only evaluate the nnet on every n'th frame.
+subsampling_interpolate=false # if true, interpolate scores of skipped frames
+                              # (only relevant if frame_subsampling_factor > 1).
 # End configuration section.
 
 echo "$0 $@"  # Print the command line for logging
@@ -48,6 +51,7 @@ if [ $# -ne 3 ]; then
   echo "  --scoring-opts <string>                  # options to local/score.sh"
   echo "  --num-threads <n>                        # number of threads to use, default 1."
   echo "  --parallel-opts <opts>                   # e.g. '-pe smp 4' if you supply --num-threads 4"
+  echo "  --frame-subsampling-factor <n>           # evaluate nnet on every n'th frame; default 1."
   exit 1;
 fi
 
@@ -133,6 +137,8 @@ if [ $stage -le 1 ]; then
     nnet-latgen-faster$thread_string \
      --minimize=$minimize --max-active=$max_active --min-active=$min_active --beam=$beam \
      --lattice-beam=$lattice_beam --acoustic-scale=$acwt --allow-partial=true \
+     --frame-subsampling-factor=$frame_subsampling_factor \
+     --subsampling-interpolate=$subsampling_interpolate \
      --word-symbol-table=$graphdir/words.txt "$model" \
      $graphdir/HCLG.fst "$feats" "ark:|gzip -c > $dir/lat.JOB.gz" || exit 1;
 fi
@@ -0,0 +1,54 @@
+#!/bin/bash
+
+# Copyright 2015  Johns Hopkins University
+# Apache 2.0
+
+# This is like search_index.sh, for the inverted index created by
+# steps/make_inverted_index.sh.  All the keywords are searched in one job;
+# the results are in the same format as those of search_index.sh.
+
+# Begin configuration section.  
+cmd=run.pl
+nbest=-1
+max_gap_frames=50
+strict=true
+indices_dir=
+# End configuration section.
+
+echo "$0 $@"  # Print the command line for logging
+
+[ -f ./path.sh ] && . ./path.sh; # source the path.
+. parse_options.sh || exit 1;
+
+if [ $# != 2 ]; then
+   echo "Usage: steps/search_inverted_index.sh [options] <kws-data-dir> <kws-dir>"
+   echo " e.g.: steps/search_inverted_index.sh data/kws exp/sgmm2_5a_mmi/decode/kws/"
+   echo ""
+   echo "main options (for others, see top of script file)"
+   echo "  --cmd (utils/run.pl|utils/queue.pl <queue opts>) # how to run jobs."
+   echo "  --nbest <int>                                    # return n best results. (-1 means all)"
+   echo "  --indices-dir <path>                             # where the index is, by default it will be in <kws-dir>"
+   exit 1;
+fi
+
+
+kwsdatadir=$1;
+kwsdir=$2;
+
+if [ -z $indices_dir ] ; then
+  indices_dir=$kwsdir
+fi
+
+mkdir -p $kwsdir/log;
+keywords=$kwsdatadir/keywords.fsts;
+
+for f in $indices_dir/inverted_index.scp $keywords; do
+  [ ! -f $f ] && echo "search_inverted_index.sh: no such file $f" && exit 1;
+done
+
+$cmd $kwsdir/log/search.1.log \
+  kws-search-inverted --strict=$strict --nbest=$nbest --max-gap-frames=$max_gap_frames \
+  scp:$indices_dir/inverted_index.scp ark:$keywords \
+  "ark,t:|int2sym.pl -f 2 $kwsdatadir/utter_id > $kwsdir/result.1" || exit 1;
+
+exit 0;
@@ -0,0 +1,109 @@
+// base/kaldi-profile-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <pthread.h>
+#include <sstream>
+#include "base/kaldi-common.h"
+#include "base/kaldi-profile.h"
+
+namespace kaldi {
+
+static void *ProfileTestThread(void *arg) {
+  int32 id = *static_cast<int32*>(arg);
+  for (int32 i = 0; i < 100; i++) {
+    ProfileAddCount(id, 2);
+    ProfileAddTime(id, 0.5);
+    // Registering new names makes the tables of the threads grow while the
+    // main thread may be printing the summary.
+    if (i % 10 == 0) {
+      std::ostringstream name;
+      name << "test-grow-" << i;
+      ProfileAddCount(ProfileGetId(name.str().c_str()), 1);
+    }
+  }
+  return NULL;
+}
+
+void UnitTestProfile() {
+  ProfileReset();
+  int32 id1 = ProfileGetId("test-stat-1"),
+      id2 = ProfileGetId("test-stat-2"),
+      id3 = ProfileGetId("test-stat-3");
+  KALDI_ASSERT(id1 != id2 && ProfileGetId("test-stat-1") == id1);
+
+  const int32 num_threads = 4;
+  pthread_t threads[num_threads];
+  for (int32 t = 0; t < num_threads; t++)
+    KALDI_ASSERT(pthread_create(&threads[t], NULL, ProfileTestThread,
+                                &id1) == 0);
+  for (int32 t = 0; t < num_threads; t++) {
+    std::ostringstream os;
+    ProfilePrintSummary(os);
+  }
+  for (int32 t = 0; t < num_threads; t++)
+    pthread_join(threads[t], NULL);
+  ProfileAddCount(id2, 7);
+  ProfileAddMax(id3, 3);
+  ProfileAddMax(id3, 9);
+  ProfileAddMax(id3, 5);
+
+  std::ostringstream os;
+  ProfilePrintSummary(os);
+  std::istringstream is(os.str());
+  std::string line;
+  bool seen1 = false, seen2 = false, seen3 = false;
+  while (std::getline(is, line)) {
+    if (line[0] == '#') continue;
+    std::istringstream line_is(line);
+    std::string name;
+    int64 num_calls, count, max_count;
+    double seconds;
+    line_is >> name >> num_calls >> seconds >> count >> max_count;
+    KALDI_ASSERT(!line_is.fail());
+    if (name == "test-stat-1") {
+      KALDI_ASSERT(num_calls == 200 * num_threads &&
+                   count == 200 * num_threads && max_count == 2 &&
+                   ApproxEqual(seconds, 50.0 * num_threads));
+      seen1 = true;
+    } else if (name == "test-stat-2") {
+      KALDI_ASSERT(num_calls == 1 && count == 7 && max_count == 7 &&
+                   seconds == 0.0);
+      seen2 = true;
+    } else if (name == "test-stat-3") {
+      // maxima are not summed.
+      KALDI_ASSERT(num_calls == 3 && count == 0 && max_count == 9);
+      seen3 = true;
+    } else if (name == "test-grow-0") {
+      KALDI_ASSERT(num_calls == num_threads && count == num_threads);
+    }
+  }
+  KALDI_ASSERT(seen1 && seen2 && seen3);
+
+  {
+    KALDI_PROFILE_SCOPE("test-scope");  // does nothing unless -DKALDI_PROFILE.
+    KALDI_PROFILE_COUNT("test-count", 1);
+    KALDI_PROFILE_MAX("test-max", 1);
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  kaldi::UnitTestProfile();
+  std::cout << "Test OK.\n";
+  return 0;
+}
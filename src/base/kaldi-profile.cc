@@ -0,0 +1,257 @@
+// base/kaldi-profile.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#if defined(_MSC_VER)
+# include <windows.h>
+#else
+# include <pthread.h>
+# include <sys/time.h>
+#endif
+
+#include "base/kaldi-common.h"
+#include "base/kaldi-profile.h"
+
+namespace kaldi {
+
+struct ProfileStat {
+  int64 num_calls;
+  double seconds;
+  int64 count;
+  int64 max_count;
+  ProfileStat(): num_calls(0), seconds(0.0), count(0), max_count(0) { }
+  void Add(const ProfileStat &other) {
+    num_calls += other.num_calls;
+    seconds += other.seconds;
+    count += other.count;
+    max_count = std::max(max_count, other.max_count);
+  }
+};
+
+typedef std::vector<ProfileStat> ProfileTable;
+
+// The following are allocated once and never freed, so that they are still
+// there when we print the summary at exit, whatever the order of destruction
+// of static objects.  profile_names, profile_tables and profile_totals are
+// protected by the profile lock.  Each table in profile_tables is only written
+// to by its own thread, and is only resized with the lock held, so the summary
+// never reads a table while it is being reallocated.  When a thread exits, its
+// table is added to profile_totals and freed (see ProfileFreeTable()), so
+// programs that start a thread per task do not accumulate tables.
+static std::vector<std::string> *profile_names = NULL;
+static std::vector<ProfileTable*> *profile_tables = NULL;
+static ProfileTable *profile_totals = NULL;
+
+static void ProfileFreeTable(void *ptr);
+static void ProfileInit();
+
+// The following wrap the threading primitives, which differ between Windows
+// and POSIX systems.
+#if defined(_MSC_VER)
+static SRWLOCK profile_lock = SRWLOCK_INIT;
+static INIT_ONCE profile_once = INIT_ONCE_STATIC_INIT;
+static DWORD profile_key;
+static void ProfileLock() { AcquireSRWLockExclusive(&profile_lock); }
+static void ProfileUnlock() { ReleaseSRWLockExclusive(&profile_lock); }
+static VOID NTAPI ProfileFlsCallback(PVOID ptr) { ProfileFreeTable(ptr); }
+static BOOL CALLBACK ProfileInitOnce(PINIT_ONCE, PVOID, PVOID*) {
+  ProfileInit();
+  return TRUE;
+}
+static void ProfileCallOnce() {
+  InitOnceExecuteOnce(&profile_once, ProfileInitOnce, NULL, NULL);
+}
+static void ProfileCreateKey() {
+  profile_key = FlsAlloc(ProfileFlsCallback);
+  KALDI_ASSERT(profile_key != FLS_OUT_OF_INDEXES);
+}
+static void *ProfileGetSpecific() { return FlsGetValue(profile_key); }
+static void ProfileSetSpecific(void *ptr) { FlsSetValue(profile_key, ptr); }
+#else
+static pthread_mutex_t profile_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t profile_once = PTHREAD_ONCE_INIT;
+static pthread_key_t profile_key;
+static void ProfileLock() { pthread_mutex_lock(&profile_mutex); }
+static void ProfileUnlock() { pthread_mutex_unlock(&profile_mutex); }
+static void ProfileCallOnce() { pthread_once(&profile_once, ProfileInit); }
+static void ProfileCreateKey() {
+  int ret = pthread_key_create(&profile_key, ProfileFreeTable);
+  KALDI_ASSERT(ret == 0);
+}
+static void *ProfileGetSpecific() { return pthread_getspecific(profile_key); }
+static void ProfileSetSpecific(void *ptr) {
+  pthread_setspecific(profile_key, ptr);
+}
+#endif
+
+#ifdef KALDI_PROFILE
+static void ProfilePrintAtExit() {
+  const char *filename = getenv("KALDI_PROFILE_OUTPUT");
+  if (filename != NULL && *filename != '\0') {
+    std::ofstream os(filename);
+    if (os.good()) {
+      ProfilePrintSummary(os);
+      return;
+    }
+    std::cerr << "Could not open " << filename
+              << " to write profile; writing to standard error.\n";
+  }
+  ProfilePrintSummary(std::cerr);
+}
+#endif
+
+static void ProfileInit() {
+  ProfileCreateKey();
+  profile_names = new std::vector<std::string>();
+  profile_tables = new std::vector<ProfileTable*>();
+  profile_totals = new ProfileTable();
+#ifdef KALDI_PROFILE
+  // Only print the summary if profiling was compiled in; programs such as
+  // kaldi-profile-test call the functions directly and print it themselves.
+  atexit(ProfilePrintAtExit);
+#endif
+}
+
+// Called at exit of a thread that has a table; it adds the table to the
+// totals, and frees it.
+static void ProfileFreeTable(void *ptr) {
+  ProfileTable *table = static_cast<ProfileTable*>(ptr);
+  if (table == NULL) return;
+  ProfileLock();
+  if (profile_totals->size() < table->size())
+    profile_totals->resize(table->size());
+  for (size_t i = 0; i < table->size(); i++)
+    (*profile_totals)[i].Add((*table)[i]);
+  for (size_t t = 0; t < profile_tables->size(); t++) {
+    if ((*profile_tables)[t] == table) {
+      (*profile_tables)[t] = profile_tables->back();
+      profile_tables->pop_back();
+      break;
+    }
+  }
+  ProfileUnlock();
+  delete table;
+}
+
+// Returns the calling thread's table, resized if necessary so that "id" is a
+// valid index.
+static inline ProfileTable *ProfileGetTable(int32 id) {
+  ProfileTable *table = static_cast<ProfileTable*>(ProfileGetSpecific());
+  if (table == NULL || static_cast<size_t>(id) >= table->size()) {
+    ProfileLock();
+    if (table == NULL) {
+      table = new ProfileTable();
+      profile_tables->push_back(table);
+    }
+    // Size it for all names registered so far, so that we rarely come back
+    // here.
+    table->resize(profile_names->size());
+    ProfileUnlock();
+    ProfileSetSpecific(table);
+    KALDI_ASSERT(static_cast<size_t>(id) < table->size());
+  }
+  return table;
+}
+
+int32 ProfileGetId(const char *name) {
+  ProfileCallOnce();
+  ProfileLock();
+  int32 ans = -1;
+  for (size_t i = 0; i < profile_names->size(); i++) {
+    if ((*profile_names)[i] == name) {
+      ans = i;
+      break;
+    }
+  }
+  if (ans == -1) {
+    ans = profile_names->size();
+    profile_names->push_back(name);
+  }
+  ProfileUnlock();
+  return ans;
+}
+
+void ProfileAddTime(int32 id, double seconds) {
+  ProfileStat &stat = (*ProfileGetTable(id))[id];
+  stat.num_calls++;
+  stat.seconds += seconds;
+}
+
+void ProfileAddCount(int32 id, int64 count) {
+  ProfileStat &stat = (*ProfileGetTable(id))[id];
+  stat.num_calls++;
+  stat.count += count;
+  if (count > stat.max_count) stat.max_count = count;
+}
+
+void ProfileAddMax(int32 id, int64 value) {
+  ProfileStat &stat = (*ProfileGetTable(id))[id];
+  stat.num_calls++;
+  if (value > stat.max_count) stat.max_count = value;
+}
+
+double ProfileCurrentTime() {
+#if defined(_MSC_VER)
+  LARGE_INTEGER now, freq;
+  QueryPerformanceCounter(&now);
+  if (QueryPerformanceFrequency(&freq) == 0) return 0.0;
+  return static_cast<double>(now.QuadPart) / static_cast<double>(freq.QuadPart);
+#else
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return now.tv_sec + 1.0e-06 * now.tv_usec;
+#endif
+}
+
+void ProfilePrintSummary(std::ostream &os) {
+  ProfileCallOnce();
+  ProfileLock();
+  ProfileTable totals(profile_names->size());
+  for (size_t i = 0; i < profile_totals->size(); i++)
+    totals[i].Add((*profile_totals)[i]);
+  for (size_t t = 0; t < profile_tables->size(); t++) {
+    const ProfileTable &table = *((*profile_tables)[t]);
+    for (size_t i = 0; i < table.size(); i++)
+      totals[i].Add(table[i]);
+  }
+  os << "# name\tnum-calls\ttotal-seconds\ttotal-count\tmax-count\n";
+  for (size_t i = 0; i < totals.size(); i++)
+    os << (*profile_names)[i] << '\t' << totals[i].num_calls << '\t'
+       << totals[i].seconds << '\t' << totals[i].count << '\t'
+       << totals[i].max_count << '\n';
+  os.flush();
+  ProfileUnlock();
+}
+
+void ProfileReset() {
+  ProfileCallOnce();
+  ProfileLock();
+  for (size_t i = 0; i < profile_totals->size(); i++)
+    (*profile_totals)[i] = ProfileStat();
+  for (size_t t = 0; t < profile_tables->size(); t++) {
+    ProfileTable &table = *((*profile_tables)[t]);
+    for (size_t i = 0; i < table.size(); i++)
+      table[i] = ProfileStat();
+  }
+  ProfileUnlock();
+}
+
+}  // namespace kaldi
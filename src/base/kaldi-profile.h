@@ -0,0 +1,117 @@
+// base/kaldi-profile.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_BASE_KALDI_PROFILE_H_
+#define KALDI_BASE_KALDI_PROFILE_H_
+
+#include <string>
+#include <ostream>
+#include "base/kaldi-types.h"
+
+/**
+   This header provides low-overhead instrumentation of the hot paths of the
+   code (feature extraction, neural-net computation, the decoders' per-frame
+   functions, lattice determinization), so that we can see which stage the
+   real-time factor goes to.  It is compiled out unless you add -DKALDI_PROFILE
+   to your CXXFLAGS (e.g. in EXTRA_CXXFLAGS), in which case the macros
+   below are active.
+
+   Each named quantity is either a timer (KALDI_PROFILE_SCOPE, which times the
+   enclosing scope), a counter (KALDI_PROFILE_COUNT, which adds a number, e.g.
+   the number of active tokens, and also keeps the largest number added) or a
+   maximum (KALDI_PROFILE_MAX, which only keeps the largest value seen, for
+   things like peak memory where a sum would be meaningless).  The statistics
+   are accumulated in a separate table for each thread, which only takes a lock
+   when a new name has been registered; when a thread exits its table is added
+   to a global total and freed.  When the program exits, the summary is written
+   to the file named by the environment variable KALDI_PROFILE_OUTPUT if it is
+   set, or to the standard error otherwise, as tab-separated lines of the form
+     <name> <num-calls> <total-seconds> <total-count> <max-count>
+   preceded by a header line starting with '#'.
+*/
+
+namespace kaldi {
+
+/// Returns a numeric id for the name, registering it if necessary.  This
+/// locks a mutex, so the macros below call it only once per call site.
+int32 ProfileGetId(const char *name);
+
+/// Adds "seconds" to the time for this id, and one to its number of calls, in
+/// the calling thread's table.
+void ProfileAddTime(int32 id, double seconds);
+
+/// Adds "count" to the count for this id, and one to its number of calls, in
+/// the calling thread's table.
+void ProfileAddCount(int32 id, int64 count);
+
+/// Sets the maximum for this id to "value" if it is larger, and adds one to its
+/// number of calls, in the calling thread's table.
+void ProfileAddMax(int32 id, int64 value);
+
+/// Returns the time in seconds from an arbitrary starting point.
+double ProfileCurrentTime();
+
+/// Writes the statistics summed over all threads, in the format described
+/// above.  If compiled with -DKALDI_PROFILE, this is called automatically at
+/// exit if any statistics were registered.
+void ProfilePrintSummary(std::ostream &os);
+
+/// Sets all statistics to zero (for testing).
+void ProfileReset();
+
+class ProfileScopedTimer {
+ public:
+  explicit ProfileScopedTimer(int32 id): id_(id),
+                                         start_(ProfileCurrentTime()) { }
+  ~ProfileScopedTimer() { ProfileAddTime(id_, ProfileCurrentTime() - start_); }
+ private:
+  int32 id_;
+  double start_;
+};
+
+}  // namespace kaldi
+
+#define KALDI_PROFILE_CONCAT_(a, b) a ## b
+#define KALDI_PROFILE_CONCAT(a, b) KALDI_PROFILE_CONCAT_(a, b)
+
+#ifdef KALDI_PROFILE
+#define KALDI_PROFILE_SCOPE(name)                                       \
+  static const ::kaldi::int32 KALDI_PROFILE_CONCAT(kaldi_profile_id_,   \
+                                                   __LINE__) =          \
+      ::kaldi::ProfileGetId(name);                                      \
+  ::kaldi::ProfileScopedTimer KALDI_PROFILE_CONCAT(kaldi_profile_timer_, \
+                                                   __LINE__)(           \
+      KALDI_PROFILE_CONCAT(kaldi_profile_id_, __LINE__))
+#define KALDI_PROFILE_COUNT(name, count)                                \
+  do {                                                                  \
+    static const ::kaldi::int32 kaldi_profile_id =                      \
+        ::kaldi::ProfileGetId(name);                                    \
+    ::kaldi::ProfileAddCount(kaldi_profile_id, count);                  \
+  } while (0)
+#define KALDI_PROFILE_MAX(name, value)                                  \
+  do {                                                                  \
+    static const ::kaldi::int32 kaldi_profile_id =                      \
+        ::kaldi::ProfileGetId(name);                                    \
+    ::kaldi::ProfileAddMax(kaldi_profile_id, value);                    \
+  } while (0)
+#else
+#define KALDI_PROFILE_SCOPE(name)
+#define KALDI_PROFILE_COUNT(name, count)
+#define KALDI_PROFILE_MAX(name, value)
+#endif
+
+#endif  // KALDI_BASE_KALDI_PROFILE_H_
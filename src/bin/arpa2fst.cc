@@ -27,18 +27,26 @@
  */
 
 #include <string>
-#include "lm/kaldi-lm.h"
+#include "fstext/fstext-utils.h"
+#include "lm/arpa-lm-compiler.h"
 #include "util/parse-options.h"
 
 int main(int argc, char *argv[]) {
   try {
+    using namespace kaldi;
     const char *usage  =
         "Converts an ARPA format language model into a FST\n"
-        "Usage: arpa2fst [opts] (input_arpa|-)  [output_fst|-]\n";
-    kaldi::ParseOptions po(usage);
+        "Usage: arpa2fst [opts] (input_arpa|-)  [output_fst|-]\n"
+        " e.g.: arpa2fst 'gunzip -c lm.arpa.gz |' G.fst\n"
+        "With --max-order=1 this gives the unigram grammar from which to build\n"
+        "a small decoding graph for latgen-biglm-faster-mapped.\n";
+    ParseOptions po(usage);
 
     bool natural_base = true;
+    int32 max_order = 0;
     po.Register("natural-base", &natural_base, "Use log-base e (not log-base 10)");
+    po.Register("max-order", &max_order, "If >0, only use n-grams up to this "
+                "order, ignoring the rest of the language model.");
     po.Read(argc, argv);
 
     if (po.NumArgs() != 1 && po.NumArgs() != 2) {
@@ -47,11 +55,28 @@ int main(int argc, char *argv[]) {
     }
     std::string arpa_filename = po.GetArg(1),
         fst_filename = po.GetOptArg(2);
-    
-    kaldi::LangModelFst lm;
-    // read from standard input and write to standard output
-    lm.Read(arpa_filename, kaldi::kArpaLm, NULL, natural_base);
-    lm.Write(fst_filename);
+
+    fst::StdVectorFst fst;
+    fst.SetStart(fst.AddState());
+    {
+      fst::SymbolTable symbols("lmInputSymbols");
+      symbols.AddSymbol("<eps>");
+      fst.SetInputSymbols(&symbols);  // This makes a copy.
+    }
+    fst::SymbolTable *symbols = fst.MutableInputSymbols();
+    int32 bos_symbol = symbols->AddSymbol("<s>"),
+        eos_symbol = symbols->AddSymbol("</s>");
+
+    ArpaParseOptions options;
+    options.oov_handling = ArpaParseOptions::kAddToSymbols;
+    options.max_order = max_order;
+    ArpaLmCompiler compiler(options, bos_symbol, eos_symbol, natural_base,
+                            &fst);
+    {
+      Input ki(arpa_filename);
+      compiler.Read(ki.Stream(), false);
+    }
+    fst::WriteFstKaldi(fst, fst_filename);
     exit(0);
   } catch(const std::exception &e) {
     std::cerr << e.what();
@@ -59,4 +84,3 @@ int main(int argc, char *argv[]) {
   }
 }
 /// @}
-
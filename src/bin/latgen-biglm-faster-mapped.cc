@@ -0,0 +1,220 @@
+// bin/latgen-biglm-faster-mapped.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "hmm/transition-model.h"
+#include "fstext/fstext-lib.h"
+#include "decoder/decoder-wrappers.h"
+#include "decoder/decodable-matrix.h"
+#include "lm/const-arpa-lm.h"
+#include "base/timer.h"
+
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+    using fst::VectorFst;
+    using fst::StdArc;
+
+    const char *usage =
+        "Generate lattices, reading log-likelihoods as matrices, composing the\n"
+        "decoding graph with a language model on the fly.  The graph is built\n"
+        "with a small LM, e.g. the unigram part of the real LM (arpa2fst\n"
+        "--max-order=1), which acts as the LM lookahead; as the decoder crosses\n"
+        "words it applies the difference between the real LM and the small one.\n"
+        "So the real LM is never compiled into the graph, and it can be changed\n"
+        "without rebuilding the graph.  The lattices are the same kind as those\n"
+        "of latgen-faster-mapped.\n"
+        " (model is needed only for the integer mappings in its transition-model)\n"
+        "Usage: latgen-biglm-faster-mapped [options] trans-model-in "
+        "(fst-in|fsts-rspecifier) oldlm-fst-in newlm-in loglikes-rspecifier "
+        "lattice-wspecifier [ words-wspecifier [alignments-wspecifier] ]\n"
+        " e.g.: latgen-biglm-faster-mapped --use-const-arpa=true final.mdl "
+        "HCLG_unigram.fst G_unigram.fst G.carpa ark:loglikes.ark ark:lat.ark\n"
+        "where oldlm-fst-in is the grammar the graph was built with, and newlm-in\n"
+        "is the real LM, as an FST or (with --use-const-arpa) in the format of\n"
+        "arpa-to-const-arpa.  See also: gmm-latgen-biglm-faster\n";
+    ParseOptions po(usage);
+    Timer timer;
+    bool allow_partial = false;
+    BaseFloat acoustic_scale = 0.1;
+    bool use_const_arpa = false;
+    LatticeBiglmFasterDecoderConfig config;
+
+    std::string word_syms_filename;
+    config.Register(&po);
+    po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
+    po.Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
+    po.Register("allow-partial", &allow_partial, "If true, produce output even if end state was not reached.");
+    po.Register("use-const-arpa", &use_const_arpa, "If true, newlm-in is a "
+                "language model in ConstArpaLm format rather than an FST.");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() < 6 || po.NumArgs() > 8) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string model_in_filename = po.GetArg(1),
+        fst_in_str = po.GetArg(2),
+        old_lm_fst_rxfilename = po.GetArg(3),
+        new_lm_rxfilename = po.GetArg(4),
+        feature_rspecifier = po.GetArg(5),
+        lattice_wspecifier = po.GetArg(6),
+        words_wspecifier = po.GetOptArg(7),
+        alignment_wspecifier = po.GetOptArg(8);
+
+    TransitionModel trans_model;
+    ReadKaldiObject(model_in_filename, &trans_model);
+
+    VectorFst<StdArc> *old_lm_fst = fst::ReadFstKaldi(old_lm_fst_rxfilename);
+    ApplyProbabilityScale(-1.0, old_lm_fst); // Negate old LM probs...
+
+    VectorFst<StdArc> *new_lm_fst = NULL;
+    ConstArpaLm const_arpa;
+    if (use_const_arpa)
+      ReadKaldiObject(new_lm_rxfilename, &const_arpa);
+    else
+      new_lm_fst = fst::ReadFstKaldi(new_lm_rxfilename);
+
+    bool determinize = config.determinize_lattice;
+    CompactLatticeWriter compact_lattice_writer;
+    LatticeWriter lattice_writer;
+    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier)
+           : lattice_writer.Open(lattice_wspecifier)))
+      KALDI_ERR << "Could not open table for writing lattices: "
+                 << lattice_wspecifier;
+
+    Int32VectorWriter words_writer(words_wspecifier);
+
+    Int32VectorWriter alignment_writer(alignment_wspecifier);
+
+    fst::SymbolTable *word_syms = NULL;
+    if (word_syms_filename != "")
+      if (!(word_syms = fst::SymbolTable::ReadText(word_syms_filename)))
+        KALDI_ERR << "Could not read symbol table from file "
+                   << word_syms_filename;
+
+    double tot_like = 0.0;
+    kaldi::int64 frame_count = 0;
+    int num_success = 0, num_fail = 0;
+
+    bool single_fst =
+        (ClassifyRspecifier(fst_in_str, NULL, NULL) == kNoRspecifier);
+    VectorFst<StdArc> *decode_fst = NULL;
+    SequentialTableReader<fst::VectorFstHolder> fst_reader;
+    SequentialBaseFloatMatrixReader loglike_reader;
+    RandomAccessBaseFloatMatrixReader loglike_random_reader;
+    // As in gmm-latgen-biglm-faster, the on-demand LM FSTs live as long as
+    // the process, so the LM states they have expanded are shared by all the
+    // utterances.
+    fst::BackoffDeterministicOnDemandFst<StdArc> old_lm_dfst(*old_lm_fst);
+    fst::DeterministicOnDemandFst<StdArc> *new_lm_dfst = NULL;
+    if (use_const_arpa)
+      new_lm_dfst = new ConstArpaLmDeterministicFst(const_arpa);
+    else
+      new_lm_dfst = new fst::BackoffDeterministicOnDemandFst<StdArc>(
+          *new_lm_fst);
+    fst::ComposeDeterministicOnDemandFst<StdArc> compose_dfst(&old_lm_dfst,
+                                                              new_lm_dfst);
+    // With a single FST we keep the decoder, and with it the arcs of
+    // compose_dfst that it has cached (--lm-cache-size), from one utterance
+    // to the next.
+    LatticeBiglmFasterDecoder *decoder = NULL;
+    if (single_fst) {
+      // Input FST is just one FST, not a table of FSTs.
+      decode_fst = fst::ReadFstKaldi(fst_in_str);
+      loglike_reader.Open(feature_rspecifier);
+      decoder = new LatticeBiglmFasterDecoder(*decode_fst, config,
+                                              &compose_dfst);
+    } else {
+      fst_reader.Open(fst_in_str);
+      loglike_random_reader.Open(feature_rspecifier);
+    }
+
+    while (single_fst ? !loglike_reader.Done() : !fst_reader.Done()) {
+      std::string utt;
+      Matrix<BaseFloat> loglikes;
+      if (single_fst) {
+        utt = loglike_reader.Key();
+        loglikes = loglike_reader.Value();
+        loglike_reader.FreeCurrent();
+        loglike_reader.Next();
+      } else {
+        utt = fst_reader.Key();
+        if (!loglike_random_reader.HasKey(utt)) {
+          KALDI_WARN << "Not decoding utterance " << utt
+                     << " because no loglikes available.";
+          num_fail++;
+          fst_reader.Next();
+          continue;
+        }
+        loglikes = loglike_random_reader.Value(utt);
+      }
+      if (loglikes.NumRows() == 0) {
+        KALDI_WARN << "Zero-length utterance: " << utt;
+        num_fail++;
+        if (!single_fst) fst_reader.Next();
+        continue;
+      }
+
+      if (!single_fst) {
+        delete decoder;
+        decoder = new LatticeBiglmFasterDecoder(fst_reader.Value(), config,
+                                                &compose_dfst);
+      }
+      DecodableMatrixScaledMapped decodable(trans_model, loglikes,
+                                            acoustic_scale);
+      double like;
+      if (DecodeUtteranceLatticeFaster(
+              *decoder, decodable, trans_model, word_syms, utt,
+              acoustic_scale, determinize, allow_partial, &alignment_writer,
+              &words_writer, &compact_lattice_writer, &lattice_writer,
+              &like)) {
+        tot_like += like;
+        frame_count += loglikes.NumRows();
+        num_success++;
+      } else num_fail++;
+      if (!single_fst) fst_reader.Next();
+    }
+    delete decoder;  // delete this before decode_fst.
+    delete decode_fst;
+    delete new_lm_dfst;
+    delete old_lm_fst;
+    delete new_lm_fst;
+
+    double elapsed = timer.Elapsed();
+    KALDI_LOG << "Time taken "<< elapsed
+              << "s: real-time factor assuming 100 frames/sec is "
+              << (elapsed*100.0/frame_count);
+    KALDI_LOG << "Done " << num_success << " utterances, failed for "
+              << num_fail;
+    KALDI_LOG << "Overall log-likelihood per frame is " << (tot_like/frame_count) << " over "
+              << frame_count<<" frames.";
+
+    if (word_syms) delete word_syms;
+    if (num_success != 0) return 0;
+    else return 1;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -49,10 +49,12 @@ int main(int argc, char *argv[]) {
     bool allow_partial = false;
     BaseFloat acoustic_scale = 0.1;
     LatticeFasterDecoderConfig config;
+    EpsilonClosureConfig epsilon_closure_config;
     TaskSequencerConfig sequencer_config; // has --num-threads option
 
     std::string word_syms_filename;
     config.Register(&po);
+    epsilon_closure_config.Register(&po);
     sequencer_config.Register(&po);
 
     po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
@@ -100,12 +102,15 @@ int main(int argc, char *argv[]) {
     int num_success = 0, num_fail = 0;
     VectorFst<StdArc> *decode_fst = NULL; // only used if there is a single
                                           // decoding graph.
+    EpsilonClosureTable *epsilon_closure_table = NULL;
     
     TaskSequencer<DecodeUtteranceLatticeFasterClass> sequencer(sequencer_config);
     if (ClassifyRspecifier(fst_in_str, NULL, NULL) == kNoRspecifier) {
       SequentialBaseFloatMatrixReader loglike_reader(feature_rspecifier);
       // Input FST is just one FST, not a table of FSTs.
       decode_fst = fst::ReadFstKaldi(fst_in_str);
+      epsilon_closure_table =
+          NewEpsilonClosureTable(*decode_fst, epsilon_closure_config);
 
       {
         for (; !loglike_reader.Done(); loglike_reader.Next()) {
@@ -122,6 +127,7 @@ int main(int argc, char *argv[]) {
       
           LatticeFasterDecoder *decoder = new LatticeFasterDecoder(*decode_fst,
                                                                    config);
+          decoder->SetEpsilonClosureTable(epsilon_closure_table);
           DecodableMatrixScaledMapped *decodable = 
               new DecodableMatrixScaledMapped(trans_model, acoustic_scale, loglikes);
           DecodeUtteranceLatticeFasterClass *task =
@@ -171,6 +177,7 @@ int main(int argc, char *argv[]) {
     sequencer.Wait();
 
     if (decode_fst != NULL) delete decode_fst;
+    delete epsilon_closure_table;
       
     double elapsed = timer.Elapsed();
     KALDI_LOG << "Decoded with " << sequencer_config.num_threads << " threads.";
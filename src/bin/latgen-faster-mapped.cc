@@ -48,9 +48,11 @@ int main(int argc, char *argv[]) {
     bool allow_partial = false;
     BaseFloat acoustic_scale = 0.1;
     LatticeFasterDecoderConfig config;
+    EpsilonClosureConfig epsilon_closure_config;
     
     std::string word_syms_filename;
     config.Register(&po);
+    epsilon_closure_config.Register(&po);
     po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
 
     po.Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
@@ -99,9 +101,12 @@ int main(int argc, char *argv[]) {
       SequentialBaseFloatMatrixReader loglike_reader(feature_rspecifier);
       // Input FST is just one FST, not a table of FSTs.
       VectorFst<StdArc> *decode_fst = fst::ReadFstKaldi(fst_in_str);
+      EpsilonClosureTable *epsilon_closure_table =
+          NewEpsilonClosureTable(*decode_fst, epsilon_closure_config);
 
       {
         LatticeFasterDecoder decoder(*decode_fst, config);
+        decoder.SetEpsilonClosureTable(epsilon_closure_table);
     
         for (; !loglike_reader.Done(); loglike_reader.Next()) {
           std::string utt = loglike_reader.Key();
@@ -128,6 +133,7 @@ int main(int argc, char *argv[]) {
         }
       }
       delete decode_fst; // delete this only after decoder goes out of scope.
+      delete epsilon_closure_table;
     } else { // We have different FSTs for different utterances.
       SequentialTableReader<fst::VectorFstHolder> fst_reader(fst_in_str);
       RandomAccessBaseFloatMatrixReader loglike_reader(feature_rspecifier);          
@@ -0,0 +1,127 @@
+// decoder/decodable-subsampled.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_DECODER_DECODABLE_SUBSAMPLED_H_
+#define KALDI_DECODER_DECODABLE_SUBSAMPLED_H_
+
+#include "base/kaldi-common.h"
+#include "itf/options-itf.h"
+#include "itf/decodable-itf.h"
+
+namespace kaldi {
+
+struct DecodableSubsampledConfig {
+  int32 frame_subsampling_factor;
+  bool interpolate;
+
+  DecodableSubsampledConfig(): frame_subsampling_factor(1),
+                               interpolate(false) { }
+
+  void Register(OptionsItf *po) {
+    po->Register("frame-subsampling-factor", &frame_subsampling_factor,
+                 "If >1, evaluate the acoustic model only on every n'th "
+                 "frame and reuse its scores for the frames in between.");
+    po->Register("subsampling-interpolate", &interpolate,
+                 "If true (and --frame-subsampling-factor > 1), linearly "
+                 "interpolate the scores of skipped frames between the "
+                 "neighboring evaluated frames, instead of repeating the "
+                 "score of the preceding evaluated frame.");
+  }
+  void Check() const {
+    KALDI_ASSERT(frame_subsampling_factor > 0);
+  }
+};
+
+/**
+   DecodableSubsampled wraps a decodable object that was evaluated at a reduced
+   frame rate, i.e. whose frame i corresponds to frame i * n at the original
+   frame rate, where n is config.frame_subsampling_factor.  It presents scores
+   at the original frame rate, either by repeating the score of the most recent
+   evaluated frame or by linear interpolation between evaluated frames, so the
+   decoder still advances one frame at a time and the time information in the
+   lattices it produces is unchanged.
+
+   If num_frames >= 0 it is the number of frames at the original rate (e.g. the
+   number of rows of the feature matrix); otherwise, which is what you'd do in
+   online decoding, it is worked out from the wrapped object's
+   NumFramesReady() and IsLastFrame(), and the utterance will be rounded up to
+   a multiple of n frames.
+*/
+class DecodableSubsampled: public DecodableInterface {
+ public:
+  DecodableSubsampled(DecodableInterface *decodable,
+                      const DecodableSubsampledConfig &config,
+                      int32 num_frames = -1,
+                      bool delete_decodable = false):
+      decodable_(decodable), factor_(config.frame_subsampling_factor),
+      interpolate_(config.interpolate), num_frames_(num_frames),
+      delete_decodable_(delete_decodable) {
+    KALDI_ASSERT(decodable_ != NULL);
+    config.Check();
+  }
+
+  virtual BaseFloat LogLikelihood(int32 frame, int32 index) {
+    int32 i = frame / factor_, r = frame % factor_;
+    BaseFloat ans = decodable_->LogLikelihood(i, index);
+    if (!interpolate_ || r == 0 || i + 1 >= decodable_->NumFramesReady())
+      return ans;
+    BaseFloat next = decodable_->LogLikelihood(i + 1, index);
+    return ans + (next - ans) * r / static_cast<BaseFloat>(factor_);
+  }
+
+  virtual int32 NumFramesReady() const {
+    int32 ready = decodable_->NumFramesReady();
+    if (ready == 0) return 0;
+    if (num_frames_ >= 0) {
+      // Interpolated frames need the following evaluated frame, unless we
+      // have all the evaluated frames there will be.
+      int32 ans = (interpolate_ &&
+                   ready * factor_ < num_frames_ ?
+                   (ready - 1) * factor_ + 1 : ready * factor_);
+      return std::min(ans, num_frames_);
+    } else {
+      if (interpolate_ && !decodable_->IsLastFrame(ready - 1))
+        return (ready - 1) * factor_ + 1;
+      return ready * factor_;
+    }
+  }
+
+  virtual bool IsLastFrame(int32 frame) const {
+    if (num_frames_ >= 0)
+      return (frame == num_frames_ - 1);
+    return (frame % factor_ == factor_ - 1 &&
+            decodable_->IsLastFrame(frame / factor_));
+  }
+
+  virtual int32 NumIndices() const { return decodable_->NumIndices(); }
+
+  virtual ~DecodableSubsampled() {
+    if (delete_decodable_) delete decodable_;
+  }
+ private:
+  DecodableInterface *decodable_;
+  int32 factor_;
+  bool interpolate_;
+  int32 num_frames_;
+  bool delete_decodable_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(DecodableSubsampled);
+};
+
+
+}  // namespace kaldi
+
+#endif  // KALDI_DECODER_DECODABLE_SUBSAMPLED_H_
@@ -19,6 +19,7 @@
 
 #include "decoder/decoder-wrappers.h"
 #include "decoder/faster-decoder.h"
+#include "lat/lattice-functions.h"
 
 namespace kaldi {
 
@@ -193,9 +194,72 @@ DecodeUtteranceLatticeFasterClass::~DecodeUtteranceLatticeFasterClass() {
 }
 
 
+// The next three functions do the output that DecodeUtteranceLatticeFaster()
+// and DecodeUtteranceLatticeFasterSegmented() have in common.
+
+// If the decoder did not reach a final state, warns and returns allow_partial.
+static bool CheckReachedFinal(bool reached_final, bool allow_partial,
+                              const std::string &utt) {
+  if (!reached_final) {
+    if (allow_partial) {
+      KALDI_WARN << "Outputting partial output for utterance " << utt
+                 << " since no final-state reached\n";
+    } else {
+      KALDI_WARN << "Not producing output for utterance " << utt
+                 << " since no final-state reached and "
+                 << "--allow-partial=false.\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+// Writes the words and alignment of the best path "decoded" (a linear lattice)
+// if the writers are open, and prints the words if word_syms != NULL.  Outputs
+// the weight of the path and its number of frames, and returns its
+// log-likelihood.
+static double OutputBestPath(const Lattice &decoded,
+                             const fst::SymbolTable *word_syms,
+                             const std::string &utt,
+                             Int32VectorWriter *alignment_writer,
+                             Int32VectorWriter *words_writer,
+                             LatticeWeight *weight,
+                             int32 *num_frames) {
+  std::vector<int32> alignment;
+  std::vector<int32> words;
+  GetLinearSymbolSequence(decoded, &alignment, &words, weight);
+  *num_frames = alignment.size();
+  if (words_writer->IsOpen())
+    words_writer->Write(utt, words);
+  if (alignment_writer->IsOpen())
+    alignment_writer->Write(utt, alignment);
+  if (word_syms != NULL) {
+    std::cerr << utt << ' ';
+    for (size_t i = 0; i < words.size(); i++) {
+      std::string s = word_syms->Find(words[i]);
+      if (s == "")
+        KALDI_ERR << "Word-id " << words[i] << " not in symbol table.";
+      std::cerr << s << ' ';
+    }
+    std::cerr << '\n';
+  }
+  return -(weight->Value1() + weight->Value2());
+}
+
+static void LogUtteranceLikelihood(const std::string &utt, double likelihood,
+                                   int32 num_frames,
+                                   const LatticeWeight &weight) {
+  KALDI_LOG << "Log-like per frame for utterance " << utt << " is "
+            << (likelihood / num_frames) << " over "
+            << num_frames << " frames.";
+  KALDI_VLOG(2) << "Cost for utterance " << utt << " is "
+                << weight.Value1() << " + " << weight.Value2();
+}
+
 // Takes care of output.  Returns true on success.
+template <typename FST_DECODER>
 bool DecodeUtteranceLatticeFaster(
-    LatticeFasterDecoder &decoder, // not const but is really an input.
+    FST_DECODER &decoder, // not const but is really an input.
     DecodableInterface &decodable, // not const but is really an input.
     const TransitionModel &trans_model,
     const fst::SymbolTable *word_syms,
@@ -214,17 +278,8 @@ bool DecodeUtteranceLatticeFaster(
     KALDI_WARN << "Failed to decode file " << utt;
     return false;
   }
-  if (!decoder.ReachedFinal()) {
-    if (allow_partial) {
-      KALDI_WARN << "Outputting partial output for utterance " << utt
-                 << " since no final-state reached\n";
-    } else {
-      KALDI_WARN << "Not producing output for utterance " << utt
-                 << " since no final-state reached and "
-                 << "--allow-partial=false.\n";
-      return false;
-    }
-  }
+  if (!CheckReachedFinal(decoder.ReachedFinal(), allow_partial, utt))
+    return false;
 
   double likelihood;
   LatticeWeight weight;
@@ -235,25 +290,8 @@ bool DecodeUtteranceLatticeFaster(
       // Shouldn't really reach this point as already checked success.
       KALDI_ERR << "Failed to get traceback for utterance " << utt;
 
-    std::vector<int32> alignment;
-    std::vector<int32> words;
-    GetLinearSymbolSequence(decoded, &alignment, &words, &weight);
-    num_frames = alignment.size();
-    if (words_writer->IsOpen())
-      words_writer->Write(utt, words);
-    if (alignment_writer->IsOpen())
-      alignment_writer->Write(utt, alignment);
-    if (word_syms != NULL) {
-      std::cerr << utt << ' ';
-      for (size_t i = 0; i < words.size(); i++) {
-        std::string s = word_syms->Find(words[i]);
-        if (s == "")
-          KALDI_ERR << "Word-id " << words[i] << " not in symbol table.";
-        std::cerr << s << ' ';
-      }
-      std::cerr << '\n';
-    }
-    likelihood = -(weight.Value1() + weight.Value2());
+    likelihood = OutputBestPath(decoded, word_syms, utt, alignment_writer,
+                                words_writer, &weight, &num_frames);
   }
 
   // Get lattice, and do determinization if requested.
@@ -282,11 +320,85 @@ bool DecodeUtteranceLatticeFaster(
       fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale), &lat);
     lattice_writer->Write(utt, lat);
   }
-  KALDI_LOG << "Log-like per frame for utterance " << utt << " is "
-            << (likelihood / num_frames) << " over "
-            << num_frames << " frames.";
-  KALDI_VLOG(2) << "Cost for utterance " << utt << " is "
-                << weight.Value1() << " + " << weight.Value2();
+  LogUtteranceLikelihood(utt, likelihood, num_frames, weight);
+  *like_ptr = likelihood;
+  return true;
+}
+
+// Instantiate the template above for the two decoders it is used with.
+template
+bool DecodeUtteranceLatticeFaster(
+    LatticeFasterDecoder &decoder,
+    DecodableInterface &decodable,
+    const TransitionModel &trans_model,
+    const fst::SymbolTable *word_syms,
+    std::string utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial,
+    Int32VectorWriter *alignment_writer,
+    Int32VectorWriter *words_writer,
+    CompactLatticeWriter *compact_lattice_writer,
+    LatticeWriter *lattice_writer,
+    double *like_ptr);
+
+template
+bool DecodeUtteranceLatticeFaster(
+    LatticeBiglmFasterDecoder &decoder,
+    DecodableInterface &decodable,
+    const TransitionModel &trans_model,
+    const fst::SymbolTable *word_syms,
+    std::string utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial,
+    Int32VectorWriter *alignment_writer,
+    Int32VectorWriter *words_writer,
+    CompactLatticeWriter *compact_lattice_writer,
+    LatticeWriter *lattice_writer,
+    double *like_ptr);
+
+bool DecodeUtteranceLatticeFasterSegmented(
+    const fst::Fst<fst::StdArc> &fst,
+    const LatticeFasterDecoderConfig &decoder_config,
+    const SegmentedDecodingConfig &segment_config,
+    DecodableInterface &decodable, // not const but is really an input.
+    const TransitionModel &trans_model,
+    const fst::SymbolTable *word_syms,
+    std::string utt,
+    double acoustic_scale,
+    bool allow_partial,
+    Int32VectorWriter *alignment_writer,
+    Int32VectorWriter *words_writer,
+    CompactLatticeWriter *compact_lattice_writer,
+    double *like_ptr) { // puts utterance's like in like_ptr on success.
+  CompactLattice clat;
+  bool reached_final;
+  if (!DecodeSegmented(fst, decoder_config, segment_config, trans_model,
+                       &decodable, &clat, &reached_final)) {
+    KALDI_WARN << "Failed to decode file " << utt;
+    return false;
+  }
+  if (!CheckReachedFinal(reached_final, allow_partial, utt))
+    return false;
+
+  double likelihood;
+  LatticeWeight weight;
+  int32 num_frames;
+  { // First do some stuff with word-level traceback...
+    CompactLattice clat_best_path;
+    CompactLatticeShortestPath(clat, &clat_best_path);
+    Lattice decoded;
+    ConvertLattice(clat_best_path, &decoded);
+    likelihood = OutputBestPath(decoded, word_syms, utt, alignment_writer,
+                                words_writer, &weight, &num_frames);
+  }
+
+  // We'll write the lattice without acoustic scaling.
+  if (acoustic_scale != 0.0)
+    fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale), &clat);
+  compact_lattice_writer->Write(utt, clat);
+  LogUtteranceLikelihood(utt, likelihood, num_frames, weight);
   *like_ptr = likelihood;
   return true;
 }
@@ -22,7 +22,9 @@
 
 #include "itf/options-itf.h"
 #include "decoder/lattice-faster-decoder.h"
+#include "decoder/lattice-biglm-faster-decoder.h"
 #include "decoder/lattice-simple-decoder.h"
+#include "decoder/segmented-decoding.h"
 
 // This header contains declarations from various convenience functions that are called
 // from binary-level programs such as gmm-decode-faster.cc, gmm-align-compiled.cc, and
@@ -94,8 +96,11 @@ void ModifyGraphForCarefulAlignment(
 /// other obvious place to put it.  If determinize == false, it writes to
 /// lattice_writer, else to compact_lattice_writer.  The writers for
 /// alignments and words will only be written to if they are open.
+/// FST_DECODER may be LatticeFasterDecoder or LatticeBiglmFasterDecoder (it is
+/// instantiated for those two in decoder-wrappers.cc).
+template <typename FST_DECODER>
 bool DecodeUtteranceLatticeFaster(
-    LatticeFasterDecoder &decoder, // not const but is really an input.
+    FST_DECODER &decoder, // not const but is really an input.
     DecodableInterface &decodable, // not const but is really an input.
     const TransitionModel &trans_model,
     const fst::SymbolTable *word_syms,
@@ -189,6 +194,28 @@ bool DecodeUtteranceLatticeSimple(
     LatticeWriter *lattice_writer,
     double *like_ptr);  // puts utterance's likelihood in like_ptr on success.
 
+/// This is like DecodeUtteranceLatticeFaster, but it decodes the utterance as
+/// overlapping windows, in parallel, and stitches the lattices together (see
+/// segmented-decoding.h); this is for very long utterances, which would
+/// otherwise take a long time on one core.  It always writes a CompactLattice,
+/// made of determinized lattices but not necessarily deterministic itself (see
+/// DecodeSegmented()).  "decodable" must be safe to call from several threads.  The LM
+/// history is reset at each window boundary, since each window is decoded from
+/// the start state of the graph; see DecodeSegmented().
+bool DecodeUtteranceLatticeFasterSegmented(
+    const fst::Fst<fst::StdArc> &fst,
+    const LatticeFasterDecoderConfig &decoder_config,
+    const SegmentedDecodingConfig &segment_config,
+    DecodableInterface &decodable, // not const but is really an input.
+    const TransitionModel &trans_model,
+    const fst::SymbolTable *word_syms,
+    std::string utt,
+    double acoustic_scale,
+    bool allow_partial,
+    Int32VectorWriter *alignments_writer,
+    Int32VectorWriter *words_writer,
+    CompactLatticeWriter *compact_lattice_writer,
+    double *like_ptr);  // puts utterance's likelihood in like_ptr on success.
 
 
 } // end namespace kaldi.
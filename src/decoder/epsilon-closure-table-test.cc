@@ -0,0 +1,246 @@
+// decoder/epsilon-closure-table-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/epsilon-closure-table.h"
+#include "decoder/lattice-faster-decoder.h"
+#include "decoder/decodable-matrix.h"
+#include "util/stl-utils.h"
+
+namespace kaldi {
+
+using fst::StdArc;
+using fst::VectorFst;
+typedef StdArc::StateId StateId;
+
+// Returns a random graph with "num_states" states, emitting arcs with ilabels
+// 1 ... num_pdfs, and epsilon arcs, some with words on them.  The epsilon
+// arcs only go to higher-numbered states, so there are no epsilon cycles.
+VectorFst<StdArc> *RandDecodingGraph(int32 num_states, int32 num_pdfs) {
+  VectorFst<StdArc> *fst = new VectorFst<StdArc>();
+  for (int32 s = 0; s < num_states; s++)
+    fst->AddState();
+  fst->SetStart(0);
+  for (int32 s = 0; s < num_states; s++) {
+    int32 num_emitting = 1 + Rand() % 3;
+    for (int32 i = 0; i < num_emitting; i++)
+      fst->AddArc(s, StdArc(1 + Rand() % num_pdfs, 0, RandUniform(),
+                            Rand() % num_states));
+    int32 num_epsilon = Rand() % 3;
+    for (int32 i = 0; i < num_epsilon && s + 1 < num_states; i++) {
+      StateId next = s + 1 + Rand() % (num_states - s - 1);
+      int32 word = (Rand() % 2 == 0 ? 0 : 1 + Rand() % 10);
+      fst->AddArc(s, StdArc(0, word, 2.0 * RandUniform(), next));
+    }
+    if (Rand() % 4 == 0)
+      fst->SetFinal(s, RandUniform());
+  }
+  return fst;
+}
+
+// Returns the epsilon arcs leaving state s, in order.
+void GetEpsilonArcs(const VectorFst<StdArc> &fst, StateId s,
+                    std::vector<StdArc> *arcs) {
+  arcs->clear();
+  for (fst::ArcIterator<VectorFst<StdArc> > aiter(fst, s); !aiter.Done();
+       aiter.Next())
+    if (aiter.Value().ilabel == 0)
+      arcs->push_back(aiter.Value());
+}
+
+// Checks the closure of state s in "table", and outputs the graph state of
+// each node of it in *node_states.
+void CheckClosure(const VectorFst<StdArc> &fst,
+                  const EpsilonClosureTable &table, StateId s,
+                  std::vector<StateId> *node_states) {
+  int32 num_nodes;
+  const EpsilonClosureTable::Node *nodes = table.Closure(s, &num_nodes);
+  std::vector<StdArc> eps_arcs;
+  GetEpsilonArcs(fst, s, &eps_arcs);
+  node_states->clear();
+  if (eps_arcs.empty()) {
+    KALDI_ASSERT(num_nodes == 0 && nodes == NULL);
+    return;
+  }
+  KALDI_ASSERT(num_nodes > 0);
+  node_states->resize(num_nodes, fst::kNoStateId);
+  (*node_states)[0] = s;
+  for (int32 i = 0; i < num_nodes; i++) {
+    // Nodes are only reached by arcs from earlier nodes, so we know the state
+    // of node i by now.
+    StateId t = (*node_states)[i];
+    KALDI_ASSERT(t != fst::kNoStateId);
+    GetEpsilonArcs(fst, t, &eps_arcs);
+    KALDI_ASSERT(nodes[i].arc_end - nodes[i].arc_begin ==
+                 static_cast<int32>(eps_arcs.size()));
+    for (int32 j = 0; j < static_cast<int32>(eps_arcs.size()); j++) {
+      const EpsilonClosureTable::Arc &arc =
+          table.Arcs()[nodes[i].arc_begin + j];
+      KALDI_ASSERT(arc.olabel == eps_arcs[j].olabel &&
+                   arc.nextstate == eps_arcs[j].nextstate &&
+                   ApproxEqual(arc.graph_cost, eps_arcs[j].weight.Value()));
+      if (arc.next_node != -1) {
+        KALDI_ASSERT(arc.next_node > i && arc.next_node < num_nodes);
+        StateId &u = (*node_states)[arc.next_node];
+        KALDI_ASSERT(u == fst::kNoStateId || u == arc.nextstate);
+        u = arc.nextstate;
+      }
+    }
+  }
+  // Each state is in the closure at most once.
+  std::vector<StateId> sorted(*node_states);
+  SortAndUniq(&sorted);
+  KALDI_ASSERT(sorted.size() == node_states->size());
+}
+
+// Returns the lowest epsilon-path cost from s to each state (infinity if not
+// reachable), for a graph from RandDecodingGraph().
+void GetEpsilonCosts(const VectorFst<StdArc> &fst, StateId s,
+                     std::vector<BaseFloat> *costs) {
+  costs->clear();
+  costs->resize(fst.NumStates(), std::numeric_limits<BaseFloat>::infinity());
+  (*costs)[s] = 0.0;
+  std::vector<StdArc> eps_arcs;
+  for (StateId t = s; t < fst.NumStates(); t++) {
+    GetEpsilonArcs(fst, t, &eps_arcs);
+    for (size_t j = 0; j < eps_arcs.size(); j++)
+      (*costs)[eps_arcs[j].nextstate] =
+          std::min((*costs)[eps_arcs[j].nextstate],
+                   (*costs)[t] + eps_arcs[j].weight.Value());
+  }
+}
+
+// With no limits, the closures must contain exactly the states reachable by
+// epsilon arcs; with limits, they must respect them.
+void TestClosures(bool limited) {
+  int32 num_states = 2 + Rand() % 30;
+  VectorFst<StdArc> *fst = RandDecodingGraph(num_states, 5);
+  EpsilonClosureConfig config;
+  if (limited) {
+    config.max_states = 1 + Rand() % 4;
+    config.max_cost = 2.0 * RandUniform();
+  } else {
+    config.max_states = num_states;
+    config.max_cost = 1.0e+10;
+  }
+  EpsilonClosureTable table(*fst, config);
+  KALDI_ASSERT(table.NumStates() == num_states);
+  std::vector<StateId> node_states;
+  std::vector<BaseFloat> costs;
+  for (StateId s = 0; s < num_states; s++) {
+    CheckClosure(*fst, table, s, &node_states);
+    if (node_states.empty()) continue;
+    GetEpsilonCosts(*fst, s, &costs);
+    KALDI_ASSERT(node_states.size() <=
+                 static_cast<size_t>(config.max_states));
+    for (size_t i = 0; i < node_states.size(); i++)
+      KALDI_ASSERT(costs[node_states[i]] <= config.max_cost + 1.0e-04);
+    if (!limited) {
+      int32 num_reachable = 0;
+      for (StateId t = 0; t < num_states; t++)
+        if (costs[t] != std::numeric_limits<BaseFloat>::infinity())
+          num_reachable++;
+      KALDI_ASSERT(num_reachable == static_cast<int32>(node_states.size()));
+    }
+  }
+  delete fst;
+}
+
+// A state on an epsilon cycle gets a closure with just itself, so the decoder
+// puts everything it reaches on its queue.
+void TestCycles() {
+  int32 num_states = 3 + Rand() % 10;
+  VectorFst<StdArc> *fst = RandDecodingGraph(num_states, 5);
+  StateId a = Rand() % (num_states - 1),
+      b = a + 1 + Rand() % (num_states - a - 1);
+  fst->AddArc(a, StdArc(0, 0, 0.5, b));
+  fst->AddArc(b, StdArc(0, 0, 0.5, a));
+  EpsilonClosureConfig config;
+  config.max_states = num_states;
+  config.max_cost = 1.0e+10;
+  EpsilonClosureTable table(*fst, config);
+  std::vector<StateId> node_states;
+  CheckClosure(*fst, table, a, &node_states);
+  KALDI_ASSERT(node_states.size() == 1);
+  CheckClosure(*fst, table, b, &node_states);
+  KALDI_ASSERT(node_states.size() == 1);
+  for (StateId s = 0; s < num_states; s++)
+    CheckClosure(*fst, table, s, &node_states);
+  delete fst;
+}
+
+// Decoding with the table must give the same lattice as decoding without it.
+void TestDecodeEquivalence() {
+  int32 num_states = 2 + Rand() % 50, num_pdfs = 5,
+      num_frames = 1 + Rand() % 20;
+  VectorFst<StdArc> *fst = RandDecodingGraph(num_states, num_pdfs);
+  Matrix<BaseFloat> likes(num_frames, num_pdfs + 1);
+  likes.SetRandn();
+  LatticeFasterDecoderConfig decoder_config;
+  decoder_config.beam = 1.0 + 10.0 * RandUniform();
+  EpsilonClosureConfig config;
+  config.max_states = 1 + Rand() % 10;
+  config.max_cost = 5.0 * RandUniform();
+  EpsilonClosureTable table(*fst, config);
+
+  LatticeFasterDecoder decoder(*fst, decoder_config),
+      table_decoder(*fst, decoder_config);
+  table_decoder.SetEpsilonClosureTable(&table);
+  DecodableMatrixScaled decodable(likes, 1.0), table_decodable(likes, 1.0);
+  bool ans = decoder.Decode(&decodable),
+      table_ans = table_decoder.Decode(&table_decodable);
+  KALDI_ASSERT(ans == table_ans);
+  if (!ans) {
+    delete fst;
+    return;
+  }
+  Lattice lat, table_lat;
+  KALDI_ASSERT(decoder.GetRawLattice(&lat) ==
+               table_decoder.GetRawLattice(&table_lat));
+  // The tokens and links are the same, but may be in a different order.
+  KALDI_ASSERT(lat.NumStates() == table_lat.NumStates());
+  size_t num_arcs = 0, table_num_arcs = 0;
+  for (StateId s = 0; s < lat.NumStates(); s++) {
+    num_arcs += lat.NumArcs(s);
+    table_num_arcs += table_lat.NumArcs(s);
+  }
+  KALDI_ASSERT(num_arcs == table_num_arcs);
+
+  Lattice best_path, table_best_path;
+  decoder.GetBestPath(&best_path);
+  table_decoder.GetBestPath(&table_best_path);
+  std::vector<int32> ali, words, table_ali, table_words;
+  LatticeWeight weight, table_weight;
+  GetLinearSymbolSequence(best_path, &ali, &words, &weight);
+  GetLinearSymbolSequence(table_best_path, &table_ali, &table_words,
+                          &table_weight);
+  KALDI_ASSERT(ali == table_ali && words == table_words &&
+               ApproxEqual(weight, table_weight));
+  delete fst;
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 50; i++) {
+    TestClosures(false);
+    TestClosures(true);
+    TestCycles();
+    TestDecodeEquivalence();
+  }
+  std::cout << "Tests succeeded\n";
+}
@@ -0,0 +1,204 @@
+// decoder/epsilon-closure-table.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "decoder/epsilon-closure-table.h"
+#include "base/timer.h"
+
+namespace kaldi {
+
+EpsilonClosureTable::EpsilonClosureTable(const fst::Fst<fst::StdArc> &fst,
+                                         const EpsilonClosureConfig &config):
+    num_truncated_(0), num_cyclic_(0) {
+  config.Check();
+  if (config.max_states <= 0)
+    KALDI_ERR << "EpsilonClosureTable: max_states must be positive.";
+
+  StateId num_states = 0;
+  for (fst::StateIterator<fst::Fst<fst::StdArc> > siter(fst); !siter.Done();
+       siter.Next())
+    num_states = std::max(num_states, siter.Value() + 1);
+
+  // First collect the epsilon arcs of each state, so we don't have to
+  // iterate over the emitting arcs more than once.
+  std::vector<int32> eps_offsets(num_states + 1);
+  std::vector<fst::StdArc> eps_arcs;
+  for (StateId s = 0; s < num_states; s++) {
+    eps_offsets[s] = eps_arcs.size();
+    for (fst::ArcIterator<fst::Fst<fst::StdArc> > aiter(fst, s);
+         !aiter.Done(); aiter.Next())
+      if (aiter.Value().ilabel == 0)
+        eps_arcs.push_back(aiter.Value());
+  }
+  eps_offsets[num_states] = eps_arcs.size();
+
+  node_offsets_.resize(num_states + 1);
+  state_to_node_.resize(num_states, -1);
+  dfs_color_.resize(config.max_states);
+  for (StateId s = 0; s < num_states; s++) {
+    node_offsets_[s] = nodes_.size();
+    if (eps_offsets[s + 1] > eps_offsets[s])
+      ComputeClosure(s, config, eps_offsets, eps_arcs);
+    if (arcs_.size() > static_cast<size_t>(
+            std::numeric_limits<int32>::max()))
+      KALDI_ERR << "Table of epsilon closures is too large; reduce "
+                << "--epsilon-closure-max-states.";
+  }
+  node_offsets_[num_states] = nodes_.size();
+
+  // Free the memory used by the temporary variables.
+  std::vector<int32>().swap(state_to_node_);
+  std::vector<StateId>().swap(closure_states_);
+  std::vector<BaseFloat>().swap(closure_costs_);
+}
+
+void EpsilonClosureTable::ComputeClosure(
+    StateId s, const EpsilonClosureConfig &config,
+    const std::vector<int32> &eps_offsets,
+    const std::vector<fst::StdArc> &eps_arcs) {
+  closure_states_.clear();
+  closure_costs_.clear();
+  closure_states_.push_back(s);
+  closure_costs_.push_back(0.0);
+  state_to_node_[s] = 0;
+  bool truncated = false;
+  // Add states in breadth-first order until we reach the limits.
+  for (size_t i = 0; i < closure_states_.size(); i++) {
+    StateId t = closure_states_[i];
+    BaseFloat cost = closure_costs_[i];
+    for (int32 j = eps_offsets[t]; j < eps_offsets[t + 1]; j++) {
+      const fst::StdArc &arc = eps_arcs[j];
+      if (state_to_node_[arc.nextstate] != -1) continue;
+      BaseFloat next_cost = cost + arc.weight.Value();
+      if (closure_states_.size() >= static_cast<size_t>(config.max_states) ||
+          next_cost > config.max_cost) {
+        truncated = true;
+        continue;
+      }
+      state_to_node_[arc.nextstate] = closure_states_.size();
+      closure_states_.push_back(arc.nextstate);
+      closure_costs_.push_back(next_cost);
+    }
+  }
+  if (truncated) num_truncated_++;
+  if (!TopSortClosure(eps_offsets, eps_arcs)) {
+    // There is an epsilon cycle (the decoders would fail on this graph
+    // anyway).  Keep only state s, whose arcs will all lead out of the
+    // closure, so the decoder will use its queue for them.
+    num_cyclic_++;
+    for (size_t i = 1; i < closure_states_.size(); i++)
+      state_to_node_[closure_states_[i]] = -1;
+    closure_states_.resize(1);
+  }
+
+  for (size_t i = 0; i < closure_states_.size(); i++) {
+    StateId t = closure_states_[i];
+    Node node;
+    node.arc_begin = arcs_.size();
+    for (int32 j = eps_offsets[t]; j < eps_offsets[t + 1]; j++) {
+      const fst::StdArc &eps_arc = eps_arcs[j];
+      Arc arc;
+      arc.olabel = eps_arc.olabel;
+      arc.graph_cost = eps_arc.weight.Value();
+      arc.nextstate = eps_arc.nextstate;
+      int32 next_node = state_to_node_[eps_arc.nextstate];
+      // next_node <= i can only happen for a self-loop on s in a cyclic
+      // closure.
+      arc.next_node = (next_node > static_cast<int32>(i) ? next_node : -1);
+      arcs_.push_back(arc);
+    }
+    node.arc_end = arcs_.size();
+    nodes_.push_back(node);
+  }
+  for (size_t i = 0; i < closure_states_.size(); i++)
+    state_to_node_[closure_states_[i]] = -1;
+}
+
+bool EpsilonClosureTable::TopSortClosure(
+    const std::vector<int32> &eps_offsets,
+    const std::vector<fst::StdArc> &eps_arcs) {
+  // Depth-first search from closure_states_[0], which reaches all the states;
+  // the reverse of the order in which they finish is a topological order.
+  // dfs_color_ is 0 for unvisited nodes, 1 for nodes on the stack and 2 for
+  // finished nodes.
+  int32 num_nodes = closure_states_.size();
+  std::fill(dfs_color_.begin(), dfs_color_.begin() + num_nodes, 0);
+  dfs_order_.clear();
+  dfs_stack_.clear();
+  dfs_stack_.push_back(std::make_pair(0, eps_offsets[closure_states_[0]]));
+  dfs_color_[0] = 1;
+  while (!dfs_stack_.empty()) {
+    int32 node = dfs_stack_.back().first, &j = dfs_stack_.back().second;
+    StateId t = closure_states_[node];
+    if (j == eps_offsets[t + 1]) {
+      dfs_color_[node] = 2;
+      dfs_order_.push_back(t);
+      dfs_stack_.pop_back();
+      continue;
+    }
+    int32 next_node = state_to_node_[eps_arcs[j].nextstate];
+    j++;
+    if (next_node == -1) continue;
+    if (dfs_color_[next_node] == 1) return false;  // epsilon cycle.
+    if (dfs_color_[next_node] == 0) {
+      dfs_color_[next_node] = 1;
+      dfs_stack_.push_back(std::make_pair(
+          next_node, eps_offsets[closure_states_[next_node]]));
+    }
+  }
+  KALDI_ASSERT(dfs_order_.size() == closure_states_.size());
+  for (int32 i = 0; i < num_nodes; i++) {
+    StateId t = dfs_order_[num_nodes - 1 - i];
+    closure_states_[i] = t;
+    state_to_node_[t] = i;
+  }
+  return true;
+}
+
+size_t EpsilonClosureTable::MemSize() const {
+  return node_offsets_.capacity() * sizeof(int32) +
+      nodes_.capacity() * sizeof(Node) + arcs_.capacity() * sizeof(Arc);
+}
+
+void EpsilonClosureTable::Info() const {
+  int32 num_closures = 0;
+  for (size_t s = 0; s + 1 < node_offsets_.size(); s++)
+    if (node_offsets_[s + 1] > node_offsets_[s])
+      num_closures++;
+  KALDI_LOG << "Table of epsilon closures has " << num_closures
+            << " closures (out of " << NumStates() << " states), with "
+            << (nodes_.size() / std::max<BaseFloat>(num_closures, 1))
+            << " states and "
+            << (arcs_.size() / std::max<BaseFloat>(num_closures, 1))
+            << " arcs per closure on average; " << num_truncated_
+            << " were limited by the maximum #states or cost, and "
+            << num_cyclic_ << " had epsilon cycles.  Memory used is "
+            << (MemSize() / 1048576.0) << " MB.";
+}
+
+EpsilonClosureTable *NewEpsilonClosureTable(const fst::Fst<fst::StdArc> &fst,
+                                            const EpsilonClosureConfig &config) {
+  if (config.max_states == 0) return NULL;
+  Timer timer;
+  EpsilonClosureTable *ans = new EpsilonClosureTable(fst, config);
+  ans->Info();
+  KALDI_LOG << "Computed table of epsilon closures in " << timer.Elapsed()
+            << " seconds.";
+  return ans;
+}
+
+}  // namespace kaldi
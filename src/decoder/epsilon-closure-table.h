@@ -0,0 +1,166 @@
+// decoder/epsilon-closure-table.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+
+#ifndef KALDI_DECODER_EPSILON_CLOSURE_TABLE_H_
+#define KALDI_DECODER_EPSILON_CLOSURE_TABLE_H_
+
+#include <vector>
+#include "base/kaldi-common.h"
+#include "itf/options-itf.h"
+#include "fst/fstlib.h"
+
+/**
+   This header contains a table, computed once for a decoding graph, that
+   lets the decoders propagate tokens over epsilon (non-emitting) arcs without
+   iterating over all the arcs of each active state on each frame.  In HCLG,
+   the epsilon arcs are mostly LM backoff arcs and word-end arcs, and the states
+   they leave often have many emitting arcs, so most of the work that
+   ProcessNonemitting() does in the normal decoders is skipping over those.
+
+   For each graph state s that has epsilon arcs, the table stores a small part
+   of its epsilon closure: s itself and up to config.max_states - 1 other states
+   reachable from s by epsilon arcs with a total graph cost not exceeding
+   config.max_cost, in topological order, with the epsilon arcs leaving each of
+   them.  The decoder walks this list in order, propagating tokens along the
+   arcs; states outside the stored part of the closure are put on the decoder's
+   queue as usual, so the result does not depend on the limits.  Because we
+   store the individual arcs rather than the total cost to each state, the
+   lattices produced are exactly the same as without the table (up to the order
+   of arcs).
+*/
+
+namespace kaldi {
+
+struct EpsilonClosureConfig {
+  int32 max_states;
+  BaseFloat max_cost;
+
+  EpsilonClosureConfig(): max_states(0), max_cost(15.0) { }
+
+  void Register(OptionsItf *po) {
+    po->Register("epsilon-closure-max-states", &max_states, "If >0, "
+                 "precompute for each state of the decoding graph the states "
+                 "reachable from it by epsilon arcs (at most this many per "
+                 "state, e.g. 20), which is meant to speed up the processing "
+                 "of non-emitting arcs in decoding.  Requires extra memory, "
+                 "and some time to compute when the graph is read.");
+    po->Register("epsilon-closure-max-cost", &max_cost, "Graph cost beyond "
+                 "which we don't store states in the table of epsilon "
+                 "closures (only relevant if --epsilon-closure-max-states > 0).");
+  }
+  void Check() const {
+    KALDI_ASSERT(max_states >= 0 && max_cost >= 0.0);
+  }
+};
+
+
+class EpsilonClosureTable {
+ public:
+  typedef fst::StdArc::Label Label;
+  typedef fst::StdArc::StateId StateId;
+
+  /// An epsilon arc leaving one of the states in a closure.
+  struct Arc {
+    Label olabel;
+    BaseFloat graph_cost;
+    StateId nextstate;
+    int32 next_node;  // Index of "nextstate" in the closure, which is
+                      // always greater than the index of the state this arc
+                      // leaves; or -1 if it is not in the stored closure.
+  };
+  /// A state in a closure; the arcs leaving it are
+  /// Arcs()[arc_begin] ... Arcs()[arc_end - 1].
+  struct Node {
+    int32 arc_begin;
+    int32 arc_end;
+  };
+
+  /// Computes the table for "fst".  The table does not keep a reference to
+  /// the FST.  It is an error if config.max_states is not positive.
+  EpsilonClosureTable(const fst::Fst<fst::StdArc> &fst,
+                      const EpsilonClosureConfig &config);
+
+  /// Returns the nodes of the closure of state s, in topological order;
+  /// node 0 is s itself.  Sets *num_nodes to zero, and returns NULL, if s has
+  /// no epsilon arcs.
+  inline const Node *Closure(StateId s, int32 *num_nodes) const {
+    KALDI_PARANOID_ASSERT(static_cast<size_t>(s) + 1 < node_offsets_.size());
+    int32 begin = node_offsets_[s];
+    *num_nodes = node_offsets_[s + 1] - begin;
+    // "begin" may be nodes_.size() if the closure is empty, so we must not
+    // index nodes_ with it.
+    return *num_nodes == 0 ? NULL : &(nodes_[0]) + begin;
+  }
+
+  inline const Arc *Arcs() const { return arcs_.empty() ? NULL : &(arcs_[0]); }
+
+  int32 NumStates() const { return node_offsets_.size() - 1; }
+
+  /// Returns the approximate memory used by the table, in bytes.
+  size_t MemSize() const;
+
+  /// Prints some statistics about the table at log level.
+  void Info() const;
+
+ private:
+  // Computes the closure of state s and appends it to nodes_ and arcs_.
+  void ComputeClosure(StateId s, const EpsilonClosureConfig &config,
+                      const std::vector<int32> &eps_offsets,
+                      const std::vector<fst::StdArc> &eps_arcs);
+
+  // Orders the states in closure_states_ topologically with respect to the
+  // epsilon arcs between them, with closure_states_[0] staying first.
+  // Returns false if there is an epsilon cycle.  Uses state_to_node_, which
+  // maps each state in closure_states_ to its position there.
+  bool TopSortClosure(const std::vector<int32> &eps_offsets,
+                      const std::vector<fst::StdArc> &eps_arcs);
+
+  // node_offsets_[s] is the index in nodes_ of the first node of the closure
+  // of state s; the closure ends at node_offsets_[s + 1].
+  std::vector<int32> node_offsets_;
+  std::vector<Node> nodes_;
+  std::vector<Arc> arcs_;
+
+  int32 num_truncated_;  // Number of closures limited by max_states or
+                         // max_cost.
+  int32 num_cyclic_;  // Number of closures with epsilon cycles.
+
+  // Temporary variables used while computing the table.
+  std::vector<StateId> closure_states_;
+  std::vector<BaseFloat> closure_costs_;  // cost from the first state in
+                                          // closure_states_ to each state.
+  std::vector<int32> state_to_node_;  // indexed by state; -1 if not in
+                                      // closure_states_.
+  std::vector<char> dfs_color_;
+  std::vector<std::pair<int32, int32> > dfs_stack_;
+  std::vector<StateId> dfs_order_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(EpsilonClosureTable);
+};
+
+/// This function is for use in command-line programs: it returns a newly
+/// allocated table for "fst" and prints some statistics and the time taken,
+/// or returns NULL if config.max_states is zero (the default).
+EpsilonClosureTable *NewEpsilonClosureTable(const fst::Fst<fst::StdArc> &fst,
+                                            const EpsilonClosureConfig &config);
+
+
+}  // namespace kaldi
+
+#endif  // KALDI_DECODER_EPSILON_CLOSURE_TABLE_H_
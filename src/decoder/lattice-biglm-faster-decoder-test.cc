@@ -0,0 +1,147 @@
+// decoder/lattice-biglm-faster-decoder-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/lattice-biglm-faster-decoder.h"
+#include "decoder/decodable-matrix.h"
+
+namespace kaldi {
+
+using fst::StdArc;
+using fst::VectorFst;
+typedef StdArc::StateId StateId;
+
+const int32 kNumWords = 10;
+
+// Returns a random graph with "num_states" states, emitting arcs with ilabels
+// 1 ... num_pdfs, and epsilon arcs, some with words on them.  The epsilon
+// arcs only go to higher-numbered states, so there are no epsilon cycles.
+VectorFst<StdArc> *RandDecodingGraph(int32 num_states, int32 num_pdfs) {
+  VectorFst<StdArc> *fst = new VectorFst<StdArc>();
+  for (int32 s = 0; s < num_states; s++)
+    fst->AddState();
+  fst->SetStart(0);
+  for (int32 s = 0; s < num_states; s++) {
+    int32 num_emitting = 1 + Rand() % 3;
+    for (int32 i = 0; i < num_emitting; i++)
+      fst->AddArc(s, StdArc(1 + Rand() % num_pdfs, 0, RandUniform(),
+                            Rand() % num_states));
+    int32 num_epsilon = Rand() % 3;
+    for (int32 i = 0; i < num_epsilon && s + 1 < num_states; i++) {
+      StateId next = s + 1 + Rand() % (num_states - s - 1);
+      int32 word = (Rand() % 2 == 0 ? 0 : 1 + Rand() % kNumWords);
+      fst->AddArc(s, StdArc(0, word, 2.0 * RandUniform(), next));
+    }
+    if (Rand() % 4 == 0)
+      fst->SetFinal(s, RandUniform());
+  }
+  return fst;
+}
+
+// Returns a random deterministic acceptor over the words, with "num_states"
+// states, to stand in for the LM-difference FST.  Some words have no arc, so
+// the decoder's "no arc" case is tested too.
+VectorFst<StdArc> *RandLmFst(int32 num_states) {
+  VectorFst<StdArc> *fst = new VectorFst<StdArc>();
+  for (int32 s = 0; s < num_states; s++)
+    fst->AddState();
+  fst->SetStart(0);
+  for (int32 s = 0; s < num_states; s++) {
+    for (int32 word = 1; word <= kNumWords; word++)
+      if (Rand() % 5 != 0)
+        fst->AddArc(s, StdArc(word, word, 4.0 * RandUniform() - 2.0,
+                              Rand() % num_states));
+    fst->SetFinal(s, RandUniform());
+  }
+  return fst;
+}
+
+// Checks that the two decoders give the same lattice.
+void CheckSameLattice(bool ans, const LatticeBiglmFasterDecoder &decoder,
+                      bool cached_ans,
+                      const LatticeBiglmFasterDecoder &cached_decoder) {
+  KALDI_ASSERT(ans == cached_ans);
+  if (!ans) return;
+  Lattice lat, cached_lat;
+  KALDI_ASSERT(decoder.GetRawLattice(&lat) ==
+               cached_decoder.GetRawLattice(&cached_lat));
+  KALDI_ASSERT(lat.NumStates() == cached_lat.NumStates());
+  size_t num_arcs = 0, cached_num_arcs = 0;
+  for (StateId s = 0; s < lat.NumStates(); s++) {
+    num_arcs += lat.NumArcs(s);
+    cached_num_arcs += cached_lat.NumArcs(s);
+  }
+  KALDI_ASSERT(num_arcs == cached_num_arcs);
+
+  Lattice best_path, cached_best_path;
+  decoder.GetBestPath(&best_path);
+  cached_decoder.GetBestPath(&cached_best_path);
+  std::vector<int32> ali, words, cached_ali, cached_words;
+  LatticeWeight weight, cached_weight;
+  GetLinearSymbolSequence(best_path, &ali, &words, &weight);
+  GetLinearSymbolSequence(cached_best_path, &cached_ali, &cached_words,
+                          &cached_weight);
+  KALDI_ASSERT(ali == cached_ali && words == cached_words &&
+               ApproxEqual(weight, cached_weight));
+}
+
+// Decoding with the LM arc cache must give the same lattice as decoding
+// without it, also after SetLmDiffFst() gives the decoders a different LM
+// whose state ids mean different things.
+void TestLmCache() {
+  int32 num_states = 2 + Rand() % 50, num_pdfs = 5, num_lm_states = 1 +
+      Rand() % 5;
+  VectorFst<StdArc> *fst = RandDecodingGraph(num_states, num_pdfs),
+      *lm_fst1 = RandLmFst(num_lm_states), *lm_fst2 = RandLmFst(num_lm_states);
+  fst::ArcSort(lm_fst1, fst::ILabelCompare<StdArc>());
+  fst::ArcSort(lm_fst2, fst::ILabelCompare<StdArc>());
+  fst::BackoffDeterministicOnDemandFst<StdArc> lm_dfst1(*lm_fst1),
+      lm_dfst2(*lm_fst2);
+
+  LatticeBiglmFasterDecoderConfig config, cached_config;
+  config.beam = cached_config.beam = 1.0 + 10.0 * RandUniform();
+  config.lm_cache_size = 0;
+  // A small cache, so that entries get replaced.
+  cached_config.lm_cache_size = 2 + Rand() % 20;
+  LatticeBiglmFasterDecoder decoder(*fst, config, &lm_dfst1),
+      cached_decoder(*fst, cached_config, &lm_dfst1);
+
+  for (int32 utt = 0; utt < 3; utt++) {
+    if (utt == 2) {
+      decoder.SetLmDiffFst(&lm_dfst2);
+      cached_decoder.SetLmDiffFst(&lm_dfst2);
+    }
+    int32 num_frames = 1 + Rand() % 20;
+    Matrix<BaseFloat> likes(num_frames, num_pdfs + 1);
+    likes.SetRandn();
+    DecodableMatrixScaled decodable(likes, 1.0), cached_decodable(likes, 1.0);
+    bool ans = decoder.Decode(&decodable),
+        cached_ans = cached_decoder.Decode(&cached_decodable);
+    CheckSameLattice(ans, decoder, cached_ans, cached_decoder);
+  }
+  delete fst;
+  delete lm_fst1;
+  delete lm_fst2;
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 50; i++)
+    TestLmCache();
+  std::cout << "Tests succeeded\n";
+}
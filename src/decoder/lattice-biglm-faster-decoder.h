@@ -33,8 +33,23 @@
 
 namespace kaldi {
 
-// The options are the same as for lattice-faster-decoder.h for now.
-typedef LatticeFasterDecoderConfig LatticeBiglmFasterDecoderConfig;
+// The options are the same as for lattice-faster-decoder.h, plus the size of
+// the decoder's cache of arcs of the LM-difference FST.
+struct LatticeBiglmFasterDecoderConfig: public LatticeFasterDecoderConfig {
+  int32 lm_cache_size;
+
+  LatticeBiglmFasterDecoderConfig(): lm_cache_size(100000) { }
+  void Register(OptionsItf *po) {
+    LatticeFasterDecoderConfig::Register(po);
+    po->Register("lm-cache-size", &lm_cache_size, "Number of arcs of the "
+                 "language model [difference] FST that the decoder caches "
+                 "(0 means no cache).");
+  }
+  void Check() const {
+    LatticeFasterDecoderConfig::Check();
+    KALDI_ASSERT(lm_cache_size >= 0);
+  }
+};
 
 /** This is as LatticeFasterDecoder, but does online composition between
     HCLG and the "difference language model", which is a deterministic
@@ -43,6 +58,19 @@ typedef LatticeFasterDecoderConfig LatticeBiglmFasterDecoderConfig;
     DeterministicOnDemandFst follows through the epsilons in G for you
     (assuming G is a standard backoff language model) and makes it look
     like a determinized FST.
+
+    Looking up an arc in the LM-difference FST is expensive (it typically goes
+    through a composition and the backoff arcs of two LMs), and on any given
+    frame many tokens cross the same word from the same LM state, e.g. from
+    different pronunciations or phonetic contexts of the word.  So the decoder
+    keeps its own cache of LM arcs, two-way set-associative, in which each
+    entry records the frame it was last used on and the entry used least
+    recently is the one replaced.  The cache belongs to the decoder object, so
+    there is no locking when several decoders run in different threads; the
+    hit rate is printed at verbose level 1.  The cached arcs are only valid for
+    the LM-difference FST they came from, so if you give the decoder a new one
+    use SetLmDiffFst(), which empties the cache; to get the benefit of the
+    cache across utterances, keep the same decoder and LM-difference FST.
 */
 
 class LatticeBiglmFasterDecoder {
@@ -59,13 +87,26 @@ class LatticeBiglmFasterDecoder {
       const LatticeBiglmFasterDecoderConfig &config,
       fst::DeterministicOnDemandFst<fst::StdArc> *lm_diff_fst):
       fst_(fst), lm_diff_fst_(lm_diff_fst), config_(config),
-      warned_noarc_(false), num_toks_(0) {
+      warned_noarc_(false), num_toks_(0), lm_cache_(config.lm_cache_size / 2 * 2),
+      lm_cache_frame_(0), lm_cache_valid_frame_(0), lm_cache_hits_(0),
+      lm_cache_misses_(0) {
     config.Check();
     KALDI_ASSERT(fst.Start() != fst::kNoStateId &&
                  lm_diff_fst->Start() != fst::kNoStateId);
     toks_.SetSize(1000);  // just so on the first frame we do something reasonable.
   }
   void SetOptions(const LatticeBiglmFasterDecoderConfig &config) { config_ = config; } 
+
+  // Makes the decoder use a different LM-difference FST from the next call to
+  // Decode().  The LM-state ids of the new FST are unrelated to those of the
+  // old one, so this empties the LM arc cache; it does not free it, so it is
+  // cheaper than constructing a new decoder.
+  void SetLmDiffFst(fst::DeterministicOnDemandFst<fst::StdArc> *lm_diff_fst) {
+    KALDI_ASSERT(lm_diff_fst->Start() != fst::kNoStateId);
+    lm_diff_fst_ = lm_diff_fst;
+    // Entries last used before Decode() increments lm_cache_frame_ are stale.
+    lm_cache_valid_frame_ = lm_cache_frame_ + 1;
+  }
   LatticeBiglmFasterDecoderConfig GetOptions() { return config_; } 
   ~LatticeBiglmFasterDecoder() {
     DeleteElems(toks_.Clear());    
@@ -82,6 +123,9 @@ class LatticeBiglmFasterDecoder {
     final_active_ = false;
     final_costs_.clear();
     num_toks_ = 0;
+    lm_cache_hits_ = 0;
+    lm_cache_misses_ = 0;
+    lm_cache_frame_++;
     PairId start_pair = ConstructPair(fst_.Start(), lm_diff_fst_->Start());
     active_toks_.resize(1);
     Token *start_tok = new Token(0.0, 0.0, NULL, NULL);
@@ -95,6 +139,7 @@ class LatticeBiglmFasterDecoder {
     // numbering, which we have to correct for when we call it.
     for (int32 frame = 1; !decodable->IsLastFrame(frame-2); frame++) {
       active_toks_.resize(frame+1); // new column
+      lm_cache_frame_++;
 
       ProcessEmitting(decodable, frame);
       
@@ -105,6 +150,10 @@ class LatticeBiglmFasterDecoder {
       else if (frame % config_.prune_interval == 0)
         PruneActiveTokens(frame, config_.lattice_beam * 0.1); // use larger delta.        
     }
+    int64 lm_lookups = lm_cache_hits_ + lm_cache_misses_;
+    KALDI_VLOG(1) << "LM arc cache: " << lm_lookups << " lookups, hit rate "
+                  << (lm_lookups == 0 ? 0.0 : lm_cache_hits_ * 100.0 / lm_lookups)
+                  << "%";
     // Returns true if we have any kind of traceback available (not necessarily
     // to the end state; query ReachedFinal() for that).
     return !final_costs_.empty();
@@ -660,14 +709,59 @@ class LatticeBiglmFasterDecoder {
     }
   }
 
+  // An entry in the LM arc cache.  An arc with nextstate == kNoStateId records
+  // that there was no arc.
+  struct LmCacheEntry {
+    StateId lm_state;  // kNoStateId if the entry is unused.
+    Label ilabel;
+    int64 frame;  // Value of lm_cache_frame_ when the entry was last used.
+    Arc arc;
+    LmCacheEntry(): lm_state(fst::kNoStateId), ilabel(0), frame(-1) { }
+  };
+
+  // Returns the arc with this label leaving this state of the LM-difference
+  // FST, through the cache.
+  inline const Arc &GetLmArc(StateId lm_state, Label ilabel) {
+    if (lm_cache_.empty()) {  // --lm-cache-size=0.
+      lm_cache_misses_++;
+      if (!lm_diff_fst_->GetArc(lm_state, ilabel, &lm_arc_))
+        lm_arc_.nextstate = fst::kNoStateId;
+      return lm_arc_;
+    }
+    const size_t p1 = 26597, p2 = 50329; // two primes (as in
+    // CacheDeterministicOnDemandFst).
+    size_t set = (static_cast<size_t>(lm_state) * p1 +
+                  static_cast<size_t>(ilabel) * p2) % (lm_cache_.size() / 2);
+    LmCacheEntry *entries = &(lm_cache_[2 * set]);
+    for (int32 i = 0; i < 2; i++) {
+      if (entries[i].lm_state == lm_state && entries[i].ilabel == ilabel &&
+          entries[i].frame >= lm_cache_valid_frame_) {
+        entries[i].frame = lm_cache_frame_;
+        lm_cache_hits_++;
+        return entries[i].arc;
+      }
+    }
+    lm_cache_misses_++;
+    // Replace the entry that was used least recently; stale entries have
+    // older frames than any valid ones.
+    LmCacheEntry *entry = (entries[0].frame <= entries[1].frame ?
+                           &(entries[0]) : &(entries[1]));
+    entry->lm_state = lm_state;
+    entry->ilabel = ilabel;
+    entry->frame = lm_cache_frame_;
+    if (!lm_diff_fst_->GetArc(lm_state, ilabel, &(entry->arc)))
+      entry->arc.nextstate = fst::kNoStateId;
+    return entry->arc;
+  }
+
   inline StateId PropagateLm(StateId lm_state,
                              Arc *arc) { // returns new LM state.
     if (arc->olabel == 0) {
       return lm_state; // no change in LM state if no word crossed.
     } else { // Propagate in the LM-diff FST.
-      Arc lm_arc;
-      bool ans = lm_diff_fst_->GetArc(lm_state, arc->olabel, &lm_arc);
-      if (!ans) { // this case is unexpected for statistical LMs.
+      const Arc &lm_arc = GetLmArc(lm_state, arc->olabel);
+      if (lm_arc.nextstate == fst::kNoStateId) {
+        // this case is unexpected for statistical LMs.
         if (!warned_noarc_) {
           warned_noarc_ = true;
           KALDI_WARN << "No arc available in LM (unlikely to be correct "
@@ -843,6 +937,15 @@ class LatticeBiglmFasterDecoder {
   LatticeBiglmFasterDecoderConfig config_;
   bool warned_noarc_;  
   int32 num_toks_; // current total #toks allocated...
+  std::vector<LmCacheEntry> lm_cache_;  // See GetLmArc().  Its entries stay
+  // valid from one utterance to the next, until SetLmDiffFst() is called.
+  // These are int64 because they count frames over all the utterances a
+  // decoder is used for, which may be the whole of a long-running process.
+  int64 lm_cache_frame_;  // Counts frames over all utterances.
+  int64 lm_cache_valid_frame_;  // Entries last used before this are stale.
+  Arc lm_arc_;  // Output of GetLmArc() if there is no cache.
+  int64 lm_cache_hits_;
+  int64 lm_cache_misses_;
   bool warned_;
   bool final_active_; // use this to say whether we found active final tokens
   // on the last frame.
@@ -25,14 +25,18 @@
 // svn merge ^/sandbox/online/src/decoder/lattice-faster-decoder.cc lattice-faster-online-decoder.cc
 
 #include "decoder/lattice-faster-decoder.h"
+#include "base/kaldi-profile.h"
 #include "lat/lattice-functions.h"
+#include "lat/determinize-lattice-incremental.h"
+#include "decoder/raw-lattice-chunk.h"
 
 namespace kaldi {
 
 // instantiate this class once for each thing you have to decode.
 LatticeFasterDecoder::LatticeFasterDecoder(const fst::Fst<fst::StdArc> &fst,
                                            const LatticeFasterDecoderConfig &config):
-    fst_(fst), delete_fst_(false), config_(config), num_toks_(0) {
+    fst_(fst), delete_fst_(false), config_(config), num_toks_(0),
+    epsilon_closure_table_(NULL) {
   config.Check();
   toks_.SetSize(1000);  // just so on the first frame we do something reasonable.
 }
@@ -40,7 +44,8 @@ LatticeFasterDecoder::LatticeFasterDecoder(const fst::Fst<fst::StdArc> &fst,
 
 LatticeFasterDecoder::LatticeFasterDecoder(const LatticeFasterDecoderConfig &config,
                                            fst::Fst<fst::StdArc> *fst):
-    fst_(*fst), delete_fst_(true), config_(config), num_toks_(0) {
+    fst_(*fst), delete_fst_(true), config_(config), num_toks_(0),
+    epsilon_closure_table_(NULL) {
   config.Check();
   toks_.SetSize(1000);  // just so on the first frame we do something reasonable.
 }
@@ -61,6 +66,8 @@ void LatticeFasterDecoder::InitDecoding() {
   num_toks_ = 0;
   decoding_finalized_ = false;
   final_costs_.clear();
+  boundary_labels_.clear();
+  boundary_frame_ = 0;
   StateId start_state = fst_.Start();
   KALDI_ASSERT(start_state != fst::kNoStateId);
   active_toks_.resize(1);
@@ -191,6 +198,50 @@ bool LatticeFasterDecoder::GetRawLattice(Lattice *ofst,
 }
 
 
+bool LatticeFasterDecoder::GetRawLatticeChunk(int32 begin_frame,
+                                              int32 end_frame,
+                                              Lattice *ofst) {
+  unordered_map<Token*, Label> end_labels;
+  if (!GetRawLatticeRange(begin_frame, end_frame, false, &end_labels, ofst))
+    return false;
+  boundary_labels_.swap(end_labels);
+  boundary_frame_ = end_frame;
+  return true;
+}
+
+bool LatticeFasterDecoder::GetRawLatticeFinalChunk(int32 begin_frame,
+                                                   bool use_final_probs,
+                                                   Lattice *ofst) const {
+  return GetRawLatticeRange(begin_frame, NumFramesDecoded(), use_final_probs,
+                            NULL, ofst);
+}
+
+bool LatticeFasterDecoder::GetRawLatticeRange(
+    int32 begin_frame, int32 end_frame, bool use_final_probs,
+    unordered_map<Token*, Label> *end_labels, Lattice *ofst) const {
+  KALDI_ASSERT(begin_frame >= 0 && begin_frame < end_frame &&
+               end_frame <= NumFramesDecoded());
+  if (begin_frame != 0 && begin_frame != boundary_frame_)
+    KALDI_ERR << "Chunk of lattice starts at frame " << begin_frame
+              << " but the previous chunk ended at frame " << boundary_frame_;
+  bool last_chunk = (end_labels == NULL);
+  if (last_chunk && decoding_finalized_ && !use_final_probs)
+    KALDI_ERR << "You cannot call FinalizeDecoding() and then call "
+              << "GetRawLatticeFinalChunk() with use_final_probs == false";
+
+  unordered_map<Token*, BaseFloat> final_costs_local;
+  const unordered_map<Token*, BaseFloat> &final_costs =
+      (decoding_finalized_ ? final_costs_ : final_costs_local);
+  if (last_chunk && !decoding_finalized_ && use_final_probs)
+    ComputeFinalCosts(&final_costs_local, NULL, NULL);
+
+  return GetRawLatticeChunkFromTokens<Token, ForwardLink>(
+      active_toks_, cost_offsets_, &TopSortTokens, begin_frame, end_frame,
+      boundary_labels_, (use_final_probs ? &final_costs : NULL), end_labels,
+      ofst);
+}
+
+
 // This function is now deprecated, since now we do determinization from outside
 // the LatticeFasterDecoder class.  Outputs an FST corresponding to the
 // lattice-determinized lattice (one path per word sequence).
@@ -474,6 +525,7 @@ void LatticeFasterDecoder::PruneTokensForFrame(int32 frame_plus_one) {
 // where the delta-costs are not changing (and the delta controls when we consider
 // a cost to have "not changed").
 void LatticeFasterDecoder::PruneActiveTokens(BaseFloat delta) {
+  KALDI_PROFILE_SCOPE("LatticeFasterDecoder::PruneActiveTokens");
   int32 cur_frame_plus_one = NumFramesDecoded();
   int32 num_toks_begin = num_toks_;
   // The index "f" below represents a "frame plus one", i.e. you'd have to subtract
@@ -658,6 +710,7 @@ BaseFloat LatticeFasterDecoder::GetCutoff(Elem *list_head, size_t *tok_count,
 }
 
 BaseFloat LatticeFasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
+  KALDI_PROFILE_SCOPE("LatticeFasterDecoder::ProcessEmitting");
   KALDI_ASSERT(active_toks_.size() > 0);
   int32 frame = active_toks_.size() - 1; // frame is the frame-index
                                          // (zero-based) used to get likelihoods
@@ -671,6 +724,7 @@ BaseFloat LatticeFasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
   BaseFloat adaptive_beam;
   size_t tok_cnt;
   BaseFloat cur_cutoff = GetCutoff(final_toks, &tok_cnt, &adaptive_beam, &best_elem);
+  KALDI_PROFILE_COUNT("LatticeFasterDecoder::ActiveTokens", tok_cnt);
   KALDI_VLOG(6) << "Adaptive beam on frame " << NumFramesDecoded() << " is "
                 << adaptive_beam;
   
@@ -750,6 +804,7 @@ BaseFloat LatticeFasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
 }
 
 void LatticeFasterDecoder::ProcessNonemitting(BaseFloat cutoff) {
+  KALDI_PROFILE_SCOPE("LatticeFasterDecoder::ProcessNonemitting");
   KALDI_ASSERT(!active_toks_.empty());
   int32 frame = static_cast<int32>(active_toks_.size()) - 2;
   // Note: "frame" is the time-index we just processed, or -1 if
@@ -780,6 +835,10 @@ void LatticeFasterDecoder::ProcessNonemitting(BaseFloat cutoff) {
     BaseFloat cur_cost = tok->tot_cost;
     if (cur_cost > cutoff) // Don't bother processing successors.
       continue;
+    if (epsilon_closure_table_ != NULL) {
+      ProcessEpsilonClosure(state, tok, frame, cutoff);
+      continue;
+    }
     // If "tok" has any existing forward links, delete them,
     // because we're about to regenerate them.  This is a kind
     // of non-optimality (remember, this is the simple decoder),
@@ -811,6 +870,46 @@ void LatticeFasterDecoder::ProcessNonemitting(BaseFloat cutoff) {
   } // while queue not empty
 }
 
+void LatticeFasterDecoder::ProcessEpsilonClosure(
+    StateId state, Token *tok, int32 frame, BaseFloat cutoff) {
+  int32 num_nodes;
+  const EpsilonClosureTable::Node *nodes =
+      epsilon_closure_table_->Closure(state, &num_nodes);
+  if (num_nodes == 0)  // No epsilon arcs, so "tok" can have no forward links
+    return;            // on this frame.
+  const EpsilonClosureTable::Arc *arcs = epsilon_closure_table_->Arcs();
+  // closure_toks_[i] is the token for node i of the closure if it was created
+  // or its cost was improved while processing this closure, else NULL.  The
+  // nodes are in topological order, so by the time we reach node i its cost
+  // can't change any more (within this closure) and we can regenerate its
+  // forward links, just as if it had been taken off queue_.
+  closure_toks_.clear();
+  closure_toks_.resize(num_nodes, NULL);
+  closure_toks_[0] = tok;
+  for (int32 i = 0; i < num_nodes; i++) {
+    Token *src_tok = closure_toks_[i];
+    if (src_tok == NULL) continue;
+    BaseFloat cur_cost = src_tok->tot_cost;
+    src_tok->DeleteForwardLinks();  // necessary when re-visiting
+    const EpsilonClosureTable::Arc *arc = arcs + nodes[i].arc_begin,
+        *arc_end = arcs + nodes[i].arc_end;
+    for (; arc != arc_end; ++arc) {
+      BaseFloat tot_cost = cur_cost + arc->graph_cost;
+      if (tot_cost < cutoff) {
+        bool changed;
+        Token *new_tok = FindOrAddToken(arc->nextstate, frame + 1, tot_cost,
+                                        &changed);
+        src_tok->links = new ForwardLink(new_tok, 0, arc->olabel,
+                                         arc->graph_cost, 0, src_tok->links);
+        if (changed) {
+          if (arc->next_node != -1) closure_toks_[arc->next_node] = new_tok;
+          else queue_.push_back(arc->nextstate);
+        }
+      }
+    }
+  }
+}
+
 
 void LatticeFasterDecoder::DeleteElems(Elem *list) {
   for (Elem *e = list, *e_tail; e != NULL; e = e_tail) {
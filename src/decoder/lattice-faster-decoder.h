@@ -34,6 +34,7 @@
 #include "fstext/fstext-lib.h"
 #include "lat/determinize-lattice-pruned.h"
 #include "lat/kaldi-lattice.h"
+#include "decoder/epsilon-closure-table.h"
 
 namespace kaldi {
 
@@ -117,6 +118,17 @@ class LatticeFasterDecoder {
   const LatticeFasterDecoderConfig &GetOptions() const {
     return config_;
   }
+
+  /// Makes the decoder use a precomputed table of epsilon closures when
+  /// processing non-emitting arcs, which avoids iterating over the emitting
+  /// arcs of each state (see ../egs/wsj/s5/local/run_epsilon_closure.sh for
+  /// how to measure the speed).  The table must have been computed from the
+  /// same FST that the decoder uses; it is not owned by the decoder, and may
+  /// be shared between decoders (e.g. in different threads).  Call with NULL
+  /// to stop using it.
+  void SetEpsilonClosureTable(const EpsilonClosureTable *table) {
+    epsilon_closure_table_ = table;
+  }
   
   ~LatticeFasterDecoder();
 
@@ -151,6 +163,25 @@ class LatticeFasterDecoder {
   bool GetRawLattice(Lattice *ofst,
                      bool use_final_probs = true) const;
 
+  /// GetRawLatticeChunk() and GetRawLatticeFinalChunk() are for determinizing
+  /// the lattice incrementally while decoding (see
+  /// ../lat/determinize-lattice-incremental.h).  Frames are numbered as for
+  /// NumFramesDecoded(), i.e. frame zero is before the first frame of features.
+  /// GetRawLatticeChunk() outputs the part of the raw lattice from begin_frame
+  /// to end_frame, with the tokens on end_frame linked to a single final state
+  /// by arcs with labels kChunkBoundaryLabel + n.  Except for the first chunk
+  /// (begin_frame == 0), begin_frame must be where the previous chunk ended,
+  /// and the start state is linked to the tokens on begin_frame by arcs with
+  /// the labels they were given then.  It returns false if some frame had no
+  /// tokens.
+  bool GetRawLatticeChunk(int32 begin_frame, int32 end_frame, Lattice *ofst);
+
+  /// Outputs the rest of the raw lattice from begin_frame, which must be zero
+  /// or where the last chunk ended, to the end; final-probs are as for
+  /// GetRawLattice().
+  bool GetRawLatticeFinalChunk(int32 begin_frame, bool use_final_probs,
+                               Lattice *ofst) const;
+
 
   /// [Deprecated, users should now use GetRawLattice and determinize it
   /// themselves, e.g. using DeterminizeLatticePhonePrunedWrapper].
@@ -347,6 +378,13 @@ class LatticeFasterDecoder {
   /// preceding ProcessEmitting().
   void ProcessNonemitting(BaseFloat cost_cutoff);
 
+  /// Called from ProcessNonemitting() if we have a table of epsilon closures:
+  /// propagates the token "tok" for state "state" over the epsilon arcs in its
+  /// closure, putting any states outside the closure whose tokens changed on
+  /// queue_.
+  void ProcessEpsilonClosure(StateId state, Token *tok, int32 frame,
+                             BaseFloat cutoff);
+
   // HashList defined in ../util/hash-list.h.  It actually allows us to maintain
   // more than one list (e.g. for current and previous frames), but only one of
   // them at a time can be indexed by StateId.  It is indexed by frame-index
@@ -370,6 +408,9 @@ class LatticeFasterDecoder {
   LatticeFasterDecoderConfig config_;
   int32 num_toks_; // current total #toks allocated...
   bool warned_;
+  const EpsilonClosureTable *epsilon_closure_table_;  // NULL if not used.
+  std::vector<Token*> closure_toks_;  // temp variable used in
+                                      // ProcessEpsilonClosure().
 
   /// decoding_finalized_ is true if someone called FinalizeDecoding().  [note,
   /// calling this is optional].  If true, it's forbidden to decode more.  Also,
@@ -409,6 +450,19 @@ class LatticeFasterDecoder {
 
   void ClearActiveTokens();
 
+  // Does the work of GetRawLatticeChunk() and GetRawLatticeFinalChunk(); if
+  // end_labels is NULL the chunk goes to the end of the utterance, else the
+  // labels of the tokens on end_frame are output to it.
+  bool GetRawLatticeRange(int32 begin_frame, int32 end_frame,
+                          bool use_final_probs,
+                          unordered_map<Token*, Label> *end_labels,
+                          Lattice *ofst) const;
+
+  // The labels given to the tokens on frame boundary_frame_ by the last call
+  // to GetRawLatticeChunk().
+  unordered_map<Token*, Label> boundary_labels_;
+  int32 boundary_frame_;
+
   KALDI_DISALLOW_COPY_AND_ASSIGN(LatticeFasterDecoder);  
 };
 
@@ -24,7 +24,10 @@
 // file in sync with lattice-faster-decoder.cc
 
 #include "decoder/lattice-faster-online-decoder.h"
+#include "base/kaldi-profile.h"
 #include "lat/lattice-functions.h"
+#include "lat/determinize-lattice-incremental.h"
+#include "decoder/raw-lattice-chunk.h"
 
 namespace kaldi {
 
@@ -61,6 +64,8 @@ void LatticeFasterOnlineDecoder::InitDecoding() {
   num_toks_ = 0;
   decoding_finalized_ = false;
   final_costs_.clear();
+  boundary_labels_.clear();
+  boundary_frame_ = 0;
   StateId start_state = fst_.Start();
   KALDI_ASSERT(start_state != fst::kNoStateId);
   active_toks_.resize(1);
@@ -227,6 +232,49 @@ bool LatticeFasterOnlineDecoder::GetRawLattice(Lattice *ofst,
   return (ofst->NumStates() > 0);
 }
 
+bool LatticeFasterOnlineDecoder::GetRawLatticeChunk(int32 begin_frame,
+                                                    int32 end_frame,
+                                                    Lattice *ofst) {
+  unordered_map<Token*, Label> end_labels;
+  if (!GetRawLatticeRange(begin_frame, end_frame, false, &end_labels, ofst))
+    return false;
+  boundary_labels_.swap(end_labels);
+  boundary_frame_ = end_frame;
+  return true;
+}
+
+bool LatticeFasterOnlineDecoder::GetRawLatticeFinalChunk(
+    int32 begin_frame, bool use_final_probs, Lattice *ofst) const {
+  return GetRawLatticeRange(begin_frame, NumFramesDecoded(), use_final_probs,
+                            NULL, ofst);
+}
+
+bool LatticeFasterOnlineDecoder::GetRawLatticeRange(
+    int32 begin_frame, int32 end_frame, bool use_final_probs,
+    unordered_map<Token*, Label> *end_labels, Lattice *ofst) const {
+  KALDI_ASSERT(begin_frame >= 0 && begin_frame < end_frame &&
+               end_frame <= NumFramesDecoded());
+  if (begin_frame != 0 && begin_frame != boundary_frame_)
+    KALDI_ERR << "Chunk of lattice starts at frame " << begin_frame
+              << " but the previous chunk ended at frame " << boundary_frame_;
+  bool last_chunk = (end_labels == NULL);
+  if (last_chunk && decoding_finalized_ && !use_final_probs)
+    KALDI_ERR << "You cannot call FinalizeDecoding() and then call "
+              << "GetRawLatticeFinalChunk() with use_final_probs == false";
+
+  unordered_map<Token*, BaseFloat> final_costs_local;
+  const unordered_map<Token*, BaseFloat> &final_costs =
+      (decoding_finalized_ ? final_costs_ : final_costs_local);
+  if (last_chunk && !decoding_finalized_ && use_final_probs)
+    ComputeFinalCosts(&final_costs_local, NULL, NULL);
+
+  return GetRawLatticeChunkFromTokens<Token, ForwardLink>(
+      active_toks_, cost_offsets_, &TopSortTokens, begin_frame, end_frame,
+      boundary_labels_, (use_final_probs ? &final_costs : NULL), end_labels,
+      ofst);
+}
+
+
 bool LatticeFasterOnlineDecoder::GetRawLatticePruned(
     Lattice *ofst,
     bool use_final_probs,
@@ -586,6 +634,7 @@ void LatticeFasterOnlineDecoder::PruneTokensForFrame(int32 frame_plus_one) {
 // where the delta-costs are not changing (and the delta controls when we consider
 // a cost to have "not changed").
 void LatticeFasterOnlineDecoder::PruneActiveTokens(BaseFloat delta) {
+  KALDI_PROFILE_SCOPE("LatticeFasterOnlineDecoder::PruneActiveTokens");
   int32 cur_frame_plus_one = NumFramesDecoded();
   int32 num_toks_begin = num_toks_;
   // The index "f" below represents a "frame plus one", i.e. you'd have to subtract
@@ -863,6 +912,7 @@ BaseFloat LatticeFasterOnlineDecoder::GetCutoff(Elem *list_head, size_t *tok_cou
 
 BaseFloat LatticeFasterOnlineDecoder::ProcessEmitting(
     DecodableInterface *decodable) {
+  KALDI_PROFILE_SCOPE("LatticeFasterOnlineDecoder::ProcessEmitting");
   KALDI_ASSERT(active_toks_.size() > 0);
   int32 frame = active_toks_.size() - 1; // frame is the frame-index
   // (zero-based) used to get likelihoods
@@ -876,6 +926,7 @@ BaseFloat LatticeFasterOnlineDecoder::ProcessEmitting(
   BaseFloat adaptive_beam;
   size_t tok_cnt;
   BaseFloat cur_cutoff = GetCutoff(final_toks, &tok_cnt, &adaptive_beam, &best_elem);
+  KALDI_PROFILE_COUNT("LatticeFasterOnlineDecoder::ActiveTokens", tok_cnt);
   PossiblyResizeHash(tok_cnt);  // This makes sure the hash is always big enough.
 
   BaseFloat next_cutoff = std::numeric_limits<BaseFloat>::infinity();
@@ -952,6 +1003,7 @@ BaseFloat LatticeFasterOnlineDecoder::ProcessEmitting(
 }
 
 void LatticeFasterOnlineDecoder::ProcessNonemitting(BaseFloat cutoff) {
+  KALDI_PROFILE_SCOPE("LatticeFasterOnlineDecoder::ProcessNonemitting");
   KALDI_ASSERT(!active_toks_.empty());
   int32 frame = static_cast<int32>(active_toks_.size()) - 2;
   // Note: "frame" is the time-index we just processed, or -1 if
@@ -143,6 +143,25 @@ class LatticeFasterOnlineDecoder {
   bool GetRawLattice(Lattice *ofst,
                      bool use_final_probs = true) const;
 
+  /// GetRawLatticeChunk() and GetRawLatticeFinalChunk() are for determinizing
+  /// the lattice incrementally while decoding (see
+  /// ../lat/determinize-lattice-incremental.h).  Frames are numbered as for
+  /// NumFramesDecoded(), i.e. frame zero is before the first frame of features.
+  /// GetRawLatticeChunk() outputs the part of the raw lattice from begin_frame
+  /// to end_frame, with the tokens on end_frame linked to a single final state
+  /// by arcs with labels kChunkBoundaryLabel + n.  Except for the first chunk
+  /// (begin_frame == 0), begin_frame must be where the previous chunk ended,
+  /// and the start state is linked to the tokens on begin_frame by arcs with
+  /// the labels they were given then.  It returns false if some frame had no
+  /// tokens.
+  bool GetRawLatticeChunk(int32 begin_frame, int32 end_frame, Lattice *ofst);
+
+  /// Outputs the rest of the raw lattice from begin_frame, which must be zero
+  /// or where the last chunk ended, to the end; final-probs are as for
+  /// GetRawLattice().
+  bool GetRawLatticeFinalChunk(int32 begin_frame, bool use_final_probs,
+                               Lattice *ofst) const;
+
   /// Behaves the same like GetRawLattice but only processes tokens whose
   /// extra_cost is smaller than the best-cost plus the specified beam.
   /// It is only worthwhile to call this function if beam is less than
@@ -406,6 +425,19 @@ class LatticeFasterOnlineDecoder {
 
   void ClearActiveTokens();
 
+  // Does the work of GetRawLatticeChunk() and GetRawLatticeFinalChunk(); if
+  // end_labels is NULL the chunk goes to the end of the utterance, else the
+  // labels of the tokens on end_frame are output to it.
+  bool GetRawLatticeRange(int32 begin_frame, int32 end_frame,
+                          bool use_final_probs,
+                          unordered_map<Token*, Label> *end_labels,
+                          Lattice *ofst) const;
+
+  // The labels given to the tokens on frame boundary_frame_ by the last call
+  // to GetRawLatticeChunk().
+  unordered_map<Token*, Label> boundary_labels_;
+  int32 boundary_frame_;
+
 
   KALDI_DISALLOW_COPY_AND_ASSIGN(LatticeFasterOnlineDecoder);
 };
@@ -0,0 +1,152 @@
+// decoder/raw-lattice-chunk.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_DECODER_RAW_LATTICE_CHUNK_H_
+#define KALDI_DECODER_RAW_LATTICE_CHUNK_H_
+
+#include <limits>
+#include <vector>
+#include "util/stl-utils.h"
+#include "lat/kaldi-lattice.h"
+#include "lat/determinize-lattice-incremental.h"
+
+namespace kaldi {
+
+/**
+   This function does the work of GetRawLatticeChunk() and
+   GetRawLatticeFinalChunk() for LatticeFasterDecoder and
+   LatticeFasterOnlineDecoder, whose Token, ForwardLink and TokenList types
+   have the same members but are different types; see the documentation of
+   those functions, and ../lat/determinize-lattice-incremental.h, for what the
+   chunk looks like.  The decoder passes its Token and ForwardLink types as
+   explicit template arguments.
+
+     active_toks     The decoder's per-frame token lists.
+     cost_offsets    The decoder's per-frame acoustic cost offsets.
+     top_sort_tokens The decoder's TopSortTokens().
+     begin_labels    The labels given to the tokens on begin_frame by the
+                     previous chunk (ignored if begin_frame == 0).
+     final_costs     If non-NULL, the final-costs of the tokens on the last
+                     frame of the utterance; if NULL or empty, all tokens on
+                     that frame are final with cost zero.
+     end_labels      If NULL this is the last chunk of the utterance, else the
+                     labels given to the tokens on end_frame are output here.
+
+   Returns false (with a warning) if some frame had no tokens.
+*/
+template<class Token, class ForwardLink, class TokenList>
+bool GetRawLatticeChunkFromTokens(
+    const std::vector<TokenList> &active_toks,
+    const std::vector<BaseFloat> &cost_offsets,
+    void (*top_sort_tokens)(Token*, std::vector<Token*>*),
+    int32 begin_frame, int32 end_frame,
+    const unordered_map<Token*, LatticeArc::Label> &begin_labels,
+    const unordered_map<Token*, BaseFloat> *final_costs,
+    unordered_map<Token*, LatticeArc::Label> *end_labels,
+    Lattice *ofst) {
+  typedef LatticeArc Arc;
+  typedef Arc::StateId StateId;
+  typedef Arc::Weight Weight;
+  typedef Arc::Label Label;
+
+  bool last_chunk = (end_labels == NULL);
+  ofst->DeleteStates();
+  unordered_map<Token*, StateId> tok_map;
+  if (begin_frame != 0)
+    ofst->AddState();  // start state, linked to the tokens on begin_frame.
+  std::vector<Token*> token_list, end_token_list;
+  for (int32 f = begin_frame; f <= end_frame; f++) {
+    if (active_toks[f].toks == NULL) {
+      KALDI_WARN << "GetRawLatticeChunk: no tokens active on frame " << f
+                 << ": not producing lattice.\n";
+      return false;
+    }
+    top_sort_tokens(active_toks[f].toks, &token_list);
+    for (size_t i = 0; i < token_list.size(); i++)
+      if (token_list[i] != NULL)
+        tok_map[token_list[i]] = ofst->AddState();
+    if (f == end_frame) end_token_list.swap(token_list);
+  }
+  ofst->SetStart(0);
+
+  if (begin_frame != 0) {
+    BaseFloat best_cost = std::numeric_limits<BaseFloat>::infinity();
+    for (Token *tok = active_toks[begin_frame].toks; tok != NULL;
+         tok = tok->next)
+      best_cost = std::min(best_cost, tok->tot_cost);
+    for (Token *tok = active_toks[begin_frame].toks; tok != NULL;
+         tok = tok->next) {
+      typename unordered_map<Token*, Label>::const_iterator iter =
+          begin_labels.find(tok);
+      KALDI_ASSERT(iter != begin_labels.end());
+      ofst->AddArc(0, Arc(0, iter->second,
+                          Weight(tok->tot_cost - best_cost, 0),
+                          tok_map[tok]));
+    }
+  }
+
+  bool use_final_costs = (final_costs != NULL && !final_costs->empty());
+  // Links from tokens on end_frame belong to the next chunk, if there is one.
+  int32 last_frame_with_links = (last_chunk ? end_frame : end_frame - 1);
+  for (int32 f = begin_frame; f <= last_frame_with_links; f++) {
+    for (Token *tok = active_toks[f].toks; tok != NULL; tok = tok->next) {
+      StateId cur_state = tok_map[tok];
+      for (ForwardLink *l = tok->links; l != NULL; l = l->next) {
+        typename unordered_map<Token*, StateId>::const_iterator iter =
+            tok_map.find(l->next_tok);
+        KALDI_ASSERT(iter != tok_map.end());
+        BaseFloat cost_offset = 0.0;
+        if (l->ilabel != 0) {  // emitting..
+          KALDI_ASSERT(f >= 0 && f < cost_offsets.size());
+          cost_offset = cost_offsets[f];
+        }
+        Arc arc(l->ilabel, l->olabel,
+                Weight(l->graph_cost, l->acoustic_cost - cost_offset),
+                iter->second);
+        ofst->AddArc(cur_state, arc);
+      }
+      if (last_chunk && f == end_frame) {
+        if (use_final_costs) {
+          typename unordered_map<Token*, BaseFloat>::const_iterator iter =
+              final_costs->find(tok);
+          if (iter != final_costs->end())
+            ofst->SetFinal(cur_state, LatticeWeight(iter->second, 0));
+        } else {
+          ofst->SetFinal(cur_state, LatticeWeight::One());
+        }
+      }
+    }
+  }
+  if (!last_chunk) {
+    StateId final_state = ofst->AddState();
+    ofst->SetFinal(final_state, LatticeWeight::One());
+    Label label = kChunkBoundaryLabel;
+    for (size_t i = 0; i < end_token_list.size(); i++) {
+      Token *tok = end_token_list[i];
+      if (tok == NULL) continue;
+      (*end_labels)[tok] = label;
+      ofst->AddArc(tok_map[tok], Arc(0, label, Weight::One(), final_state));
+      label++;
+    }
+  }
+  return (ofst->NumStates() > 0);
+}
+
+}  // namespace kaldi
+
+#endif  // KALDI_DECODER_RAW_LATTICE_CHUNK_H_
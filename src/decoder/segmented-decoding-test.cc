@@ -0,0 +1,119 @@
+// decoder/segmented-decoding-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/segmented-decoding.h"
+#include "lat/kaldi-lattice.h"
+
+namespace kaldi {
+
+void TestGetDecodingSegments() {
+  SegmentedDecodingConfig config;
+  config.segment_overlap = 1 + Rand() % 50;
+  config.segment_length = (Rand() % 4 == 0 ? 0 :
+                           config.segment_overlap + 1 + Rand() % 100);
+  int32 num_frames = 1 + Rand() % 1000;
+  std::vector<std::pair<int32, int32> > segments;
+  GetDecodingSegments(config, num_frames, &segments);
+  KALDI_ASSERT(!segments.empty());
+  KALDI_ASSERT(segments.front().first == 0 &&
+               segments.back().second == num_frames);
+  if (config.segment_length == 0 || num_frames <= config.segment_length) {
+    KALDI_ASSERT(segments.size() == 1);
+    return;
+  }
+  for (size_t i = 0; i < segments.size(); i++) {
+    int32 length = segments[i].second - segments[i].first;
+    KALDI_ASSERT(length <= config.segment_length && length > 0);
+    if (i + 1 < segments.size())
+      KALDI_ASSERT(length == config.segment_length);
+    if (i > 0)
+      KALDI_ASSERT(segments[i].first ==
+                   segments[i-1].second - config.segment_overlap);
+  }
+}
+
+// Outputs to "clat" a linear path through the states with times
+// times[begin] ... times[end]; the arc between
+// times[i] and times[i+1] has word i + 1 (or epsilon, for even i), a weight
+// that depends on i, and transition-ids equal to the frame indexes plus one,
+// so the alignment shows where each frame came from.
+void MakeLinearLattice(const std::vector<int32> &times, int32 begin,
+                       int32 end, CompactLattice *clat) {
+  clat->DeleteStates();
+  clat->SetStart(clat->AddState());
+  for (int32 i = begin; i < end; i++) {
+    std::vector<int32> tids;
+    for (int32 t = times[i]; t < times[i+1]; t++)
+      tids.push_back(t + 1);
+    int32 word = (i % 2 == 0 ? 0 : i + 1);
+    LatticeWeight w(0.5 * (i % 3), 0.25 * (i % 5));
+    CompactLatticeArc::StateId next = clat->AddState();
+    clat->AddArc(next - 1, CompactLatticeArc(word, word,
+                                             CompactLatticeWeight(w, tids),
+                                             next));
+  }
+  clat->SetFinal(clat->NumStates() - 1, CompactLatticeWeight::One());
+}
+
+// Stitching the lattices of two overlapping windows of a linear lattice should
+// give back the whole of it.
+void TestStitchCompactLattices() {
+  std::vector<int32> times(1, 0);  // state times of the whole path.
+  int32 num_states = 4 + Rand() % 20;
+  while (static_cast<int32>(times.size()) < num_states)
+    times.push_back(times.back() + 1 + Rand() % 5);
+  int32 n = num_states - 1;
+  // "a" covers states 0...k and "b" states j...n, with at least one state
+  // strictly inside the overlap.  The state times of "b" start from zero, as
+  // they would for a separately decoded window.
+  int32 k = 3 + Rand() % (n - 2), j = 1 + Rand() % (k - 2);
+  CompactLattice whole, a, b, stitched;
+  MakeLinearLattice(times, 0, n, &whole);
+  MakeLinearLattice(times, 0, k, &a);
+  MakeLinearLattice(times, j, n, &b);
+  KALDI_ASSERT(StitchCompactLattices(a, b, times[j], &stitched));
+
+  Lattice whole_lat, stitched_lat;
+  ConvertLattice(whole, &whole_lat);
+  ConvertLattice(stitched, &stitched_lat);
+  std::vector<int32> whole_ali, whole_words, stitched_ali, stitched_words;
+  LatticeWeight whole_weight, stitched_weight;
+  KALDI_ASSERT(GetLinearSymbolSequence(whole_lat, &whole_ali, &whole_words,
+                                       &whole_weight));
+  KALDI_ASSERT(GetLinearSymbolSequence(stitched_lat, &stitched_ali,
+                                       &stitched_words, &stitched_weight));
+  KALDI_ASSERT(stitched_words == whole_words);
+  KALDI_ASSERT(stitched_ali == whole_ali);
+  KALDI_ASSERT(ApproxEqual(stitched_weight, whole_weight));
+
+  // Windows that do not overlap can't be stitched.
+  CompactLattice c;
+  MakeLinearLattice(times, k, n, &c);
+  if (k < n)
+    KALDI_ASSERT(!StitchCompactLattices(a, c, times[k], &stitched));
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 100; i++) {
+    TestGetDecodingSegments();
+    TestStitchCompactLattices();
+  }
+  std::cout << "Tests succeeded\n";
+}
@@ -0,0 +1,361 @@
+// decoder/segmented-decoding.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include "decoder/segmented-decoding.h"
+#include "lat/lattice-functions.h"
+#include "lat/determinize-lattice-pruned.h"
+#include "thread/kaldi-thread.h"
+
+namespace kaldi {
+
+void GetDecodingSegments(const SegmentedDecodingConfig &config,
+                         int32 num_frames,
+                         std::vector<std::pair<int32, int32> > *segments) {
+  config.Check();
+  segments->clear();
+  if (config.segment_length == 0 || num_frames <= config.segment_length) {
+    segments->push_back(std::make_pair(0, num_frames));
+    return;
+  }
+  int32 shift = config.segment_length - config.segment_overlap;
+  for (int32 begin = 0; ; begin += shift) {
+    int32 end = std::min(begin + config.segment_length, num_frames);
+    segments->push_back(std::make_pair(begin, end));
+    if (end == num_frames) break;
+  }
+}
+
+// Works out the best path through a lattice that is topologically sorted with
+// start state zero, as the sequence of states it goes through; (*words)[i] is
+// the word on the arc from (*states)[i] to (*states)[i+1].  Returns false if
+// there is no successful path.
+static bool CompactLatticeBestPathStates(const CompactLattice &clat,
+                                         std::vector<int32> *states,
+                                         std::vector<int32> *words) {
+  typedef CompactLattice::Arc Arc;
+  typedef Arc::StateId StateId;
+  states->clear();
+  words->clear();
+  int32 num_states = clat.NumStates();
+  if (num_states == 0) return false;
+  KALDI_ASSERT(clat.Start() == 0);
+  double infinity = std::numeric_limits<double>::infinity();
+  std::vector<double> cost(num_states, infinity);
+  std::vector<StateId> prev_state(num_states, fst::kNoStateId);
+  std::vector<int32> prev_word(num_states, 0);
+  cost[0] = 0.0;
+  double best_cost = infinity;
+  StateId best_state = fst::kNoStateId;
+  for (StateId s = 0; s < num_states; s++) {
+    if (cost[s] == infinity) continue;
+    for (fst::ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done();
+         aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      KALDI_ASSERT(arc.nextstate > s && "Lattice not topologically sorted");
+      double arc_cost = cost[s] + ConvertToCost(arc.weight);
+      if (arc_cost < cost[arc.nextstate]) {
+        cost[arc.nextstate] = arc_cost;
+        prev_state[arc.nextstate] = s;
+        prev_word[arc.nextstate] = arc.olabel;
+      }
+    }
+    double final_cost = cost[s] + ConvertToCost(clat.Final(s));
+    if (final_cost < best_cost) {
+      best_cost = final_cost;
+      best_state = s;
+    }
+  }
+  if (best_state == fst::kNoStateId) return false;
+  for (StateId s = best_state; s != fst::kNoStateId; s = prev_state[s]) {
+    states->push_back(s);
+    if (s != 0) words->push_back(prev_word[s]);
+  }
+  std::reverse(states->begin(), states->end());
+  std::reverse(words->begin(), words->end());
+  return true;
+}
+
+// For each time t, sets (*index)[t] to the position in "states" of the single
+// state on the path at time t, or -1 if the path has no state, or more than
+// one state, at that time.
+static void GetPathTimeIndex(const std::vector<int32> &states,
+                             const std::vector<int32> &state_times,
+                             int32 offset,
+                             int32 num_times,
+                             std::vector<int32> *index) {
+  index->assign(num_times, -1);
+  std::vector<int32> count(num_times, 0);
+  for (size_t i = 0; i < states.size(); i++) {
+    int32 t = state_times[states[i]] + offset;
+    if (t >= 0 && t < num_times) {
+      count[t]++;
+      (*index)[t] = i;
+    }
+  }
+  for (int32 t = 0; t < num_times; t++)
+    if (count[t] != 1) (*index)[t] = -1;
+}
+
+// Returns the last nonzero word before position i of a path (i.e. on the arcs
+// before the i'th state), or zero if there is none.
+static int32 PreviousWord(const std::vector<int32> &words, int32 i) {
+  for (int32 j = i - 1; j >= 0; j--)
+    if (words[j] != 0) return words[j];
+  return 0;
+}
+
+// Returns the first nonzero word after the i'th state of a path, or zero if
+// there is none.
+static int32 NextWord(const std::vector<int32> &words, int32 i) {
+  for (size_t j = i; j < words.size(); j++)
+    if (words[j] != 0) return words[j];
+  return 0;
+}
+
+bool StitchCompactLattices(const CompactLattice &a_in,
+                           const CompactLattice &b_in,
+                           int32 b_offset,
+                           CompactLattice *out) {
+  typedef CompactLattice::Arc Arc;
+  typedef Arc::StateId StateId;
+  CompactLattice a(a_in), b(b_in);
+  TopSortCompactLatticeIfNeeded(&a);
+  TopSortCompactLatticeIfNeeded(&b);
+  if (a.Start() != 0 || b.Start() != 0) return false;  // empty lattices.
+  std::vector<int32> a_times, b_times;
+  int32 a_length = CompactLatticeStateTimes(a, &a_times);
+  CompactLatticeStateTimes(b, &b_times);
+  KALDI_ASSERT(b_offset > 0);
+  if (b_offset >= a_length) {
+    KALDI_WARN << "Lattices to be stitched do not overlap.";
+    return false;
+  }
+
+  std::vector<int32> a_states, a_words, b_states, b_words;
+  if (!CompactLatticeBestPathStates(a, &a_states, &a_words) ||
+      !CompactLatticeBestPathStates(b, &b_states, &b_words))
+    return false;
+  std::vector<int32> a_index, b_index;
+  GetPathTimeIndex(a_states, a_times, 0, a_length, &a_index);
+  GetPathTimeIndex(b_states, b_times, b_offset, a_length, &b_index);
+
+  // Choose the cut time t, strictly inside the overlap.
+  int32 middle = (b_offset + a_length) / 2, cut_time = -1;
+  bool cut_agrees = false;
+  for (int32 t = b_offset + 1; t < a_length; t++) {
+    int32 i = a_index[t], j = b_index[t];
+    if (i == -1 || j == -1) continue;
+    bool agrees = (PreviousWord(a_words, i) == PreviousWord(b_words, j) &&
+                   NextWord(a_words, i) == NextWord(b_words, j));
+    if (cut_time == -1 || (agrees && !cut_agrees) ||
+        (agrees == cut_agrees &&
+         std::abs(t - middle) < std::abs(cut_time - middle))) {
+      cut_time = t;
+      cut_agrees = agrees;
+    }
+  }
+  if (cut_time == -1) {
+    KALDI_WARN << "Could not find a common state time to stitch lattices in "
+               << "overlap from frame " << b_offset << " to " << a_length;
+    return false;
+  }
+  if (!cut_agrees)
+    KALDI_VLOG(1) << "Best paths do not agree on the words around any common "
+                  << "state time; stitching lattices at frame " << cut_time;
+  StateId b_cut_state = b_states[b_index[cut_time]];
+
+  out->DeleteStates();
+  std::vector<StateId> a_map(a.NumStates(), fst::kNoStateId),
+      b_map(b.NumStates(), fst::kNoStateId);
+  for (StateId s = 0; s < a.NumStates(); s++)
+    if (a_times[s] <= cut_time) a_map[s] = out->AddState();
+  for (StateId s = 0; s < b.NumStates(); s++)
+    if (b_times[s] + b_offset >= cut_time) b_map[s] = out->AddState();
+  out->SetStart(a_map[0]);
+
+  for (StateId s = 0; s < a.NumStates(); s++) {
+    if (a_times[s] < cut_time) {
+      // Keep the arcs that end at or before the cut.  Final-probs of "a" are
+      // dropped, as "a" does not reach the end of the utterance.
+      for (fst::ArcIterator<CompactLattice> aiter(a, s); !aiter.Done();
+           aiter.Next()) {
+        const Arc &arc = aiter.Value();
+        if (a_times[arc.nextstate] <= cut_time)
+          out->AddArc(a_map[s], Arc(arc.ilabel, arc.olabel, arc.weight,
+                                    a_map[arc.nextstate]));
+      }
+    } else if (a_times[s] == cut_time) {
+      // Continue with the arcs of "b" from its best-path state at the cut.
+      for (fst::ArcIterator<CompactLattice> aiter(b, b_cut_state);
+           !aiter.Done(); aiter.Next()) {
+        const Arc &arc = aiter.Value();
+        out->AddArc(a_map[s], Arc(arc.ilabel, arc.olabel, arc.weight,
+                                  b_map[arc.nextstate]));
+      }
+      out->SetFinal(a_map[s], b.Final(b_cut_state));
+    }
+  }
+  for (StateId s = 0; s < b.NumStates(); s++) {
+    if (b_map[s] == fst::kNoStateId) continue;
+    for (fst::ArcIterator<CompactLattice> aiter(b, s); !aiter.Done();
+         aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      out->AddArc(b_map[s], Arc(arc.ilabel, arc.olabel, arc.weight,
+                                b_map[arc.nextstate]));
+    }
+    out->SetFinal(b_map[s], b.Final(s));
+  }
+  fst::Connect(out);
+  return (out->NumStates() != 0);
+}
+
+// Presents frames [begin, end) of a decodable object as frames starting from
+// zero.
+class DecodableFrameRange: public DecodableInterface {
+ public:
+  DecodableFrameRange(DecodableInterface *decodable, int32 begin, int32 end):
+      decodable_(decodable), begin_(begin), end_(end) { }
+
+  virtual BaseFloat LogLikelihood(int32 frame, int32 index) {
+    return decodable_->LogLikelihood(frame + begin_, index);
+  }
+  virtual int32 NumFramesReady() const { return end_ - begin_; }
+  virtual bool IsLastFrame(int32 frame) const {
+    KALDI_ASSERT(frame < NumFramesReady());
+    return (frame == end_ - begin_ - 1);
+  }
+  virtual int32 NumIndices() const { return decodable_->NumIndices(); }
+ private:
+  DecodableInterface *decodable_;
+  int32 begin_;
+  int32 end_;
+};
+
+// Decodes windows thread_id_, thread_id_ + num_threads_, ... of the
+// utterance, putting the determinized lattices in (*lats)[i]; they are left
+// empty on failure.
+class SegmentDecoderClass: public MultiThreadable {
+ public:
+  SegmentDecoderClass(const fst::Fst<fst::StdArc> &fst,
+                      const LatticeFasterDecoderConfig &config,
+                      const TransitionModel &trans_model,
+                      DecodableInterface *decodable,
+                      const std::vector<std::pair<int32, int32> > &segments,
+                      std::vector<CompactLattice> *lats,
+                      bool *reached_final):
+      fst_(&fst), config_(&config), trans_model_(&trans_model),
+      decodable_(decodable), segments_(&segments), lats_(lats),
+      reached_final_(reached_final) { }
+
+  void operator() () {
+    for (size_t i = thread_id_; i < segments_->size(); i += num_threads_) {
+      int32 begin = (*segments_)[i].first, end = (*segments_)[i].second;
+      bool is_last = (i + 1 == segments_->size());
+      DecodableFrameRange decodable(decodable_, begin, end);
+      LatticeFasterDecoder decoder(*fst_, *config_);
+      Lattice lat;
+      if (is_last) {
+        // Only the last window sees the end of the utterance.
+        decoder.Decode(&decodable);
+        *reached_final_ = decoder.ReachedFinal();
+      } else {
+        decoder.InitDecoding();
+        decoder.AdvanceDecoding(&decodable);
+      }
+      if (decoder.NumFramesDecoded() != end - begin) {
+        KALDI_WARN << "Decoding failed for frames " << begin << " to " << end;
+        continue;
+      }
+      decoder.GetRawLattice(&lat, is_last);
+      fst::Connect(&lat);
+      if (lat.NumStates() == 0) {
+        KALDI_WARN << "Empty lattice for frames " << begin << " to " << end;
+        continue;
+      }
+      if (!DeterminizeLatticePhonePrunedWrapper(*trans_model_, &lat,
+                                                config_->lattice_beam,
+                                                &((*lats_)[i]),
+                                                config_->det_opts))
+        KALDI_WARN << "Determinization finished earlier than the beam for "
+                   << "frames " << begin << " to " << end;
+    }
+  }
+ private:
+  const fst::Fst<fst::StdArc> *fst_;
+  const LatticeFasterDecoderConfig *config_;
+  const TransitionModel *trans_model_;
+  DecodableInterface *decodable_;
+  const std::vector<std::pair<int32, int32> > *segments_;
+  std::vector<CompactLattice> *lats_;
+  bool *reached_final_;
+};
+
+bool DecodeSegmented(const fst::Fst<fst::StdArc> &fst,
+                     const LatticeFasterDecoderConfig &decoder_config,
+                     const SegmentedDecodingConfig &config,
+                     const TransitionModel &trans_model,
+                     DecodableInterface *decodable,
+                     CompactLattice *clat,
+                     bool *reached_final) {
+  int32 num_frames = decodable->NumFramesReady();
+  if (num_frames == 0) return false;
+  std::vector<std::pair<int32, int32> > segments;
+  GetDecodingSegments(config, num_frames, &segments);
+  int32 num_segments = segments.size();
+  std::vector<CompactLattice> lats(num_segments);
+  *reached_final = false;
+  {
+    SegmentDecoderClass c(fst, decoder_config, trans_model, decodable,
+                          segments, &lats, reached_final);
+    // The destructor of MultiThreader waits for the threads to finish.
+    MultiThreader<SegmentDecoderClass> m(
+        std::min(config.num_threads, num_segments), c);
+  }
+  for (int32 i = 0; i < num_segments; i++)
+    if (lats[i].NumStates() == 0) return false;
+
+  // Stitch neighbouring lattices pairwise, so that each state is copied only
+  // O(log(num_segments)) times.  begins[i] is the start frame of lats[i].
+  std::vector<int32> begins(num_segments);
+  for (int32 i = 0; i < num_segments; i++)
+    begins[i] = segments[i].first;
+  while (lats.size() > 1) {
+    size_t n = lats.size(), m = 0;
+    for (size_t i = 0; i < n; i += 2, m++) {
+      if (i + 1 < n) {
+        CompactLattice stitched;
+        if (!StitchCompactLattices(lats[i], lats[i + 1],
+                                   begins[i + 1] - begins[i], &stitched))
+          return false;
+        lats[m] = stitched;
+      } else {
+        lats[m] = lats[i];
+      }
+      begins[m] = begins[i];
+    }
+    lats.resize(m);
+    begins.resize(m);
+  }
+  *clat = lats[0];
+  return true;
+}
+
+}  // namespace kaldi
@@ -0,0 +1,128 @@
+// decoder/segmented-decoding.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_DECODER_SEGMENTED_DECODING_H_
+#define KALDI_DECODER_SEGMENTED_DECODING_H_
+
+#include <vector>
+#include "base/kaldi-common.h"
+#include "itf/options-itf.h"
+#include "itf/decodable-itf.h"
+#include "hmm/transition-model.h"
+#include "lat/kaldi-lattice.h"
+#include "decoder/lattice-faster-decoder.h"
+
+/**
+   This header contains code for decoding a single long utterance with several
+   threads.  The utterance is split into overlapping windows of frames, the
+   windows are decoded concurrently with LatticeFasterDecoder, and the
+   resulting lattices are stitched together at a word boundary inside each
+   overlap region, giving one CompactLattice for the whole utterance.  The
+   overlap gives the decoder for each window some "warm-up" frames (so it has a
+   reasonable idea of the word sequence at the start of its window) and some
+   look-ahead at the end.
+*/
+
+namespace kaldi {
+
+struct SegmentedDecodingConfig {
+  int32 segment_length;
+  int32 segment_overlap;
+  int32 num_threads;
+
+  SegmentedDecodingConfig(): segment_length(0), segment_overlap(500),
+                             num_threads(1) { }
+
+  void Register(OptionsItf *po) {
+    po->Register("segment-length", &segment_length,
+                 "If >0, utterances longer than this many frames are decoded "
+                 "as overlapping windows of this length, in parallel, and the "
+                 "lattices are stitched together.");
+    po->Register("segment-overlap", &segment_overlap,
+                 "Number of frames of overlap between successive windows, "
+                 "with --segment-length > 0; the lattices are joined at a "
+                 "word boundary inside the overlap.");
+    po->Register("segment-threads", &num_threads,
+                 "Number of threads used to decode the windows of one "
+                 "utterance, with --segment-length > 0.");
+  }
+  void Check() const {
+    KALDI_ASSERT(segment_length >= 0 && segment_overlap > 0 &&
+                 num_threads > 0);
+    KALDI_ASSERT((segment_length == 0 || segment_length > segment_overlap) &&
+                 "--segment-length must exceed --segment-overlap");
+  }
+};
+
+/// Works out the windows [begin, end) of frames, for an utterance of
+/// "num_frames" frames.  Successive windows overlap by exactly
+/// config.segment_overlap frames, and the last one ends at num_frames.  If
+/// segment_length is zero or num_frames <= segment_length, there is just one
+/// window.
+void GetDecodingSegments(const SegmentedDecodingConfig &config,
+                         int32 num_frames,
+                         std::vector<std::pair<int32, int32> > *segments);
+
+/// Joins two lattices, "a" which starts at frame zero and "b" which starts at
+/// frame b_offset; the region from b_offset to the end of "a" is the overlap.
+/// It picks a time t in the overlap at which the best paths of both lattices
+/// have a state, preferring times where they agree on the words before and
+/// after the state (i.e. both have a word boundary there) and, among those, the
+/// one closest to the middle of the overlap.  The output contains the part of
+/// "a" up to time t, and the part of "b" after t: each state of "a" at time t
+/// gets the arcs and final-prob of the best-path state of "b" at time t.
+/// Both inputs must be connected and acyclic, as produced by determinization.
+/// Returns false if the best paths have no state at a common time in the
+/// overlap (e.g. if the overlap is inside one long word), in which case *out is
+/// not set.
+bool StitchCompactLattices(const CompactLattice &a,
+                           const CompactLattice &b,
+                           int32 b_offset,
+                           CompactLattice *out);
+
+/// Decodes one utterance as overlapping windows (see GetDecodingSegments()),
+/// using config.num_threads threads, and outputs the stitched lattice in
+/// *clat; its scores are as produced by the decoder, i.e. with the acoustic
+/// scale applied.  Each window's lattice is determinized before stitching, but
+/// the stitched lattice is not determinized again and need not be
+/// deterministic, since a word sequence may be split at the stitch point in
+/// more than one way; use lattice-determinize-pruned if that matters.  "decodable" must give all frames in
+/// NumFramesReady() and its LogLikelihood() must be safe to call from several
+/// threads at once, which is true of decodable objects that just look up
+/// precomputed scores, such as DecodableAmNnet and DecodableMatrixScaledMapped.
+/// Only the last window is decoded with final-probs; if it did not reach a
+/// final state, *reached_final is set to false and the final-probs are
+/// treated as one, as for LatticeFasterDecoder::GetRawLattice().  Returns
+/// false if decoding failed, or if the lattices could not be stitched.
+/// Note: the LM history is reset at each window boundary.  Each window is
+/// decoded from the start state of "fst", so the first word of every window
+/// after the first is scored as if it began a sentence; the overlap only
+/// gives the search some frames to recover from that before the stitch
+/// point, and no LM context is carried across the stitch.
+bool DecodeSegmented(const fst::Fst<fst::StdArc> &fst,
+                     const LatticeFasterDecoderConfig &decoder_config,
+                     const SegmentedDecodingConfig &config,
+                     const TransitionModel &trans_model,
+                     DecodableInterface *decodable,
+                     CompactLattice *clat,
+                     bool *reached_final);
+
+
+}  // namespace kaldi
+
+#endif  // KALDI_DECODER_SEGMENTED_DECODING_H_
@@ -19,6 +19,7 @@
 
 
 #include "feat/feature-fbank.h"
+#include "base/kaldi-profile.h"
 
 
 namespace kaldi {
@@ -105,6 +106,7 @@ void Fbank::ComputeInternal(const VectorBase<BaseFloat> &wave,
                             const MelBanks &mel_banks,
                             Matrix<BaseFloat> *output,
                             Vector<BaseFloat> *wave_remainder) const {
+  KALDI_PROFILE_SCOPE("Fbank::Compute");
   KALDI_ASSERT(output != NULL);
 
   // Get dimensions of output features
@@ -19,6 +19,7 @@
 
 
 #include "feat/feature-mfcc.h"
+#include "base/kaldi-profile.h"
 
 
 namespace kaldi {
@@ -118,6 +119,7 @@ void Mfcc::ComputeInternal(const VectorBase<BaseFloat> &wave,
                            const MelBanks &mel_banks,
                            Matrix<BaseFloat> *output,
                            Vector<BaseFloat> *wave_remainder) const {
+  KALDI_PROFILE_SCOPE("Mfcc::Compute");
   KALDI_ASSERT(output != NULL);
   int32 rows_out = NumFrames(wave.Dim(), opts_.frame_opts),
       cols_out = opts_.num_ceps;
@@ -19,6 +19,7 @@
 
 
 #include "feat/feature-plp.h"
+#include "base/kaldi-profile.h"
 #include "util/parse-options.h"
 
 
@@ -163,6 +164,7 @@ void Plp::ComputeInternal(const VectorBase<BaseFloat> &wave,
                           const Vector<BaseFloat> &equal_loudness,
                           Matrix<BaseFloat> *output,
                           Vector<BaseFloat> *wave_remainder) const {
+  KALDI_PROFILE_SCOPE("Plp::Compute");
   KALDI_ASSERT(output != NULL);
   int32 rows_out = NumFrames(wave.Dim(), opts_.frame_opts),
       cols_out = opts_.num_ceps;
@@ -0,0 +1,79 @@
+// fstbin/fstcompactgraph.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "util/kaldi-io.h"
+#include "util/parse-options.h"
+#include "fst/fstlib.h"
+#include "fstext/fstext-utils.h"
+#include "fstext/compact-graph-fst.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace fst;
+    using kaldi::int32;
+
+    const char *usage =
+        "Converts a decoding graph (e.g. HCLG.fst) to the compact read-only\n"
+        "format of CompactGraphFst, which has quantized weights and\n"
+        "variable-length coded arcs.  Note: no decoder or other program reads\n"
+        "this format yet, except fstcompactgraph itself.\n"
+        "\n"
+        "Usage:  fstcompactgraph [options] [in.fst [out.fst] ]\n"
+        " e.g.:  fstcompactgraph HCLG.fst HCLG.cfst\n";
+
+    int32 weight_bits = 16;
+    ParseOptions po(usage);
+    po.Register("weight-bits", &weight_bits, "Number of bits for each arc "
+                "weight (8 or 16).  With 8 bits the weights of HCLG are "
+                "quantized to about 0.1, which may affect the results.");
+    po.Read(argc, argv);
+
+    if (po.NumArgs() > 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string fst_in_filename = po.GetOptArg(1),
+        fst_out_filename = po.GetOptArg(2);
+
+    Fst<StdArc> *fst = ReadFstKaldiGeneric(fst_in_filename);
+    CompactGraphFst compact_fst(*fst, weight_bits);
+    delete fst;
+
+    int64 num_arcs = compact_fst.TotalNumArcs(),
+        num_states = compact_fst.NumStates(),
+        const_size = num_states * 16 + num_arcs * sizeof(StdArc);
+    KALDI_LOG << "Converted FST with " << num_states << " states and "
+              << num_arcs << " arcs; size is " << compact_fst.MemSize()
+              << " bytes, versus about " << const_size << " as ConstFst.";
+
+    if (fst_out_filename == "") fst_out_filename = "-";
+    bool write_binary = true, write_header = false;
+    Output ko(fst_out_filename, write_binary, write_header);
+    FstWriteOptions wopts(PrintableWxfilename(fst_out_filename));
+    if (!compact_fst.Write(ko.Stream(), wopts))
+      KALDI_ERR << "Error writing FST to "
+                << PrintableWxfilename(fst_out_filename);
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -19,6 +19,7 @@
 
 
 #include "base/kaldi-common.h"
+#include "base/timer.h"
 #include "util/common-utils.h"
 #include "fst/fstlib.h"
 #include "fstext/context-fst.h"
@@ -135,7 +136,17 @@ int main(int argc, char *argv[]) {
     VectorFst<StdArc> composed_fst;
 
     // Work gets done here (see context-fst.h)
+    Timer timer;
     ComposeContext(disambig_in, N, P, fst, &composed_fst, &ilabels);
+    double elapsed = timer.Elapsed();
+    int64 num_arcs = 0;
+    for (StateIterator<VectorFst<StdArc> > siter(composed_fst);
+         !siter.Done(); siter.Next())
+      num_arcs += composed_fst.NumArcs(siter.Value());
+    KALDI_LOG << "Composed with context FST in " << elapsed << " seconds: "
+              << composed_fst.NumStates() << " states, " << num_arcs
+              << " arcs (" << (num_arcs / std::max(elapsed, 1.0e-03))
+              << " arcs per second), " << ilabels.size() << " ilabels.";
 
     WriteILabelInfo(Output(ilabels_out_filename, binary).Stream(),
                     binary, ilabels);
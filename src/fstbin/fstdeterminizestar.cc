@@ -73,11 +73,17 @@ int main(int argc, char *argv[]) {
 
     float delta = kDelta;
     int max_states = -1;
+    double max_mem = -1;
     bool use_log = false;
     ParseOptions po(usage);
     po.Register("use-log", &use_log, "Determinize in log semiring.");
     po.Register("delta", &delta, "Delta value used to determine equivalence of weights.");
     po.Register("max-states", &max_states, "Maximum number of states in determinized FST before it will abort.");
+    po.Register("max-mem", &max_mem, "If >0, abort determinization once its "
+                "approximate memory use passes this many bytes (e.g. 3e10).  "
+                "This is only a safety limit, like --max-states: it does not "
+                "make determinization use less memory.  Use --verbose=1 to "
+                "see progress and peak memory use.");
     po.Read(argc, argv);
 
     if (po.NumArgs() > 2) {
@@ -99,10 +105,12 @@ int main(int argc, char *argv[]) {
 
       ArcSort(fst, ILabelCompare<StdArc>());  // improves speed.
       if (use_log) {
-        DeterminizeStarInLog(fst, delta, &debug_location, max_states);
+        DeterminizeStarInLog(fst, delta, &debug_location, max_states,
+                             static_cast<int64>(max_mem));
       } else {
         VectorFst<StdArc> det_fst;
-        DeterminizeStar(*fst, &det_fst, delta, &debug_location, max_states);
+        DeterminizeStar(*fst, &det_fst, delta, &debug_location, max_states,
+                        false, static_cast<int64>(max_mem));
         *fst = det_fst;  // will do shallow copy and then det_fst goes
         // out of scope anyway.
       }
@@ -118,10 +126,12 @@ int main(int argc, char *argv[]) {
         ArcSort(&fst, ILabelCompare<StdArc>()); // improves speed.
         try {
           if (use_log) {
-            DeterminizeStarInLog(&fst, delta, &debug_location, max_states);
+            DeterminizeStarInLog(&fst, delta, &debug_location, max_states,
+                                 static_cast<int64>(max_mem));
           } else {
             VectorFst<StdArc> det_fst;
-            DeterminizeStar(fst, &det_fst, delta, &debug_location, max_states);
+            DeterminizeStar(fst, &det_fst, delta, &debug_location,
+                            max_states, false, static_cast<int64>(max_mem));
             fst = det_fst;  // will do shallow copy and then det_fst goes out
             // of scope anyway.
           }
@@ -0,0 +1,258 @@
+// fstext/compact-graph-fst-inl.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_FSTEXT_COMPACT_GRAPH_FST_INL_H_
+#define KALDI_FSTEXT_COMPACT_GRAPH_FST_INL_H_
+// Do not include this file directly.  It is included by compact-graph-fst.h
+
+#include <algorithm>
+#include <limits>
+
+namespace fst {
+
+inline uint32 CompactGraphFst::Data::EncodeWeight(float weight) const {
+  if (weight == 0.0) return 0;
+  if (weight == std::numeric_limits<float>::infinity())
+    return max_weight_code;
+  double code = 1.0 + floor((weight - weight_offset) / weight_scale + 0.5);
+  if (code < 1.0) code = 1.0;  // can only happen due to roundoff.
+  if (code > max_weight_code - 1) code = max_weight_code - 1;
+  return static_cast<uint32>(code);
+}
+
+inline CompactGraphFst::CompactGraphFst(const Fst<StdArc> &fst,
+                                        int32 weight_bits): data_(new Data()) {
+  if (weight_bits != 8 && weight_bits != 16)
+    KALDI_ERR << "CompactGraphFst: weight_bits must be 8 or 16, got "
+              << weight_bits;
+  Data *d = data_;
+  d->weight_bits = weight_bits;
+  d->max_weight_code = (1 << weight_bits) - 1;
+
+  // First pass: work out the number of states and the range of the weights.
+  float min_weight = std::numeric_limits<float>::infinity(),
+      max_weight = -std::numeric_limits<float>::infinity();
+  for (StateIterator<Fst<StdArc> > siter(fst); !siter.Done(); siter.Next()) {
+    StateId s = siter.Value();
+    d->num_states = std::max(d->num_states, s + 1);
+    for (ArcIterator<Fst<StdArc> > aiter(fst, s); !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      if (arc.ilabel < 0 || arc.olabel < 0)
+        KALDI_ERR << "CompactGraphFst: negative labels are not allowed.";
+      float w = arc.weight.Value();
+      if (w != 0.0 && w != std::numeric_limits<float>::infinity()) {
+        min_weight = std::min(min_weight, w);
+        max_weight = std::max(max_weight, w);
+      }
+    }
+  }
+  if (min_weight <= max_weight) {  // There were some finite, nonzero weights.
+    d->weight_offset = min_weight;
+    if (max_weight > min_weight)
+      d->weight_scale = (max_weight - min_weight) / (d->max_weight_code - 2);
+  }
+
+  // Second pass: encode the states.
+  d->start = fst.Start();
+  d->state_offsets.resize(d->num_states);
+  for (StateId s = 0; s < d->num_states; s++) {
+    // The limit is from WriteIntegerVector(), which writes the size as int32.
+    if (d->arc_data.size() >
+        static_cast<size_t>(std::numeric_limits<int32>::max()) - 1000)
+      KALDI_ERR << "CompactGraphFst: FST is too large (more than 2G bytes "
+                << "of arc data).";
+    d->state_offsets[s] = d->arc_data.size();
+    WriteVarint(fst.NumArcs(s), &(d->arc_data));
+    WriteVarint(fst.NumInputEpsilons(s), &(d->arc_data));
+    for (ArcIterator<Fst<StdArc> > aiter(fst, s); !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      WriteVarint((static_cast<uint64>(arc.ilabel) << 1) | (arc.olabel != 0),
+                  &(d->arc_data));
+      if (arc.olabel != 0)
+        WriteVarint(arc.olabel, &(d->arc_data));
+      int64 delta = static_cast<int64>(arc.nextstate) - s;
+      WriteVarint(delta >= 0 ? static_cast<uint64>(delta) << 1 :
+                  (static_cast<uint64>(-(delta + 1)) << 1) | 1,
+                  &(d->arc_data));
+      uint32 code = d->EncodeWeight(arc.weight.Value());
+      d->arc_data.push_back(static_cast<unsigned char>(code & 255));
+      if (weight_bits == 16)
+        d->arc_data.push_back(static_cast<unsigned char>(code >> 8));
+      d->num_arcs++;
+    }
+    Weight final_weight = fst.Final(s);
+    if (final_weight != Weight::Zero()) {
+      d->final_states.push_back(s);
+      d->final_weights.push_back(final_weight.Value());
+    }
+  }
+  // The quantization may change which weights are equal to One(), so we
+  // can't keep the kWeighted property.
+  d->properties = kExpanded |
+      (fst.Properties(kCopyProperties, false) & ~(kWeighted | kError));
+}
+
+inline CompactGraphFst::Weight CompactGraphFst::Final(StateId s) const {
+  std::vector<StateId>::const_iterator iter =
+      std::lower_bound(data_->final_states.begin(),
+                       data_->final_states.end(), s);
+  if (iter == data_->final_states.end() || *iter != s)
+    return Weight::Zero();
+  return data_->final_weights[iter - data_->final_states.begin()];
+}
+
+inline size_t CompactGraphFst::NumArcs(StateId s) const {
+  const unsigned char *ptr = &(data_->arc_data[data_->state_offsets[s]]);
+  return ReadVarint(&ptr);
+}
+
+inline size_t CompactGraphFst::NumInputEpsilons(StateId s) const {
+  const unsigned char *ptr = &(data_->arc_data[data_->state_offsets[s]]);
+  ReadVarint(&ptr);  // number of arcs.
+  return ReadVarint(&ptr);
+}
+
+inline size_t CompactGraphFst::NumOutputEpsilons(StateId s) const {
+  size_t ans = 0;
+  for (ArcIterator<CompactGraphFst> aiter(*this, s); !aiter.Done(); aiter.Next())
+    if (aiter.Value().olabel == 0) ans++;
+  return ans;
+}
+
+inline uint64 CompactGraphFst::Properties(uint64 mask, bool test) const {
+  if (test) {
+    uint64 known;
+    return TestProperties(*this, mask, &known) & mask;
+  } else {
+    return data_->properties & mask;
+  }
+}
+
+inline const string &CompactGraphFst::Type() const {
+  static const string type = "compact-graph";
+  return type;
+}
+
+// Used in InitArcIterator(), for code that iterates over the arcs through the
+// Fst<StdArc> interface.
+class CompactGraphArcIteratorBase: public ArcIteratorBase<StdArc> {
+ public:
+  CompactGraphArcIteratorBase(const CompactGraphFst &fst, StdArc::StateId s):
+      aiter_(fst, s) { }
+ private:
+  virtual bool Done_() const { return aiter_.Done(); }
+  virtual const StdArc &Value_() const { return aiter_.Value(); }
+  virtual void Next_() { aiter_.Next(); }
+  virtual size_t Position_() const { return aiter_.Position(); }
+  virtual void Reset_() { aiter_.Reset(); }
+  virtual void Seek_(size_t a) { aiter_.Seek(a); }
+  virtual uint32 Flags_() const { return aiter_.Flags(); }
+  virtual void SetFlags_(uint32 flags, uint32 mask) {
+    aiter_.SetFlags(flags, mask);
+  }
+  ArcIterator<CompactGraphFst> aiter_;
+};
+
+inline void CompactGraphFst::InitArcIterator(
+    StateId s, ArcIteratorData<Arc> *data) const {
+  data->base = new CompactGraphArcIteratorBase(*this, s);
+}
+
+inline size_t CompactGraphFst::MemSize() const {
+  return sizeof(CompactGraphFst) + sizeof(Data) +
+      data_->state_offsets.size() * sizeof(uint32) +
+      data_->arc_data.size() +
+      data_->final_states.size() * (sizeof(StateId) + sizeof(float));
+}
+
+inline bool CompactGraphFst::Write(std::ostream &strm,
+                                   const FstWriteOptions &opts) const {
+  if (opts.write_header) {
+    FstHeader hdr;
+    hdr.SetFstType(Type());
+    hdr.SetArcType(Arc::Type());
+    hdr.SetVersion(kFileVersion);
+    hdr.SetFlags(0);
+    hdr.SetProperties(data_->properties);
+    hdr.SetStart(data_->start);
+    hdr.SetNumStates(data_->num_states);
+    hdr.SetNumArcs(data_->num_arcs);
+    if (!hdr.Write(strm, opts.source))
+      return false;
+  }
+  bool binary = true;
+  kaldi::WriteBasicType(strm, binary, data_->weight_bits);
+  kaldi::WriteBasicType(strm, binary, data_->weight_offset);
+  kaldi::WriteBasicType(strm, binary, data_->weight_scale);
+  kaldi::WriteIntegerVector(strm, binary, data_->state_offsets);
+  kaldi::WriteIntegerVector(strm, binary, data_->arc_data);
+  kaldi::WriteIntegerVector(strm, binary, data_->final_states);
+  for (size_t i = 0; i < data_->final_weights.size(); i++)
+    kaldi::WriteBasicType(strm, binary, data_->final_weights[i]);
+  return strm.good();
+}
+
+inline CompactGraphFst *CompactGraphFst::Read(std::istream &strm,
+                                              const FstReadOptions &opts) {
+  FstHeader hdr;
+  if (opts.header != NULL) {
+    hdr = *opts.header;
+  } else if (!hdr.Read(strm, opts.source)) {
+    KALDI_ERR << "Error reading FST header from " << opts.source;
+  }
+  if (hdr.FstType() != "compact-graph" || hdr.ArcType() != Arc::Type()) {
+    KALDI_WARN << "Reading CompactGraphFst: unexpected FST type "
+               << hdr.FstType() << " or arc type " << hdr.ArcType();
+    return NULL;
+  }
+  if (hdr.Version() != kFileVersion)
+    KALDI_ERR << "Reading CompactGraphFst: unsupported version "
+              << hdr.Version();
+  Data *d = new Data();
+  d->start = hdr.Start();
+  d->num_states = hdr.NumStates();
+  d->num_arcs = hdr.NumArcs();
+  d->properties = hdr.Properties();
+  bool binary = true;
+  try {
+    kaldi::ReadBasicType(strm, binary, &(d->weight_bits));
+    if (d->weight_bits != 8 && d->weight_bits != 16)
+      KALDI_ERR << "Reading CompactGraphFst: bad weight_bits "
+                << d->weight_bits;
+    d->max_weight_code = (1 << d->weight_bits) - 1;
+    kaldi::ReadBasicType(strm, binary, &(d->weight_offset));
+    kaldi::ReadBasicType(strm, binary, &(d->weight_scale));
+    kaldi::ReadIntegerVector(strm, binary, &(d->state_offsets));
+    kaldi::ReadIntegerVector(strm, binary, &(d->arc_data));
+    kaldi::ReadIntegerVector(strm, binary, &(d->final_states));
+    d->final_weights.resize(d->final_states.size());
+    for (size_t i = 0; i < d->final_weights.size(); i++)
+      kaldi::ReadBasicType(strm, binary, &(d->final_weights[i]));
+    if (d->state_offsets.size() != static_cast<size_t>(d->num_states) ||
+        (d->num_states > 0 && d->state_offsets.back() >= d->arc_data.size()))
+      KALDI_ERR << "Reading CompactGraphFst: inconsistent data "
+                << "(corrupted file?)";
+  } catch (...) {
+    delete d;
+    throw;
+  }
+  return new CompactGraphFst(d);
+}
+
+}  // namespace fst
+
+#endif  // KALDI_FSTEXT_COMPACT_GRAPH_FST_INL_H_
@@ -0,0 +1,123 @@
+// fstext/compact-graph-fst-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "fstext/compact-graph-fst.h"
+#include "fstext/rand-fst.h"
+#include "base/kaldi-math.h"
+
+namespace fst {
+
+// Adds some arcs with large labels and special weights to "fst", so that we
+// test the multi-byte label coding and the codes for zero and infinite
+// weights.
+static void AddSpecialArcs(VectorFst<StdArc> *fst) {
+  int32 num_states = fst->NumStates();
+  if (num_states == 0) return;
+  for (int32 i = 0; i < 10; i++) {
+    StdArc arc;
+    arc.ilabel = (kaldi::Rand() % 2 == 0 ? 0 : kaldi::Rand() % 100000);
+    arc.olabel = (kaldi::Rand() % 2 == 0 ? 0 : kaldi::Rand() % 100000);
+    switch (kaldi::Rand() % 3) {
+      case 0: arc.weight = TropicalWeight::One(); break;
+      case 1: arc.weight = TropicalWeight::Zero(); break;
+      default: arc.weight = kaldi::RandGauss() * 10.0;
+    }
+    arc.nextstate = kaldi::Rand() % num_states;
+    fst->AddArc(kaldi::Rand() % num_states, arc);
+  }
+}
+
+void TestCompactGraphFst(int32 weight_bits) {
+  VectorFst<StdArc> *fst = RandFst<StdArc>();
+  AddSpecialArcs(fst);
+
+  // Work out the quantization step from the range of the finite, nonzero
+  // weights.
+  float min_weight = 0.0, max_weight = 0.0;
+  bool seen_weight = false;
+  for (StateIterator<VectorFst<StdArc> > siter(*fst); !siter.Done();
+       siter.Next()) {
+    for (ArcIterator<VectorFst<StdArc> > aiter(*fst, siter.Value());
+         !aiter.Done(); aiter.Next()) {
+      float w = aiter.Value().weight.Value();
+      if (w == 0.0 || w == std::numeric_limits<float>::infinity()) continue;
+      if (!seen_weight || w < min_weight) min_weight = w;
+      if (!seen_weight || w > max_weight) max_weight = w;
+      seen_weight = true;
+    }
+  }
+  float tolerance = 1.0e-04 + 0.5 * (max_weight - min_weight) /
+      ((1 << weight_bits) - 3);
+
+  CompactGraphFst compact_fst(*fst, weight_bits);
+
+  // Test writing and reading.
+  std::ostringstream os;
+  KALDI_ASSERT(compact_fst.Write(os, FstWriteOptions("foo")));
+  std::istringstream is(os.str());
+  CompactGraphFst *read_fst = CompactGraphFst::Read(is, FstReadOptions("foo"));
+  KALDI_ASSERT(read_fst != NULL);
+  // Access it via the generic (virtual) interface as well.
+  Fst<StdArc> *generic_fst = read_fst->Copy();
+
+  KALDI_ASSERT(read_fst->NumStates() == fst->NumStates() &&
+               read_fst->Start() == fst->Start() &&
+               read_fst->TotalNumArcs() == compact_fst.TotalNumArcs());
+  for (int32 s = 0; s < fst->NumStates(); s++) {
+    KALDI_ASSERT(read_fst->Final(s) == fst->Final(s));
+    KALDI_ASSERT(read_fst->NumArcs(s) == fst->NumArcs(s));
+    KALDI_ASSERT(read_fst->NumInputEpsilons(s) == fst->NumInputEpsilons(s));
+    KALDI_ASSERT(read_fst->NumOutputEpsilons(s) == fst->NumOutputEpsilons(s));
+    ArcIterator<VectorFst<StdArc> > aiter(*fst, s);
+    ArcIterator<Fst<StdArc> > aiter_generic(*generic_fst, s);
+    for (ArcIterator<CompactGraphFst> aiter_compact(*read_fst, s);
+         !aiter_compact.Done();
+         aiter_compact.Next(), aiter.Next(), aiter_generic.Next()) {
+      KALDI_ASSERT(!aiter.Done() && !aiter_generic.Done());
+      const StdArc &arc = aiter.Value(), &compact_arc = aiter_compact.Value(),
+          &generic_arc = aiter_generic.Value();
+      KALDI_ASSERT(arc.ilabel == compact_arc.ilabel &&
+                   arc.olabel == compact_arc.olabel &&
+                   arc.nextstate == compact_arc.nextstate);
+      float w = arc.weight.Value(), cw = compact_arc.weight.Value();
+      if (w == 0.0 || w == std::numeric_limits<float>::infinity())
+        KALDI_ASSERT(w == cw);  // These are coded exactly.
+      else
+        KALDI_ASSERT(std::abs(w - cw) <= tolerance);
+      KALDI_ASSERT(generic_arc.ilabel == compact_arc.ilabel &&
+                   generic_arc.olabel == compact_arc.olabel &&
+                   generic_arc.nextstate == compact_arc.nextstate &&
+                   generic_arc.weight == compact_arc.weight);
+    }
+    KALDI_ASSERT(aiter.Done() && aiter_generic.Done());
+  }
+  delete generic_fst;
+  delete read_fst;
+  delete fst;
+}
+
+}  // end namespace fst
+
+int main() {
+  using namespace fst;
+  for (int i = 0; i < 20; i++) {
+    TestCompactGraphFst(8);
+    TestCompactGraphFst(16);
+  }
+  std::cout << "Test OK\n";
+}
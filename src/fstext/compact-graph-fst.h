@@ -0,0 +1,271 @@
+// fstext/compact-graph-fst.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_FSTEXT_COMPACT_GRAPH_FST_H_
+#define KALDI_FSTEXT_COMPACT_GRAPH_FST_H_
+
+#include <fst/fstlib.h>
+#include <fst/fst-decl.h>
+#include <string>
+#include <vector>
+#include "base/kaldi-common.h"
+
+namespace fst {
+
+/// \addtogroup fst_extensions
+///  @{
+
+/**
+   CompactGraphFst is a read-only FST on StdArc, intended for large decoding
+   graphs (HCLG), that takes less memory than ConstFst, which needs 16 bytes
+   per arc.  An arc takes at least 3 bytes with 8-bit weights and 4 with
+   16-bit weights, plus one byte for every further 7 bits of its labels and
+   of its nextstate distance; how much smaller a real graph gets has not been
+   measured yet.  The arcs of each state are stored as a sequence of bytes:
+     - the ilabel, shifted left by one, with the lowest bit set if the olabel
+       is nonzero, as a variable-length integer (7 bits per byte);
+     - the olabel, only if it is nonzero (in HCLG, only the minority of arcs
+       that have words on them);
+     - the difference between the nextstate and the source state, as a
+       variable-length integer;
+     - the weight, quantized to 8 or 16 bits.
+   Code 0 of the quantized weights is reserved for exactly zero (One()) and the
+   highest code for infinity (Zero()); the rest of the codes are spread
+   uniformly between the smallest and largest finite weight in the graph, so
+   with 16 bits the quantization error for HCLG is of the order of 10^-4.
+   Final-weights are stored unquantized.  Labels must be nonnegative.
+   Symbol tables are not kept.
+
+   Because the arcs have to be decoded, code that iterates over them through
+   the generic Fst<StdArc> interface gets a virtual arc iterator that is
+   allocated on the heap for each state visited; code that knows the type can
+   use ArcIterator<CompactGraphFst>, which is specialized below and has no
+   virtual calls or allocation.  The decoders use the generic interface, so
+   they do not read this format until their speed with it has been compared
+   with ConstFst.  The object is safe to use from several threads at once (but
+   not to copy from several threads).
+
+   The file format is an OpenFst header with the type "compact-graph",
+   followed by the data in Kaldi binary format; you can read it with
+   ReadFstKaldiGeneric() in fstext-utils.h, which also reads vector and const
+   FSTs.  See fstcompactgraph for the command-line tool.
+*/
+class CompactGraphFst: public ExpandedFst<StdArc> {
+ public:
+  typedef StdArc Arc;
+  typedef Arc::Label Label;
+  typedef Arc::StateId StateId;
+  typedef Arc::Weight Weight;
+
+  /// Converts "fst", whose states must be numbered contiguously from zero
+  /// (as for VectorFst and ConstFst).  The encoded arcs may take at most 2G
+  /// bytes (about 300 million arcs).  weight_bits is the number of bits per
+  /// arc weight, 8 or 16.
+  explicit CompactGraphFst(const Fst<StdArc> &fst, int32 weight_bits = 16);
+
+  /// The copy shares the data with "other".
+  CompactGraphFst(const CompactGraphFst &other): data_(other.data_) {
+    data_->ref_count++;
+  }
+
+  virtual ~CompactGraphFst() {
+    if (--data_->ref_count == 0) delete data_;
+  }
+
+  virtual StateId Start() const { return data_->start; }
+
+  virtual Weight Final(StateId s) const;
+
+  virtual StateId NumStates() const { return data_->num_states; }
+
+  virtual size_t NumArcs(StateId s) const;
+
+  virtual size_t NumInputEpsilons(StateId s) const;
+
+  virtual size_t NumOutputEpsilons(StateId s) const;
+
+  virtual uint64 Properties(uint64 mask, bool test) const;
+
+  virtual const string &Type() const;
+
+  virtual CompactGraphFst *Copy(bool safe = false) const {
+    return new CompactGraphFst(*this);
+  }
+
+  virtual const SymbolTable *InputSymbols() const { return NULL; }
+
+  virtual const SymbolTable *OutputSymbols() const { return NULL; }
+
+  virtual void InitStateIterator(StateIteratorData<Arc> *data) const {
+    data->base = NULL;
+    data->nstates = data_->num_states;
+  }
+
+  virtual void InitArcIterator(StateId s, ArcIteratorData<Arc> *data) const;
+
+  virtual bool Write(std::ostream &strm, const FstWriteOptions &opts) const;
+
+  /// Reads the FST; if opts.header is set, the header must already have been
+  /// read from the stream.  Returns NULL if the header is for a different
+  /// type of FST, and throws on other errors.
+  static CompactGraphFst *Read(std::istream &strm, const FstReadOptions &opts);
+
+  /// Returns the approximate memory used by the FST, in bytes.
+  size_t MemSize() const;
+
+  /// Returns the number of arcs in the FST.
+  int64 TotalNumArcs() const { return data_->num_arcs; }
+
+ private:
+  friend class ArcIterator<CompactGraphFst>;
+
+  struct Data {
+    int32 ref_count;
+    StateId num_states;
+    StateId start;
+    int64 num_arcs;
+    uint64 properties;
+    int32 weight_bits;  // 8 or 16.
+    uint32 max_weight_code;  // (1 << weight_bits) - 1; means Zero().
+    float weight_offset;  // weight for code 1.
+    float weight_scale;  // difference in weight between successive codes.
+    // Indexed by state; offset of the state's data in arc_data.  Each state
+    // starts with its number of arcs and of input epsilons, as
+    // variable-length integers.
+    std::vector<uint32> state_offsets;
+    std::vector<unsigned char> arc_data;
+    std::vector<StateId> final_states;  // sorted.
+    std::vector<float> final_weights;  // corresponding to final_states.
+
+    Data(): ref_count(1), num_states(0), start(kNoStateId), num_arcs(0),
+            properties(0), weight_bits(16), max_weight_code(0),
+            weight_offset(0.0), weight_scale(1.0) { }
+
+    inline uint32 EncodeWeight(float weight) const;
+    inline float DecodeWeight(uint32 code) const {
+      if (code == 0) return 0.0;
+      else if (code == max_weight_code)
+        return std::numeric_limits<float>::infinity();
+      else return weight_offset + (code - 1) * weight_scale;
+    }
+  };
+
+  explicit CompactGraphFst(Data *data): data_(data) { }
+
+  static void WriteVarint(uint64 value, std::vector<unsigned char> *bytes) {
+    while (value >= 128) {
+      bytes->push_back(static_cast<unsigned char>(value & 127) | 128);
+      value >>= 7;
+    }
+    bytes->push_back(static_cast<unsigned char>(value));
+  }
+
+  static inline uint64 ReadVarint(const unsigned char **ptr) {
+    const unsigned char *p = *ptr;
+    uint64 ans = *p & 127;
+    int32 shift = 7;
+    while (*p & 128) {
+      p++;
+      ans |= static_cast<uint64>(*p & 127) << shift;
+      shift += 7;
+    }
+    *ptr = p + 1;
+    return ans;
+  }
+
+  static const int32 kFileVersion = 1;
+
+  Data *data_;
+
+  void operator = (const CompactGraphFst &);  // disallow
+};
+
+
+/// Specialization of ArcIterator for CompactGraphFst, which decodes the arcs
+/// one by one as you iterate.  Seek() is linear in the position.
+template<>
+class ArcIterator<CompactGraphFst> {
+ public:
+  typedef StdArc Arc;
+  typedef Arc::StateId StateId;
+
+  ArcIterator(const CompactGraphFst &fst, StateId s):
+      data_(fst.data_), state_(s) {
+    Reset();
+  }
+
+  bool Done() const { return pos_ >= num_arcs_; }
+
+  const Arc &Value() const { return arc_; }
+
+  void Next() {
+    pos_++;
+    if (pos_ < num_arcs_) Decode();
+  }
+
+  size_t Position() const { return pos_; }
+
+  void Reset() {
+    ptr_ = &(data_->arc_data[data_->state_offsets[state_]]);
+    num_arcs_ = CompactGraphFst::ReadVarint(&ptr_);
+    CompactGraphFst::ReadVarint(&ptr_);  // number of input epsilons.
+    pos_ = 0;
+    if (num_arcs_ > 0) Decode();
+  }
+
+  void Seek(size_t a) {
+    if (a < pos_) Reset();
+    while (pos_ < a) Next();
+  }
+
+  uint32 Flags() const { return kArcValueFlags; }
+
+  void SetFlags(uint32 flags, uint32 mask) { }
+
+ private:
+  // Decodes the arc at ptr_ into arc_, and advances ptr_.
+  void Decode() {
+    uint64 ilabel = CompactGraphFst::ReadVarint(&ptr_);
+    arc_.olabel = ((ilabel & 1) ? CompactGraphFst::ReadVarint(&ptr_) : 0);
+    arc_.ilabel = ilabel >> 1;
+    uint64 delta = CompactGraphFst::ReadVarint(&ptr_);  // zigzag-coded.
+    arc_.nextstate = state_ + static_cast<StateId>(
+        (delta & 1) ? -static_cast<int64>(delta >> 1) - 1 :
+        static_cast<int64>(delta >> 1));
+    uint32 code = *(ptr_++);
+    if (data_->weight_bits == 16)
+      code |= static_cast<uint32>(*(ptr_++)) << 8;
+    arc_.weight = data_->DecodeWeight(code);
+  }
+
+  const CompactGraphFst::Data *data_;
+  StateId state_;
+  const unsigned char *ptr_;  // start of the next arc to decode.
+  size_t num_arcs_;
+  size_t pos_;
+  Arc arc_;
+
+  DISALLOW_COPY_AND_ASSIGN(ArcIterator);
+};
+
+/// @} end "addtogroup fst_extensions"
+
+}  // namespace fst
+
+#include "fstext/compact-graph-fst-inl.h"
+
+#endif  // KALDI_FSTEXT_COMPACT_GRAPH_FST_H_
@@ -397,6 +397,88 @@ bool ContextMatcher<Arc, LabelT>::Find(typename Arc::Label match_label) {
   }
 }
 
+template<class Arc, class LabelT>
+void ComposeContextFst(const ContextFst<Arc, LabelT> &ifst1, const Fst<Arc> &ifst2,
+                       MutableFst<Arc> *ofst,
+                       const ComposeOptions &opts) {
+  typedef typename Arc::StateId StateId;
+  typedef typename Arc::Label Label;
+  typedef typename Arc::Weight Weight;
+  typedef std::pair<StateId, StateId> StatePair;
+  typedef unordered_map<StatePair, StateId,
+                        kaldi::PairHasher<StateId> > StatePairMap;
+  // An entry of the per-context-state arc tables: (ilabel, nextstate) of the
+  // arc of ifst1, or (kNoLabel, kNoStateId) if we have not yet called
+  // CreateArc() for that label, or (0, kNoStateId) if there is no such arc.
+  typedef std::pair<Label, StateId> ContextArc;
+
+  ofst->DeleteStates();
+  ofst->SetInputSymbols(ifst1.InputSymbols());
+  ofst->SetOutputSymbols(ifst2.OutputSymbols());
+  StateId start1 = ifst1.Start(), start2 = ifst2.Start();
+  if (start1 == kNoStateId || start2 == kNoStateId)
+    return;
+
+  vector<StatePair> state_pairs;  // indexed by state of ofst.
+  StatePairMap state_map;
+  vector<vector<ContextArc> > context_arcs;  // indexed by context state, then
+                                             // by label.
+  state_pairs.push_back(StatePair(start1, start2));
+  state_map[state_pairs.back()] = 0;
+  ofst->SetStart(ofst->AddState());
+
+  for (StateId s = 0; s < static_cast<StateId>(state_pairs.size()); s++) {
+    StatePair pr = state_pairs[s];  // copy, as state_pairs may be resized.
+    Weight final_weight = Times(ifst1.Final(pr.first),
+                                ifst2.Final(pr.second));
+    if (final_weight != Weight::Zero())
+      ofst->SetFinal(s, final_weight);
+    if (static_cast<size_t>(pr.first) >= context_arcs.size())
+      context_arcs.resize(pr.first + 1);
+    vector<ContextArc> &this_context_arcs = context_arcs[pr.first];
+
+    for (ArcIterator<Fst<Arc> > aiter(ifst2, pr.second); !aiter.Done();
+         aiter.Next()) {
+      const Arc &arc2 = aiter.Value();
+      StatePair next_pr(pr.first, arc2.nextstate);
+      Label ilabel = 0;
+      if (arc2.ilabel != 0) {  // else the context FST stays where it is.
+        if (static_cast<size_t>(arc2.ilabel) >= this_context_arcs.size())
+          this_context_arcs.resize(arc2.ilabel + 1,
+                                   ContextArc(kNoLabel, kNoStateId));
+        ContextArc &context_arc = this_context_arcs[arc2.ilabel];
+        if (context_arc.first == kNoLabel) {
+          Arc arc1;
+          if (ifst1.CreateArc(pr.first, arc2.ilabel, &arc1)) {
+            // The arcs of the context FST all have unit weight.
+            KALDI_ASSERT(arc1.weight == Weight::One());
+            context_arc = ContextArc(arc1.ilabel, arc1.nextstate);
+          } else {
+            context_arc = ContextArc(0, kNoStateId);
+          }
+        }
+        if (context_arc.second == kNoStateId)
+          continue;
+        ilabel = context_arc.first;
+        next_pr.first = context_arc.second;
+      }
+      StateId nextstate;
+      typename StatePairMap::const_iterator iter = state_map.find(next_pr);
+      if (iter == state_map.end()) {
+        nextstate = ofst->AddState();
+        KALDI_ASSERT(nextstate == static_cast<StateId>(state_pairs.size()));
+        state_pairs.push_back(next_pr);
+        state_map[next_pr] = nextstate;
+      } else {
+        nextstate = iter->second;
+      }
+      ofst->AddArc(s, Arc(ilabel, arc2.olabel, arc2.weight, nextstate));
+    }
+  }
+  if (opts.connect)
+    Connect(ofst);
+}
+
 template<class Arc>
 void AddSubsequentialLoop(typename Arc::Label subseq_symbol,
                           MutableFst<Arc> *fst) {
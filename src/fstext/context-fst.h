@@ -479,21 +479,21 @@ class ContextMatcher : public MatcherBase<Arc> {  // CAREFUL: templated on arc,
 /* This is a specialization of Compose, where the left argument is of
    type ContextFst.
    For clarity we distinguish it with a different name.
-   It uses the special matcher which should be more efficient than
-   a normal matcher.
+   Rather than going through ComposeFst with ContextMatcher, it directly
+   enumerates the reachable pairs (context state, state of ifst2), creating
+   the arcs of the context FST with CreateArc().  For each context state we
+   remember the arc created for each label, in a table indexed by label, so
+   the hashing of phone sequences inside ContextFst is done once per (context
+   state, label) rather than once per output arc.  The states are visited in
+   the same order as ComposeFst would visit them, so the output (and the
+   numbering of the ilabels of ifst1) is the same as from Compose.
    The fst ifst2 must have the subsequential loop (if not a left-context-only
    system)
 */
 template<class Arc, class LabelT>
 void ComposeContextFst(const ContextFst<Arc, LabelT> &ifst1, const Fst<Arc> &ifst2,
                        MutableFst<Arc> *ofst,
-                       const ComposeOptions &opts = ComposeOptions()) {
-  ComposeFstOptions<Arc, ContextMatcher<Arc, LabelT> > nopts;
-  nopts.gc_limit = 0;  // Cache only the most recent state for fastest copy.
-  *ofst = ComposeFst<Arc>(ifst1, ifst2, nopts);
-  if (opts.connect)
-    Connect(ofst);
-}
+                       const ComposeOptions &opts = ComposeOptions());
 
 /**
    Used in the command-line tool fstcomposecontext.  It creates a context FST and
@@ -30,6 +30,10 @@ namespace fst {
 // This class maps back and forth from/to integer id's to sequences of strings.
 // used in determinization algorithm.  It is constructed in such a way that
 // finding the string-id of the successor of (string, next-label) has constant time.
+// The Entry objects are allocated in large blocks, and entries that are freed by
+// Rebuild() are kept on a free list for reuse, which avoids the time and memory
+// overhead of allocating each (small) Entry separately.  Rebuild() gives back
+// the blocks that no longer hold any Entry that is in use.
 
 // Note: class IntType, typically int32, is the type of the element in the
 // string (typically a template argument of the CompactLatticeWeightTpl).
@@ -59,10 +63,9 @@ template<class IntType> class LatticeStringRepository {
     
     std::pair<typename SetType::iterator, bool> pr = set_.insert(new_entry_);
     if (pr.second) { // Was successfully inserted (was not there).  We need to
-                     // replace the element we inserted, which resides on the
-                     // stack, with one from the heap.
+                     // replace the element we inserted with a new spare one.
       const Entry *ans = new_entry_;
-      new_entry_ = new Entry();
+      new_entry_ = NewEntry();
       return ans;
     } else { // Was not inserted because an equivalent Entry already
              // existed.
@@ -164,19 +167,20 @@ template<class IntType> class LatticeStringRepository {
     return e;
   }
   
-  LatticeStringRepository() { new_entry_ = new Entry; }
+  LatticeStringRepository(): free_list_(NULL), block_pos_(kBlockSize) {
+    new_entry_ = NewEntry();
+  }
   
   void Destroy() {
-    for (typename SetType::iterator iter = set_.begin();
-         iter != set_.end();
-         ++iter)
-      delete *iter;
     SetType tmp;
     tmp.swap(set_);
-    if (new_entry_) {
-      delete new_entry_;
-      new_entry_ = NULL;
-    }
+    for (size_t i = 0; i < blocks_.size(); i++)
+      delete [] blocks_[i];
+    std::vector<Entry*> tmp_blocks;
+    tmp_blocks.swap(blocks_);
+    free_list_ = NULL;
+    block_pos_ = kBlockSize;
+    new_entry_ = NULL;
   }
 
   // Rebuild will rebuild this object, guaranteeing only
@@ -189,21 +193,82 @@ template<class IntType> class LatticeStringRepository {
              iter = to_keep.begin();
          iter != to_keep.end(); ++iter)
       RebuildHelper(*iter, &tmp_set);
-    // Now delete all elems not in tmp_set.
+    set_.swap(tmp_set);
+    if (blocks_.empty()) return;
+
+    // Count the Entries still in use in each block; we sort the blocks so we
+    // can find the block of an Entry by its address.
+    Entry *cur_block = blocks_.back();  // the one we are allocating from.
+    std::sort(blocks_.begin(), blocks_.end());
+    std::vector<size_t> num_used(blocks_.size(), 0);
     for (typename SetType::iterator iter = set_.begin();
-         iter != set_.end(); ++iter) {
-      if (tmp_set.count(*iter) == 0)
-        delete (*iter); // delete the Entry; not needed.
+         iter != set_.end(); ++iter)
+      num_used[BlockIndex(*iter)]++;
+    num_used[BlockIndex(new_entry_)]++;
+
+    // Delete the blocks that are no longer used, and put all the unused
+    // Entries of the others on a new free list.
+    std::vector<Entry*> kept_blocks;
+    free_list_ = NULL;
+    for (size_t b = 0; b < blocks_.size(); b++) {
+      Entry *block = blocks_[b];
+      if (num_used[b] == 0 && block != cur_block) {
+        delete [] block;
+        continue;
+      }
+      if (block != cur_block) kept_blocks.push_back(block);
+      size_t size = (block == cur_block ? block_pos_ : kBlockSize);
+      for (size_t j = 0; j < size; j++) {
+        Entry *e = block + j;
+        if (e == new_entry_) continue;
+        typename SetType::iterator iter = set_.find(e);
+        if (iter == set_.end() || *iter != e)
+          FreeEntry(e);
+      }
     }
-    set_.swap(tmp_set);
+    kept_blocks.push_back(cur_block);  // must stay last.
+    blocks_.swap(kept_blocks);
   }
   
   ~LatticeStringRepository() { Destroy(); }
   int32 MemSize() const {
-    return set_.size() * sizeof(Entry) * 2; // this is a lower bound
-    // on the size this structure might take.
+    // The blocks hold the Entries in use and the free list; set_ takes at
+    // least as much again for the Entries in use.  This is a lower bound on
+    // the size this structure might take.
+    return (blocks_.size() * kBlockSize + set_.size()) * sizeof(Entry);
   }
  private:  
+  static const size_t kBlockSize = 4096;  // number of Entries per block.
+
+  // Returns an uninitialized Entry, from the free list if possible.
+  Entry *NewEntry() {
+    if (free_list_ != NULL) {
+      Entry *ans = free_list_;
+      free_list_ = const_cast<Entry*>(free_list_->parent);
+      return ans;
+    }
+    if (block_pos_ == kBlockSize) {
+      blocks_.push_back(new Entry[kBlockSize]);
+      block_pos_ = 0;
+    }
+    return blocks_.back() + block_pos_++;
+  }
+  // Returns the index in blocks_ of the block that holds "entry"; only valid
+  // while blocks_ is sorted, i.e. inside Rebuild().
+  size_t BlockIndex(const Entry *entry) const {
+    typename std::vector<Entry*>::const_iterator iter =
+        std::upper_bound(blocks_.begin(), blocks_.end(),
+                         const_cast<Entry*>(entry));
+    assert(iter != blocks_.begin());
+    return (iter - blocks_.begin()) - 1;
+  }
+  // Puts an Entry on the free list; we link the list through "parent".
+  void FreeEntry(const Entry *entry) {
+    Entry *e = const_cast<Entry*>(entry);
+    e->parent = free_list_;
+    free_list_ = e;
+  }
+
   class EntryKey { // Hash function object.
    public:
     inline size_t operator()(const Entry *entry) const {
@@ -237,6 +302,9 @@ template<class IntType> class LatticeStringRepository {
   Entry *new_entry_; // We always have a pre-allocated Entry ready to use,
                      // to avoid unnecessary news and deletes.
   SetType set_;
+  std::vector<Entry*> blocks_;  // The blocks in which Entries are allocated.
+  Entry *free_list_;  // Entries freed by Rebuild(), linked through "parent".
+  size_t block_pos_;  // Number of Entries used in blocks_.back().
 
 };
 
@@ -90,6 +90,12 @@ template<class Label, class StringId> class StringRepository {
   inline bool IsEmptyString(StringId id) {
     return id == no_symbol;
   }
+  // Returns an approximation of the memory used by the stored sequences,
+  // in bytes (the hash overhead is only roughly estimated).
+  size_t MemSize() const {
+    return vec_.size() * (sizeof(vector<Label>) + 4 * sizeof(void*)) +
+        num_labels_ * sizeof(Label);
+  }
   void SeqOfId(StringId id, vector<Label> *v) {
     if (id == no_symbol) v->clear();
     else if (id>=single_symbol_start) {
@@ -112,7 +118,7 @@ template<class Label, class StringId> class StringRepository {
     }
   }
 
-  StringRepository() {
+  StringRepository(): num_labels_(0) {
     // The following are really just constants but don't want to complicate compilation so make them
     // class variables.  Due to the brokenness of <limits>, they can't be accessed as constants.
     string_end = (numeric_limits<StringId>::max() / 2) - 1;  // all hash values must be <= this.
@@ -127,6 +133,7 @@ template<class Label, class StringId> class StringRepository {
     tmp_vec.swap(vec_);    
     MapType tmp_map;
     tmp_map.swap(map_);
+    num_labels_ = 0;
   }
   ~StringRepository() {
     Destroy();
@@ -144,6 +151,7 @@ template<class Label, class StringId> class StringRepository {
       vector<Label> *v_new = new vector<Label> (v);
       vec_.push_back(v_new);
       map_[v_new] = this_id;
+      num_labels_ += v.size();
       assert(this_id < string_end);  // or we used up the labels.
       return this_id;
     }
@@ -151,6 +159,7 @@ template<class Label, class StringId> class StringRepository {
 
   vector<vector<Label>* > vec_;
   MapType map_;
+  size_t num_labels_;  // total length of the sequences in vec_.
 
   static const StringId string_start = (StringId) 0;  // This must not change.  It's assumed.
   StringId string_end;  // = (numeric_limits<StringId>::max() / 2) - 1; // all hash values must be <= this.
@@ -297,10 +306,12 @@ template<class Arc> class DeterminizerStar {
   // Initializer.  After initializing the object you will typically call one of
   // the Output functions.
   DeterminizerStar(const Fst<Arc> &ifst, float delta = kDelta,
-                   int max_states = -1, bool allow_partial = false):
+                   int max_states = -1, bool allow_partial = false,
+                   int64 max_mem = -1):
       ifst_(ifst.Copy()), delta_(delta), max_states_(max_states),
       determinized_(false), allow_partial_(allow_partial),
-      is_partial_(false), equal_(delta),
+      is_partial_(false), max_mem_(max_mem), num_arcs_(0), num_elems_(0),
+      cur_block_(NULL), cur_block_free_(0), peak_mem_(0), equal_(delta),
       hash_(ifst.Properties(kExpanded, false) ? down_cast<const ExpandedFst<Arc>*, const Fst<Arc> >(&ifst)->NumStates()/2 + 3 : 20, hasher_, equal_) { }
 
   void Determinize(bool *debug_ptr) {
@@ -319,11 +330,18 @@ template<class Arc> class DeterminizerStar {
       OutputStateId cur_id = SubsetToStateId(vec);
       assert(cur_id == 0 && "Do not call Determinize twice.");
     }
+    int64 num_processed = 0;
     while (!Q_.empty()) {
-      pair<vector<Element>*, OutputStateId> cur_pair = Q_.front();
+      pair<Subset, OutputStateId> cur_pair = Q_.front();
       Q_.pop_front();
       ProcessSubset(cur_pair);
       if (debug_ptr && *debug_ptr) Debug();  // will exit.
+      size_t mem = MemSize();
+      if (mem > peak_mem_) peak_mem_ = mem;
+      if (++num_processed % 1000000 == 0)
+        KALDI_VLOG(1) << "DeterminizeStar: processed " << num_processed
+                      << " states, " << Q_.size() << " in queue, using about "
+                      << (mem >> 20) << " MB.";
       if (max_states_ > 0 && output_arcs_.size() > max_states_) {
         if (allow_partial_ == false) {
           std::cerr << "Determinization aborted since passed " << max_states_
@@ -336,13 +354,42 @@ template<class Arc> class DeterminizerStar {
           break;
         }
       }
+      if (max_mem_ > 0 && static_cast<int64>(mem) > max_mem_) {
+        if (allow_partial_ == false) {
+          std::cerr << "Determinization aborted since memory use passed "
+                    << max_mem_ << " bytes.\n";
+          throw std::runtime_error("max-mem reached in determinization");
+        } else {
+          KALDI_WARN << "Determinization terminated since memory use passed "
+                     << max_mem_ << " bytes, partial results will be generated.";
+          is_partial_ = true;
+          break;
+        }
+      }
     }
+    KALDI_VLOG(1) << "DeterminizeStar: output has " << output_arcs_.size()
+                  << " states and " << num_arcs_ << " arcs (before expanding "
+                  << "output strings); peak memory use was about "
+                  << (peak_mem_ >> 20) << " MB.";
     determinized_ = true;
   }
 
   bool IsPartial() {
     return is_partial_;
   }
+
+  // Returns an estimate, in bytes, of the memory used by the determinization
+  // (the stored subsets and their hash, the output arcs and the strings).
+  size_t MemSize() const {
+    return num_elems_ * sizeof(Element) +
+        hash_.size() * (sizeof(Subset) + sizeof(OutputStateId) +
+                        2 * sizeof(void*)) +
+        output_arcs_.size() * sizeof(vector<TempArc>) +
+        num_arcs_ * sizeof(TempArc) + repository_.MemSize();
+  }
+
+  // Returns the largest value MemSize() took during Determinize().
+  size_t PeakMemSize() const { return peak_mem_; }
   
   // frees all except output_arcs_, which contains the important info
   // we need to output.
@@ -351,11 +398,16 @@ template<class Arc> class DeterminizerStar {
       delete ifst_;
       ifst_ = NULL;
     }
-    for (typename SubsetHash::iterator iter = hash_.begin();
-        iter != hash_.end(); ++iter)
-      delete iter->first;
+    Q_.clear();
     SubsetHash tmp;
-    tmp.swap(hash_); 
+    tmp.swap(hash_);
+    for (size_t i = 0; i < subset_blocks_.size(); i++)
+      delete [] subset_blocks_[i];
+    vector<Element*> tmp_blocks;
+    tmp_blocks.swap(subset_blocks_);
+    cur_block_ = NULL;
+    cur_block_free_ = 0;
+    num_elems_ = 0;
   }
   
   ~DeterminizerStar() {
@@ -392,8 +444,20 @@ template<class Arc> class DeterminizerStar {
   };
 
 
+  // A subset of input states as stored in hash_ and Q_: "size" Elements,
+  // stored contiguously in one of the blocks in subset_blocks_.  We don't
+  // allocate a separate vector<Element> for each output state, because for
+  // large inputs (e.g. LG with a big vocabulary) the vector headers and the
+  // malloc overhead would be a large fraction of the memory.
+  struct Subset {
+    const Element *elems;
+    size_t size;
+    Subset(const Element *elems, size_t size): elems(elems), size(size) { }
+    explicit Subset(const vector<Element> &vec):
+        elems(vec.empty() ? NULL : &(vec[0])), size(vec.size()) { }
+  };
+
   // Hashing function used in hash of subsets.
-  // A subset is a pointer to vector<Element>.
   // The Elements are in sorted order on state id, and without repeated states.
   // Because the order of Elements is fixed, we can use a hashing function that is
   // order-dependent.  However the weights are not included in the hashing function--
@@ -407,9 +471,10 @@ template<class Arc> class DeterminizerStar {
 
   class SubsetKey {
    public:
-    size_t operator ()(const vector<Element> * subset) const {  // hashes only the state and string.
+    size_t operator ()(const Subset &subset) const {  // hashes only the state and string.
       size_t hash = 0, factor = 1;
-      for (typename vector<Element>::const_iterator iter= subset->begin(); iter != subset->end(); ++iter) {
+      const Element *iter = subset.elems, *end = subset.elems + subset.size;
+      for (; iter != end; ++iter) {
         hash *= factor;
         hash += iter->state + 103333*iter->string;
         factor *= 23531;  // these numbers are primes.
@@ -422,12 +487,10 @@ template<class Arc> class DeterminizerStar {
   // and string, and approximate match on weights.
   class SubsetEqual {
    public:
-    bool operator ()(const vector<Element> * s1, const vector<Element> * s2) const {
-      size_t sz = s1->size();
-      assert(sz>=0);
-      if (sz != s2->size()) return false;
-      typename vector<Element>::const_iterator iter1 = s1->begin(),
-          iter1_end = s1->end(), iter2=s2->begin();
+    bool operator ()(const Subset &s1, const Subset &s2) const {
+      if (s1.size != s2.size) return false;
+      const Element *iter1 = s1.elems, *iter1_end = s1.elems + s1.size,
+          *iter2 = s2.elems;
       for (; iter1 < iter1_end; ++iter1, ++iter2) {
         if (iter1->state != iter2->state ||
            iter1->string != iter2->string ||
@@ -444,12 +507,10 @@ template<class Arc> class DeterminizerStar {
   // Used only for debug.
   class SubsetEqualStates {
    public:
-    bool operator ()(const vector<Element> * s1, const vector<Element> * s2) const {
-      size_t sz = s1->size();
-      assert(sz>=0);
-      if (sz != s2->size()) return false;
-      typename vector<Element>::const_iterator iter1 = s1->begin(),
-          iter1_end = s1->end(), iter2=s2->begin();
+    bool operator ()(const Subset &s1, const Subset &s2) const {
+      if (s1.size != s2.size) return false;
+      const Element *iter1 = s1.elems, *iter1_end = s1.elems + s1.size,
+          *iter2 = s2.elems;
       for (; iter1 < iter1_end; ++iter1, ++iter2) {
         if (iter1->state != iter2->state) return false;
       }
@@ -458,14 +519,14 @@ template<class Arc> class DeterminizerStar {
   };
 
   // Define the hash type we use to store subsets.
-  typedef unordered_map<const vector<Element>*, OutputStateId, SubsetKey, SubsetEqual> SubsetHash;
+  typedef unordered_map<Subset, OutputStateId, SubsetKey, SubsetEqual> SubsetHash;
 
 
   // This function computes epsilon closure of subset of states by following epsilon links.
   // Called by ProcessSubset.
   // Has no side effects except on the repository.
 
-  void EpsilonClosure(const vector<Element> & input_subset,
+  void EpsilonClosure(const Subset &input_subset,
                       vector<Element> *output_subset) {
     // input_subset must have only one example of each StateId.
 
@@ -473,8 +534,9 @@ template<class Arc> class DeterminizerStar {
     typedef typename std::map<InputStateId, Element>::iterator MapIter;
     {
       MapIter iter = cur_subset.end();
-      for (size_t i = 0;i < input_subset.size();i++) {
-        std::pair<const InputStateId, Element> pr(input_subset[i].state, input_subset[i]);
+      for (size_t i = 0;i < input_subset.size;i++) {
+        const Element &elem = input_subset.elems[i];
+        std::pair<const InputStateId, Element> pr(elem.state, elem);
         iter = cur_subset.insert(iter, pr);
         // By providing iterator where we inserted last one, we make insertion more efficient since
         // input subset was already in sorted order.
@@ -483,7 +545,8 @@ template<class Arc> class DeterminizerStar {
     // find whether input fst is known to be sorted in input label.
     bool sorted = ((ifst_->Properties(kILabelSorted, false) & kILabelSorted) != 0);
     
-    vector<Element> queue(input_subset);  // queue of things to be processed.
+    vector<Element> queue(input_subset.elems,
+                          input_subset.elems + input_subset.size);  // queue of things to be processed.
     bool replaced_elems = false; // relates to an optimization, see below.
     int counter = 0; // relates to max-states option, used for test.
     while (queue.size() != 0) {
@@ -603,6 +666,7 @@ template<class Arc> class DeterminizerStar {
       temp_arc.ostring = final_string;
       temp_arc.weight = final_weight;
       output_arcs_[state].push_back(temp_arc);
+      num_arcs_++;
     }
   }
 
@@ -686,6 +750,7 @@ template<class Arc> class DeterminizerStar {
     temp_arc.ostring = common_str;
     temp_arc.weight = tot_weight;
     output_arcs_[state].push_back(temp_arc);  // record the arc.
+    num_arcs_++;
   }
 
 
@@ -762,6 +827,29 @@ template<class Arc> class DeterminizerStar {
     }
   }
 
+  // Copies "subset" into the block storage and returns the stored version.
+  // Subsets larger than a quarter of a block get a block of their own.
+  Subset NewSubset(const vector<Element> &subset) {
+    size_t size = subset.size();
+    Element *elems;
+    if (size > kSubsetBlockSize / 4) {
+      elems = new Element[size];
+      subset_blocks_.push_back(elems);
+      num_elems_ += size;
+    } else {
+      if (size > cur_block_free_) {
+        cur_block_ = new Element[kSubsetBlockSize];
+        subset_blocks_.push_back(cur_block_);
+        cur_block_free_ = kSubsetBlockSize;
+        num_elems_ += kSubsetBlockSize;
+      }
+      elems = cur_block_ + (kSubsetBlockSize - cur_block_free_);
+      cur_block_free_ -= size;
+    }
+    std::copy(subset.begin(), subset.end(), elems);
+    return Subset(elems, size);
+  }
+
   // SubsetToStateId converts a subset (vector of Elements) to a StateId in the output
   // fst.  This is a hash lookup; if no such state exists, it adds a new state to the hash
   // and adds a new pair to the queue.
@@ -769,20 +857,20 @@ template<class Arc> class DeterminizerStar {
 
   OutputStateId SubsetToStateId(const vector<Element> &subset) {  // may add the subset to the queue.
     typedef typename SubsetHash::iterator IterType;
-    IterType iter = hash_.find(&subset);
+    IterType iter = hash_.find(Subset(subset));
     if (iter == hash_.end()) {  // was not there.
-      vector<Element> *new_subset = new vector<Element>(subset);
+      Subset new_subset = NewSubset(subset);
       OutputStateId new_state_id = (OutputStateId) output_arcs_.size();
-      hash_[new_subset] = new_state_id;
+      hash_.insert(std::make_pair(new_subset, new_state_id));
       output_arcs_.push_back(vector<TempArc>());
       if (allow_partial_ == false) {
         // If --allow-partial is not requested, we do the old way.
-        Q_.push_front(pair<vector<Element>*, OutputStateId>(new_subset,  new_state_id));
+        Q_.push_front(pair<Subset, OutputStateId>(new_subset, new_state_id));
       } else {
         // If --allow-partial is requested, we do breadth first search. This
         // ensures that when we return partial results, we return the states
         // that are reachable by the fewest steps from the start state.
-        Q_.push_back(pair<vector<Element>*, OutputStateId>(new_subset,  new_state_id));
+        Q_.push_back(pair<Subset, OutputStateId>(new_subset, new_state_id));
       }
       return new_state_id;
     } else {
@@ -798,12 +886,12 @@ template<class Arc> class DeterminizerStar {
   // of the state, and then handle transitions out (this may add more determinized states
   // to the queue).
 
-  void ProcessSubset(const pair<vector<Element>*, OutputStateId> & pair) {
-    const vector<Element> *subset = pair.first;
+  void ProcessSubset(const pair<Subset, OutputStateId> & pair) {
+    const Subset &subset = pair.first;
     OutputStateId state = pair.second;
 
     vector<Element> closed_subset;  // subset after epsilon closure.
-    EpsilonClosure(*subset, &closed_subset);
+    EpsilonClosure(subset, &closed_subset);
 
     // Now follow non-epsilon arcs [and also process final states]
     ProcessFinal(closed_subset, state);
@@ -876,7 +964,7 @@ template<class Arc> class DeterminizerStar {
 
 
   DISALLOW_COPY_AND_ASSIGN(DeterminizerStar);
-  deque<pair<vector<Element>*, OutputStateId> > Q_;  // queue of subsets to be processed.
+  deque<pair<Subset, OutputStateId> > Q_;  // queue of subsets to be processed.
 
   vector<vector<TempArc> > output_arcs_;  // essentially an FST in our format.
 
@@ -886,6 +974,17 @@ template<class Arc> class DeterminizerStar {
   bool determinized_; // used to check usage.
   bool allow_partial_;  // output paritial results or not
   bool is_partial_;     // if we get partial results or not
+  int64 max_mem_;  // if >0, stop when MemSize() exceeds this.
+
+  // The following are used to keep track of memory usage.
+  size_t num_arcs_;  // number of arcs in output_arcs_.
+  size_t num_elems_;  // number of Elements allocated in subset_blocks_.
+
+  static const size_t kSubsetBlockSize = 4096;  // number of Elements per block.
+  vector<Element*> subset_blocks_;  // storage for the subsets in hash_.
+  Element *cur_block_;  // the block we are currently allocating from ...
+  size_t cur_block_free_;  // ... and the number of Elements left in it.
+  size_t peak_mem_;  // largest MemSize() seen in Determinize().
   SubsetKey hasher_;  // object that computes keys-- has no data members.
   SubsetEqual equal_;  // object that compares subsets-- only data member is delta_.
   SubsetHash hash_;  // hash from Subset to StateId in final Fst.
@@ -897,10 +996,10 @@ template<class Arc> class DeterminizerStar {
 template<class Arc>
 bool DeterminizeStar(Fst<Arc> &ifst, MutableFst<Arc> *ofst,
                      float delta, bool *debug_ptr, int max_states,
-                     bool allow_partial) {
+                     bool allow_partial, int64 max_mem) {
   ofst->SetOutputSymbols(ifst.OutputSymbols());
   ofst->SetInputSymbols(ifst.InputSymbols());
-  DeterminizerStar<Arc> det(ifst, delta, max_states, allow_partial);
+  DeterminizerStar<Arc> det(ifst, delta, max_states, allow_partial, max_mem);
   det.Determinize(debug_ptr);
   det.Output(ofst);
   return det.IsPartial();
@@ -910,10 +1009,10 @@ bool DeterminizeStar(Fst<Arc> &ifst, MutableFst<Arc> *ofst,
 template<class Arc>
 bool DeterminizeStar(Fst<Arc> &ifst, MutableFst<GallicArc<Arc> > *ofst, float delta,
                      bool *debug_ptr, int max_states,
-                     bool allow_partial) {
+                     bool allow_partial, int64 max_mem) {
   ofst->SetOutputSymbols(ifst.InputSymbols());
   ofst->SetInputSymbols(ifst.InputSymbols());
-  DeterminizerStar<Arc> det(ifst, delta, max_states, allow_partial);
+  DeterminizerStar<Arc> det(ifst, delta, max_states, allow_partial, max_mem);
   det.Determinize(debug_ptr);
   det.Output(ofst);
   return det.IsPartial();
@@ -64,6 +64,42 @@ template<class Arc> void TestDeterminizeGeneral() {
 }
 
 
+// test the max-mem option: with a tiny limit determinization should fail, or
+// return partial output if allow_partial == true, and with a large limit it
+// should give the same output as with no limit.
+template<class Arc> void TestDeterminizeMaxMem() {
+  for(int i = 0; i < 100; i++) {
+    VectorFst<Arc> *fst = RandFst<Arc>();
+    if (fst->Start() == kNoStateId) {  // nothing to determinize.
+      delete fst;
+      continue;
+    }
+    VectorFst<Arc> ofst1, ofst2, ofst3;
+    try {
+      DeterminizeStar<Arc>(*fst, &ofst1, kDelta, NULL, 100);
+    } catch (...) {
+      delete fst;  // probably not determinizable.
+      continue;
+    }
+    bool is_partial = DeterminizeStar<Arc>(*fst, &ofst2, kDelta, NULL, 100,
+                                           true, 1);
+    KALDI_ASSERT(is_partial);
+    is_partial = DeterminizeStar<Arc>(*fst, &ofst3, kDelta, NULL, 100,
+                                      false, 100000000);
+    KALDI_ASSERT(!is_partial && ofst3.NumStates() == ofst1.NumStates());
+    assert(RandEquivalent(ofst1, ofst3, 5/*paths*/, 0.01/*delta*/, kaldi::Rand()/*seed*/, 100/*path length, max*/));
+    bool threw = false;
+    try {
+      DeterminizeStar<Arc>(*fst, &ofst2, kDelta, NULL, 100, false, 1);
+    } catch (...) {
+      threw = true;
+    }
+    KALDI_ASSERT(threw);
+    delete fst;
+  }
+}
+
+
 // Don't instantiate with log semiring, as RandEquivalent may fail.
 template<class Arc>  void TestDeterminize() {
   typedef typename Arc::Label Label;
@@ -600,6 +636,7 @@ int main() {
     fst::TestStringRepository<fst::StdArc, unsigned char>();
     fst::TestStringRepository<fst::StdArc, char>();
     fst::TestDeterminizeGeneral<fst::StdArc>();
+    fst::TestDeterminizeMaxMem<fst::StdArc>();
     fst::TestDeterminize<fst::StdArc>();
     // fst::TestDeterminize2<fst::StdArc>();
     fst::TestPush<fst::StdArc>();
@@ -81,13 +81,23 @@ namespace fst {
     out an error.
     The function will return false if partial FST is generated, and true if the
     complete determinized FST is generated.
+    If max_mem is positive, it is a limit in bytes on the (approximately
+    computed) memory used by the algorithm; it behaves like max_states, i.e.
+    we throw an exception, or output partial results if allow_partial is true,
+    once it is exceeded.  This is intended for large inputs such as LG for a
+    big vocabulary, where you'd rather get an error than exhaust the memory of
+    the machine; it does not reduce the memory the algorithm needs, as all the
+    subsets still have to be kept in memory.  With --verbose=1 or above, the
+    algorithm prints the progress and memory use every million states, and the
+    peak memory use at the end.
 */
 template<class Arc>
 bool DeterminizeStar(Fst<Arc> &ifst, MutableFst<Arc> *ofst,
                      float delta = kDelta,
                      bool *debug_ptr = NULL,
                      int max_states = -1,
-                     bool allow_partial = false);
+                     bool allow_partial = false,
+                     int64 max_mem = -1);
 
 
 
@@ -101,12 +111,14 @@ bool DeterminizeStar(Fst<Arc> &ifst, MutableFst<Arc> *ofst,
     out an error.
     The function will return false if partial FST is generated, and true if the
     complete determinized FST is generated.
+    The max_mem option is as for the version above.
 */
 template<class Arc>
 bool DeterminizeStar(Fst<Arc> &ifst, MutableFst<GallicArc<Arc> > *ofst,
                      float delta = kDelta, bool *debug_ptr = NULL,
                      int max_states = -1,
-                     bool allow_partial = false);
+                     bool allow_partial = false,
+                     int64 max_mem = -1);
 
 
 /// @} end "addtogroup fst_extensions"
@@ -442,7 +442,8 @@ void SafeDeterminizeMinimizeWrapper(MutableFst<Arc> *ifst, VectorFst<Arc> *ofst,
 
 
 inline
-void DeterminizeStarInLog(VectorFst<StdArc> *fst, float delta, bool *debug_ptr, int max_states) {
+void DeterminizeStarInLog(VectorFst<StdArc> *fst, float delta, bool *debug_ptr,
+                          int max_states, int64 max_mem) {
   // DeterminizeStarInLog determinizes 'fst' in the log semiring, using
   // the DeterminizeStar algorithm (which also removes epsilons).
 
@@ -452,7 +453,8 @@ void DeterminizeStarInLog(VectorFst<StdArc> *fst, float delta, bool *debug_ptr,
   VectorFst<StdArc> tmp;
   *fst = tmp;  // make fst empty to free up memory. [actually may make no difference..]
   VectorFst<LogArc> *fst_det_log = new VectorFst<LogArc>;
-  DeterminizeStar(*fst_log, fst_det_log, delta, debug_ptr, max_states);
+  DeterminizeStar(*fst_log, fst_det_log, delta, debug_ptr, max_states, false,
+                  max_mem);
   Cast(*fst_det_log, fst);
   delete fst_log;
   delete fst_det_log;
@@ -1307,6 +1309,33 @@ inline VectorFst<StdArc> *ReadFstKaldi(std::string rxfilename) {
   return fst;
 }
 
+inline Fst<StdArc> *ReadFstKaldiGeneric(std::string rxfilename) {
+  if (rxfilename == "") rxfilename = "-"; // interpret "" as stdin,
+  // for compatibility with OpenFst conventions.
+  kaldi::Input ki(rxfilename);
+  fst::FstHeader hdr;
+  if (!hdr.Read(ki.Stream(), rxfilename))
+    KALDI_ERR << "Reading FST: error reading FST header from "
+              << kaldi::PrintableRxfilename(rxfilename);
+  if (hdr.ArcType() != StdArc::Type())
+    KALDI_ERR << "FST with arc type " << hdr.ArcType() << " not supported.";
+  FstReadOptions ropts("<unspecified>", &hdr);
+  Fst<StdArc> *fst = NULL;
+  if (hdr.FstType() == "vector") {
+    fst = VectorFst<StdArc>::Read(ki.Stream(), ropts);
+  } else if (hdr.FstType() == "const") {
+    fst = ConstFst<StdArc>::Read(ki.Stream(), ropts);
+  } else if (hdr.FstType() == "compact-graph") {
+    fst = CompactGraphFst::Read(ki.Stream(), ropts);
+  } else {
+    KALDI_ERR << "Reading FST: unsupported FST type: " << hdr.FstType();
+  }
+  if (!fst)
+    KALDI_ERR << "Could not read fst from "
+              << kaldi::PrintableRxfilename(rxfilename);
+  return fst;
+}
+
 inline void WriteFstKaldi(const VectorFst<StdArc> &fst,
                           std::string wxfilename) {
   if (wxfilename == "") wxfilename = "-"; // interpret "" as stdout,
@@ -27,6 +27,7 @@
 #include <vector>
 #include <fst/fstlib.h>
 #include <fst/fst-decl.h>
+#include "fstext/compact-graph-fst.h"
 #include "fstext/determinize-star.h"
 #include "fstext/deterministic-fst.h"
 #include "fstext/remove-eps-local.h"
@@ -82,7 +83,7 @@ void GetSymbols(const SymbolTable &symtab,
 
 inline
 void DeterminizeStarInLog(VectorFst<StdArc> *fst, float delta = kDelta, bool *debug_ptr = NULL,
-                          int max_states = -1);
+                          int max_states = -1, int64 max_mem = -1);
 
 
 // e.g. of using this function: PushInLog<REWEIGHT_TO_INITIAL>(fst, kPushWeights|kPushLabels);
@@ -629,6 +630,12 @@ void RhoCompose(const Fst<Arc> &fst1,
 // On error, throws using KALDI_ERR.
 inline VectorFst<StdArc> *ReadFstKaldi(std::string rxfilename);
 
+// Read a decoding graph using Kaldi I/O mechanisms; unlike ReadFstKaldi(),
+// it accepts FSTs of type "vector", "const" or "compact-graph" (see
+// CompactGraphFst), and it returns the object in its own type.
+// On error, throws using KALDI_ERR.
+inline Fst<StdArc> *ReadFstKaldiGeneric(std::string rxfilename);
+
 // Write an FST using Kaldi I/O mechanisms.
 // On error, throws using KALDI_ERR.
 inline void WriteFstKaldi(const VectorFst<StdArc> &fst,
@@ -52,10 +52,12 @@ int main(int argc, char *argv[]) {
     BaseFloat acoustic_scale = 0.1;
     BaseFloat log_sum_exp_prune = 0.0;
     LatticeFasterDecoderConfig latgen_config;
+    EpsilonClosureConfig epsilon_closure_config;
     TaskSequencerConfig sequencer_config; // has --num-threads option
     
     std::string word_syms_filename;
     latgen_config.Register(&po);
+    epsilon_closure_config.Register(&po);
     sequencer_config.Register(&po);
     po.Register("acoustic-scale", &acoustic_scale,
                 "Scaling factor for acoustic likelihoods");
@@ -113,6 +115,7 @@ int main(int argc, char *argv[]) {
     int num_done = 0, num_err = 0;
     VectorFst<StdArc> *decode_fst = NULL; // only used if there is a single
                                           // decoding graph.
+    EpsilonClosureTable *epsilon_closure_table = NULL;
     
     TaskSequencer<DecodeUtteranceLatticeFasterClass> sequencer(sequencer_config);
       
@@ -121,6 +124,8 @@ int main(int argc, char *argv[]) {
       // Input FST is just one FST, not a table of FSTs.
 
       decode_fst = fst::ReadFstKaldi(fst_in_str);
+      epsilon_closure_table =
+          NewEpsilonClosureTable(*decode_fst, epsilon_closure_config);
       
       {    
         for (; !feature_reader.Done(); feature_reader.Next()) {
@@ -137,6 +142,7 @@ int main(int argc, char *argv[]) {
           
           LatticeFasterDecoder *decoder = new LatticeFasterDecoder(*decode_fst,
                                                                    latgen_config);
+          decoder->SetEpsilonClosureTable(epsilon_closure_table);
           // takes ownership of "features"
           DecodableAmDiagGmmScaled *gmm_decodable =
               new DecodableAmDiagGmmScaled(am_gmm, trans_model, 
@@ -200,6 +206,7 @@ int main(int argc, char *argv[]) {
     sequencer.Wait();
 
     if (decode_fst != NULL) delete decode_fst;
+    delete epsilon_closure_table;
     
     double elapsed = timer.Elapsed();
     KALDI_LOG << "Decoded with " << sequencer_config.num_threads << " threads.";
@@ -0,0 +1,64 @@
+// itf/sentence-scorer-itf.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_ITF_SENTENCE_SCORER_ITF_H_
+#define KALDI_ITF_SENTENCE_SCORER_ITF_H_
+
+#include <vector>
+#include "base/kaldi-common.h"
+
+namespace kaldi {
+/// @ingroup Interfaces
+/// @{
+
+/**
+   SentenceScorerInterface is an interface for language models (or other
+   models of word sequences) that are used to rescore N-best lists; see
+   NbestRescorer in lat/nbest-rescore.h.  The model is seen as a set of states,
+   each standing for a word history.  The states are integers that are
+   allocated by the scorer, and the caller only obtains them from Start() and
+   ScoreBatch().  Words are scored in batches, so that models that are
+   expensive to evaluate one word at a time (e.g. neural nets, on a GPU) can
+   be efficient.
+*/
+class SentenceScorerInterface {
+ public:
+  /// Returns the state corresponding to the start of the sentence.
+  virtual int32 Start() = 0;
+
+  /// For each i, works out the cost (negated log-probability) of the word
+  /// words[i] following the history states[i], and the state reached.  A word
+  /// of zero means the end of the sentence, in which case (*next_states)[i] is
+  /// set to -1.  If the model does not allow the word, the cost is infinity.
+  /// "costs" and "next_states" are resized to words.size().
+  virtual void ScoreBatch(const std::vector<int32> &states,
+                          const std::vector<int32> &words,
+                          std::vector<BaseFloat> *costs,
+                          std::vector<int32> *next_states) = 0;
+
+  /// Called when the caller no longer needs any of the states it has
+  /// obtained (e.g. between utterances), so the scorer can free the memory
+  /// they use; states obtained before the call become invalid.
+  virtual void Reset() { }
+
+  virtual ~SentenceScorerInterface() { }
+};
+/// @} end of "Interfaces"
+}  // namespace kaldi
+
+#endif  // KALDI_ITF_SENTENCE_SCORER_ITF_H_
@@ -0,0 +1,85 @@
+// kwsbin/kws-index-shard.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "lat/kws-inverted-index.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+
+    const char *usage =
+        "Merge inverted indexes created by lattice-to-kws-inverted-index and\n"
+        "split the result into shards by a hash of the n-gram.  The shards\n"
+        "are written with keys 0, 1, ... and kws-search-inverted needs all\n"
+        "of them.\n"
+        "\n"
+        "Usage: kws-index-shard [options] <index-rxfilename-1> "
+        "[<index-rxfilename-2> ...] <index-wspecifier>\n"
+        " e.g.: kws-index-shard --num-shards=4 1.inv.idx 2.inv.idx "
+        "ark,scp:shards.ark,shards.scp\n";
+
+    ParseOptions po(usage);
+
+    int32 num_shards = 1;
+    po.Register("num-shards", &num_shards, "Number of shards to split the "
+                "index into.");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() < 2 || num_shards <= 0) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string index_wspecifier = po.GetArg(po.NumArgs());
+
+    KwsInvertedIndex index;
+    for (int32 i = 1; i < po.NumArgs(); i++) {
+      KwsInvertedIndex this_index;
+      ReadKaldiObject(po.GetArg(i), &this_index);
+      if (this_index.NumShards() != 1)
+        KALDI_ERR << "Index " << po.GetArg(i) << " is already sharded.";
+      index.Merge(this_index);
+    }
+    index.SortPostings();
+
+    KALDI_LOG << "Merged index has " << index.NumPostings()
+              << " occurrences of " << index.NumNgrams() << " n-grams.";
+
+    std::vector<KwsInvertedIndex*> shards;
+    index.Split(num_shards, &shards);
+    TableWriter<KaldiObjectHolder<KwsInvertedIndex> >
+        index_writer(index_wspecifier);
+    for (int32 i = 0; i < num_shards; i++) {
+      std::ostringstream key;
+      key << i;
+      KALDI_VLOG(1) << "Shard " << i << " has " << shards[i]->NumNgrams()
+                    << " n-grams.";
+      index_writer.Write(key.str(), *(shards[i]));
+      delete shards[i];
+    }
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
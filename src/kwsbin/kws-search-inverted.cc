@@ -0,0 +1,180 @@
+// kwsbin/kws-search-inverted.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+
+#include <algorithm>
+#include "base/kaldi-common.h"
+#include "base/timer.h"
+#include "util/common-utils.h"
+#include "fstext/fstext-utils.h"
+#include "lat/kws-inverted-index.h"
+
+namespace kaldi {
+
+static bool CompareKwsPostingCosts(const KwsPosting &a, const KwsPosting &b) {
+  return a.cost < b.cost;
+}
+
+}  // namespace kaldi
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace fst;
+    typedef kaldi::int32 int32;
+
+    const char *usage =
+        "Search the keywords over an inverted index created by\n"
+        "lattice-to-kws-inverted-index and kws-index-shard; all the shards\n"
+        "of the index are read.  Keywords longer than the maximum n-gram\n"
+        "order of the index are split into pieces whose posting lists are\n"
+        "intersected.  The output is in the same format as kws-search:\n"
+        "kw utterance_id beg_frame end_frame negated_log_probs\n"
+        " e.g.: KW1 1 23 67 0.6074219\n"
+        "\n"
+        "Usage: kws-search-inverted [options] index-rspecifier "
+        "keywords-rspecifier results-wspecifier\n"
+        " e.g.: kws-search-inverted scp:shards.scp ark:keywords.fsts "
+        "ark:results\n";
+
+    ParseOptions po(usage);
+
+    int32 n_best = -1;
+    int32 keyword_nbest = 1;
+    bool strict = true;
+    KwsSearchOptions search_opts;
+
+    po.Register("nbest", &n_best, "Return the best n hypotheses.");
+    po.Register("keyword-nbest", &keyword_nbest, "If a keyword FST is not "
+                "linear, search for its best n paths.");
+    po.Register("strict", &strict, "Affects the return status of the program.");
+    search_opts.Register(&po);
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 3 || keyword_nbest <= 0) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string index_rspecifier = po.GetArg(1),
+        keyword_rspecifier = po.GetArg(2),
+        result_wspecifier = po.GetArg(3);
+
+    // Read all the shards, and put them in order.
+    std::vector<KwsInvertedIndex*> shards;
+    {
+      SequentialTableReader<KaldiObjectHolder<KwsInvertedIndex> >
+          index_reader(index_rspecifier);
+      for (; !index_reader.Done(); index_reader.Next()) {
+        const KwsInvertedIndex &shard = index_reader.Value();
+        if (shards.empty()) shards.resize(shard.NumShards(), NULL);
+        if (shard.NumShards() != static_cast<int32>(shards.size()) ||
+            shards[shard.ShardIndex()] != NULL)
+          KALDI_ERR << "Shard " << index_reader.Key() << " does not match "
+                    << "the others.";
+        shards[shard.ShardIndex()] = new KwsInvertedIndex(shard);
+      }
+    }
+    if (shards.empty())
+      KALDI_ERR << "No index was read from " << index_rspecifier;
+    for (size_t i = 0; i < shards.size(); i++)
+      if (shards[i] == NULL)
+        KALDI_ERR << "Shard " << i << " of " << shards.size() << " is missing.";
+    std::vector<const KwsInvertedIndex*> const_shards(shards.begin(),
+                                                      shards.end());
+    KwsIndexSearcher searcher(const_shards);
+
+    SequentialTableReader<VectorFstHolder> keyword_reader(keyword_rspecifier);
+    TableWriter< BasicVectorHolder<double> > result_writer(result_wspecifier);
+
+    Timer timer;
+    int32 n_done = 0, n_fail = 0;
+    int64 n_results = 0;
+    for (; !keyword_reader.Done(); keyword_reader.Next()) {
+      std::string key = keyword_reader.Key();
+      const VectorFst<StdArc> &keyword = keyword_reader.Value();
+
+      // Get the word sequence(s) of the keyword, with their costs.
+      std::vector<std::vector<int32> > word_seqs;
+      std::vector<TropicalWeight> weights;
+      {
+        std::vector<int32> words;
+        TropicalWeight weight;
+        if (GetLinearSymbolSequence<StdArc, int32>(keyword, NULL, &words,
+                                                   &weight)) {
+          word_seqs.push_back(words);
+          weights.push_back(weight);
+        } else {
+          VectorFst<StdArc> nbest;
+          ShortestPath(keyword, &nbest, keyword_nbest, true, true);
+          std::vector<VectorFst<StdArc> > paths;
+          ConvertNbestToVector(nbest, &paths);
+          for (size_t i = 0; i < paths.size(); i++) {
+            GetLinearSymbolSequence<StdArc, int32>(paths[i], NULL, &words,
+                                                   &weight);
+            word_seqs.push_back(words);
+            weights.push_back(weight);
+          }
+        }
+      }
+      if (word_seqs.empty()) {
+        KALDI_WARN << "Empty keyword FST for " << key;
+        n_fail++;
+        continue;
+      }
+
+      std::vector<KwsPosting> results;
+      for (size_t i = 0; i < word_seqs.size(); i++) {
+        size_t num_before = results.size();
+        searcher.Search(word_seqs[i], search_opts, &results);
+        for (size_t j = num_before; j < results.size(); j++)
+          results[j].cost += weights[i].Value();
+      }
+      std::sort(results.begin(), results.end(), CompareKwsPostingCosts);
+      if (n_best > 0 && static_cast<int32>(results.size()) > n_best)
+        results.resize(n_best);
+
+      for (size_t i = 0; i < results.size(); i++) {
+        std::vector<double> result;
+        result.push_back(results[i].utt_id);
+        result.push_back(results[i].start);
+        result.push_back(results[i].end);
+        result.push_back(results[i].cost);
+        result_writer.Write(key, result);
+      }
+      n_results += results.size();
+      n_done++;
+    }
+
+    double elapsed = timer.Elapsed();
+    KALDI_LOG << "Searched for " << n_done << " keywords in " << elapsed
+              << " seconds (" << (n_done / (elapsed + 1.0e-10))
+              << " per second), with " << n_results << " results.";
+    for (size_t i = 0; i < shards.size(); i++)
+      delete shards[i];
+    KALDI_LOG << "Done " << n_done << " keywords, failed for " << n_fail;
+    if (strict == true)
+      return (n_done != 0 ? 0 : 1);
+    else
+      return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
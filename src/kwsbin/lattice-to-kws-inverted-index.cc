@@ -0,0 +1,156 @@
+// kwsbin/lattice-to-kws-inverted-index.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "fstext/fstext-utils.h"
+#include "lat/kaldi-lattice.h"
+#include "lat/kws-inverted-index.h"
+#include "thread/kaldi-task-sequence.h"
+
+namespace kaldi {
+
+class KwsInvertedIndexTask {
+ public:
+  // Takes ownership of "clat".
+  KwsInvertedIndexTask(const KwsIndexOptions &opts, const std::string &key,
+                       int32 utt_id, CompactLattice *clat,
+                       KwsInvertedIndex *index, int32 *n_done,
+                       int32 *n_fail):
+      opts_(opts), key_(key), utt_id_(utt_id), clat_(clat), index_(index),
+      n_done_(n_done), n_fail_(n_fail), success_(false) { }
+
+  void operator () () {
+    // Topologically sort the lattice, if not already sorted.
+    uint64 props = clat_->Properties(fst::kFstProperties, false);
+    if (!(props & fst::kTopSorted)) {
+      if (fst::TopSort(clat_) == false) {
+        KALDI_WARN << "Cycles detected in lattice " << key_;
+        return;
+      }
+    }
+    success_ = ComputeKwsNgramPostings(*clat_, utt_id_, opts_, &postings_);
+    if (!success_)
+      KALDI_WARN << "Empty lattice for utterance " << key_;
+  }
+
+  ~KwsInvertedIndexTask() {
+    delete clat_;
+    if (success_) {
+      for (size_t i = 0; i < postings_.size(); i++)
+        index_->AddPosting(postings_[i].first, postings_[i].second);
+      (*n_done_)++;
+    } else {
+      (*n_fail_)++;
+    }
+  }
+ private:
+  const KwsIndexOptions &opts_;
+  std::string key_;
+  int32 utt_id_;
+  CompactLattice *clat_;
+  KwsInvertedIndex *index_;
+  int32 *n_done_;
+  int32 *n_fail_;
+  bool success_;
+  std::vector<std::pair<std::vector<int32>, KwsPosting> > postings_;
+};
+
+}  // namespace kaldi
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+
+    const char *usage =
+        "Create an inverted index of the given lattices, which maps each word\n"
+        "n-gram up to --max-order to the list of its occurrences (utterance\n"
+        "id, start and end frame and negated log posterior).  This is an\n"
+        "alternative to lattice-to-kws-index for large archives; see\n"
+        "kws-index-shard and kws-search-inverted.  The lattices should be\n"
+        "scaled as desired (e.g. by the acoustic scale) beforehand.\n"
+        "\n"
+        "Usage: lattice-to-kws-inverted-index [options] utter-symtab-rspecifier"
+        " lattice-rspecifier index-wxfilename\n"
+        " e.g.: lattice-to-kws-inverted-index ark:utter.symtab ark:1.lats "
+        "1.inv.idx\n";
+
+    ParseOptions po(usage);
+
+    KwsIndexOptions opts;
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
+    bool binary = true;
+    bool strict = true;
+    opts.Register(&po);
+    sequencer_config.Register(&po);
+    po.Register("binary", &binary, "Write output in binary mode");
+    po.Register("strict", &strict, "Setting --strict=false will cause successful "
+                "termination even if we processed no lattices.");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 3) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string usymtab_rspecifier = po.GetArg(1),
+        lats_rspecifier = po.GetArg(2),
+        index_wxfilename = po.GetArg(3);
+
+    RandomAccessInt32Reader usymtab_reader(usymtab_rspecifier);
+    SequentialCompactLatticeReader clat_reader(lats_rspecifier);
+
+    KwsInvertedIndex index;
+    int32 n_done = 0, n_fail = 0;
+    {
+      TaskSequencer<KwsInvertedIndexTask> sequencer(sequencer_config);
+      for (; !clat_reader.Done(); clat_reader.Next()) {
+        std::string key = clat_reader.Key();
+        // Check if we have the corresponding utterance id.
+        if (!usymtab_reader.HasKey(key)) {
+          KALDI_WARN << "Cannot find utterance id for " << key;
+          n_fail++;
+          continue;
+        }
+        CompactLattice *clat = clat_reader.Value().Copy();
+        clat_reader.FreeCurrent();
+        sequencer.Run(new KwsInvertedIndexTask(opts, key,
+                                               usymtab_reader.Value(key),
+                                               clat, &index, &n_done,
+                                               &n_fail));
+      }
+      sequencer.Wait();
+    }
+    index.SortPostings();
+    WriteKaldiObject(index, index_wxfilename, binary);
+
+    KALDI_LOG << "Indexed " << index.NumPostings() << " occurrences of "
+              << index.NumNgrams() << " n-grams.";
+    KALDI_LOG << "Done " << n_done << " lattices, failed for " << n_fail;
+    if (strict == true)
+      return (n_done != 0 ? 0 : 1);
+    else
+      return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -0,0 +1,226 @@
+// lat/determinize-lattice-incremental-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <limits>
+#include "hmm/transition-model.h"
+#include "tree/context-dep.h"
+#include "lat/kaldi-lattice.h"
+#include "lat/lattice-functions.h"
+#include "lat/determinize-lattice-incremental.h"
+
+namespace kaldi {
+using namespace fst;
+
+// Returns a random lattice with "width" states on each of "num_frames" frames
+// plus a start state, like a decoder's raw lattice: arcs between adjacent
+// frames have ilabels from 1 to 10 (think transition-ids), about one in three
+// of them has a word from 1 to 20 as olabel, and there are a few epsilon arcs
+// within each frame.  The output is connected and topologically sorted.
+Lattice *RandFrameLattice(int32 num_frames, int32 width) {
+  Lattice *lat = new Lattice;
+  lat->AddState();
+  lat->SetStart(0);
+  for (int32 t = 0; t < num_frames; t++)
+    for (int32 i = 0; i < width; i++)
+      lat->AddState();
+  for (int32 t = 0; t < num_frames; t++) {
+    for (int32 i = 0; i < width; i++) {
+      int32 s = 1 + t * width + i;
+      int32 num_prev = (t == 0 ? 1 : 1 + Rand() % 3);
+      for (int32 j = 0; j < num_prev; j++) {
+        int32 prev = (t == 0 ? 0 : 1 + (t - 1) * width + Rand() % width);
+        LatticeWeight w(RandUniform(), 10.0 * RandUniform());
+        int32 word = (Rand() % 3 == 0 ? 1 + Rand() % 20 : 0);
+        lat->AddArc(prev, LatticeArc(1 + Rand() % 10, word, w, s));
+      }
+      if (i > 0 && Rand() % 5 == 0) {  // epsilon arc within the frame.
+        LatticeWeight w(RandUniform(), 0.0);
+        lat->AddArc(s - 1, LatticeArc(0, 0, w, s));
+      }
+      if (t == num_frames - 1)
+        lat->SetFinal(s, LatticeWeight(RandUniform(), 0.0));
+    }
+  }
+  Connect(lat);
+  TopSort(lat);
+  return lat;
+}
+
+// Returns the cost of the best path through "clat", or infinity if it is
+// empty.
+double BestCost(const CompactLattice &clat) {
+  CompactLattice best_path;
+  CompactLatticeShortestPath(clat, &best_path);
+  if (best_path.Start() == kNoStateId)
+    return std::numeric_limits<double>::infinity();
+  CompactLatticeWeight w = CompactLatticeWeight::One();
+  for (CompactLatticeArc::StateId s = best_path.Start(); ; ) {
+    if (best_path.Final(s) != CompactLatticeWeight::Zero()) {
+      w = Times(w, best_path.Final(s));
+      break;
+    }
+    ArcIterator<CompactLattice> aiter(best_path, s);
+    w = Times(w, aiter.Value().weight);
+    s = aiter.Value().nextstate;
+  }
+  return w.Weight().Value1() + w.Weight().Value2();
+}
+
+// Does what the decoder's GetRawLatticeChunk() and GetRawLatticeFinalChunk()
+// do, treating the states of "lat" as tokens: outputs the part of "lat" from
+// begin_frame to end_frame, where times[s] is the frame of state s and
+// forward_cost[s] its best forward cost.  The tokens on a chunk boundary are
+// labeled kChunkBoundaryLabel + n where n is their index among the states on
+// that frame, which is the same in the chunks on both sides.
+void GetLatticeChunk(const Lattice &lat,
+                     const std::vector<int32> &times,
+                     const std::vector<double> &forward_cost,
+                     int32 begin_frame, int32 end_frame, bool last_chunk,
+                     Lattice *chunk) {
+  typedef LatticeArc::StateId StateId;
+  StateId num_states = lat.NumStates();
+  std::vector<int32> labels(num_states);
+  std::vector<int32> num_on_frame(times.empty() ? 0 :
+                                  *std::max_element(times.begin(),
+                                                    times.end()) + 1, 0);
+  for (StateId s = 0; s < num_states; s++)
+    labels[s] = kChunkBoundaryLabel + num_on_frame[times[s]]++;
+
+  chunk->DeleteStates();
+  if (begin_frame != 0)
+    chunk->SetStart(chunk->AddState());
+  std::vector<StateId> state_map(num_states, kNoStateId);
+  for (StateId s = 0; s < num_states; s++)
+    if (times[s] >= begin_frame && times[s] <= end_frame)
+      state_map[s] = chunk->AddState();
+  if (begin_frame == 0) {
+    chunk->SetStart(state_map[lat.Start()]);
+  } else {
+    double best_cost = std::numeric_limits<double>::infinity();
+    for (StateId s = 0; s < num_states; s++)
+      if (times[s] == begin_frame)
+        best_cost = std::min(best_cost, forward_cost[s]);
+    for (StateId s = 0; s < num_states; s++)
+      if (times[s] == begin_frame)
+        chunk->AddArc(0, LatticeArc(0, labels[s],
+                                    LatticeWeight(forward_cost[s] - best_cost,
+                                                  0.0),
+                                    state_map[s]));
+  }
+  // Arcs leaving the tokens on end_frame belong to the next chunk.
+  int32 last_frame_with_arcs = (last_chunk ? end_frame : end_frame - 1);
+  for (StateId s = 0; s < num_states; s++) {
+    if (times[s] < begin_frame || times[s] > last_frame_with_arcs) continue;
+    for (ArcIterator<Lattice> aiter(lat, s); !aiter.Done(); aiter.Next()) {
+      LatticeArc arc = aiter.Value();
+      KALDI_ASSERT(state_map[arc.nextstate] != kNoStateId);
+      arc.nextstate = state_map[arc.nextstate];
+      chunk->AddArc(state_map[s], arc);
+    }
+    if (last_chunk)
+      chunk->SetFinal(state_map[s], lat.Final(s));
+  }
+  if (!last_chunk) {
+    StateId final_state = chunk->AddState();
+    chunk->SetFinal(final_state, LatticeWeight::One());
+    for (StateId s = 0; s < num_states; s++)
+      if (times[s] == end_frame)
+        chunk->AddArc(state_map[s], LatticeArc(0, labels[s],
+                                               LatticeWeight::One(),
+                                               final_state));
+  }
+}
+
+// Checks that determinizing a random lattice in chunks, split at random frames,
+// gives the same result as determinizing all of it at once, with a beam large
+// enough that nothing is pruned.
+void TestIncrementalDeterminization(const TransitionModel &trans_model) {
+  // The ilabels of RandFrameLattice() go up to 10 and must be transition-ids.
+  KALDI_ASSERT(trans_model.NumTransitionIds() >= 10);
+  Lattice *lat = RandFrameLattice(1 + Rand() % 20, 1 + Rand() % 5);
+  std::vector<int32> times;
+  int32 num_frames = LatticeStateTimes(*lat, &times);
+  std::vector<double> forward_cost(lat->NumStates(),
+                                   std::numeric_limits<double>::infinity());
+  forward_cost[lat->Start()] = 0.0;
+  // RandFrameLattice() outputs a topologically sorted lattice.
+  for (int32 s = 0; s < lat->NumStates(); s++) {
+    for (ArcIterator<Lattice> aiter(*lat, s); !aiter.Done(); aiter.Next()) {
+      const LatticeArc &arc = aiter.Value();
+      forward_cost[arc.nextstate] = std::min(forward_cost[arc.nextstate],
+                                             forward_cost[s] +
+                                             ConvertToCost(arc.weight));
+    }
+  }
+
+  std::vector<int32> boundaries;
+  for (int32 t = 1; t < num_frames; t++)
+    if (Rand() % 3 == 0)
+      boundaries.push_back(t);
+  KALDI_LOG << "Determinizing lattice with " << num_frames << " frames in "
+            << (boundaries.size() + 1) << " chunks.";
+
+  BaseFloat beam = 1000.0;
+  DeterminizeLatticePhonePrunedOptions opts;
+  LatticeIncrementalDeterminizer determinizer(trans_model, beam, opts);
+  determinizer.Init();
+  int32 begin_frame = 0;
+  for (size_t i = 0; i < boundaries.size(); i++) {
+    Lattice chunk;
+    GetLatticeChunk(*lat, times, forward_cost, begin_frame, boundaries[i],
+                    false, &chunk);
+    KALDI_ASSERT(determinizer.AcceptChunk(&chunk));
+    begin_frame = boundaries[i];
+  }
+  KALDI_ASSERT(determinizer.NumChunks() ==
+               static_cast<int32>(boundaries.size()));
+  Lattice last_chunk;
+  GetLatticeChunk(*lat, times, forward_cost, begin_frame, num_frames, true,
+                  &last_chunk);
+  CompactLattice chunked_clat;
+  KALDI_ASSERT(determinizer.GetLattice(&last_chunk, &chunked_clat));
+
+  // DeterminizeLatticePruned() determinizes on the input side.
+  Invert(lat);
+  CompactLattice clat;
+  KALDI_ASSERT(DeterminizeLatticePruned<LatticeWeight>(*lat, beam, &clat));
+  Connect(&clat);
+
+  KALDI_ASSERT(ApproxEqual(BestCost(chunked_clat), BestCost(clat)));
+  KALDI_ASSERT(RandEquivalent(chunked_clat, clat, 5, 0.01, Rand(), 100));
+  KALDI_ASSERT(RandEquivalent(clat, chunked_clat, 5, 0.01, Rand(), 100));
+  delete lat;
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  std::vector<int32> phones;
+  for (int32 i = 1; i <= 10; i++)
+    phones.push_back(i);
+  std::vector<int32> num_pdf_classes;
+  ContextDependency *ctx_dep =
+      GenRandContextDependencyLarge(phones, 3, 1, true, &num_pdf_classes);
+  HmmTopology topo = GetDefaultTopology(phones);
+  TransitionModel trans_model(*ctx_dep, topo);
+  delete ctx_dep;
+  for (int32 i = 0; i < 20; i++)
+    TestIncrementalDeterminization(trans_model);
+  std::cout << "Tests succeeded\n";
+}
@@ -0,0 +1,166 @@
+// lat/determinize-lattice-incremental.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "lat/determinize-lattice-incremental.h"
+
+namespace kaldi {
+
+void LatticeIncrementalDeterminizer::Init() {
+  clat_.DeleteStates();
+  pending_.clear();
+  num_chunks_ = 0;
+}
+
+bool LatticeIncrementalDeterminizer::DeterminizeChunk(
+    Lattice *chunk,
+    CompactLattice *chunk_clat,
+    std::vector<LatticeWeight> *start_costs) const {
+  typedef LatticeArc Arc;
+  start_costs->clear();
+  if (chunk->Start() == fst::kNoStateId)
+    KALDI_ERR << "Empty chunk of lattice";
+  for (fst::ArcIterator<Lattice> aiter(*chunk, chunk->Start());
+       !aiter.Done(); aiter.Next()) {
+    const Arc &arc = aiter.Value();
+    if (arc.olabel >= kChunkBoundaryLabel) {
+      size_t i = arc.olabel - kChunkBoundaryLabel;
+      if (i >= start_costs->size())
+        start_costs->resize(i + 1, LatticeWeight::Zero());
+      (*start_costs)[i] = arc.weight;
+    }
+  }
+  return fst::DeterminizeLatticePhonePrunedWrapper(
+      trans_model_, chunk, lattice_beam_, chunk_clat, opts_);
+}
+
+void LatticeIncrementalDeterminizer::AppendChunk(
+    const CompactLattice &chunk_clat,
+    const std::vector<LatticeWeight> &start_costs,
+    CompactLattice *clat,
+    std::vector<PendingArc> *pending) {
+  typedef CompactLatticeArc Arc;
+  typedef Arc::StateId StateId;
+  StateId num_states = chunk_clat.NumStates(),
+      start = chunk_clat.Start();
+  bool first_chunk = (clat->NumStates() == 0);
+  KALDI_ASSERT(first_chunk == start_costs.empty());
+
+  // The states reached by arcs with boundary labels are final and have no arcs
+  // (they came from the single final state of the raw chunk); we don't copy
+  // them, or the start state unless this is the first chunk.
+  std::vector<bool> copy_state(num_states, true);
+  if (!first_chunk) copy_state[start] = false;
+  for (StateId s = 0; s < num_states; s++) {
+    if (s == start && !first_chunk) continue;
+    for (fst::ArcIterator<CompactLattice> aiter(chunk_clat, s);
+         !aiter.Done(); aiter.Next())
+      if (aiter.Value().olabel >= kChunkBoundaryLabel)
+        copy_state[aiter.Value().nextstate] = false;
+  }
+  std::vector<StateId> state_map(num_states, fst::kNoStateId);
+  for (StateId s = 0; s < num_states; s++)
+    if (copy_state[s]) state_map[s] = clat->AddState();
+
+  if (first_chunk) {
+    clat->SetStart(state_map[start]);
+  } else {
+    // Join the pending arcs to the successors of the chunk's start state.
+    std::vector<std::vector<size_t> > pending_by_label;
+    for (size_t i = 0; i < pending->size(); i++) {
+      size_t label = (*pending)[i].label - kChunkBoundaryLabel;
+      if (label >= pending_by_label.size())
+        pending_by_label.resize(label + 1);
+      pending_by_label[label].push_back(i);
+    }
+    for (fst::ArcIterator<CompactLattice> aiter(chunk_clat, start);
+         !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      KALDI_ASSERT(arc.olabel >= kChunkBoundaryLabel &&
+                   state_map[arc.nextstate] != fst::kNoStateId);
+      size_t label = arc.olabel - kChunkBoundaryLabel;
+      KALDI_ASSERT(label < start_costs.size());
+      if (label >= pending_by_label.size()) continue;
+      // Remove the relative forward cost that the decoder put on the arc into
+      // the token.
+      const LatticeWeight &cost = start_costs[label];
+      CompactLatticeWeight weight =
+          fst::Times(arc.weight,
+                     CompactLatticeWeight(LatticeWeight(-cost.Value1(),
+                                                        -cost.Value2()),
+                                          std::vector<int32>()));
+      const std::vector<size_t> &indexes = pending_by_label[label];
+      for (size_t j = 0; j < indexes.size(); j++) {
+        const PendingArc &p = (*pending)[indexes[j]];
+        clat->AddArc(p.state, Arc(0, 0, fst::Times(p.weight, weight),
+                                  state_map[arc.nextstate]));
+      }
+    }
+  }
+
+  // Copy the rest of the chunk; arcs with boundary labels become pending arcs.
+  std::vector<PendingArc> new_pending;
+  for (StateId s = 0; s < num_states; s++) {
+    if (!copy_state[s]) continue;
+    StateId state = state_map[s];
+    for (fst::ArcIterator<CompactLattice> aiter(chunk_clat, s);
+         !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      if (arc.olabel >= kChunkBoundaryLabel) {
+        new_pending.push_back(
+            PendingArc(state, arc.olabel,
+                       fst::Times(arc.weight, chunk_clat.Final(arc.nextstate))));
+      } else {
+        KALDI_ASSERT(state_map[arc.nextstate] != fst::kNoStateId);
+        clat->AddArc(state, Arc(arc.ilabel, arc.olabel, arc.weight,
+                                state_map[arc.nextstate]));
+      }
+    }
+    clat->SetFinal(state, chunk_clat.Final(s));
+  }
+  pending->swap(new_pending);
+}
+
+bool LatticeIncrementalDeterminizer::AcceptChunk(Lattice *chunk) {
+  CompactLattice chunk_clat;
+  std::vector<LatticeWeight> start_costs;
+  bool ans = DeterminizeChunk(chunk, &chunk_clat, &start_costs);
+  if (chunk_clat.NumStates() == 0)
+    KALDI_ERR << "Empty lattice after determinizing chunk " << num_chunks_;
+  AppendChunk(chunk_clat, start_costs, &clat_, &pending_);
+  num_chunks_++;
+  return ans;
+}
+
+bool LatticeIncrementalDeterminizer::GetLattice(Lattice *last_chunk,
+                                                CompactLattice *clat) const {
+  CompactLattice chunk_clat;
+  std::vector<LatticeWeight> start_costs;
+  bool ans = DeterminizeChunk(last_chunk, &chunk_clat, &start_costs);
+  *clat = clat_;
+  std::vector<PendingArc> pending(pending_);
+  if (chunk_clat.NumStates() != 0) {
+    AppendChunk(chunk_clat, start_costs, clat, &pending);
+    KALDI_ASSERT(pending.empty() &&
+                 "Last chunk of lattice should not end with boundary labels.");
+  }
+  // Remove the paths that ended in tokens that were later pruned away.
+  fst::Connect(clat);
+  return ans;
+}
+
+}  // namespace kaldi
@@ -0,0 +1,150 @@
+// lat/determinize-lattice-incremental.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_LAT_DETERMINIZE_LATTICE_INCREMENTAL_H_
+#define KALDI_LAT_DETERMINIZE_LATTICE_INCREMENTAL_H_
+
+#include <vector>
+#include "base/kaldi-common.h"
+#include "itf/options-itf.h"
+#include "hmm/transition-model.h"
+#include "lat/kaldi-lattice.h"
+#include "lat/determinize-lattice-pruned.h"
+
+namespace kaldi {
+
+/**
+   This header contains code for determinizing the lattice of an utterance a
+   piece at a time while it is being decoded, so that at the end of the
+   utterance only the last few frames remain to be determinized.
+
+   The decoder outputs "chunks" of the raw state-level lattice covering
+   successive ranges of frames (see LatticeFasterDecoder::GetRawLatticeChunk()
+   and GetRawLatticeFinalChunk()).  The tokens on the frame where one chunk ends
+   and the next one starts are identified by special labels, numbered from
+   kChunkBoundaryLabel, on the word side: in the chunk that ends there, each
+   such token has an arc with its label to a single final state, and in the
+   chunk that starts there, the start state has an arc with the token's label
+   to that token, whose cost is the token's forward cost relative to the best
+   token on that frame (so that pruned determinization has a sensible idea of
+   which paths are good).  After determinizing a chunk, we join it to what we
+   have so far by replacing each pair of arcs with matching labels by an arc
+   with no word label, removing the relative forward cost again.
+
+   The result is equivalent to the full lattice, but it is only deterministic
+   within each chunk: a state just before a chunk boundary may have more than
+   one arc with the same word, and pruning is not done across chunks (each chunk
+   is pruned with the lattice beam as if its last frame ended the utterance).
+*/
+
+/// Word-side labels greater than or equal to this identify decoder tokens at
+/// chunk boundaries.  It must exceed any real word-id.
+const int32 kChunkBoundaryLabel = 100000000;
+
+struct LatticeIncrementalDeterminizerConfig {
+  int32 determinize_period;
+  int32 determinize_delay;
+
+  LatticeIncrementalDeterminizerConfig(): determinize_period(0),
+                                          determinize_delay(25) { }
+
+  void Register(OptionsItf *po) {
+    po->Register("determinize-period", &determinize_period,
+                 "If >0, determinize the lattice incrementally while decoding, "
+                 "in chunks of at least this many frames, so that little is "
+                 "left to do at the end of the utterance.");
+    po->Register("determinize-delay", &determinize_delay,
+                 "With --determinize-period > 0, the number of frames behind "
+                 "the decoding frontier that the lattice must be before we "
+                 "determinize it (so that it is stable under pruning).");
+  }
+  void Check() const {
+    // The last chunk must contain at least one frame.
+    KALDI_ASSERT(determinize_period >= 0 && determinize_delay > 0);
+  }
+};
+
+class LatticeIncrementalDeterminizer {
+ public:
+  LatticeIncrementalDeterminizer(
+      const TransitionModel &trans_model,
+      BaseFloat lattice_beam,
+      const fst::DeterminizeLatticePhonePrunedOptions &opts):
+      trans_model_(trans_model), lattice_beam_(lattice_beam), opts_(opts),
+      num_chunks_(0) { }
+
+  /// Forgets any chunks accepted so far, e.g. at the start of an utterance.
+  void Init();
+
+  /// Determinizes a chunk (which it destroys) that ends with boundary labels,
+  /// and appends it to the lattice so far.  The first chunk must start at
+  /// frame zero.  Returns false if determinization stopped early because of
+  /// the max-mem or similar constraints (like
+  /// DeterminizeLatticePhonePrunedWrapper()).
+  bool AcceptChunk(Lattice *chunk);
+
+  /// Outputs the whole lattice, consisting of the chunks accepted so far
+  /// followed by "last_chunk" (which it destroys), which covers the remaining
+  /// frames and has no boundary labels at the end.  This does not change the
+  /// state of this object, so you can call it for partial results and later
+  /// accept more chunks.  Returns false if determinization of the last chunk
+  /// stopped early.
+  bool GetLattice(Lattice *last_chunk, CompactLattice *clat) const;
+
+  /// Returns the number of chunks accepted so far.
+  int32 NumChunks() const { return num_chunks_; }
+
+ private:
+  // An arc of the lattice so far that is waiting for the next chunk: it goes
+  // from "state" to the token labeled "label".
+  struct PendingArc {
+    CompactLattice::StateId state;
+    int32 label;
+    CompactLatticeWeight weight;
+    PendingArc(CompactLattice::StateId state, int32 label,
+               const CompactLatticeWeight &weight):
+        state(state), label(label), weight(weight) { }
+  };
+
+  // Determinizes "chunk" into *chunk_clat, and outputs in *start_costs the
+  // costs on the arcs from the start state with boundary labels (indexed by
+  // label minus kChunkBoundaryLabel).
+  bool DeterminizeChunk(Lattice *chunk, CompactLattice *chunk_clat,
+                        std::vector<LatticeWeight> *start_costs) const;
+
+  // Appends the determinized chunk to *clat, joining it to the arcs in
+  // *pending, which it replaces by the pending arcs at the end of this chunk.
+  static void AppendChunk(const CompactLattice &chunk_clat,
+                          const std::vector<LatticeWeight> &start_costs,
+                          CompactLattice *clat,
+                          std::vector<PendingArc> *pending);
+
+  const TransitionModel &trans_model_;
+  BaseFloat lattice_beam_;
+  fst::DeterminizeLatticePhonePrunedOptions opts_;
+
+  CompactLattice clat_;  // The lattice so far.
+  std::vector<PendingArc> pending_;  // Arcs at the end of clat_ that
+                                     // lead to tokens in the next chunk.
+  int32 num_chunks_;
+};
+
+
+}  // namespace kaldi
+
+#endif  // KALDI_LAT_DETERMINIZE_LATTICE_INCREMENTAL_H_
@@ -160,6 +160,37 @@ template<class Arc> void TestDeterminizeLatticePruned2() {
   }
 }
 
+// test that with a beam large enough that nothing is pruned, the output of
+// DeterminizeLatticePruned() is equivalent to that of DeterminizeLattice(),
+// which does not share its code for hashing subsets, and has no more states
+// (it has fewer if DeterminizeLatticePruned() removed states that can't reach
+// a final state, but no output state may be duplicated).
+template<class Arc> void TestDeterminizeLatticePrunedAgainstUnpruned() {
+  typedef kaldi::int32 Int;
+  typedef typename Arc::Weight Weight;
+  typedef ArcTpl<CompactLatticeWeightTpl<Weight, Int> > CompactArc;
+  RandFstOptions opts;
+  opts.acyclic = true;
+  opts.weight_multiplier = 0.5;  // so ties are broken the same way.
+  for (int i = 0; i < 100; i++) {
+    VectorFst<Arc> *fst = RandPairFst<Arc>(opts);
+    if (fst->Start() == kNoStateId) {
+      delete fst;
+      continue;
+    }
+    VectorFst<CompactArc> det_fst, pruned_det_fst;
+    DeterminizeLattice<Weight, Int>(*fst, &det_fst);
+    DeterminizeLatticePrunedOptions lat_opts;
+    lat_opts.max_mem = ((kaldi::Rand() % 2 == 0) ? 100 : 50000000);
+    KALDI_ASSERT(DeterminizeLatticePruned<Weight>(*fst, 1000.0,
+                                                  &pruned_det_fst, lat_opts));
+    KALDI_ASSERT(RandEquivalent(det_fst, pruned_det_fst, 5/*paths*/,
+                                0.01/*delta*/, kaldi::Rand()/*seed*/,
+                                100/*path length, max*/));
+    KALDI_ASSERT(pruned_det_fst.NumStates() <= det_fst.NumStates());
+    delete fst;
+  }
+}
 
 } // end namespace fst
 
@@ -167,5 +198,6 @@ int main() {
   using namespace fst;
   TestDeterminizeLatticePruned<kaldi::LatticeArc>();
   TestDeterminizeLatticePruned2<kaldi::LatticeArc>();
+  TestDeterminizeLatticePrunedAgainstUnpruned<kaldi::LatticeArc>();
   std::cout << "Tests succeeded\n";
 }
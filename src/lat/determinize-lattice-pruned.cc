@@ -32,6 +32,8 @@ using std::tr1::unordered_map;
 
 #include <vector>
 #include <climits>
+#include "base/kaldi-profile.h"
+#include "base/timer.h"
 #include "fstext/determinize-lattice.h" // for LatticeStringRepository
 #include "fstext/fstext-utils.h"
 #include "lat/lattice-functions.h"  // for PruneLattice
@@ -198,7 +200,8 @@ template<class Weight, class IntType> class LatticeDeterminizerPruned {
   LatticeDeterminizerPruned(const ExpandedFst<Arc> &ifst,
                             double beam,
                             DeterminizeLatticePrunedOptions opts):
-      num_arcs_(0), num_elems_(0), ifst_(ifst.Copy()), beam_(beam), opts_(opts),
+      num_arcs_(0), num_elems_(0), num_rebuilds_(0), rebuild_seconds_(0.0),
+      max_repo_size_(0), ifst_(ifst.Copy()), beam_(beam), opts_(opts),
       equal_(opts_.delta), determinized_(false),
       minimal_hash_(3, hasher_, equal_), initial_hash_(3, hasher_, equal_) {
     KALDI_ASSERT(Weight::Properties() & kIdempotent); // this algorithm won't
@@ -228,7 +231,7 @@ template<class Weight, class IntType> class LatticeDeterminizerPruned {
     
     for (typename InitialSubsetHash::iterator iter = initial_hash_.begin();
          iter != initial_hash_.end(); ++iter)
-      delete iter->first;
+      delete iter->first.subset;
     { InitialSubsetHash tmp; tmp.swap(initial_hash_); }
     for (size_t i = 0; i < output_states_.size(); i++) {
       vector<Element> tmp;
@@ -258,6 +261,8 @@ template<class Weight, class IntType> class LatticeDeterminizerPruned {
     // passes a supplied threshold.  We need to accumulate all the
     // strings we need the repository to "remember", then tell it
     // to clean the repository.
+    KALDI_PROFILE_SCOPE("LatticeDeterminizerPruned::RebuildRepository");
+    Timer timer;
     std::vector<StringId> needed_strings;
     for (size_t i = 0; i < output_states_.size(); i++) {
       AddStrings(output_states_[i]->minimal_subset, &needed_strings);
@@ -282,7 +287,7 @@ template<class Weight, class IntType> class LatticeDeterminizerPruned {
     for (typename InitialSubsetHash::const_iterator
              iter = initial_hash_.begin();
          iter != initial_hash_.end(); ++iter) {
-      const vector<Element> &vec = *(iter->first);
+      const vector<Element> &vec = *(iter->first.subset);
       Element elem = iter->second;
       AddStrings(vec, &needed_strings);
       needed_strings.push_back(elem.string);
@@ -294,6 +299,8 @@ template<class Weight, class IntType> class LatticeDeterminizerPruned {
     KALDI_LOG << "Rebuilding repository.";
     
     repository_.Rebuild(needed_strings);
+    num_rebuilds_++;
+    rebuild_seconds_ += timer.Elapsed();
   }
   
   bool CheckMemoryUsage() {
@@ -301,6 +308,7 @@ template<class Weight, class IntType> class LatticeDeterminizerPruned {
         arcs_size = num_arcs_ * sizeof(TempArc),
         elems_size = num_elems_ * sizeof(Element),
         total_size = repo_size + arcs_size + elems_size;
+    max_repo_size_ = std::max(max_repo_size_, repo_size);
     if (opts_.max_mem > 0 && total_size > opts_.max_mem) { // We passed the memory threshold.
       // This is usually due to the repository getting large, so we
       // clean this out.
@@ -376,6 +384,13 @@ template<class Weight, class IntType> class LatticeDeterminizerPruned {
       delete task;
     }
     determinized_ = true;
+    KALDI_PROFILE_MAX("LatticeDeterminizerPruned::MaxRepositorySize",
+                      max_repo_size_);
+    KALDI_VLOG(2) << "Determinized lattice has " << output_states_.size()
+                  << " states and " << num_arcs_ << " arcs; string repository "
+                  << "reached " << max_repo_size_ << " bytes (approximately) "
+                  << "and was rebuilt " << num_rebuilds_ << " times, taking "
+                  << rebuild_seconds_ << " seconds.";
     if (effective_beam != NULL) {
       if (queue_.empty()) *effective_beam = beam_;
       else
@@ -436,24 +451,38 @@ template<class Weight, class IntType> class LatticeDeterminizerPruned {
   // Instead we apply the delta when comparing subsets for equality, and allow a small
   // difference.
 
+  //   The keys of the hashes are a pointer to the subset together with its hash
+  // value, which we compute once when we look up the subset; this saves
+  // recomputing it when the hash is resized, and lets us reject most unequal
+  // subsets without looking at their elements.
+  struct SubsetHashKey {
+    const vector<Element> *subset;
+    size_t hash;
+    SubsetHashKey(const vector<Element> *subset, size_t hash):
+        subset(subset), hash(hash) { }
+  };
+
   class SubsetKey {
    public:
-    size_t operator ()(const vector<Element> * subset) const {  // hashes only the state and string.
+    static size_t Hash(const vector<Element> &subset) {  // hashes only the state and string.
       size_t hash = 0, factor = 1;
-      for (typename vector<Element>::const_iterator iter= subset->begin(); iter != subset->end(); ++iter) {
+      for (typename vector<Element>::const_iterator iter= subset.begin(); iter != subset.end(); ++iter) {
         hash *= factor;
         hash += iter->state + reinterpret_cast<size_t>(iter->string);
         factor *= 23531;  // these numbers are primes.
       }
       return hash;
     }
+    size_t operator ()(const SubsetHashKey &key) const { return key.hash; }
   };
 
   // This is the equality operator on subsets.  It checks for exact match on state-id
   // and string, and approximate match on weights.
   class SubsetEqual {
    public:
-    bool operator ()(const vector<Element> * s1, const vector<Element> * s2) const {
+    bool operator ()(const SubsetHashKey &k1, const SubsetHashKey &k2) const {
+      if (k1.hash != k2.hash) return false;
+      const vector<Element> *s1 = k1.subset, *s2 = k2.subset;
       size_t sz = s1->size();
       KALDI_ASSERT(sz>=0);
       if (sz != s2->size()) return false;
@@ -490,7 +519,7 @@ template<class Weight, class IntType> class LatticeDeterminizerPruned {
 
   // Define the hash type we use to map subsets (in minimal
   // representation) to OutputStateId.
-  typedef unordered_map<const vector<Element>*, OutputStateId,
+  typedef unordered_map<SubsetHashKey, OutputStateId,
                         SubsetKey, SubsetEqual> MinimalSubsetHash;
 
   // Define the hash type we use to map subsets (in initial
@@ -498,7 +527,7 @@ template<class Weight, class IntType> class LatticeDeterminizerPruned {
   // extra weight. [note: we interpret the Element.state in here
   // as an OutputStateId even though it's declared as InputStateId;
   // these types are the same anyway].
-  typedef unordered_map<const vector<Element>*, Element,
+  typedef unordered_map<SubsetHashKey, Element,
                         SubsetKey, SubsetEqual> InitialSubsetHash;
   
 
@@ -526,8 +555,9 @@ template<class Weight, class IntType> class LatticeDeterminizerPruned {
   // transitions.
   OutputStateId MinimalToStateId(const vector<Element> &subset,
                                  const double forward_cost) {
+    size_t hash = SubsetKey::Hash(subset);
     typename MinimalSubsetHash::const_iterator iter
-        = minimal_hash_.find(&subset);
+        = minimal_hash_.find(SubsetHashKey(&subset, hash));
     if (iter != minimal_hash_.end()) { // Found a matching subset.
       OutputStateId state_id = iter->second;
       const OutputState &state = *(output_states_[state_id]);
@@ -538,10 +568,11 @@ template<class Weight, class IntType> class LatticeDeterminizerPruned {
                    << forward_cost << ", "
                    << state.forward_cost;
       }
+      return state_id;
     }
     OutputStateId state_id = static_cast<OutputStateId>(output_states_.size());
     OutputState *new_state = new OutputState(subset, forward_cost);
-    minimal_hash_[&(new_state->minimal_subset)] = state_id;
+    minimal_hash_[SubsetHashKey(&(new_state->minimal_subset), hash)] = state_id;
     output_states_.push_back(new_state);
     num_elems_ += subset.size();
     // Note: in the previous algorithm, we pushed the new state-id onto the queue
@@ -559,8 +590,9 @@ template<class Weight, class IntType> class LatticeDeterminizerPruned {
                                  double forward_cost,
                                  Weight *remaining_weight,
                                  StringId *common_prefix) {
+    size_t hash = SubsetKey::Hash(subset_in);
     typename InitialSubsetHash::const_iterator iter
-        = initial_hash_.find(&subset_in);
+        = initial_hash_.find(SubsetHashKey(&subset_in, hash));
     if (iter != initial_hash_.end()) { // Found a matching subset.
       const Element &elem = iter->second;
       *remaining_weight = elem.weight;
@@ -596,7 +628,7 @@ template<class Weight, class IntType> class LatticeDeterminizerPruned {
     // we process the same initial subset.
     vector<Element> *initial_subset_ptr = new vector<Element>(subset_in);
     elem.state = ans;
-    initial_hash_[initial_subset_ptr] = elem;
+    initial_hash_[SubsetHashKey(initial_subset_ptr, hash)] = elem;
     num_elems_ += initial_subset_ptr->size(); // keep track of memory usage.
     return ans;
   }
@@ -1099,7 +1131,8 @@ template<class Weight, class IntType> class LatticeDeterminizerPruned {
       output_states_.push_back(initial_state);
       num_elems_ += subset.size();
       OutputStateId initial_state_id = 0;
-      minimal_hash_[&(initial_state->minimal_subset)] = initial_state_id;
+      minimal_hash_[SubsetHashKey(&(initial_state->minimal_subset),
+                                  SubsetKey::Hash(subset))] = initial_state_id;
       ProcessFinal(initial_state_id);
       ProcessTransitions(initial_state_id); // this will add tasks to
       // the queue, which we'll start processing in Determinize().
@@ -1129,6 +1162,9 @@ template<class Weight, class IntType> class LatticeDeterminizerPruned {
   int num_arcs_; // keep track of memory usage: number of arcs in output_states_[ ]->arcs
   int num_elems_; // keep track of memory usage: number of elems in output_states_ and
   // the keys of initial_hash_
+  int32 num_rebuilds_; // number of calls to RebuildRepository(), for diagnostics.
+  double rebuild_seconds_; // time taken by RebuildRepository(), for diagnostics.
+  int32 max_repo_size_; // largest value of repository_.MemSize() that we saw.
   
   const ExpandedFst<Arc> *ifst_;
   std::vector<double> backward_costs_; // This vector stores, for every state in ifst_,
@@ -1212,6 +1248,7 @@ bool DeterminizeLatticePruned(
     double beam,
     MutableFst<ArcTpl<CompactLatticeWeightTpl<Weight, IntType> > >*ofst,
     DeterminizeLatticePrunedOptions opts) {
+  KALDI_PROFILE_SCOPE("DeterminizeLatticePruned");
   ofst->SetInputSymbols(ifst.InputSymbols());
   ofst->SetOutputSymbols(ifst.OutputSymbols());
   if (ifst.NumStates() == 0) {
@@ -1264,6 +1301,7 @@ bool DeterminizeLatticePruned(const ExpandedFst<ArcTpl<Weight> > &ifst,
                               MutableFst<ArcTpl<Weight> > *ofst,
                               DeterminizeLatticePrunedOptions opts) {
   typedef int32 IntType;
+  KALDI_PROFILE_SCOPE("DeterminizeLatticePruned");
   ofst->SetInputSymbols(ifst.InputSymbols());
   ofst->SetOutputSymbols(ifst.OutputSymbols());
   KALDI_ASSERT(opts.retry_cutoff >= 0.0 && opts.retry_cutoff < 1.0);
@@ -0,0 +1,182 @@
+// lat/kws-inverted-index-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+
+#include "lat/kaldi-lattice.h"
+#include "lat/kws-inverted-index.h"
+
+namespace kaldi {
+
+// Adds an arc with word "word", cost "cost" and "num_frames" frames.
+static void AddWordArc(CompactLattice *clat, int32 from, int32 to,
+                       int32 word, BaseFloat cost, int32 num_frames) {
+  CompactLatticeWeight w(LatticeWeight(cost, 0.0),
+                         std::vector<int32>(num_frames, 1));
+  clat->AddArc(from, CompactLatticeArc(word, word, w, to));
+}
+
+static const KwsPosting *FindPosting(
+    const std::vector<std::pair<std::vector<int32>, KwsPosting> > &postings,
+    const std::vector<int32> &ngram) {
+  const KwsPosting *ans = NULL;
+  for (size_t i = 0; i < postings.size(); i++) {
+    if (postings[i].first == ngram) {
+      KALDI_ASSERT(ans == NULL);  // expect just one.
+      ans = &(postings[i].second);
+    }
+  }
+  return ans;
+}
+
+void TestComputeKwsNgramPostings() {
+  // Two paths, "a b" with cost 1 and "a c" with cost 2, with 10 frames per
+  // word.
+  CompactLattice clat;
+  for (int32 i = 0; i < 4; i++) clat.AddState();
+  clat.SetStart(0);
+  AddWordArc(&clat, 0, 1, 1, 0.0, 10);
+  AddWordArc(&clat, 0, 2, 1, 0.0, 10);
+  AddWordArc(&clat, 1, 3, 2, 1.0, 10);
+  AddWordArc(&clat, 2, 3, 3, 2.0, 10);
+  clat.SetFinal(3, CompactLatticeWeight::One());
+
+  KwsIndexOptions opts;
+  std::vector<std::pair<std::vector<int32>, KwsPosting> > postings;
+  KALDI_ASSERT(ComputeKwsNgramPostings(clat, 5, opts, &postings));
+  double p_b = Exp(-1.0) / (Exp(-1.0) + Exp(-2.0));
+
+  std::vector<int32> a(1, 1), b(1, 2), ab(2), ac(2);
+  ab[0] = 1; ab[1] = 2;
+  ac[0] = 1; ac[1] = 3;
+  const KwsPosting *p = FindPosting(postings, a);
+  KALDI_ASSERT(p != NULL && p->utt_id == 5 && p->start == 0 && p->end == 10);
+  KALDI_ASSERT(ApproxEqual(p->cost + 1.0, 1.0));  // posterior is one.
+  p = FindPosting(postings, b);
+  KALDI_ASSERT(p != NULL && p->start == 10 && p->end == 20);
+  KALDI_ASSERT(ApproxEqual(p->cost, -Log(p_b)));
+  p = FindPosting(postings, ab);
+  KALDI_ASSERT(p != NULL && p->start == 0 && p->end == 20);
+  KALDI_ASSERT(ApproxEqual(p->cost, -Log(p_b)));
+  p = FindPosting(postings, ac);
+  KALDI_ASSERT(p != NULL && ApproxEqual(p->cost, -Log(1.0 - p_b)));
+  KALDI_ASSERT(postings.size() == 5);  // a, b, c, "a b", "a c".
+
+  // With a high enough min_posterior, "a c" and "c" are pruned.
+  opts.min_posterior = 0.5;
+  postings.clear();
+  ComputeKwsNgramPostings(clat, 5, opts, &postings);
+  KALDI_ASSERT(postings.size() == 3 && FindPosting(postings, ac) == NULL);
+}
+
+void TestSilence() {
+  // "a <eps> b", with 5 frames of silence.
+  CompactLattice clat;
+  for (int32 i = 0; i < 4; i++) clat.AddState();
+  clat.SetStart(0);
+  AddWordArc(&clat, 0, 1, 1, 0.0, 10);
+  AddWordArc(&clat, 1, 2, 0, 0.0, 5);
+  AddWordArc(&clat, 2, 3, 2, 0.0, 10);
+  clat.SetFinal(3, CompactLatticeWeight::One());
+
+  std::vector<int32> ab(2);
+  ab[0] = 1; ab[1] = 2;
+  KwsIndexOptions opts;
+  std::vector<std::pair<std::vector<int32>, KwsPosting> > postings;
+  ComputeKwsNgramPostings(clat, 0, opts, &postings);
+  const KwsPosting *p = FindPosting(postings, ab);
+  KALDI_ASSERT(p != NULL && p->start == 0 && p->end == 25);
+  KALDI_ASSERT(postings.size() == 3);
+
+  opts.max_silence_frames = 4;
+  postings.clear();
+  ComputeKwsNgramPostings(clat, 0, opts, &postings);
+  KALDI_ASSERT(FindPosting(postings, ab) == NULL && postings.size() == 2);
+}
+
+void TestKwsInvertedIndex() {
+  // Index random sequences of words as if they were 1-best transcripts, with
+  // max_order 1 or 2, and check that searching for their subsequences finds
+  // them, after writing, reading and splitting the index.
+  int32 num_utts = 1 + Rand() % 10, max_order = 1 + Rand() % 2;
+  std::vector<std::vector<int32> > transcripts(num_utts);
+  KwsInvertedIndex index;
+  for (int32 u = 0; u < num_utts; u++) {
+    std::vector<int32> &words = transcripts[u];
+    words.resize(1 + Rand() % 10);
+    for (size_t i = 0; i < words.size(); i++)
+      words[i] = 1 + Rand() % 5;
+    for (size_t i = 0; i < words.size(); i++) {
+      for (int32 n = 1; n <= max_order && i + n <= words.size(); n++) {
+        std::vector<int32> ngram(words.begin() + i, words.begin() + i + n);
+        index.AddPosting(ngram, KwsPosting(u, 10 * i, 10 * (i + n), 0.5 * n));
+      }
+    }
+  }
+  index.SortPostings();
+
+  bool binary = (Rand() % 2 == 0);
+  std::ostringstream os;
+  index.Write(os, binary);
+  KwsInvertedIndex index2;
+  std::istringstream is(os.str());
+  index2.Read(is, binary);
+  KALDI_ASSERT(index2.NumNgrams() == index.NumNgrams() &&
+               index2.NumPostings() == index.NumPostings() &&
+               index2.MaxOrder() == max_order);
+
+  int32 num_shards = 1 + Rand() % 4;
+  std::vector<KwsInvertedIndex*> shards;
+  index2.Split(num_shards, &shards);
+  std::vector<const KwsInvertedIndex*> const_shards(shards.begin(),
+                                                    shards.end());
+  KwsIndexSearcher searcher(const_shards);
+  KwsSearchOptions opts;
+  opts.max_gap_frames = 0;
+
+  for (int32 u = 0; u < num_utts; u++) {
+    const std::vector<int32> &words = transcripts[u];
+    int32 start = Rand() % words.size(),
+        len = 1 + Rand() % (words.size() - start);
+    std::vector<int32> keyword(words.begin() + start,
+                               words.begin() + start + len);
+    std::vector<KwsPosting> results;
+    searcher.Search(keyword, opts, &results);
+    bool found = false;
+    for (size_t i = 0; i < results.size(); i++) {
+      if (results[i].utt_id == u && results[i].start == 10 * start) {
+        KALDI_ASSERT(results[i].end == 10 * (start + len));
+        KALDI_ASSERT(ApproxEqual(results[i].cost, 0.5 * len));
+        found = true;
+      }
+    }
+    KALDI_ASSERT(found);
+  }
+  for (int32 i = 0; i < num_shards; i++)
+    delete shards[i];
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  TestComputeKwsNgramPostings();
+  TestSilence();
+  for (int32 i = 0; i < 50; i++)
+    TestKwsInvertedIndex();
+  KALDI_LOG << "Success.";
+}
@@ -0,0 +1,402 @@
+// lat/kws-inverted-index.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <algorithm>
+#include <limits>
+#include "lat/kws-inverted-index.h"
+#include "lat/kws-functions.h"
+#include "lat/lattice-functions.h"
+
+namespace kaldi {
+
+namespace {
+
+// An occurrence of an n-gram, before merging.
+struct KwsHit {
+  int32 start;
+  int32 end;
+  double log_post;
+  KwsHit(int32 start, int32 end, double log_post):
+      start(start), end(end), log_post(log_post) { }
+  bool operator < (const KwsHit &other) const { return start < other.start; }
+};
+
+class KwsNgramCollector {
+ public:
+  typedef CompactLatticeArc::StateId StateId;
+  typedef unordered_map<std::vector<int32>, std::vector<KwsHit>,
+                        VectorHasher<int32> > HitMapType;
+
+  KwsNgramCollector(const CompactLattice &clat,
+                    const std::vector<int32> &state_times,
+                    const std::vector<double> &alpha,
+                    const std::vector<double> &beta,
+                    double tot_like, const KwsIndexOptions &opts):
+      clat_(clat), state_times_(state_times), alpha_(alpha), beta_(beta),
+      tot_like_(tot_like), opts_(opts),
+      log_floor_(Log(static_cast<double>(opts.min_posterior))) { }
+
+  void Collect() {
+    for (StateId s = 0; s < clat_.NumStates(); s++) {
+      if (alpha_[s] == -std::numeric_limits<double>::infinity()) continue;
+      for (fst::ArcIterator<CompactLattice> aiter(clat_, s); !aiter.Done();
+           aiter.Next()) {
+        const CompactLatticeArc &arc = aiter.Value();
+        if (arc.ilabel == 0) continue;  // n-grams don't start with silence.
+        words_.assign(1, arc.ilabel);
+        Extend(arc.nextstate, alpha_[s] - ArcCost(arc), state_times_[s]);
+      }
+    }
+  }
+
+  HitMapType &Hits() { return hits_; }
+
+ private:
+  static double ArcCost(const CompactLatticeArc &arc) {
+    return arc.weight.Weight().Value1() + arc.weight.Weight().Value2();
+  }
+
+  // Called when words_ ends at state "s"; "fwd" is the log-likelihood of
+  // getting to "s" along the chain of arcs, including alpha of its start.
+  void Extend(StateId s, double fwd, int32 start_time) {
+    double log_post = fwd + beta_[s] - tot_like_;
+    // The posterior of any extension can't be greater, so this pruning is
+    // safe.
+    if (log_post < log_floor_) return;
+    hits_[words_].push_back(KwsHit(start_time, state_times_[s], log_post));
+    if (static_cast<int32>(words_.size()) < opts_.max_order)
+      ExtendThroughSilence(s, fwd, start_time, 0);
+  }
+
+  void ExtendThroughSilence(StateId s, double fwd, int32 start_time,
+                            int32 silence_frames) {
+    for (fst::ArcIterator<CompactLattice> aiter(clat_, s); !aiter.Done();
+         aiter.Next()) {
+      const CompactLatticeArc &arc = aiter.Value();
+      double arc_fwd = fwd - ArcCost(arc);
+      if (arc_fwd + beta_[arc.nextstate] - tot_like_ < log_floor_) continue;
+      if (arc.ilabel == 0) {
+        int32 frames = silence_frames + state_times_[arc.nextstate] -
+            state_times_[s];
+        if (frames <= opts_.max_silence_frames)
+          ExtendThroughSilence(arc.nextstate, arc_fwd, start_time, frames);
+      } else {
+        words_.push_back(arc.ilabel);
+        Extend(arc.nextstate, arc_fwd, start_time);
+        words_.pop_back();
+      }
+    }
+  }
+
+  const CompactLattice &clat_;
+  const std::vector<int32> &state_times_;
+  const std::vector<double> &alpha_;
+  const std::vector<double> &beta_;
+  double tot_like_;
+  const KwsIndexOptions &opts_;
+  double log_floor_;
+  std::vector<int32> words_;
+  HitMapType hits_;
+};
+
+}  // namespace
+
+bool ComputeKwsNgramPostings(
+    const CompactLattice &clat, int32 utt_id, const KwsIndexOptions &opts,
+    std::vector<std::pair<std::vector<int32>, KwsPosting> > *postings) {
+  KALDI_ASSERT(opts.max_order > 0 && opts.min_posterior > 0.0);
+  if (clat.Start() == fst::kNoStateId) return false;
+  std::vector<int32> state_times;
+  CompactLatticeStateTimes(clat, &state_times);
+  std::vector<double> alpha, beta;
+  if (!ComputeCompactLatticeAlphas(clat, &alpha) ||
+      !ComputeCompactLatticeBetas(clat, &beta))
+    return false;
+  double tot_like = beta[clat.Start()];
+  if (tot_like == -std::numeric_limits<double>::infinity()) return false;
+
+  KwsNgramCollector collector(clat, state_times, alpha, beta, tot_like, opts);
+  collector.Collect();
+
+  // Merge the occurrences of each n-gram whose times overlap with that of the
+  // most likely occurrence so far.
+  KwsNgramCollector::HitMapType &hits = collector.Hits();
+  for (KwsNgramCollector::HitMapType::iterator iter = hits.begin();
+       iter != hits.end(); ++iter) {
+    std::vector<KwsHit> &occurrences = iter->second;
+    std::sort(occurrences.begin(), occurrences.end());
+    size_t i = 0;
+    while (i < occurrences.size()) {
+      KwsHit best = occurrences[i];
+      double tot_log_post = best.log_post;
+      for (i++; i < occurrences.size(); i++) {
+        const KwsHit &hit = occurrences[i];
+        if (hit.start >= best.end || best.start >= hit.end) break;
+        tot_log_post = LogAdd(tot_log_post, hit.log_post);
+        if (hit.log_post > best.log_post) best = hit;
+      }
+      BaseFloat cost = -std::min(tot_log_post, 0.0);
+      postings->push_back(std::make_pair(
+          iter->first, KwsPosting(utt_id, best.start, best.end, cost)));
+    }
+  }
+  return true;
+}
+
+
+void KwsInvertedIndex::AddPosting(const std::vector<int32> &ngram,
+                                  const KwsPosting &posting) {
+  KALDI_ASSERT(!ngram.empty());
+  postings_[ngram].push_back(posting);
+  max_order_ = std::max(max_order_, static_cast<int32>(ngram.size()));
+}
+
+void KwsInvertedIndex::Merge(const KwsInvertedIndex &other) {
+  KALDI_ASSERT(num_shards_ == 1 && other.num_shards_ == 1);
+  for (MapType::const_iterator iter = other.postings_.begin();
+       iter != other.postings_.end(); ++iter) {
+    std::vector<KwsPosting> &list = postings_[iter->first];
+    list.insert(list.end(), iter->second.begin(), iter->second.end());
+  }
+  max_order_ = std::max(max_order_, other.max_order_);
+}
+
+void KwsInvertedIndex::SortPostings() {
+  for (MapType::iterator iter = postings_.begin(); iter != postings_.end();
+       ++iter)
+    std::sort(iter->second.begin(), iter->second.end());
+}
+
+const std::vector<KwsPosting> *KwsInvertedIndex::Lookup(
+    const std::vector<int32> &ngram) const {
+  MapType::const_iterator iter = postings_.find(ngram);
+  return (iter == postings_.end() ? NULL : &(iter->second));
+}
+
+int32 KwsInvertedIndex::ShardOf(const std::vector<int32> &ngram,
+                                int32 num_shards) {
+  // This is part of the on-disk format, so we don't use VectorHasher, whose
+  // result depends on sizeof(size_t).
+  uint32 hash = 0;
+  for (size_t i = 0; i < ngram.size(); i++)
+    hash = hash * 7853 + static_cast<uint32>(ngram[i]);
+  return static_cast<int32>(hash % static_cast<uint32>(num_shards));
+}
+
+void KwsInvertedIndex::Split(int32 num_shards,
+                             std::vector<KwsInvertedIndex*> *shards) const {
+  KALDI_ASSERT(num_shards_ == 1 && num_shards > 0);
+  shards->resize(num_shards);
+  for (int32 i = 0; i < num_shards; i++) {
+    (*shards)[i] = new KwsInvertedIndex();
+    (*shards)[i]->max_order_ = max_order_;
+    (*shards)[i]->num_shards_ = num_shards;
+    (*shards)[i]->shard_index_ = i;
+  }
+  for (MapType::const_iterator iter = postings_.begin();
+       iter != postings_.end(); ++iter)
+    (*shards)[ShardOf(iter->first, num_shards)]->postings_[iter->first] =
+        iter->second;
+}
+
+int64 KwsInvertedIndex::NumPostings() const {
+  int64 ans = 0;
+  for (MapType::const_iterator iter = postings_.begin();
+       iter != postings_.end(); ++iter)
+    ans += iter->second.size();
+  return ans;
+}
+
+namespace {
+typedef std::pair<const std::vector<int32>, std::vector<KwsPosting> >
+    KwsIndexEntry;
+bool CompareKwsIndexEntries(const KwsIndexEntry *a, const KwsIndexEntry *b) {
+  return a->first < b->first;
+}
+}  // namespace
+
+void KwsInvertedIndex::Write(std::ostream &os, bool binary) const {
+  WriteToken(os, binary, "<KwsInvertedIndex>");
+  WriteToken(os, binary, "<MaxOrder>");
+  WriteBasicType(os, binary, max_order_);
+  WriteToken(os, binary, "<NumShards>");
+  WriteBasicType(os, binary, num_shards_);
+  WriteToken(os, binary, "<ShardIndex>");
+  WriteBasicType(os, binary, shard_index_);
+  WriteToken(os, binary, "<NumNgrams>");
+  int32 num_ngrams = postings_.size();
+  WriteBasicType(os, binary, num_ngrams);
+  if (!binary) os << "\n";
+  // Write the n-grams in sorted order so the output is deterministic.
+  std::vector<const KwsIndexEntry*> entries;
+  entries.reserve(num_ngrams);
+  for (MapType::const_iterator iter = postings_.begin();
+       iter != postings_.end(); ++iter)
+    entries.push_back(&(*iter));
+  std::sort(entries.begin(), entries.end(), CompareKwsIndexEntries);
+  for (size_t i = 0; i < entries.size(); i++) {
+    WriteIntegerVector(os, binary, entries[i]->first);
+    const std::vector<KwsPosting> &list = entries[i]->second;
+    int32 num_postings = list.size();
+    WriteBasicType(os, binary, num_postings);
+    for (int32 j = 0; j < num_postings; j++) {
+      WriteBasicType(os, binary, list[j].utt_id);
+      WriteBasicType(os, binary, list[j].start);
+      WriteBasicType(os, binary, list[j].end);
+      WriteBasicType(os, binary, list[j].cost);
+    }
+    if (!binary) os << "\n";
+  }
+  WriteToken(os, binary, "</KwsInvertedIndex>");
+}
+
+void KwsInvertedIndex::Read(std::istream &is, bool binary) {
+  ExpectToken(is, binary, "<KwsInvertedIndex>");
+  ExpectToken(is, binary, "<MaxOrder>");
+  ReadBasicType(is, binary, &max_order_);
+  ExpectToken(is, binary, "<NumShards>");
+  ReadBasicType(is, binary, &num_shards_);
+  ExpectToken(is, binary, "<ShardIndex>");
+  ReadBasicType(is, binary, &shard_index_);
+  if (num_shards_ <= 0 || shard_index_ < 0 || shard_index_ >= num_shards_)
+    KALDI_ERR << "Bad shard index " << shard_index_ << " of " << num_shards_;
+  ExpectToken(is, binary, "<NumNgrams>");
+  int32 num_ngrams;
+  ReadBasicType(is, binary, &num_ngrams);
+  postings_.clear();
+  std::vector<int32> ngram;
+  for (int32 i = 0; i < num_ngrams; i++) {
+    ReadIntegerVector(is, binary, &ngram);
+    std::vector<KwsPosting> &list = postings_[ngram];
+    int32 num_postings;
+    ReadBasicType(is, binary, &num_postings);
+    list.resize(num_postings);
+    for (int32 j = 0; j < num_postings; j++) {
+      ReadBasicType(is, binary, &(list[j].utt_id));
+      ReadBasicType(is, binary, &(list[j].start));
+      ReadBasicType(is, binary, &(list[j].end));
+      ReadBasicType(is, binary, &(list[j].cost));
+    }
+  }
+  ExpectToken(is, binary, "</KwsInvertedIndex>");
+}
+
+
+KwsIndexSearcher::KwsIndexSearcher(
+    const std::vector<const KwsInvertedIndex*> &shards):
+    shards_(shards), max_order_(0) {
+  KALDI_ASSERT(!shards_.empty());
+  int32 num_shards = shards_.size();
+  for (int32 i = 0; i < num_shards; i++) {
+    if (shards_[i]->NumShards() != num_shards ||
+        shards_[i]->ShardIndex() != i)
+      KALDI_ERR << "Expected shard " << i << " of " << num_shards
+                << ", got shard " << shards_[i]->ShardIndex() << " of "
+                << shards_[i]->NumShards();
+    max_order_ = std::max(max_order_, shards_[i]->MaxOrder());
+  }
+}
+
+const std::vector<KwsPosting> *KwsIndexSearcher::Lookup(
+    const std::vector<int32> &ngram) const {
+  int32 shard = KwsInvertedIndex::ShardOf(ngram, shards_.size());
+  return shards_[shard]->Lookup(ngram);
+}
+
+// Outputs to "out" the combinations of a posting in "prev" with a posting in
+// "next" (for the same utterance) that starts after it and no more than
+// max_gap frames after its end.  All are sorted by utterance and time.
+static void IntersectKwsPostings(const std::vector<KwsPosting> &prev,
+                                 const std::vector<KwsPosting> &next,
+                                 int32 max_gap,
+                                 std::vector<KwsPosting> *out) {
+  typedef std::vector<KwsPosting>::const_iterator IterType;
+  const int32 kMin = std::numeric_limits<int32>::min();
+  out->clear();
+  IterType prev_iter = prev.begin(), next_iter = next.begin();
+  while (prev_iter != prev.end()) {
+    int32 utt_id = prev_iter->utt_id;
+    // Skip over the utterances in "next" that are not in "prev"; then, if
+    // this utterance is not in "next", skip over it in "prev".
+    next_iter = std::lower_bound(next_iter, next.end(),
+                                 KwsPosting(utt_id, kMin, kMin, 0.0));
+    if (next_iter == next.end()) break;
+    if (next_iter->utt_id != utt_id) {
+      prev_iter = std::lower_bound(
+          prev_iter, prev.end(),
+          KwsPosting(next_iter->utt_id, kMin, kMin, 0.0));
+      continue;
+    }
+    IterType next_utt_end = std::lower_bound(
+        next_iter, next.end(), KwsPosting(utt_id + 1, kMin, kMin, 0.0));
+    for (; prev_iter != prev.end() && prev_iter->utt_id == utt_id;
+         ++prev_iter) {
+      const KwsPosting &p = *prev_iter;
+      IterType iter = std::lower_bound(
+          next_iter, next_utt_end, KwsPosting(utt_id, p.start + 1, kMin, 0.0));
+      for (; iter != next_utt_end && iter->start <= p.end + max_gap; ++iter)
+        out->push_back(KwsPosting(utt_id, p.start, std::max(p.end, iter->end),
+                                  p.cost + iter->cost));
+    }
+    next_iter = next_utt_end;
+  }
+  // Keep the best of any duplicates.
+  std::sort(out->begin(), out->end());
+  size_t num_out = 0;
+  for (size_t i = 0; i < out->size(); i++) {
+    const KwsPosting &p = (*out)[i];
+    if (num_out > 0) {
+      KwsPosting &q = (*out)[num_out - 1];
+      if (q.utt_id == p.utt_id && q.start == p.start && q.end == p.end) {
+        q.cost = std::min(q.cost, p.cost);
+        continue;
+      }
+    }
+    (*out)[num_out++] = p;
+  }
+  out->resize(num_out);
+}
+
+void KwsIndexSearcher::Search(const std::vector<int32> &keyword,
+                              const KwsSearchOptions &opts,
+                              std::vector<KwsPosting> *results) const {
+  std::vector<int32> words;
+  for (size_t i = 0; i < keyword.size(); i++)
+    if (keyword[i] != 0) words.push_back(keyword[i]);
+  if (words.empty() || max_order_ == 0) return;
+
+  // Split the keyword into pieces of at most max_order_ words, and intersect
+  // their posting lists.
+  std::vector<KwsPosting> cur, next;
+  for (size_t pos = 0; pos < words.size(); pos += max_order_) {
+    size_t end = std::min(words.size(), pos + max_order_);
+    std::vector<int32> piece(words.begin() + pos, words.begin() + end);
+    const std::vector<KwsPosting> *list = Lookup(piece);
+    if (list == NULL) return;
+    if (pos == 0) {
+      cur = *list;
+    } else {
+      IntersectKwsPostings(cur, *list, opts.max_gap_frames, &next);
+      cur.swap(next);
+    }
+    if (cur.empty()) return;
+  }
+  results->insert(results->end(), cur.begin(), cur.end());
+}
+
+}  // namespace kaldi
@@ -0,0 +1,172 @@
+// lat/kws-inverted-index.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_LAT_KWS_INVERTED_INDEX_H_
+#define KALDI_LAT_KWS_INVERTED_INDEX_H_
+
+#include <vector>
+#include "base/kaldi-common.h"
+#include "itf/options-itf.h"
+#include "lat/kaldi-lattice.h"
+#include "util/stl-utils.h"
+
+namespace kaldi {
+
+/**
+   This header contains a simpler alternative to the factor-transducer index of
+   lat/kws-functions.h, for large archives.  The index is an inverted index
+   that maps each word n-gram (up to a maximum order) to a "posting list" of
+   its occurrences, each with an utterance id, a start and end frame and a
+   cost (the negated log of the posterior probability of the n-gram in the
+   lattice at that time).  Keywords of up to the maximum order are answered
+   by a single hash lookup; longer keywords are split into consecutive pieces,
+   and their posting lists are intersected, requiring each piece to start
+   soon after the previous one (the posterior is approximated by the product
+   of the pieces' posteriors).
+
+   The index can be split into shards by a hash of the n-gram, so that the
+   shards can be built and stored separately; a search needs all the shards.
+*/
+
+struct KwsIndexOptions {
+  int32 max_order;
+  BaseFloat min_posterior;
+  int32 max_silence_frames;
+
+  KwsIndexOptions(): max_order(3), min_posterior(1.0e-03),
+                     max_silence_frames(50) { }
+
+  void Register(OptionsItf *po) {
+    po->Register("max-order", &max_order, "Maximum length of the word "
+                 "n-grams that are indexed.");
+    po->Register("min-posterior", &min_posterior, "Occurrences of n-grams "
+                 "with posterior below this are not indexed.");
+    po->Register("max-silence-frames", &max_silence_frames, "Maximum number "
+                 "of frames of silence (epsilon arcs) between adjacent words "
+                 "of an n-gram.");
+  }
+};
+
+struct KwsPosting {
+  int32 utt_id;
+  int32 start;  // start frame.
+  int32 end;  // end frame (one past the last frame).
+  BaseFloat cost;  // negated log posterior.
+  KwsPosting() { }
+  KwsPosting(int32 utt_id, int32 start, int32 end, BaseFloat cost):
+      utt_id(utt_id), start(start), end(end), cost(cost) { }
+  // Order by utterance and then by time; posting lists are sorted this way.
+  bool operator < (const KwsPosting &other) const {
+    if (utt_id != other.utt_id) return utt_id < other.utt_id;
+    if (start != other.start) return start < other.start;
+    return end < other.end;
+  }
+};
+
+/// Works out the posting of each word n-gram of length up to opts.max_order
+/// in the lattice "clat", which must be topologically sorted and already
+/// scaled as desired (e.g. with the acoustic scale).  Occurrences of the same
+/// n-gram whose times overlap are merged into one, whose posterior is the sum
+/// of theirs (at most one) and whose times are those of the most likely one.
+/// The words may be separated by epsilon (silence) arcs, but not begin or end
+/// with them.  Returns false if the lattice was empty.
+bool ComputeKwsNgramPostings(
+    const CompactLattice &clat, int32 utt_id, const KwsIndexOptions &opts,
+    std::vector<std::pair<std::vector<int32>, KwsPosting> > *postings);
+
+
+class KwsInvertedIndex {
+ public:
+  KwsInvertedIndex(): max_order_(0), num_shards_(1), shard_index_(0) { }
+
+  /// Adds a posting.  The posting lists must be sorted with SortPostings()
+  /// before Lookup() or Write() is called.
+  void AddPosting(const std::vector<int32> &ngram, const KwsPosting &posting);
+
+  /// Adds the postings of "other", which must be an unsharded index.
+  void Merge(const KwsInvertedIndex &other);
+
+  /// Sorts each posting list by utterance and time.
+  void SortPostings();
+
+  /// Returns the posting list for this n-gram (sorted by utterance and time),
+  /// or NULL if there is none.  The n-gram must be in this shard.
+  const std::vector<KwsPosting> *Lookup(const std::vector<int32> &ngram) const;
+
+  /// Splits this (unsharded) index into "num_shards" shards; the shards
+  /// are newly allocated and the caller owns them.
+  void Split(int32 num_shards, std::vector<KwsInvertedIndex*> *shards) const;
+
+  /// Returns the shard that the n-gram belongs in.
+  static int32 ShardOf(const std::vector<int32> &ngram, int32 num_shards);
+
+  int32 MaxOrder() const { return max_order_; }
+  int32 NumShards() const { return num_shards_; }
+  int32 ShardIndex() const { return shard_index_; }
+  int32 NumNgrams() const { return postings_.size(); }
+  int64 NumPostings() const;
+
+  void Write(std::ostream &os, bool binary) const;
+  void Read(std::istream &is, bool binary);
+
+ private:
+  typedef unordered_map<std::vector<int32>, std::vector<KwsPosting>,
+                        VectorHasher<int32> > MapType;
+  MapType postings_;
+  int32 max_order_;  // the longest n-gram added.
+  int32 num_shards_;
+  int32 shard_index_;
+};
+
+
+struct KwsSearchOptions {
+  int32 max_gap_frames;
+
+  KwsSearchOptions(): max_gap_frames(50) { }
+
+  void Register(OptionsItf *po) {
+    po->Register("max-gap-frames", &max_gap_frames, "For keywords longer than "
+                 "the maximum order of the index, the maximum number of "
+                 "frames between the end of one piece and the start of the "
+                 "next.");
+  }
+};
+
+/// Searches the shards of an inverted index, which must be in order of shard
+/// index.  It does not take ownership of them.
+class KwsIndexSearcher {
+ public:
+  explicit KwsIndexSearcher(const std::vector<const KwsInvertedIndex*> &shards);
+
+  /// Appends to "results" the occurrences of "keyword" (a word sequence).
+  /// The results are sorted by utterance and time.
+  void Search(const std::vector<int32> &keyword,
+              const KwsSearchOptions &opts,
+              std::vector<KwsPosting> *results) const;
+
+ private:
+  const std::vector<KwsPosting> *Lookup(const std::vector<int32> &ngram) const;
+
+  std::vector<const KwsInvertedIndex*> shards_;
+  int32 max_order_;
+};
+
+
+}  // namespace kaldi
+
+#endif  // KALDI_LAT_KWS_INVERTED_INDEX_H_
@@ -0,0 +1,245 @@
+// lat/lattice-functions-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lat/kaldi-lattice.h"
+#include "lat/lattice-functions.h"
+#include "util/edit-distance.h"
+#include "fstext/rand-fst.h"
+
+
+namespace kaldi {
+using namespace fst;
+
+// Returns a random lattice with "width" states on each of "num_frames" frames
+// plus a start state, whose arcs mostly go between adjacent frames and have
+// transition-ids as ilabels; some of them have words as olabels, and there are
+// a few epsilon arcs within each frame.
+Lattice *RandFrameLattice(int32 num_frames, int32 width) {
+  Lattice *lat = new Lattice;
+  lat->AddState();
+  lat->SetStart(0);
+  for (int32 t = 0; t < num_frames; t++)
+    for (int32 i = 0; i < width; i++)
+      lat->AddState();
+  for (int32 t = 0; t < num_frames; t++) {
+    for (int32 i = 0; i < width; i++) {
+      int32 s = 1 + t * width + i;
+      int32 num_prev = (t == 0 ? 1 : 1 + Rand() % 3);
+      for (int32 j = 0; j < num_prev; j++) {
+        int32 prev = (t == 0 ? 0 : 1 + (t - 1) * width + Rand() % width);
+        LatticeWeight w(RandUniform(), 10.0 * RandUniform());
+        int32 word = (Rand() % 5 == 0 ? 1 + Rand() % 10 : 0);
+        lat->AddArc(prev, LatticeArc(1 + Rand() % 10, word, w, s));
+      }
+      if (i > 0 && Rand() % 5 == 0) {  // epsilon arc within the frame.
+        LatticeWeight w(RandUniform(), 0.0);
+        lat->AddArc(s - 1, LatticeArc(0, 0, w, s));
+      }
+      if (t == num_frames - 1)
+        lat->SetFinal(s, LatticeWeight(RandUniform(), 0.0));
+    }
+  }
+  Connect(lat);
+  TopSort(lat);
+  return lat;
+}
+
+// Returns RandFrameLattice() as a topologically sorted CompactLattice, with
+// the words on the input side.
+CompactLattice *RandFrameCompactLattice(int32 num_frames, int32 width) {
+  Lattice *lat = RandFrameLattice(num_frames, width);
+  Invert(lat);
+  CompactLattice *clat = new CompactLattice;
+  ConvertLattice(*lat, clat);
+  delete lat;
+  TopSortCompactLatticeIfNeeded(clat);
+  return clat;
+}
+
+// Returns the best-path cost of the lattice.
+template<class LatticeType>
+double BestCost(const LatticeType &lat) {
+  typedef typename LatticeType::Arc Arc;
+  KALDI_ASSERT(lat.Properties(kTopSorted, true) != 0);
+  int32 num_states = lat.NumStates();
+  std::vector<double> cost(num_states,
+                           std::numeric_limits<double>::infinity());
+  double best_cost = std::numeric_limits<double>::infinity();
+  cost[lat.Start()] = 0.0;
+  for (int32 s = 0; s < num_states; s++) {
+    for (ArcIterator<LatticeType> aiter(lat, s); !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      cost[arc.nextstate] = std::min(cost[arc.nextstate],
+                                     cost[s] + ConvertToCost(arc.weight));
+    }
+    best_cost = std::min(best_cost, cost[s] + ConvertToCost(lat.Final(s)));
+  }
+  return best_cost;
+}
+
+// Checks that PruneLattice() keeps exactly the arcs whose best path is within
+// the beam of the best path: such an arc is on a path all of whose arcs are
+// within the beam, so none of them should be removed by Connect().
+template<class LatticeType>
+void TestPruneLatticeBeam(const LatticeType &lat, BaseFloat beam) {
+  typedef typename LatticeType::Arc Arc;
+  int32 num_states = lat.NumStates();
+  std::vector<double> forward_cost(num_states,
+                                   std::numeric_limits<double>::infinity()),
+      backward_cost(num_states);
+  forward_cost[lat.Start()] = 0.0;
+  double best_cost = BestCost(lat);
+  for (int32 s = 0; s < num_states; s++)
+    for (ArcIterator<LatticeType> aiter(lat, s); !aiter.Done(); aiter.Next())
+      forward_cost[aiter.Value().nextstate] =
+          std::min(forward_cost[aiter.Value().nextstate],
+                   forward_cost[s] + ConvertToCost(aiter.Value().weight));
+  int32 num_arcs_in_beam = 0;
+  for (int32 s = num_states - 1; s >= 0; s--) {
+    backward_cost[s] = ConvertToCost(lat.Final(s));
+    for (ArcIterator<LatticeType> aiter(lat, s); !aiter.Done();
+         aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      double arc_backward_cost = ConvertToCost(arc.weight) +
+          backward_cost[arc.nextstate];
+      backward_cost[s] = std::min(backward_cost[s], arc_backward_cost);
+      if (forward_cost[s] + arc_backward_cost <= best_cost + beam)
+        num_arcs_in_beam++;
+    }
+  }
+  LatticeType pruned_lat(lat);
+  KALDI_ASSERT(PruneLattice(beam, &pruned_lat));
+  KALDI_ASSERT(NumArcs(pruned_lat) == num_arcs_in_beam);
+  AssertEqual(BestCost(pruned_lat), best_cost, 1.0e-05);
+}
+
+void TestPruneLatticeLimitDepth() {
+  Lattice *lat = RandFrameLattice(20 + Rand() % 20, 5 + Rand() % 10);
+  CompactLattice clat;
+  ConvertLattice(*lat, &clat);
+  TopSortCompactLatticeIfNeeded(&clat);
+  BaseFloat beam = 1.0 + 10.0 * RandUniform();
+  TestPruneLatticeBeam(*lat, beam);
+  TestPruneLatticeBeam(clat, beam);
+
+  int32 max_arcs_per_frame = 1 + Rand() % 5;
+  {
+    Lattice pruned_lat(*lat);
+    KALDI_ASSERT(PruneLatticeLimitDepth(beam, max_arcs_per_frame,
+                                        &pruned_lat));
+    TopSortLatticeIfNeeded(&pruned_lat);
+    // The best path should be kept.
+    AssertEqual(BestCost(pruned_lat), BestCost(*lat), 1.0e-05);
+    std::vector<int32> state_times;
+    int32 num_frames = LatticeStateTimes(pruned_lat, &state_times);
+    std::vector<int32> depth(num_frames, 0);
+    for (int32 s = 0; s < pruned_lat.NumStates(); s++)
+      for (ArcIterator<Lattice> aiter(pruned_lat, s); !aiter.Done();
+           aiter.Next())
+        if (aiter.Value().ilabel != 0)
+          depth[state_times[s]]++;
+    for (int32 t = 0; t < num_frames; t++)
+      KALDI_ASSERT(depth[t] <= max_arcs_per_frame);
+  }
+  {
+    CompactLattice pruned_clat(clat);
+    KALDI_ASSERT(PruneLatticeLimitDepth(beam, max_arcs_per_frame,
+                                        &pruned_clat));
+    AssertEqual(BestCost(pruned_clat), BestCost(clat), 1.0e-05);
+    TopSortCompactLatticeIfNeeded(&pruned_clat);
+    std::vector<int32> depth_per_frame;
+    CompactLatticeDepthPerFrame(pruned_clat, &depth_per_frame);
+    for (size_t t = 0; t < depth_per_frame.size(); t++)
+      KALDI_ASSERT(depth_per_frame[t] <= max_arcs_per_frame);
+  }
+  delete lat;
+}
+
+// Appends to *word_seqs the word sequences (without epsilons and wildcards) of
+// all paths through "clat" from state s, each preceded by "prefix".
+void GetAllWordSequences(const CompactLattice &clat, CompactLattice::StateId s,
+                         const std::vector<int32> &wildcards,
+                         std::vector<int32> *prefix,
+                         std::vector<std::vector<int32> > *word_seqs) {
+  if (clat.Final(s) != CompactLatticeWeight::Zero())
+    word_seqs->push_back(*prefix);
+  for (ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done();
+       aiter.Next()) {
+    int32 word = aiter.Value().ilabel;
+    bool keep = (word != 0 && std::find(wildcards.begin(), wildcards.end(),
+                                        word) == wildcards.end());
+    if (keep) prefix->push_back(word);
+    GetAllWordSequences(clat, aiter.Value().nextstate, wildcards, prefix,
+                        word_seqs);
+    if (keep) prefix->pop_back();
+  }
+}
+
+// Checks CompactLatticeOracle() against the smallest edit distance over all
+// paths of a small lattice, found by brute force.
+void TestCompactLatticeOracle() {
+  CompactLattice *clat = RandFrameCompactLattice(1 + Rand() % 6,
+                                                 1 + Rand() % 3);
+  std::vector<int32> reference, wildcards;
+  for (int32 n = Rand() % 8; n > 0; n--)
+    reference.push_back(Rand() % 11);  // may include epsilon.
+  for (int32 n = Rand() % 3; n > 0; n--)
+    wildcards.push_back(1 + Rand() % 10);
+
+  std::vector<int32> stripped_reference;
+  for (size_t i = 0; i < reference.size(); i++)
+    if (reference[i] != 0 && std::find(wildcards.begin(), wildcards.end(),
+                                       reference[i]) == wildcards.end())
+      stripped_reference.push_back(reference[i]);
+  std::vector<int32> prefix;
+  std::vector<std::vector<int32> > word_seqs;
+  GetAllWordSequences(*clat, clat->Start(), wildcards, &prefix, &word_seqs);
+  KALDI_ASSERT(!word_seqs.empty());
+  int32 best_edit_distance = std::numeric_limits<int32>::max();
+  for (size_t i = 0; i < word_seqs.size(); i++)
+    best_edit_distance = std::min(best_edit_distance,
+                                  LevenshteinEditDistance(stripped_reference,
+                                                          word_seqs[i]));
+
+  std::vector<int32> oracle_words;
+  CompactLattice oracle_path;
+  int32 edit_distance = CompactLatticeOracle(*clat, reference, wildcards,
+                                             &oracle_words, &oracle_path);
+  KALDI_ASSERT(edit_distance == best_edit_distance);
+  KALDI_ASSERT(LevenshteinEditDistance(stripped_reference, oracle_words) ==
+               edit_distance);
+  // The oracle path should be a path through the lattice with those words.
+  std::vector<std::vector<int32> > path_word_seqs;
+  GetAllWordSequences(oracle_path, oracle_path.Start(), wildcards, &prefix,
+                      &path_word_seqs);
+  KALDI_ASSERT(path_word_seqs.size() == 1 &&
+               path_word_seqs[0] == oracle_words);
+  KALDI_ASSERT(std::find(word_seqs.begin(), word_seqs.end(), oracle_words) !=
+               word_seqs.end());
+  delete clat;
+}
+
+} // end namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 20; i++)
+    TestPruneLatticeLimitDepth();
+  for (int32 i = 0; i < 100; i++)
+    TestCompactLatticeOracle();
+  std::cout << "Test OK\n";
+}
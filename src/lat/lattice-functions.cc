@@ -28,6 +28,7 @@
 #include "util/stl-utils.h"
 #include "base/kaldi-math.h"
 #include "hmm/hmm-utils.h"
+#include "lat/lattice-level-graph.h"
 
 namespace kaldi {
 using std::map;
@@ -107,10 +108,28 @@ int32 CompactLatticeStateTimes(const CompactLattice &lat, vector<int32> *times)
 
 template<class LatType> // could be Lattice or CompactLattice
 bool PruneLattice(BaseFloat beam, LatType *lat) {
+  return PruneLatticeLimitDepth(beam, 0, lat);
+}
+
+// instantiate the template for lattice and CompactLattice.
+template bool PruneLattice(BaseFloat beam, Lattice *lat);
+template bool PruneLattice(BaseFloat beam, CompactLattice *lat);
+
+// Returns the number of frames an arc takes, for PruneLatticeLimitDepth().
+static inline int32 ArcNumFrames(const LatticeArc &arc) {
+  return (arc.ilabel != 0 ? 1 : 0);
+}
+static inline int32 ArcNumFrames(const CompactLatticeArc &arc) {
+  return arc.weight.String().size();
+}
+
+template<class LatType> // could be Lattice or CompactLattice
+bool PruneLatticeLimitDepth(BaseFloat beam, int32 max_arcs_per_frame,
+                            LatType *lat) {
   typedef typename LatType::Arc Arc;
   typedef typename Arc::Weight Weight;
   typedef typename Arc::StateId StateId;
-  
+
   KALDI_ASSERT(beam > 0.0);
   if (!lat->Properties(fst::kTopSorted, true)) {
     if (fst::TopSort(lat) == false) {
@@ -118,23 +137,24 @@ bool PruneLattice(BaseFloat beam, LatType *lat) {
       return false;
     }
   }
-  // We assume states before "start" are not reachable, since
-  // the lattice is topologically sorted.
   int32 start = lat->Start();
   int32 num_states = lat->NumStates();
   if (num_states == 0) return false;
+  // Viterbi forward costs, and the frame index of each state; we work these
+  // out in the same pass.  We also number the arcs.
   std::vector<double> forward_cost(num_states,
-                                   std::numeric_limits<double>::infinity()); // viterbi forward.
-  forward_cost[start] = 0.0; // lattice can't have cycles so couldn't be
-  // less than this.
+                                   std::numeric_limits<double>::infinity());
+  std::vector<int32> state_times(num_states, 0), arc_begin(num_states + 1);
+  forward_cost[start] = 0.0;
   double best_final_cost = std::numeric_limits<double>::infinity();
-  // Update the forward probs.
-  // Thanks to Jing Zheng for finding a bug here.
+  int32 num_arcs = 0, num_frames = 0;
   for (int32 state = 0; state < num_states; state++) {
     double this_forward_cost = forward_cost[state];
+    int32 this_time = state_times[state];
+    arc_begin[state] = num_arcs;
     for (fst::ArcIterator<LatType> aiter(*lat, state);
          !aiter.Done();
-         aiter.Next()) {
+         aiter.Next(), num_arcs++) {
       const Arc &arc(aiter.Value());
       StateId nextstate = arc.nextstate;
       KALDI_ASSERT(nextstate > state && nextstate < num_states);
@@ -142,6 +162,11 @@ bool PruneLattice(BaseFloat beam, LatType *lat) {
           ConvertToCost(arc.weight);
       if (forward_cost[nextstate] > next_forward_cost)
         forward_cost[nextstate] = next_forward_cost;
+      if (this_forward_cost != std::numeric_limits<double>::infinity()) {
+        int32 next_time = this_time + ArcNumFrames(arc);
+        state_times[nextstate] = next_time;
+        num_frames = std::max(num_frames, next_time);
+      }
     }
     Weight final_weight = lat->Final(state);
     double this_final_cost = this_forward_cost +
@@ -149,14 +174,14 @@ bool PruneLattice(BaseFloat beam, LatType *lat) {
     if (this_final_cost < best_final_cost)
       best_final_cost = this_final_cost;
   }
-  int32 bad_state = lat->AddState(); // this state is not final.
+  arc_begin[num_states] = num_arcs;
   double cutoff = best_final_cost + beam;
-  
+
   // Go backwards updating the backward probs (which share memory with the
-  // forward probs), and pruning arcs and deleting final-probs.  We prune arcs
-  // by making them point to the non-final state "bad_state".  We'll then use
-  // Trim() to remove unnecessary arcs and states.  [this is just easier than
-  // doing it ourselves.]
+  // forward probs), pruning arcs outside the beam and deleting final-probs,
+  // and noting the forward-backward cost of each arc: arc_fb_cost[a] is
+  // infinity if arc a is to be pruned.
+  std::vector<double> arc_fb_cost(num_arcs);
   std::vector<double> &backward_cost(forward_cost);
   for (int32 state = num_states - 1; state >= 0; state--) {
     double this_forward_cost = forward_cost[state];
@@ -164,31 +189,79 @@ bool PruneLattice(BaseFloat beam, LatType *lat) {
     if (this_backward_cost + this_forward_cost > cutoff
         && this_backward_cost != std::numeric_limits<double>::infinity())
       lat->SetFinal(state, Weight::Zero());
-    for (fst::MutableArcIterator<LatType> aiter(lat, state);
+    int32 a = arc_begin[state];
+    for (fst::ArcIterator<LatType> aiter(*lat, state);
          !aiter.Done();
-         aiter.Next()) {
-      Arc arc(aiter.Value());
-      StateId nextstate = arc.nextstate;
-      KALDI_ASSERT(nextstate > state && nextstate < num_states);
+         aiter.Next(), a++) {
+      const Arc &arc(aiter.Value());
       double arc_cost = ConvertToCost(arc.weight),
-          arc_backward_cost = arc_cost + backward_cost[nextstate],
+          arc_backward_cost = arc_cost + backward_cost[arc.nextstate],
           this_fb_cost = this_forward_cost + arc_backward_cost;
       if (arc_backward_cost < this_backward_cost)
         this_backward_cost = arc_backward_cost;
-      if (this_fb_cost > cutoff) { // Prune the arc.
+      arc_fb_cost[a] = (this_fb_cost > cutoff ?
+                        std::numeric_limits<double>::infinity() :
+                        this_fb_cost);
+    }
+    backward_cost[state] = this_backward_cost;
+  }
+
+  if (max_arcs_per_frame > 0) {
+    // For each frame, the (cost, arc-index) of the arcs within the beam that
+    // cross it.
+    std::vector<std::vector<std::pair<double, int32> > > buckets(num_frames);
+    for (int32 state = 0; state < num_states; state++) {
+      int32 a = arc_begin[state], t = state_times[state];
+      for (fst::ArcIterator<LatType> aiter(*lat, state);
+           !aiter.Done();
+           aiter.Next(), a++) {
+        if (arc_fb_cost[a] == std::numeric_limits<double>::infinity())
+          continue;
+        int32 arc_frames = ArcNumFrames(aiter.Value());
+        for (int32 f = t; f < t + arc_frames; f++)
+          buckets[f].push_back(std::make_pair(arc_fb_cost[a], a));
+      }
+    }
+    size_t max_arcs = max_arcs_per_frame;
+    for (int32 t = 0; t < num_frames; t++) {
+      std::vector<std::pair<double, int32> > &bucket = buckets[t];
+      if (bucket.size() > max_arcs) {
+        // Keep the max_arcs best arcs; an arc that is removed on any frame is
+        // removed.
+        std::nth_element(bucket.begin(), bucket.begin() + max_arcs,
+                         bucket.end());
+        for (size_t i = max_arcs; i < bucket.size(); i++)
+          arc_fb_cost[bucket[i].second] =
+              std::numeric_limits<double>::infinity();
+      }
+      std::vector<std::pair<double, int32> >().swap(bucket);
+    }
+  }
+
+  // Prune the arcs by making them point to the non-final state "bad_state".
+  // We'll then use Connect() to remove unnecessary arcs and states.
+  int32 bad_state = lat->AddState(); // this state is not final.
+  for (int32 state = 0; state < num_states; state++) {
+    int32 a = arc_begin[state];
+    for (fst::MutableArcIterator<LatType> aiter(lat, state);
+         !aiter.Done();
+         aiter.Next(), a++) {
+      if (arc_fb_cost[a] == std::numeric_limits<double>::infinity()) {
+        Arc arc(aiter.Value());
         arc.nextstate = bad_state;
         aiter.SetValue(arc);
       }
     }
-    backward_cost[state] = this_backward_cost;
   }
   fst::Connect(lat);
   return (lat->NumStates() > 0);
 }
 
 // instantiate the template for lattice and CompactLattice.
-template bool PruneLattice(BaseFloat beam, Lattice *lat);
-template bool PruneLattice(BaseFloat beam, CompactLattice *lat);
+template bool PruneLatticeLimitDepth(BaseFloat beam, int32 max_arcs_per_frame,
+                                     Lattice *lat);
+template bool PruneLatticeLimitDepth(BaseFloat beam, int32 max_arcs_per_frame,
+                                     CompactLattice *lat);
 
 
 BaseFloat LatticeForwardBackward(const Lattice &lat, Posterior *post,
@@ -683,62 +756,27 @@ BaseFloat LatticeForwardBackwardMpeVariants(
   vector<int32> state_times;
   int32 max_time = LatticeStateTimes(lat, &state_times);
   KALDI_ASSERT(max_time == static_cast<int32>(num_ali.size()));
-  std::vector<double> alpha(num_states, kLogZeroDouble),
-      alpha_smbr(num_states, 0), //forward variable for sMBR
-      beta(num_states, kLogZeroDouble),
-      beta_smbr(num_states, 0); //backward variable for sMBR
-
-  double tot_forward_prob = kLogZeroDouble;
-  double tot_forward_score = 0;
+  std::vector<double> alpha, beta,
+      alpha_smbr, //forward variable for sMBR
+      beta_smbr; //backward variable for sMBR
 
   post->clear();
   post->resize(max_time);
 
-  alpha[0] = 0.0;
-  // First Pass Forward,
-  for (StateId s = 0; s < num_states; s++) {
-    double this_alpha = alpha[s];
-    for (ArcIterator<Lattice> aiter(lat, s); !aiter.Done(); aiter.Next()) {
-      const Arc &arc = aiter.Value();
-      double arc_like = -ConvertToCost(arc.weight);
-      alpha[arc.nextstate] = LogAdd(alpha[arc.nextstate], this_alpha + arc_like);
-    }
-    Weight f = lat.Final(s);
-    if (f != Weight::Zero()) {
-      double final_like = this_alpha - (f.Value1() + f.Value2());
-      tot_forward_prob = LogAdd(tot_forward_prob, final_like);
-      KALDI_ASSERT(state_times[s] == max_time &&
-                   "Lattice is inconsistent (final-prob not at max_time)");
-    }
-  }
-  // First Pass Backward,
-  for (StateId s = num_states-1; s >= 0; s--) {
-    Weight f = lat.Final(s);
-    double this_beta = -(f.Value1() + f.Value2());
-    for (ArcIterator<Lattice> aiter(lat, s); !aiter.Done(); aiter.Next()) {
-      const Arc &arc = aiter.Value();
-      double arc_like = -ConvertToCost(arc.weight),
-          arc_beta = beta[arc.nextstate] + arc_like;
-      this_beta = LogAdd(this_beta, arc_beta);
-    }
-    beta[s] = this_beta;
-  }
-  // First Pass Forward-Backward Check
-  double tot_backward_prob = beta[0];
-  // may loose the condition somehow here 1e-6 (was 1e-8)
-  if (!ApproxEqual(tot_forward_prob, tot_backward_prob, 1e-6)) {
+  LatticeLevelGraph graph(lat);
+  // First Pass Forward-Backward,
+  double tot_forward_prob = graph.ComputeAlphas(false, &alpha),
+      tot_backward_prob = graph.ComputeBetas(false, &beta);
+  if (!ApproxEqual(tot_forward_prob, tot_backward_prob, 1e-8)) {
     KALDI_ERR << "Total forward probability over lattice = " << tot_forward_prob
               << ", while total backward probability = " << tot_backward_prob;
   }
 
-  alpha_smbr[0] = 0.0;
-  // Second Pass Forward, calculate forward for MPFE/SMBR
-  for (StateId s = 0; s < num_states; s++) {
-    double this_alpha = alpha[s];
-    for (ArcIterator<Lattice> aiter(lat, s); !aiter.Done(); aiter.Next()) {
+  // The frame accuracy of each arc, numbered as in LatticeLevelGraph.
+  std::vector<double> frame_acc(graph.NumArcs(), 0.0);
+  for (StateId s = 0, a = 0; s < num_states; s++) {
+    for (ArcIterator<Lattice> aiter(lat, s); !aiter.Done(); aiter.Next(), a++) {
       const Arc &arc = aiter.Value();
-      double arc_like = -ConvertToCost(arc.weight);
-      double frame_acc = 0.0;
       if (arc.ilabel != 0) {
         int32 cur_time = state_times[s];
         int32 phone = trans.TransitionIdToPhone(arc.ilabel),
@@ -754,74 +792,47 @@ BaseFloat LatticeForwardBackwardMpeVariants(
           int32 pdf = trans.TransitionIdToPdf(arc.ilabel),
               ref_pdf = trans.TransitionIdToPdf(num_ali[cur_time]);
           if (!one_silence_class)  // old behavior
-            frame_acc = (pdf == ref_pdf && !phone_is_sil) ? 1.0 : 0.0;
+            frame_acc[a] = (pdf == ref_pdf && !phone_is_sil) ? 1.0 : 0.0;
           else
-            frame_acc = (pdf == ref_pdf || both_sil) ? 1.0 : 0.0;
+            frame_acc[a] = (pdf == ref_pdf || both_sil) ? 1.0 : 0.0;
         } else {
           if (!one_silence_class)  // old behavior
-            frame_acc = (phone == ref_phone && !phone_is_sil) ? 1.0 : 0.0;
+            frame_acc[a] = (phone == ref_phone && !phone_is_sil) ? 1.0 : 0.0;
           else
-            frame_acc = (phone == ref_phone || both_sil) ? 1.0 : 0.0;
+            frame_acc[a] = (phone == ref_phone || both_sil) ? 1.0 : 0.0;
         }
       }
-      double arc_scale = Exp(alpha[s] + arc_like - alpha[arc.nextstate]);
-      alpha_smbr[arc.nextstate] += arc_scale * (alpha_smbr[s] + frame_acc);
     }
+  }
+
+  // Second Pass Forward, calculate forward for MPFE/SMBR
+  graph.ComputeForwardExpectations(alpha, frame_acc, &alpha_smbr);
+  double tot_forward_score = 0;
+  for (StateId s = 0; s < num_states; s++) {
     Weight f = lat.Final(s);
     if (f != Weight::Zero()) {
-      double final_like = this_alpha - (f.Value1() + f.Value2());
+      double final_like = alpha[s] - (f.Value1() + f.Value2());
       double arc_scale = Exp(final_like - tot_forward_prob);
       tot_forward_score += arc_scale * alpha_smbr[s];
       KALDI_ASSERT(state_times[s] == max_time &&
                    "Lattice is inconsistent (final-prob not at max_time)");
     }
   }
-  // Second Pass Backward, collect Mpe style posteriors
-  for (StateId s = num_states-1; s >= 0; s--) {
-    for (ArcIterator<Lattice> aiter(lat, s); !aiter.Done(); aiter.Next()) {
+  // Second Pass Backward, then collect Mpe style posteriors
+  graph.ComputeBackwardExpectations(beta, frame_acc, &beta_smbr);
+  for (StateId s = 0, a = 0; s < num_states; s++) {
+    for (ArcIterator<Lattice> aiter(lat, s); !aiter.Done(); aiter.Next(), a++) {
       const Arc &arc = aiter.Value();
-      double arc_like = -ConvertToCost(arc.weight),
-          arc_beta = beta[arc.nextstate] + arc_like;
-      double frame_acc = 0.0;
       int32 transition_id = arc.ilabel;
-      if (arc.ilabel != 0) {
-        int32 cur_time = state_times[s];
-        int32 phone = trans.TransitionIdToPhone(arc.ilabel),
-            ref_phone = trans.TransitionIdToPhone(num_ali[cur_time]);
-        bool phone_is_sil = std::binary_search(silence_phones.begin(),
-                                               silence_phones.end(), phone),
-            ref_phone_is_sil = std::binary_search(silence_phones.begin(),
-                                                  silence_phones.end(),
-                                                  ref_phone),
-            both_sil = phone_is_sil && ref_phone_is_sil;
-        if (!is_mpfe) { // smbr.
-          int32 pdf = trans.TransitionIdToPdf(arc.ilabel),
-              ref_pdf = trans.TransitionIdToPdf(num_ali[cur_time]);
-          if (!one_silence_class)  // old behavior
-            frame_acc = (pdf == ref_pdf && !phone_is_sil) ? 1.0 : 0.0;
-          else
-            frame_acc = (pdf == ref_pdf || both_sil) ? 1.0 : 0.0;
-        } else {
-          if (!one_silence_class)  // old behavior
-            frame_acc = (phone == ref_phone && !phone_is_sil) ? 1.0 : 0.0;
-          else
-            frame_acc = (phone == ref_phone || both_sil) ? 1.0 : 0.0;
-        }
-      }
-      double arc_scale = Exp(beta[arc.nextstate] + arc_like - beta[s]);
-      // check arc_scale NAN,
-      // this is to prevent partial paths in Lattices
-      // i.e., paths don't survive to the final state
-      if (KALDI_ISNAN(arc_scale)) arc_scale = 0;
-      beta_smbr[s] += arc_scale * (beta_smbr[arc.nextstate] + frame_acc);
-
       if (transition_id != 0) { // Arc has a transition-id on it [not epsilon]
+        double arc_like = -ConvertToCost(arc.weight),
+            arc_beta = beta[arc.nextstate] + arc_like;
         double posterior = exp(alpha[s] + arc_beta - tot_forward_prob);
-        double acc_diff = alpha_smbr[s] + frame_acc + beta_smbr[arc.nextstate]
-                               - tot_forward_score;
+        double acc_diff = alpha_smbr[s] + frame_acc[a]
+            + beta_smbr[arc.nextstate] - tot_forward_score;
         double posterior_smbr = posterior * acc_diff;
         (*post)[state_times[s]].push_back(std::make_pair(transition_id,
-                                                             posterior_smbr));
+                                                         posterior_smbr));
       }
     }
   }
@@ -1394,6 +1405,169 @@ int32 LongestSentenceLength(const CompactLattice &clat) {
   return lattice_max_length;
 }
 
+int32 CompactLatticeOracle(const CompactLattice &clat,
+                           const std::vector<int32> &reference,
+                           const std::vector<int32> &wildcards,
+                           std::vector<int32> *oracle_words,
+                           CompactLattice *oracle_path) {
+  typedef CompactLattice::Arc Arc;
+  typedef Arc::StateId StateId;
+
+  if (clat.Properties(fst::kTopSorted, true) == 0) {
+    CompactLattice clat_copy(clat);
+    if (!TopSort(&clat_copy)) {
+      KALDI_WARN << "Was not able to topologically sort lattice (cycles found?)";
+      return -1;
+    }
+    return CompactLatticeOracle(clat_copy, reference, wildcards,
+                                oracle_words, oracle_path);
+  }
+  if (oracle_words != NULL) oracle_words->clear();
+  if (oracle_path != NULL) oracle_path->DeleteStates();
+  StateId start = clat.Start();
+  if (start == fst::kNoStateId) {
+    KALDI_WARN << "Empty lattice.";
+    return -1;
+  }
+
+  std::vector<int32> sorted_wildcards(wildcards);
+  std::sort(sorted_wildcards.begin(), sorted_wildcards.end());
+  std::vector<int32> ref;
+  for (size_t i = 0; i < reference.size(); i++)
+    if (reference[i] != 0 &&
+        !std::binary_search(sorted_wildcards.begin(), sorted_wildcards.end(),
+                            reference[i]))
+      ref.push_back(reference[i]);
+
+  // Number the arcs, and note which ones are epsilons.
+  int32 num_states = clat.NumStates(), num_arcs = 0;
+  std::vector<int32> arc_begin(num_states + 1);
+  for (StateId s = 0; s < num_states; s++) {
+    arc_begin[s] = num_arcs;
+    num_arcs += clat.NumArcs(s);
+  }
+  arc_begin[num_states] = num_arcs;
+  std::vector<int32> arc_label(num_arcs), arc_source(num_arcs);
+
+  // cost[s * stride + j] is the smallest edit distance between the words on a
+  // path from the start state to s, and the first j words of ref.  back_arc
+  // and back_type say how we got there.
+  enum { kStart = 0, kEpsilon, kInsertion, kSubstitution, kDeletion };
+  const int32 kInfCost = std::numeric_limits<int32>::max(),
+      stride = ref.size() + 1;
+  std::vector<int32> cost(static_cast<size_t>(num_states) * stride, kInfCost),
+      back_arc(static_cast<size_t>(num_states) * stride, -1);
+  std::vector<char> back_type(static_cast<size_t>(num_states) * stride,
+                              kStart);
+  cost[start * stride] = 0;
+
+  int32 best_cost = kInfCost;
+  StateId best_final = fst::kNoStateId;
+  for (StateId s = 0; s < num_states; s++) {
+    int32 *this_cost = &(cost[s * stride]);
+    // All the arcs into s have been processed, so we can do the deletions of
+    // reference words at s.
+    for (int32 j = 1; j < stride; j++) {
+      if (this_cost[j - 1] != kInfCost && this_cost[j - 1] + 1 < this_cost[j]) {
+        this_cost[j] = this_cost[j - 1] + 1;
+        back_type[s * stride + j] = kDeletion;
+      }
+    }
+    int32 a = arc_begin[s];
+    for (fst::ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done();
+         aiter.Next(), a++) {
+      const Arc &arc = aiter.Value();
+      int32 label = arc.ilabel; // note: olabel == ilabel.
+      arc_label[a] = label;
+      arc_source[a] = s;
+      StateId t = arc.nextstate;
+      KALDI_ASSERT(t > s && "CompactLattice has cycles");
+      int32 *next_cost = &(cost[t * stride]);
+      bool is_epsilon = (label == 0 ||
+                         std::binary_search(sorted_wildcards.begin(),
+                                            sorted_wildcards.end(), label));
+      for (int32 j = 0; j < stride; j++) {
+        int32 c = this_cost[j];
+        if (c == kInfCost) continue;
+        if (is_epsilon) {
+          if (c < next_cost[j]) {
+            next_cost[j] = c;
+            back_arc[t * stride + j] = a;
+            back_type[t * stride + j] = kEpsilon;
+          }
+          continue;
+        }
+        if (c + 1 < next_cost[j]) {
+          next_cost[j] = c + 1;
+          back_arc[t * stride + j] = a;
+          back_type[t * stride + j] = kInsertion;
+        }
+        if (j + 1 < stride) {
+          int32 c2 = c + (label == ref[j] ? 0 : 1);
+          if (c2 < next_cost[j + 1]) {
+            next_cost[j + 1] = c2;
+            back_arc[t * stride + j + 1] = a;
+            back_type[t * stride + j + 1] = kSubstitution;
+          }
+        }
+      }
+    }
+    if (clat.Final(s) != CompactLatticeWeight::Zero() &&
+        this_cost[stride - 1] < best_cost) {
+      best_cost = this_cost[stride - 1];
+      best_final = s;
+    }
+  }
+  if (best_final == fst::kNoStateId) {
+    KALDI_WARN << "Lattice has no successful path.";
+    return -1;
+  }
+
+  // Trace back to get the arcs of the oracle path, in reverse order.
+  std::vector<int32> path_arcs;
+  StateId s = best_final;
+  int32 j = stride - 1;
+  while (true) {
+    char type = back_type[s * stride + j];
+    if (type == kStart) break;
+    if (type == kDeletion) {
+      j--;
+      continue;
+    }
+    int32 a = back_arc[s * stride + j];
+    path_arcs.push_back(a);
+    s = arc_source[a];
+    if (type == kSubstitution) j--;
+  }
+  KALDI_ASSERT(s == start && j == 0);
+  std::reverse(path_arcs.begin(), path_arcs.end());
+
+  if (oracle_words != NULL) {
+    for (size_t i = 0; i < path_arcs.size(); i++) {
+      int32 label = arc_label[path_arcs[i]];
+      if (label != 0 &&
+          !std::binary_search(sorted_wildcards.begin(),
+                              sorted_wildcards.end(), label))
+        oracle_words->push_back(label);
+    }
+  }
+  if (oracle_path != NULL) {
+    StateId cur_state = oracle_path->AddState();
+    oracle_path->SetStart(cur_state);
+    for (size_t i = 0; i < path_arcs.size(); i++) {
+      int32 a = path_arcs[i];
+      fst::ArcIterator<CompactLattice> aiter(clat, arc_source[a]);
+      aiter.Seek(a - arc_begin[arc_source[a]]);
+      Arc arc = aiter.Value();
+      arc.nextstate = oracle_path->AddState();
+      oracle_path->AddArc(cur_state, arc);
+      cur_state = arc.nextstate;
+    }
+    oracle_path->SetFinal(cur_state, clat.Final(best_final));
+  }
+  return best_cost;
+}
+
 void ComposeCompactLatticeDeterministic(
     const CompactLattice& clat,
     fst::DeterministicOnDemandFst<fst::StdArc>* det_fst,
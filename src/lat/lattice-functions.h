@@ -118,6 +118,21 @@ void ConvertLatticeToPhones(const TransitionModel &trans_model,
 template<class LatticeType>
 bool PruneLattice(BaseFloat beam, LatticeType *lat);
 
+/// This function does the job of PruneLattice() followed by
+/// CompactLatticeLimitDepth(), in a single forward-backward pass: it prunes
+/// arcs and final-probs outside "beam" of the best path, and, if
+/// max_arcs_per_frame > 0, also removes arcs so that no more than that many
+/// of the arcs that survived the beam cross any frame, keeping the ones on the
+/// best paths.  The arcs are put in buckets indexed by frame, so the time is
+/// about linear in the number of arcs crossing each frame.  It works for Lattice
+/// (where an arc with nonzero ilabel takes one frame) and CompactLattice (where
+/// an arc takes as many frames as its string has transition-ids).  If
+/// max_arcs_per_frame <= 0 the output is the same as PruneLattice().  Returns
+/// true on success, false if the lattice had cycles or the result was empty.
+template<class LatticeType>
+bool PruneLatticeLimitDepth(BaseFloat beam, int32 max_arcs_per_frame,
+                            LatticeType *lat);
+
 
 /// Given a lattice, and a transition model to map pdf-ids to phones,
 /// replace the sequences of transition-ids with sequences of phones.
@@ -254,6 +269,25 @@ int32 LongestSentenceLength(const Lattice &lat);
 /// are identical because it is an acceptor.
 int32 LongestSentenceLength(const CompactLattice &lat);
 
+/// This function finds the "oracle" path through "clat", i.e. the path whose
+/// word sequence has the smallest edit distance (Levenshtein distance) to
+/// "reference".  Epsilons and the words in "wildcards" (which need not be
+/// sorted) are ignored, both on the lattice and in the reference.  Instead of
+/// composing with an edit-distance transducer, as lattice-oracle used to, it
+/// does dynamic programming over (lattice state, reference position) pairs,
+/// visiting the states in topological order; the time taken is proportional
+/// to the number of arcs times the reference length.  It returns the edit
+/// distance, or -1 (with a warning) if clat has no successful path or has
+/// cycles.  If "oracle_words" is non-NULL, it outputs the word sequence of the
+/// oracle path (with epsilons and wildcards removed); if "oracle_path" is
+/// non-NULL, it outputs the oracle path itself, as a linear CompactLattice
+/// with the weights and alignments of the arcs it used.
+int32 CompactLatticeOracle(const CompactLattice &clat,
+                           const std::vector<int32> &reference,
+                           const std::vector<int32> &wildcards,
+                           std::vector<int32> *oracle_words,
+                           CompactLattice *oracle_path);
+
 
 /// This function is like RescoreCompactLattice, but it is modified to avoid
 /// computing probabilities on most frames where all the pdf-ids are the same.
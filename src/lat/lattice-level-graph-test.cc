@@ -0,0 +1,197 @@
+// lat/lattice-level-graph-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+
+#include "lat/kaldi-lattice.h"
+#include "lat/lattice-level-graph.h"
+#include "fstext/rand-fst.h"
+
+
+namespace kaldi {
+using namespace fst;
+
+// Returns a random lattice with "width" states on each of "num_frames" frames
+// plus a start state, with arcs only between adjacent frames, and a few
+// epsilon arcs within each frame.
+Lattice *RandWideLattice(int32 num_frames, int32 width) {
+  Lattice *lat = new Lattice;
+  lat->AddState();
+  lat->SetStart(0);
+  for (int32 t = 0; t < num_frames; t++)
+    for (int32 i = 0; i < width; i++)
+      lat->AddState();
+  for (int32 t = 0; t < num_frames; t++) {
+    for (int32 i = 0; i < width; i++) {
+      int32 s = 1 + t * width + i;
+      int32 num_prev = (t == 0 ? 1 : 1 + Rand() % 3);
+      for (int32 j = 0; j < num_prev; j++) {
+        int32 prev = (t == 0 ? 0 : 1 + (t - 1) * width + Rand() % width);
+        LatticeWeight w(RandUniform(), 10.0 * RandUniform());
+        lat->AddArc(prev, LatticeArc(1 + Rand() % 10, 0, w, s));
+      }
+      if (i > 0 && Rand() % 5 == 0) {  // epsilon arc within the frame.
+        LatticeWeight w(RandUniform(), 0.0);
+        lat->AddArc(s - 1, LatticeArc(0, 0, w, s));
+      }
+      if (t == num_frames - 1)
+        lat->SetFinal(s, LatticeWeight(RandUniform(), 0.0));
+    }
+  }
+  Connect(lat);
+  TopSort(lat);
+  return lat;
+}
+
+Lattice *RandTopSortedLattice() {
+  RandFstOptions opts;
+  opts.acyclic = true;
+  Lattice *lat = fst::RandPairFst<LatticeArc>(opts);
+  Connect(lat);
+  TopSort(lat);
+  return lat;
+}
+
+// The simple state-by-state forward-backward, for comparison.
+template<class LatticeType>
+void ComputeAlphasAndBetasSimple(const LatticeType &lat, bool viterbi,
+                                 std::vector<double> *alpha,
+                                 std::vector<double> *beta,
+                                 double *tot_forward) {
+  typedef typename LatticeType::Arc Arc;
+  int32 num_states = lat.NumStates();
+  alpha->assign(num_states, kLogZeroDouble);
+  beta->assign(num_states, kLogZeroDouble);
+  *tot_forward = kLogZeroDouble;
+  (*alpha)[0] = 0.0;
+  for (int32 s = 0; s < num_states; s++) {
+    for (ArcIterator<LatticeType> aiter(lat, s); !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      double like = (*alpha)[s] - ConvertToCost(arc.weight);
+      (*alpha)[arc.nextstate] = (viterbi ?
+                                 std::max((*alpha)[arc.nextstate], like) :
+                                 LogAdd((*alpha)[arc.nextstate], like));
+    }
+    double final_like = (*alpha)[s] - ConvertToCost(lat.Final(s));
+    *tot_forward = (viterbi ? std::max(*tot_forward, final_like) :
+                    LogAdd(*tot_forward, final_like));
+  }
+  for (int32 s = num_states - 1; s >= 0; s--) {
+    double this_beta = -ConvertToCost(lat.Final(s));
+    for (ArcIterator<LatticeType> aiter(lat, s); !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      double like = (*beta)[arc.nextstate] - ConvertToCost(arc.weight);
+      this_beta = (viterbi ? std::max(this_beta, like) :
+                   LogAdd(this_beta, like));
+    }
+    (*beta)[s] = this_beta;
+  }
+}
+
+void AssertVectorsEqual(const std::vector<double> &a,
+                        const std::vector<double> &b) {
+  KALDI_ASSERT(a.size() == b.size());
+  for (size_t i = 0; i < a.size(); i++)
+    KALDI_ASSERT(a[i] == b[i] ||
+                 std::abs(a[i] - b[i]) <= 1.0e-08 * (1.0 + std::abs(a[i])));
+}
+
+template<class LatticeType>
+void TestLevelGraphAlphasAndBetas(const LatticeType &lat) {
+  if (lat.Start() == kNoStateId) return;  // empty lattice.
+  LatticeLevelGraph graph(lat);
+  KALDI_ASSERT(graph.NumStates() == lat.NumStates() &&
+               graph.NumArcs() == NumArcs(lat));
+  for (int32 i = 0; i < 2; i++) {
+    bool viterbi = (i == 1);
+    std::vector<double> alpha, beta, ref_alpha, ref_beta;
+    double ref_tot;
+    ComputeAlphasAndBetasSimple(lat, viterbi, &ref_alpha, &ref_beta, &ref_tot);
+    double tot_forward = graph.ComputeAlphas(viterbi, &alpha),
+        tot_backward = graph.ComputeBetas(viterbi, &beta);
+    AssertVectorsEqual(alpha, ref_alpha);
+    AssertVectorsEqual(beta, ref_beta);
+    std::vector<double> tot(1, tot_forward), tot2(1, tot_backward),
+        ref(1, ref_tot);
+    AssertVectorsEqual(tot, ref);
+    AssertVectorsEqual(tot2, ref);
+  }
+}
+
+// Tests that the expectations are right, by checking them against the
+// derivative of the total log-likelihood, since the sum of
+// alpha_value[s] + arc_value[a] + beta_value[next] weighted by the arc
+// posteriors is the expected value of the sum of arc values over paths.
+void TestLevelGraphExpectations(const Lattice &lat) {
+  if (lat.Start() == kNoStateId) return;
+  LatticeLevelGraph graph(lat);
+  std::vector<double> alpha, beta, arc_value(graph.NumArcs()),
+      alpha_value, beta_value;
+  for (size_t a = 0; a < arc_value.size(); a++)
+    arc_value[a] = RandUniform();
+  double tot = graph.ComputeAlphas(false, &alpha);
+  graph.ComputeBetas(false, &beta);
+  graph.ComputeForwardExpectations(alpha, arc_value, &alpha_value);
+  graph.ComputeBackwardExpectations(beta, arc_value, &beta_value);
+
+  // The expected value from the forward pass and from the backward pass.
+  double forward_expectation = 0.0;
+  for (int32 s = 0; s < lat.NumStates(); s++)
+    forward_expectation += Exp(alpha[s] - ConvertToCost(lat.Final(s)) - tot) *
+        alpha_value[s];
+  double backward_expectation = beta_value[0];
+  KALDI_ASSERT(ApproxEqual(forward_expectation, backward_expectation, 1.0e-06));
+
+  // The same thing, summed over arcs.
+  double arc_expectation = 0.0;
+  for (int32 s = 0, a = 0; s < lat.NumStates(); s++) {
+    for (ArcIterator<Lattice> aiter(lat, s); !aiter.Done(); aiter.Next(), a++) {
+      const LatticeArc &arc = aiter.Value();
+      double post = Exp(alpha[s] - ConvertToCost(arc.weight) +
+                        beta[arc.nextstate] - tot);
+      arc_expectation += post * arc_value[a];
+    }
+  }
+  KALDI_ASSERT(ApproxEqual(forward_expectation, arc_expectation, 1.0e-06));
+}
+
+void TestLatticeLevelGraph() {
+  Lattice *lat = RandTopSortedLattice();
+  CompactLattice clat;
+  ConvertLattice(*lat, &clat);
+  Connect(&clat);
+  TopSort(&clat);
+  TestLevelGraphAlphasAndBetas(*lat);
+  TestLevelGraphAlphasAndBetas(clat);
+  TestLevelGraphExpectations(*lat);
+  delete lat;
+
+  // The following has many states per level.
+  lat = RandWideLattice(1 + Rand() % 20, 100 + Rand() % 100);
+  TestLevelGraphAlphasAndBetas(*lat);
+  TestLevelGraphExpectations(*lat);
+  delete lat;
+}
+
+} // end namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 20; i++)
+    TestLatticeLevelGraph();
+  KALDI_LOG << "Success.";
+}
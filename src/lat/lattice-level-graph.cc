@@ -0,0 +1,275 @@
+// lat/lattice-level-graph.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "lat/lattice-level-graph.h"
+
+namespace kaldi {
+
+// Returns log(sum_i exp(x[i])), or kLogZeroDouble if n == 0.  This does one
+// exponential per element and a single log, instead of the exp and log1p of
+// each of the n - 1 LogAdd() calls it replaces.
+static inline double LogSumExpOfArray(const double *x, int32 n) {
+  if (n == 0)
+    return kLogZeroDouble;
+  int32 max_i = 0;
+  for (int32 i = 1; i < n; i++)
+    if (x[i] > x[max_i]) max_i = i;
+  double max_x = x[max_i], sum = 0.0;
+  if (max_x == kLogZeroDouble)
+    return kLogZeroDouble;
+  for (int32 i = 0; i < n; i++) {
+    double diff = x[i] - max_x;
+    // As in LogAdd(), we skip terms too small to change the result.
+    if (i != max_i && diff >= kMinLogDiffDouble)
+      sum += Exp(diff);
+  }
+  return (sum == 0.0 ? max_x : max_x + Log1p(sum));
+}
+
+static inline double MaxOfArray(const double *x, int32 n) {
+  double max_x = kLogZeroDouble;
+  for (int32 i = 0; i < n; i++)
+    max_x = std::max(max_x, x[i]);
+  return max_x;
+}
+
+// Replaces each element of x with its exponential.  These feed the MPE/sMBR
+// statistics used in training, so we use the exact Exp().
+static inline void ExpArray(double *x, int32 n) {
+  for (int32 i = 0; i < n; i++)
+    x[i] = Exp(x[i]);
+}
+
+template<class LatticeType>
+LatticeLevelGraph::LatticeLevelGraph(const LatticeType &lat) {
+  typedef typename LatticeType::Arc Arc;
+  typedef typename Arc::StateId StateId;
+
+  StateId num_states = lat.NumStates();
+  KALDI_ASSERT(num_states == 0 || lat.Start() == 0);
+  final_like_.resize(num_states);
+  out_begin_.resize(num_states + 1);
+  in_begin_.resize(num_states + 1, 0);
+
+  // level[s] is the length of the longest path to s.
+  std::vector<int32> level(num_states, 0);
+  int32 num_levels = (num_states > 0 ? 1 : 0);
+  for (StateId s = 0; s < num_states; s++) {
+    out_begin_[s] = like_.size();
+    final_like_[s] = -ConvertToCost(lat.Final(s));
+    for (fst::ArcIterator<LatticeType> aiter(lat, s); !aiter.Done();
+         aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      KALDI_ASSERT(arc.nextstate > s &&
+                   "Lattice is not topologically sorted.");
+      like_.push_back(-ConvertToCost(arc.weight));
+      next_state_.push_back(arc.nextstate);
+      in_begin_[arc.nextstate + 1]++;
+      if (level[s] + 1 > level[arc.nextstate]) {
+        level[arc.nextstate] = level[s] + 1;
+        num_levels = std::max(num_levels, level[s] + 2);
+      }
+    }
+  }
+  int32 num_arcs = like_.size();
+  out_begin_[num_states] = num_arcs;
+
+  for (StateId s = 0; s < num_states; s++)
+    in_begin_[s + 1] += in_begin_[s];
+  in_arc_.resize(num_arcs);
+  prev_state_.resize(num_arcs);
+  in_like_.resize(num_arcs);
+  std::vector<int32> next_in(in_begin_.begin(), in_begin_.end() - 1);
+  for (StateId s = 0; s < num_states; s++) {
+    for (int32 a = out_begin_[s]; a < out_begin_[s + 1]; a++) {
+      int32 i = next_in[next_state_[a]]++;
+      in_arc_[i] = a;
+      prev_state_[i] = s;
+      in_like_[i] = like_[a];
+    }
+  }
+
+  level_begin_.resize(num_levels + 1, 0);
+  for (StateId s = 0; s < num_states; s++)
+    level_begin_[level[s] + 1]++;
+  for (int32 l = 0; l < num_levels; l++)
+    level_begin_[l + 1] += level_begin_[l];
+  level_states_.resize(num_states);
+  std::vector<int32> next_pos(level_begin_.begin(), level_begin_.end() - 1);
+  for (StateId s = 0; s < num_states; s++)
+    level_states_[next_pos[level[s]]++] = s;
+}
+
+// Explicit instantiations for Lattice and CompactLattice.
+template
+LatticeLevelGraph::LatticeLevelGraph(const Lattice &lat);
+template
+LatticeLevelGraph::LatticeLevelGraph(const CompactLattice &lat);
+
+
+void LatticeLevelGraph::RunPass(const PassInfo &info) const {
+  int32 num_levels = NumLevels();
+  bool backward = (info.type == kBeta || info.type == kViterbiBeta ||
+                   info.type == kBackwardExpectation);
+  std::vector<double> buf;
+  for (int32 i = 0; i < num_levels; i++) {
+    int32 level = (backward ? num_levels - 1 - i : i);
+    for (int32 k = level_begin_[level]; k < level_begin_[level + 1]; k++)
+      ProcessState(info, level_states_[k], &buf);
+  }
+}
+
+void LatticeLevelGraph::ProcessState(const PassInfo &info, int32 s,
+                                     std::vector<double> *buf) const {
+  std::vector<double> &output = *(info.output);
+  switch (info.type) {
+    case kAlpha: case kViterbiAlpha: {
+      if (s == 0) {  // the start state.
+        output[s] = 0.0;
+        break;
+      }
+      int32 begin = in_begin_[s], n = in_begin_[s + 1] - begin;
+      if (buf->size() < static_cast<size_t>(n + 1)) buf->resize(n + 1);
+      double *x = &((*buf)[0]);
+      for (int32 i = 0; i < n; i++)
+        x[i] = output[prev_state_[begin + i]] + in_like_[begin + i];
+      output[s] = (info.type == kAlpha ? LogSumExpOfArray(x, n) :
+                   MaxOfArray(x, n));
+      break;
+    }
+    case kBeta: case kViterbiBeta: {
+      int32 begin = out_begin_[s], n = out_begin_[s + 1] - begin;
+      if (buf->size() < static_cast<size_t>(n + 1)) buf->resize(n + 1);
+      double *x = &((*buf)[0]);
+      x[0] = final_like_[s];
+      for (int32 i = 0; i < n; i++)
+        x[i + 1] = output[next_state_[begin + i]] + like_[begin + i];
+      output[s] = (info.type == kBeta ? LogSumExpOfArray(x, n + 1) :
+                   MaxOfArray(x, n + 1));
+      break;
+    }
+    case kForwardExpectation: {
+      const std::vector<double> &alpha = *(info.scores),
+          &arc_value = *(info.arc_value);
+      int32 begin = in_begin_[s], n = in_begin_[s + 1] - begin;
+      if (buf->size() < static_cast<size_t>(n + 1)) buf->resize(n + 1);
+      double *x = &((*buf)[0]), this_alpha = alpha[s], ans = 0.0;
+      for (int32 i = 0; i < n; i++)
+        x[i] = alpha[prev_state_[begin + i]] + in_like_[begin + i] - this_alpha;
+      ExpArray(x, n);
+      for (int32 i = 0; i < n; i++) {
+        double arc_scale = x[i];
+        if (KALDI_ISNAN(arc_scale)) arc_scale = 0.0;
+        ans += arc_scale * (output[prev_state_[begin + i]] +
+                            arc_value[in_arc_[begin + i]]);
+      }
+      output[s] = ans;
+      break;
+    }
+    case kBackwardExpectation: {
+      const std::vector<double> &beta = *(info.scores),
+          &arc_value = *(info.arc_value);
+      int32 begin = out_begin_[s], n = out_begin_[s + 1] - begin;
+      if (buf->size() < static_cast<size_t>(n + 1)) buf->resize(n + 1);
+      double *x = &((*buf)[0]), this_beta = beta[s], ans = 0.0;
+      for (int32 i = 0; i < n; i++)
+        x[i] = beta[next_state_[begin + i]] + like_[begin + i] - this_beta;
+      ExpArray(x, n);
+      for (int32 i = 0; i < n; i++) {
+        // arc_scale is NaN for arcs into states that cannot reach the end.
+        double arc_scale = x[i];
+        if (KALDI_ISNAN(arc_scale)) arc_scale = 0.0;
+        ans += arc_scale * (output[next_state_[begin + i]] +
+                            arc_value[begin + i]);
+      }
+      output[s] = ans;
+      break;
+    }
+    default:
+      KALDI_ERR << "Invalid pass type";
+  }
+}
+
+double LatticeLevelGraph::ComputeAlphas(bool viterbi,
+                                        std::vector<double> *alpha) const {
+  int32 num_states = NumStates();
+  alpha->clear();
+  alpha->resize(num_states, kLogZeroDouble);
+  PassInfo info;
+  info.type = (viterbi ? kViterbiAlpha : kAlpha);
+  info.scores = NULL;
+  info.arc_value = NULL;
+  info.output = alpha;
+  RunPass(info);
+
+  if (num_states == 0)
+    return kLogZeroDouble;
+  std::vector<double> final_terms(num_states);
+  for (int32 s = 0; s < num_states; s++)
+    final_terms[s] = (*alpha)[s] + final_like_[s];
+  return (viterbi ? MaxOfArray(&(final_terms[0]), num_states) :
+          LogSumExpOfArray(&(final_terms[0]), num_states));
+}
+
+double LatticeLevelGraph::ComputeBetas(bool viterbi,
+                                       std::vector<double> *beta) const {
+  int32 num_states = NumStates();
+  beta->clear();
+  beta->resize(num_states, kLogZeroDouble);
+  PassInfo info;
+  info.type = (viterbi ? kViterbiBeta : kBeta);
+  info.scores = NULL;
+  info.arc_value = NULL;
+  info.output = beta;
+  RunPass(info);
+  return (num_states > 0 ? (*beta)[0] : kLogZeroDouble);
+}
+
+void LatticeLevelGraph::ComputeForwardExpectations(
+    const std::vector<double> &alpha,
+    const std::vector<double> &arc_value,
+    std::vector<double> *alpha_value) const {
+  KALDI_ASSERT(static_cast<int32>(alpha.size()) == NumStates() &&
+               static_cast<int32>(arc_value.size()) == NumArcs());
+  alpha_value->clear();
+  alpha_value->resize(NumStates(), 0.0);
+  PassInfo info;
+  info.type = kForwardExpectation;
+  info.scores = &alpha;
+  info.arc_value = &arc_value;
+  info.output = alpha_value;
+  RunPass(info);
+}
+
+void LatticeLevelGraph::ComputeBackwardExpectations(
+    const std::vector<double> &beta,
+    const std::vector<double> &arc_value,
+    std::vector<double> *beta_value) const {
+  KALDI_ASSERT(static_cast<int32>(beta.size()) == NumStates() &&
+               static_cast<int32>(arc_value.size()) == NumArcs());
+  beta_value->clear();
+  beta_value->resize(NumStates(), 0.0);
+  PassInfo info;
+  info.type = kBackwardExpectation;
+  info.scores = &beta;
+  info.arc_value = &arc_value;
+  info.output = beta_value;
+  RunPass(info);
+}
+
+}  // namespace kaldi
@@ -0,0 +1,136 @@
+// lat/lattice-level-graph.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_LAT_LATTICE_LEVEL_GRAPH_H_
+#define KALDI_LAT_LATTICE_LEVEL_GRAPH_H_
+
+#include <vector>
+#include "base/kaldi-common.h"
+#include "lat/kaldi-lattice.h"
+
+namespace kaldi {
+
+/**
+   LatticeLevelGraph is a copy of the arcs of a topologically sorted Lattice or
+   CompactLattice, arranged for a level-synchronous forward-backward.  The
+   states are grouped into levels such that every arc goes from a lower to a
+   strictly higher level (the level of a state is the number of arcs on the
+   longest path to it from the start state).  In a Lattice without epsilon arcs
+   the levels are exactly the frames, as from LatticeStateTimes(); in general
+   there are no more levels than frames plus epsilon arcs on any one path.
+
+   Because no two states in a level are connected, the alphas (or betas) of all
+   the states in a level can be computed independently once the previous (or
+   next) levels are done.  Each state's quantity is computed by "pulling" from
+   its incoming (for alphas) or outgoing (for betas) arcs, whose scores are
+   stored contiguously, and summing them with a single log-sum-exp over the
+   array instead of a chain of scalar LogAdd() calls.
+
+   All quantities are in double precision and are log-likelihoods, i.e. negated
+   costs, as in ComputeCompactLatticeAlphas() and ComputeCompactLatticeBetas().
+   The arcs are numbered 0, 1, ... NumArcs() - 1 in the order in which you get
+   them by iterating over the states in order and over each state's arcs with
+   an ArcIterator; this numbering is used for the "arc_value" arguments below.
+
+   The lattice must be topologically sorted with Start() == 0 (this is checked
+   with KALDI_ASSERT; callers that want a softer failure should check first).
+*/
+class LatticeLevelGraph {
+ public:
+  /// Will work for either Lattice or CompactLattice.
+  template<class LatticeType>
+  explicit LatticeLevelGraph(const LatticeType &lat);
+
+  int32 NumStates() const { return static_cast<int32>(final_like_.size()); }
+  int32 NumArcs() const { return static_cast<int32>(like_.size()); }
+  int32 NumLevels() const {
+    return static_cast<int32>(level_begin_.size()) - 1;
+  }
+
+  /// Computes the alphas (not including final-probs; alpha[0] = 0) and returns
+  /// the total forward log-likelihood, including final-probs.  If viterbi ==
+  /// true they are Viterbi (best-path) quantities.
+  double ComputeAlphas(bool viterbi, std::vector<double> *alpha) const;
+
+  /// Computes the betas (including final-probs) and returns beta[0], which is
+  /// the total backward log-likelihood.
+  double ComputeBetas(bool viterbi, std::vector<double> *beta) const;
+
+  /// Given the alphas from ComputeAlphas(false, ..) and a value on each arc,
+  /// computes for each state the expected sum of arc values on paths from the
+  /// start state to it, i.e. the "alpha" of the expectation semiring divided by
+  /// the normal alpha.  This is the forward pass of MPE/sMBR.
+  void ComputeForwardExpectations(const std::vector<double> &alpha,
+                                  const std::vector<double> &arc_value,
+                                  std::vector<double> *alpha_value) const;
+
+  /// As ComputeForwardExpectations(), but computes the expected sum of arc
+  /// values on paths from each state to the end, given the betas.  As in the
+  /// original MPE code, arcs into states that cannot reach the end contribute
+  /// nothing.
+  void ComputeBackwardExpectations(const std::vector<double> &beta,
+                                   const std::vector<double> &arc_value,
+                                   std::vector<double> *beta_value) const;
+ private:
+  enum PassType { kAlpha, kViterbiAlpha, kBeta, kViterbiBeta,
+                  kForwardExpectation, kBackwardExpectation };
+
+  struct PassInfo {
+    PassType type;
+    const std::vector<double> *scores;  // alphas or betas, for expectations.
+    const std::vector<double> *arc_value;  // for expectations.
+    std::vector<double> *output;
+  };
+
+  // Does the computation for all the states, level by level, in the order
+  // required by info.type.
+  void RunPass(const PassInfo &info) const;
+
+  // Computes the quantity for state s; "buf" is temporary space.
+  void ProcessState(const PassInfo &info, int32 s,
+                    std::vector<double> *buf) const;
+
+  // The states of level l are level_states_[level_begin_[l] ...
+  // level_begin_[l+1] - 1].
+  std::vector<int32> level_states_;
+  std::vector<int32> level_begin_;
+
+  // The arcs leaving state s are numbers out_begin_[s] ... out_begin_[s+1] - 1;
+  // for arc a, like_[a] is its log-likelihood and next_state_[a] its
+  // destination.
+  std::vector<int32> out_begin_;
+  std::vector<int32> next_state_;
+  std::vector<double> like_;
+
+  // The arcs entering state s are in_begin_[s] ... in_begin_[s+1] - 1 of the
+  // following arrays, which give the arc number, the source state and (a copy
+  // of) the arc's log-likelihood.
+  std::vector<int32> in_begin_;
+  std::vector<int32> in_arc_;
+  std::vector<int32> prev_state_;
+  std::vector<double> in_like_;
+
+  // The final log-likelihood of each state (kLogZeroDouble if not final).
+  std::vector<double> final_like_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(LatticeLevelGraph);
+};
+
+}  // namespace kaldi
+
+#endif  // KALDI_LAT_LATTICE_LEVEL_GRAPH_H_
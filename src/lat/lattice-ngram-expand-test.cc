@@ -0,0 +1,148 @@
+// lat/lattice-ngram-expand-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "lat/kaldi-lattice.h"
+#include "lat/lattice-functions.h"
+#include "lat/lattice-ngram-expand.h"
+
+namespace kaldi {
+using namespace fst;
+
+// A bigram "language model" whose states are the previous word, with
+// arbitrary but deterministic costs.
+class TestBigramFst: public DeterministicOnDemandFst<StdArc> {
+ public:
+  TestBigramFst() { GetState(0); }
+  virtual StateId Start() { return 0; }
+  virtual Weight Final(StateId s) { return Weight(0.1 * (words_[s] % 3)); }
+  virtual bool GetArc(StateId s, Label ilabel, StdArc *oarc) {
+    if ((words_[s] + ilabel) % 7 == 0) return false;  // some words disallowed.
+    oarc->ilabel = ilabel;
+    oarc->olabel = ilabel;
+    oarc->weight = Weight(0.5 * ((words_[s] * 7 + ilabel * 13) % 10));
+    oarc->nextstate = GetState(ilabel);
+    return true;
+  }
+ private:
+  StateId GetState(Label word) {
+    unordered_map<Label, StateId>::iterator iter = state_map_.find(word);
+    if (iter != state_map_.end()) return iter->second;
+    StateId ans = words_.size();
+    words_.push_back(word);
+    state_map_[word] = ans;
+    return ans;
+  }
+  std::vector<Label> words_;
+  unordered_map<Label, StateId> state_map_;
+};
+
+// Returns a random CompactLattice with "width" states on each frame, whose
+// arcs have words on about one in three of them.
+CompactLattice *RandCompactLattice(int32 num_frames, int32 width) {
+  Lattice lat;
+  lat.AddState();
+  lat.SetStart(0);
+  for (int32 t = 0; t < num_frames; t++)
+    for (int32 i = 0; i < width; i++)
+      lat.AddState();
+  for (int32 t = 0; t < num_frames; t++) {
+    for (int32 i = 0; i < width; i++) {
+      int32 s = 1 + t * width + i;
+      int32 num_prev = (t == 0 ? 1 : 1 + Rand() % 3);
+      for (int32 j = 0; j < num_prev; j++) {
+        int32 prev = (t == 0 ? 0 : 1 + (t - 1) * width + Rand() % width);
+        LatticeWeight w(RandUniform(), 10.0 * RandUniform());
+        int32 word = (Rand() % 3 == 0 ? 1 + Rand() % 20 : 0);
+        lat.AddArc(prev, LatticeArc(1 + Rand() % 10, word, w, s));
+      }
+      if (t == num_frames - 1)
+        lat.SetFinal(s, LatticeWeight(RandUniform(), 0.0));
+    }
+  }
+  Connect(&lat);
+  Invert(&lat);  // so that the words are on the input side.
+  CompactLattice *clat = new CompactLattice;
+  ConvertLattice(lat, clat);
+  TopSortCompactLatticeIfNeeded(clat);
+  return clat;
+}
+
+double BestCost(const CompactLattice &clat) {
+  CompactLattice best_path;
+  CompactLatticeShortestPath(clat, &best_path);
+  if (best_path.Start() == kNoStateId)
+    return std::numeric_limits<double>::infinity();
+  CompactLatticeWeight w = CompactLatticeWeight::One();
+  for (CompactLatticeArc::StateId s = best_path.Start(); ; ) {
+    if (best_path.Final(s) != CompactLatticeWeight::Zero()) {
+      w = Times(w, best_path.Final(s));
+      break;
+    }
+    ArcIterator<CompactLattice> aiter(best_path, s);
+    w = Times(w, aiter.Value().weight);
+    s = aiter.Value().nextstate;
+  }
+  return w.Weight().Value1() + w.Weight().Value2();
+}
+
+void TestExpandCompactLatticeNgram() {
+  CompactLattice *clat = RandCompactLattice(5 + Rand() % 20, 1 + Rand() % 5);
+
+  // With no pruning we should get the same as
+  // ComposeCompactLatticeDeterministic().
+  {
+    TestBigramFst lm1, lm2;
+    CompactLattice composed1, composed2;
+    ComposeCompactLatticeDeterministic(*clat, &lm1, &composed1);
+    NgramExpandOptions opts;
+    NgramExpandStats stats;
+    bool ans = ExpandCompactLatticeNgram(*clat, &lm2, opts, &composed2,
+                                         &stats);
+    KALDI_ASSERT(ans == (composed1.Start() != kNoStateId));
+    KALDI_ASSERT(composed1.NumStates() == composed2.NumStates());
+    KALDI_ASSERT(stats.num_pruned == 0);
+    if (ans) {
+      KALDI_ASSERT(RandEquivalent(composed1, composed2, 5, 0.01, Rand(), 100));
+      KALDI_ASSERT(ApproxEqual(BestCost(composed1), BestCost(composed2)));
+    }
+  }
+  // With an unweighted "LM" the backward costs we use for pruning are exact,
+  // so pruning should not change the best path.
+  {
+    UnweightedNgramFst<StdArc> lm1(3), lm2(3);
+    CompactLattice composed1, composed2;
+    NgramExpandOptions opts;
+    ExpandCompactLatticeNgram(*clat, &lm1, opts, &composed1);
+    opts.beam = 0.5 + RandUniform();
+    opts.max_histories = (Rand() % 2 == 0 ? 0 : 1 + Rand() % 3);
+    ExpandCompactLatticeNgram(*clat, &lm2, opts, &composed2);
+    KALDI_ASSERT(composed2.NumStates() <= composed1.NumStates());
+    if (opts.max_histories == 0)  // max_histories can prune the best path.
+      KALDI_ASSERT(ApproxEqual(BestCost(composed1), BestCost(composed2)));
+  }
+  delete clat;
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 50; i++)
+    TestExpandCompactLatticeNgram();
+  KALDI_LOG << "Success.";
+}
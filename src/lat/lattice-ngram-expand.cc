@@ -0,0 +1,249 @@
+// lat/lattice-ngram-expand.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <algorithm>
+#include "lat/lattice-ngram-expand.h"
+#include "util/stl-utils.h"
+
+namespace kaldi {
+
+class NgramLatticeExpander {
+ public:
+  typedef CompactLatticeArc::StateId StateId;
+  typedef fst::StdArc::Label Label;
+
+  NgramLatticeExpander(const CompactLattice &clat,
+                       fst::DeterministicOnDemandFst<fst::StdArc> *det_fst,
+                       const NgramExpandOptions &opts,
+                       CompactLattice *composed_clat,
+                       NgramExpandStats *stats):
+      clat_(clat), det_fst_(det_fst), opts_(opts),
+      composed_clat_(composed_clat), stats_(stats) { }
+
+  void Expand() {
+    composed_clat_->DeleteStates();
+    if (clat_.Start() == fst::kNoStateId) return;
+    ComputeTimesAndBetas();
+    if (beta_[lat_->Start()] == std::numeric_limits<double>::infinity())
+      return;  // Nothing reaches a final state.
+
+    int32 num_states = lat_->NumStates();
+    pairs_of_state_.resize(num_states);
+    best_cost_.resize(max_time_ + 1, std::numeric_limits<double>::infinity());
+    StateId start = GetPair(lat_->Start(), det_fst_->Start(), 0.0);
+    composed_clat_->SetStart(start);
+
+    // Visit the lattice states in order of time.  Because the states are
+    // topologically sorted, the predecessors of each state come earlier in
+    // this order, so the forward costs of its pairs are final when we get
+    // to it.
+    std::vector<std::pair<int32, StateId> > order(num_states);
+    for (StateId s = 0; s < num_states; s++)
+      order[s] = std::make_pair(times_[s], s);
+    std::sort(order.begin(), order.end());
+    for (size_t i = 0; i < order.size(); i++)
+      ExpandState(order[i].second);
+
+    fst::Connect(composed_clat_);
+    if (stats_ != NULL) stats_->Add(stats_this_);
+  }
+
+ private:
+  // Works out the time of each state (the number of frames on any path to
+  // it) and the best cost from each state to the end, in beta_.  We make a
+  // topologically sorted copy of the lattice first if needed.
+  void ComputeTimesAndBetas() {
+    if (clat_.Properties(fst::kTopSorted, true) == 0) {
+      sorted_clat_ = clat_;
+      if (!TopSort(&sorted_clat_))
+        KALDI_ERR << "Cycles detected in lattice.";
+      lat_ = &sorted_clat_;
+    } else {
+      lat_ = &clat_;
+    }
+    int32 num_states = lat_->NumStates();
+    times_.assign(num_states, 0);
+    max_time_ = 0;
+    for (StateId s = 0; s < num_states; s++) {
+      for (fst::ArcIterator<CompactLattice> aiter(*lat_, s); !aiter.Done();
+           aiter.Next()) {
+        const CompactLatticeArc &arc = aiter.Value();
+        int32 t = times_[s] + arc.weight.String().size();
+        // Lattices are normally consistent in the times; if not, we take
+        // the maximum, which only affects which frame the pruning uses.
+        if (t > times_[arc.nextstate]) times_[arc.nextstate] = t;
+        max_time_ = std::max(max_time_, t);
+      }
+    }
+    beta_.resize(num_states);
+    for (StateId s = num_states - 1; s >= 0; s--) {
+      const LatticeWeight &final = lat_->Final(s).Weight();
+      double beta = final.Value1() + final.Value2();
+      for (fst::ArcIterator<CompactLattice> aiter(*lat_, s); !aiter.Done();
+           aiter.Next()) {
+        const CompactLatticeArc &arc = aiter.Value();
+        const LatticeWeight &w = arc.weight.Weight();
+        beta = std::min(beta, w.Value1() + w.Value2() + beta_[arc.nextstate]);
+      }
+      beta_[s] = beta;
+    }
+  }
+
+  // Returns the output state for the pair (s1, s2), creating it if
+  // necessary, and updates its forward cost with "alpha".
+  StateId GetPair(StateId s1, StateId s2, double alpha) {
+    uint64 key = (static_cast<uint64>(s1) << 32) | static_cast<uint32>(s2);
+    std::pair<PairMap::iterator, bool> ret =
+        pair_map_.insert(std::make_pair(key, static_cast<StateId>(0)));
+    StateId ans;
+    if (ret.second) {
+      ans = composed_clat_->AddState();
+      ret.first->second = ans;
+      pair_lm_state_.push_back(s2);
+      alpha_.push_back(alpha);
+      pairs_of_state_[s1].push_back(ans);
+      stats_this_.num_pairs++;
+    } else {
+      ans = ret.first->second;
+      if (alpha < alpha_[ans]) alpha_[ans] = alpha;
+    }
+    double tot = alpha_[ans] + beta_[s1];
+    if (tot < best_cost_[times_[s1]]) best_cost_[times_[s1]] = tot;
+    return ans;
+  }
+
+  // Looks up the LM arc for "word" from LM-state s2, using the cache.
+  bool GetLmArc(StateId s2, Label word, fst::StdArc *arc) {
+    uint64 key = (static_cast<uint64>(static_cast<uint32>(s2)) << 32) |
+        static_cast<uint32>(word);
+    LmArcMap::iterator iter = lm_arcs_.find(key);
+    if (iter != lm_arcs_.end()) {
+      *arc = iter->second;
+      return (arc->nextstate != fst::kNoStateId);
+    }
+    stats_this_.num_lm_lookups++;
+    if (!det_fst_->GetArc(s2, word, arc))
+      arc->nextstate = fst::kNoStateId;
+    lm_arcs_[key] = *arc;
+    return (arc->nextstate != fst::kNoStateId);
+  }
+
+  struct AlphaLess {
+    explicit AlphaLess(const std::vector<double> &alpha): alpha_(alpha) { }
+    bool operator () (StateId a, StateId b) const {
+      return alpha_[a] < alpha_[b];
+    }
+    const std::vector<double> &alpha_;
+  };
+
+  void ExpandState(StateId s1) {
+    std::vector<StateId> &pairs = pairs_of_state_[s1];
+    if (pairs.empty()) return;
+    if (opts_.max_histories > 0 &&
+        pairs.size() > static_cast<size_t>(opts_.max_histories)) {
+      std::nth_element(pairs.begin(), pairs.begin() + opts_.max_histories,
+                       pairs.end(), AlphaLess(alpha_));
+      stats_this_.num_pruned += pairs.size() - opts_.max_histories;
+      pairs.resize(opts_.max_histories);
+    }
+    double cutoff = best_cost_[times_[s1]] + opts_.beam;
+    const CompactLatticeWeight &final1 = lat_->Final(s1);
+    for (size_t i = 0; i < pairs.size(); i++) {
+      StateId s = pairs[i], s2 = pair_lm_state_[s];
+      double alpha = alpha_[s];
+      if (alpha + beta_[s1] > cutoff) {
+        stats_this_.num_pruned++;
+        continue;
+      }
+      if (final1 != CompactLatticeWeight::Zero()) {
+        float lm_final = det_fst_->Final(s2).Value();
+        if (lm_final != std::numeric_limits<float>::infinity())
+          composed_clat_->SetFinal(
+              s, CompactLatticeWeight(
+                  LatticeWeight(final1.Weight().Value1() + lm_final,
+                                final1.Weight().Value2()),
+                  final1.String()));
+      }
+      for (fst::ArcIterator<CompactLattice> aiter(*lat_, s1); !aiter.Done();
+           aiter.Next()) {
+        const CompactLatticeArc &arc1 = aiter.Value();
+        const LatticeWeight &w1 = arc1.weight.Weight();
+        if (arc1.olabel == 0) {
+          StateId next = GetPair(arc1.nextstate, s2,
+                                 alpha + w1.Value1() + w1.Value2());
+          composed_clat_->AddArc(s, CompactLatticeArc(arc1.ilabel, 0,
+                                                      arc1.weight, next));
+        } else {
+          fst::StdArc arc2;
+          if (!GetLmArc(s2, arc1.olabel, &arc2)) continue;
+          BaseFloat lm_cost = arc2.weight.Value();
+          StateId next = GetPair(arc1.nextstate, arc2.nextstate,
+                                 alpha + w1.Value1() + w1.Value2() + lm_cost);
+          CompactLatticeWeight weight(
+              LatticeWeight(w1.Value1() + lm_cost, w1.Value2()),
+              arc1.weight.String());
+          composed_clat_->AddArc(s, CompactLatticeArc(arc1.ilabel,
+                                                      arc1.olabel,
+                                                      weight, next));
+        }
+      }
+    }
+    // We won't need this any more.
+    std::vector<StateId>().swap(pairs);
+  }
+
+  typedef unordered_map<uint64, StateId> PairMap;
+  typedef unordered_map<uint64, fst::StdArc> LmArcMap;
+
+  const CompactLattice &clat_;
+  const CompactLattice *lat_;  // &clat_ or &sorted_clat_.
+  CompactLattice sorted_clat_;  // used if clat_ was not topologically sorted.
+  fst::DeterministicOnDemandFst<fst::StdArc> *det_fst_;
+  const NgramExpandOptions &opts_;
+  CompactLattice *composed_clat_;
+  NgramExpandStats *stats_;
+  NgramExpandStats stats_this_;
+
+  std::vector<int32> times_;  // indexed by lattice state.
+  int32 max_time_;
+  std::vector<double> beta_;  // indexed by lattice state.
+  std::vector<double> best_cost_;  // indexed by time: best forward plus
+                                   // backward cost of any pair so far.
+  std::vector<std::vector<StateId> > pairs_of_state_;  // indexed by lattice
+                                                       // state.
+  PairMap pair_map_;  // (lattice-state, LM-state) -> output state.
+  std::vector<StateId> pair_lm_state_;  // indexed by output state.
+  std::vector<double> alpha_;  // forward cost, indexed by output state.
+  LmArcMap lm_arcs_;  // (LM-state, word) -> LM arc; nextstate is kNoStateId
+                      // if there was no arc.
+};
+
+
+bool ExpandCompactLatticeNgram(
+    const CompactLattice &clat,
+    fst::DeterministicOnDemandFst<fst::StdArc> *det_fst,
+    const NgramExpandOptions &opts,
+    CompactLattice *composed_clat,
+    NgramExpandStats *stats) {
+  KALDI_ASSERT(opts.beam > 0.0 && opts.max_histories >= 0);
+  NgramLatticeExpander expander(clat, det_fst, opts, composed_clat, stats);
+  expander.Expand();
+  return (composed_clat->Start() != fst::kNoStateId);
+}
+
+}  // namespace kaldi
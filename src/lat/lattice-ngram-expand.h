@@ -0,0 +1,104 @@
+// lat/lattice-ngram-expand.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+
+#ifndef KALDI_LAT_LATTICE_NGRAM_EXPAND_H_
+#define KALDI_LAT_LATTICE_NGRAM_EXPAND_H_
+
+#include <limits>
+#include "base/kaldi-common.h"
+#include "itf/options-itf.h"
+#include "fstext/deterministic-fst.h"
+#include "lat/kaldi-lattice.h"
+
+namespace kaldi {
+
+/**
+   This header contains a version of ComposeCompactLatticeDeterministic() that
+   is intended for rescoring with high-order n-gram (or other
+   history-dependent) language models, where the exact composition can be
+   many times the size of the input lattice.
+
+   The states of the output are pairs (lattice-state, LM-state), where the
+   LM-state is the integer state-id of the DeterministicOnDemandFst, which
+   represents the word history (ConstArpaLmDeterministicFst, for instance,
+   truncates each history to the longest one the LM has a state for, so
+   histories that the LM would treat in the same way are merged).  We visit the
+   lattice states in order of time, and we don't expand a pair if its forward
+   cost, plus the best backward cost of its lattice-state in the input lattice,
+   is more than "beam" worse than the best such total for a pair on the same
+   frame; this is a forward-backward beam, and since the backward costs do not
+   include the new LM it may prune paths that the new LM would make the best.
+   If max_histories > 0, we only expand the best max_histories pairs for each
+   lattice-state.  With the default options this gives the same result as
+   ComposeCompactLatticeDeterministic().
+
+   The LM arcs are cached inside the function, since the same (LM-state, word)
+   pair is typically looked up from many lattice states.
+*/
+
+struct NgramExpandOptions {
+  BaseFloat beam;
+  int32 max_histories;
+
+  NgramExpandOptions(): beam(std::numeric_limits<BaseFloat>::infinity()),
+                        max_histories(0) { }
+
+  void Register(OptionsItf *po) {
+    po->Register("expand-beam", &beam, "Pruning beam used while expanding the "
+                 "lattice with the language model: (lattice-state, LM-history) "
+                 "pairs whose forward cost plus the backward cost of the "
+                 "lattice-state is more than this much worse than the best on "
+                 "the same frame are not expanded.  Costs are after any "
+                 "scaling of the lattice.  Default is no pruning.");
+    po->Register("max-histories", &max_histories, "If >0, the maximum number "
+                 "of distinct LM histories expanded for each lattice state "
+                 "(those with the best forward costs are kept).");
+  }
+};
+
+struct NgramExpandStats {
+  int64 num_pairs;  // Number of (lattice-state, LM-state) pairs created.
+  int64 num_pruned;  // Number of pairs not expanded due to the beam or
+                     // max_histories.
+  int64 num_lm_lookups;  // Number of calls to GetArc() of the LM.
+  NgramExpandStats(): num_pairs(0), num_pruned(0), num_lm_lookups(0) { }
+  void Add(const NgramExpandStats &other) {
+    num_pairs += other.num_pairs;
+    num_pruned += other.num_pruned;
+    num_lm_lookups += other.num_lm_lookups;
+  }
+};
+
+/// Composes the CompactLattice "clat" with "det_fst", matching the output
+/// labels (words) of "clat" with the input labels of "det_fst", and adds the
+/// LM costs to the graph part of the weights, as
+/// ComposeCompactLatticeDeterministic() does; but prunes as described above.
+/// "clat" need not be topologically sorted.  The output is connected.  If
+/// "stats" is non-NULL, it adds statistics to it.  Returns false if the output
+/// is empty.
+bool ExpandCompactLatticeNgram(
+    const CompactLattice &clat,
+    fst::DeterministicOnDemandFst<fst::StdArc> *det_fst,
+    const NgramExpandOptions &opts,
+    CompactLattice *composed_clat,
+    NgramExpandStats *stats = NULL);
+
+}  // namespace kaldi
+
+#endif  // KALDI_LAT_LATTICE_NGRAM_EXPAND_H_
@@ -0,0 +1,196 @@
+// lat/nbest-rescore-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "lat/kaldi-lattice.h"
+#include "lat/lattice-functions.h"
+#include "lat/nbest-rescore.h"
+
+namespace kaldi {
+using namespace fst;
+
+// A bigram "language model" whose states are the previous word, with
+// arbitrary but deterministic costs.
+class TestBigramFst: public DeterministicOnDemandFst<StdArc> {
+ public:
+  TestBigramFst() { GetState(0); }
+  virtual StateId Start() { return 0; }
+  virtual Weight Final(StateId s) { return Weight(0.1 * (words_[s] % 3)); }
+  virtual bool GetArc(StateId s, Label ilabel, StdArc *oarc) {
+    if ((words_[s] + ilabel) % 7 == 0) return false;  // some words disallowed.
+    oarc->ilabel = ilabel;
+    oarc->olabel = ilabel;
+    oarc->weight = Weight(0.5 * ((words_[s] * 7 + ilabel * 13) % 10));
+    oarc->nextstate = GetState(ilabel);
+    return true;
+  }
+ private:
+  StateId GetState(Label word) {
+    unordered_map<Label, StateId>::iterator iter = state_map_.find(word);
+    if (iter != state_map_.end()) return iter->second;
+    StateId ans = words_.size();
+    words_.push_back(word);
+    state_map_[word] = ans;
+    return ans;
+  }
+  std::vector<Label> words_;
+  unordered_map<Label, StateId> state_map_;
+};
+
+// Returns a random CompactLattice with "width" states on each frame, whose
+// arcs have words on about one in three of them.
+CompactLattice *RandCompactLattice(int32 num_frames, int32 width) {
+  Lattice lat;
+  lat.AddState();
+  lat.SetStart(0);
+  for (int32 t = 0; t < num_frames; t++)
+    for (int32 i = 0; i < width; i++)
+      lat.AddState();
+  for (int32 t = 0; t < num_frames; t++) {
+    for (int32 i = 0; i < width; i++) {
+      int32 s = 1 + t * width + i;
+      int32 num_prev = (t == 0 ? 1 : 1 + Rand() % 3);
+      for (int32 j = 0; j < num_prev; j++) {
+        int32 prev = (t == 0 ? 0 : 1 + (t - 1) * width + Rand() % width);
+        LatticeWeight w(RandUniform(), 10.0 * RandUniform());
+        int32 word = (Rand() % 3 == 0 ? 1 + Rand() % 20 : 0);
+        lat.AddArc(prev, LatticeArc(1 + Rand() % 10, word, w, s));
+      }
+      if (t == num_frames - 1)
+        lat.SetFinal(s, LatticeWeight(RandUniform(), 0.0));
+    }
+  }
+  Connect(&lat);
+  Invert(&lat);  // so that the words are on the input side.
+  CompactLattice *clat = new CompactLattice;
+  ConvertLattice(lat, clat);
+  TopSortCompactLatticeIfNeeded(clat);
+  return clat;
+}
+
+double BestCost(const CompactLattice &clat) {
+  CompactLattice best_path;
+  CompactLatticeShortestPath(clat, &best_path);
+  if (best_path.Start() == kNoStateId)
+    return std::numeric_limits<double>::infinity();
+  CompactLatticeWeight w = CompactLatticeWeight::One();
+  for (CompactLatticeArc::StateId s = best_path.Start(); ; ) {
+    if (best_path.Final(s) != CompactLatticeWeight::Zero()) {
+      w = Times(w, best_path.Final(s));
+      break;
+    }
+    ArcIterator<CompactLattice> aiter(best_path, s);
+    w = Times(w, aiter.Value().weight);
+    s = aiter.Value().nextstate;
+  }
+  return w.Weight().Value1() + w.Weight().Value2();
+}
+
+// Scores a word sequence one word at a time, for comparison.
+double ScoreSequence(DeterministicOnDemandFst<StdArc> *lm,
+                     const std::vector<int32> &words) {
+  StdArc::StateId s = lm->Start();
+  double cost = 0.0;
+  for (size_t i = 0; i < words.size(); i++) {
+    StdArc arc;
+    if (!lm->GetArc(s, words[i], &arc))
+      return std::numeric_limits<double>::infinity();
+    cost += arc.weight.Value();
+    s = arc.nextstate;
+  }
+  return cost + lm->Final(s).Value();
+}
+
+void TestScoreSequences() {
+  int32 num_seqs = 1 + Rand() % 50;
+  std::vector<std::vector<int32> > word_seqs(num_seqs);
+  for (int32 i = 0; i < num_seqs; i++) {
+    if (i > 0 && Rand() % 2 == 0)  // share a prefix with an earlier sequence.
+      word_seqs[i] = word_seqs[Rand() % i];
+    word_seqs[i].resize(Rand() % (1 + word_seqs[i].size() + 5));
+    for (size_t j = 0; j < word_seqs[i].size(); j++)
+      if (word_seqs[i][j] == 0 || Rand() % 4 == 0)
+        word_seqs[i][j] = 1 + Rand() % 10;
+  }
+  TestBigramFst lm_ref;
+  std::vector<double> ref_costs(num_seqs);
+  for (int32 i = 0; i < num_seqs; i++)
+    ref_costs[i] = ScoreSequence(&lm_ref, word_seqs[i]);
+
+  int32 batch_sizes[] = { 1, 3, 1024 };
+  for (int32 b = 0; b < 3; b++) {
+    TestBigramFst lm;
+    DeterministicFstSentenceScorer scorer(&lm);
+    NbestRescoreOptions opts;
+    opts.batch_size = batch_sizes[b];
+    NbestRescorer rescorer(opts, &scorer);
+    std::vector<double> costs;
+    rescorer.ScoreSequences(word_seqs, &costs);
+    KALDI_ASSERT(costs.size() == ref_costs.size());
+    for (int32 i = 0; i < num_seqs; i++)
+      KALDI_ASSERT(costs[i] == ref_costs[i] ||
+                   ApproxEqual(costs[i], ref_costs[i]));
+    const NbestRescoreStats &stats = rescorer.Stats();
+    KALDI_ASSERT(stats.num_hyps == num_seqs);
+    KALDI_ASSERT(stats.num_scored <= stats.num_prefixes &&
+                 stats.num_prefixes <= stats.num_words);
+  }
+}
+
+void TestRescore() {
+  CompactLattice *clat = RandCompactLattice(2 + Rand() % 5, 1 + Rand() % 2);
+  NbestRescoreOptions opts;
+  opts.n = 100000;  // more than the number of paths, so we get them all.
+
+  // With a zero LM scale the best path should not change.
+  {
+    TestBigramFst lm;
+    DeterministicFstSentenceScorer scorer(&lm);
+    opts.lm_scale = 0.0;
+    NbestRescorer rescorer(opts, &scorer);
+    CompactLattice nbest;
+    if (rescorer.Rescore(*clat, &nbest))
+      KALDI_ASSERT(ApproxEqual(BestCost(*clat), BestCost(nbest)));
+  }
+  // Since we rescore all the paths, the best path should be the same as
+  // that of the composition with the LM.
+  {
+    TestBigramFst lm1, lm2;
+    CompactLattice composed;
+    ComposeCompactLatticeDeterministic(*clat, &lm1, &composed);
+    DeterministicFstSentenceScorer scorer(&lm2);
+    opts.lm_scale = 1.0;
+    NbestRescorer rescorer(opts, &scorer);
+    CompactLattice nbest;
+    bool ans = rescorer.Rescore(*clat, &nbest);
+    KALDI_ASSERT(ans == (composed.Start() != kNoStateId));
+    if (ans)
+      KALDI_ASSERT(ApproxEqual(BestCost(composed), BestCost(nbest)));
+  }
+  delete clat;
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 50; i++) {
+    TestScoreSequences();
+    TestRescore();
+  }
+  KALDI_LOG << "Success.";
+}
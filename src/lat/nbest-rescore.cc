@@ -0,0 +1,221 @@
+// lat/nbest-rescore.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <algorithm>
+#include <limits>
+#include "lat/nbest-rescore.h"
+#include "fstext/fstext-utils.h"
+#include "fstext/lattice-utils.h"
+
+namespace kaldi {
+
+void NbestRescoreStats::Print() const {
+  KALDI_LOG << "Rescored " << num_hyps << " hypotheses with " << num_words
+            << " words (including end of sentence); " << num_prefixes
+            << " distinct prefixes, of which " << num_scored
+            << " were sent to the scorer in " << num_batches << " batches.";
+}
+
+void DeterministicFstSentenceScorer::ScoreBatch(
+    const std::vector<int32> &states,
+    const std::vector<int32> &words,
+    std::vector<BaseFloat> *costs,
+    std::vector<int32> *next_states) {
+  KALDI_ASSERT(states.size() == words.size());
+  costs->resize(words.size());
+  next_states->resize(words.size());
+  for (size_t i = 0; i < words.size(); i++) {
+    if (words[i] == 0) {
+      (*costs)[i] = det_fst_->Final(states[i]).Value();
+      (*next_states)[i] = -1;
+    } else {
+      fst::StdArc arc;
+      if (det_fst_->GetArc(states[i], words[i], &arc)) {
+        (*costs)[i] = arc.weight.Value();
+        (*next_states)[i] = arc.nextstate;
+      } else {
+        (*costs)[i] = std::numeric_limits<BaseFloat>::infinity();
+        (*next_states)[i] = -1;
+      }
+    }
+  }
+}
+
+void NbestRescorer::FlushPending() {
+  if (pending_.empty()) return;
+  std::vector<int32> states(pending_.size()), words(pending_.size());
+  for (size_t i = 0; i < pending_.size(); i++) {
+    states[i] = pending_[i].first;
+    words[i] = pending_[i].second;
+  }
+  std::vector<BaseFloat> costs;
+  std::vector<int32> next_states;
+  scorer_->ScoreBatch(states, words, &costs, &next_states);
+  KALDI_ASSERT(costs.size() == pending_.size() &&
+               next_states.size() == pending_.size());
+  for (size_t i = 0; i < pending_.size(); i++)
+    cache_[pending_[i]] = CostStatePair(costs[i], next_states[i]);
+  stats_.num_scored += pending_.size();
+  stats_.num_batches++;
+  pending_.clear();
+}
+
+void NbestRescorer::ScoreNodes(const std::vector<int32> &nodes) {
+  for (size_t i = 0; i < nodes.size(); i++) {
+    const TrieNode &node = trie_[nodes[i]];
+    int32 parent_state = trie_[node.parent].state;
+    if (parent_state == -1) continue;  // The prefix is not allowed.
+    StateWordPair key(parent_state, node.word);
+    if (cache_.find(key) == cache_.end()) {
+      // Insert a placeholder so we don't request the same pair twice;
+      // FlushPending() will overwrite it.
+      cache_[key] = CostStatePair(0.0, -1);
+      pending_.push_back(key);
+      if (static_cast<int32>(pending_.size()) >= opts_.batch_size)
+        FlushPending();
+    }
+  }
+  FlushPending();
+
+  const double inf = std::numeric_limits<double>::infinity();
+  for (size_t i = 0; i < nodes.size(); i++) {
+    TrieNode &node = trie_[nodes[i]];
+    const TrieNode &parent = trie_[node.parent];
+    if (parent.state == -1) {
+      node.cost = inf;
+      continue;
+    }
+    const CostStatePair &result =
+        cache_[StateWordPair(parent.state, node.word)];
+    node.cost = parent.cost + result.first;
+    node.state = (node.cost == inf ? -1 : result.second);
+  }
+}
+
+void NbestRescorer::ScoreSequences(
+    const std::vector<std::vector<int32> > &word_seqs,
+    std::vector<double> *costs) {
+  trie_.clear();
+  trie_.push_back(TrieNode(-1, -1));
+  trie_[0].state = scorer_->Start();
+
+  // Build the prefix trie, remembering the nodes at each depth and the node
+  // at which each sequence ends (its end-of-sentence node).
+  typedef unordered_map<std::pair<int32, int32>, int32,
+                        PairHasher<int32> > ChildMapType;
+  ChildMapType children;
+  std::vector<std::vector<int32> > nodes_at_depth;
+  std::vector<int32> end_nodes(word_seqs.size());
+  for (size_t i = 0; i < word_seqs.size(); i++) {
+    const std::vector<int32> &words = word_seqs[i];
+    int32 node = 0;
+    for (size_t j = 0; j <= words.size(); j++) {
+      int32 word = (j < words.size() ? words[j] : 0);
+      if (j < words.size() && word <= 0)
+        KALDI_ERR << "Invalid word " << word << " in word sequence.";
+      std::pair<int32, int32> key(node, word);
+      ChildMapType::iterator iter = children.find(key);
+      if (iter != children.end()) {
+        node = iter->second;
+      } else {
+        int32 child = trie_.size();
+        trie_.push_back(TrieNode(node, word));
+        children[key] = child;
+        if (nodes_at_depth.size() <= j)
+          nodes_at_depth.resize(j + 1);
+        nodes_at_depth[j].push_back(child);
+        node = child;
+      }
+    }
+    end_nodes[i] = node;
+    stats_.num_words += words.size() + 1;
+  }
+  stats_.num_hyps += word_seqs.size();
+  stats_.num_prefixes += trie_.size() - 1;
+
+  for (size_t d = 0; d < nodes_at_depth.size(); d++)
+    ScoreNodes(nodes_at_depth[d]);
+
+  costs->resize(word_seqs.size());
+  for (size_t i = 0; i < word_seqs.size(); i++)
+    (*costs)[i] = trie_[end_nodes[i]].cost;
+
+  trie_.clear();
+  cache_.clear();
+  scorer_->Reset();
+}
+
+bool NbestRescorer::Rescore(const CompactLattice &clat,
+                            CompactLattice *nbest) {
+  std::vector<Lattice> paths;
+  {
+    Lattice lat;
+    ConvertLattice(clat, &lat);
+    fst::ScaleLattice(fst::AcousticLatticeScale(opts_.acoustic_scale), &lat);
+    Lattice nbest_lat;
+    fst::ShortestPath(lat, &nbest_lat, opts_.n);
+    fst::ConvertNbestToVector(nbest_lat, &paths);
+  }
+
+  std::vector<std::vector<int32> > word_seqs(paths.size());
+  std::vector<LatticeWeight> weights(paths.size());
+  for (size_t i = 0; i < paths.size(); i++) {
+    fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / opts_.acoustic_scale),
+                      &(paths[i]));
+    if (!fst::GetLinearSymbolSequence<LatticeArc, int32>(
+            paths[i], NULL, &(word_seqs[i]), &(weights[i])))
+      KALDI_ERR << "N-best path is not linear.";  // Should not happen.
+  }
+
+  std::vector<double> lm_costs;
+  ScoreSequences(word_seqs, &lm_costs);
+
+  // Pairs of (new total cost, index of path), sorted best first.
+  std::vector<std::pair<double, int32> > ranked;
+  for (size_t i = 0; i < paths.size(); i++) {
+    if (lm_costs[i] == std::numeric_limits<double>::infinity()) continue;
+    double tot_cost = weights[i].Value1() + opts_.lm_scale * lm_costs[i] +
+        opts_.acoustic_scale * weights[i].Value2();
+    ranked.push_back(std::make_pair(tot_cost, static_cast<int32>(i)));
+  }
+  std::sort(ranked.begin(), ranked.end());
+
+  Lattice out;
+  LatticeArc::StateId start = out.AddState();
+  out.SetStart(start);
+  for (size_t r = 0; r < ranked.size(); r++) {
+    int32 i = ranked[r].second;
+    const Lattice &path = paths[i];
+    LatticeWeight extra(opts_.lm_scale * lm_costs[i], 0.0);
+    LatticeArc::StateId in_state = path.Start(), out_state = start;
+    while (path.NumArcs(in_state) != 0) {
+      LatticeArc arc = fst::ArcIterator<Lattice>(path, in_state).Value();
+      LatticeArc::StateId next_state = out.AddState();
+      out.AddArc(out_state, LatticeArc(arc.ilabel, arc.olabel, arc.weight,
+                                       next_state));
+      out_state = next_state;
+      in_state = arc.nextstate;
+    }
+    out.SetFinal(out_state, fst::Plus(out.Final(out_state),
+                                      fst::Times(path.Final(in_state), extra)));
+  }
+  ConvertLattice(out, nbest);
+  return !ranked.empty();
+}
+
+}  // namespace kaldi
@@ -0,0 +1,176 @@
+// lat/nbest-rescore.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_LAT_NBEST_RESCORE_H_
+#define KALDI_LAT_NBEST_RESCORE_H_
+
+#include <utility>
+#include <vector>
+#include "base/kaldi-common.h"
+#include "itf/options-itf.h"
+#include "itf/sentence-scorer-itf.h"
+#include "fstext/deterministic-fst.h"
+#include "lat/kaldi-lattice.h"
+#include "util/stl-utils.h"
+
+namespace kaldi {
+
+/**
+   This header contains code for rescoring N-best lists with models that are
+   too expensive (or too long-span) to be applied to the lattice by
+   composition, through the batched SentenceScorerInterface.
+
+   The word sequences of the N-best paths are stored in a prefix trie (with
+   the end of sentence as a final "word" zero), so each distinct prefix is
+   scored only once however many hypotheses share it, and the trie is scored
+   one depth at a time, so that each call to the scorer contains all the
+   words at that depth (up to --batch-size of them).  Within an utterance we
+   also cache the result for each (scorer-state, word) pair, which saves
+   scoring the same word again when different prefixes lead to the same state
+   (as happens with n-gram models, whose states only remember the last few
+   words).
+*/
+
+struct NbestRescoreOptions {
+  int32 n;
+  BaseFloat acoustic_scale;
+  BaseFloat lm_scale;
+  int32 batch_size;
+
+  NbestRescoreOptions(): n(100), acoustic_scale(1.0), lm_scale(1.0),
+                         batch_size(1024) { }
+
+  void Register(OptionsItf *po) {
+    po->Register("n", &n, "Number of distinct paths to rescore for each "
+                 "lattice.");
+    po->Register("acoustic-scale", &acoustic_scale, "Scaling factor for "
+                 "acoustic likelihoods, used in working out the N-best paths "
+                 "and in ranking them (the output costs are not scaled).");
+    po->Register("lm-scale", &lm_scale, "Scaling factor applied to the new "
+                 "model's costs before adding them to the graph costs; "
+                 "frequently 1.0 or -1.0");
+    po->Register("batch-size", &batch_size, "Maximum number of words sent to "
+                 "the scorer in one batch.");
+  }
+  void Check() const {
+    KALDI_ASSERT(n > 0 && acoustic_scale != 0.0 && batch_size > 0);
+  }
+};
+
+struct NbestRescoreStats {
+  int64 num_hyps;  // Number of N-best paths rescored.
+  int64 num_words;  // Total number of words (including end of sentence)
+                    // in those paths.
+  int64 num_prefixes;  // Number of nodes in the prefix tries, which is the
+                       // number of words we'd score without caching.
+  int64 num_scored;  // Number of words actually sent to the scorer.
+  int64 num_batches;  // Number of calls to ScoreBatch().
+  NbestRescoreStats(): num_hyps(0), num_words(0), num_prefixes(0),
+                       num_scored(0), num_batches(0) { }
+  void Add(const NbestRescoreStats &other) {
+    num_hyps += other.num_hyps;
+    num_words += other.num_words;
+    num_prefixes += other.num_prefixes;
+    num_scored += other.num_scored;
+    num_batches += other.num_batches;
+  }
+  void Print() const;
+};
+
+
+/// This class scores word sequences with a DeterministicOnDemandFst (e.g.
+/// ConstArpaLmDeterministicFst, for the ConstArpaLm format), whose state-ids
+/// are used as the states.  It does not take ownership of the FST.
+class DeterministicFstSentenceScorer: public SentenceScorerInterface {
+ public:
+  explicit DeterministicFstSentenceScorer(
+      fst::DeterministicOnDemandFst<fst::StdArc> *det_fst):
+      det_fst_(det_fst) { }
+
+  virtual int32 Start() { return det_fst_->Start(); }
+
+  virtual void ScoreBatch(const std::vector<int32> &states,
+                          const std::vector<int32> &words,
+                          std::vector<BaseFloat> *costs,
+                          std::vector<int32> *next_states);
+ private:
+  fst::DeterministicOnDemandFst<fst::StdArc> *det_fst_;
+};
+
+
+class NbestRescorer {
+ public:
+  /// Does not take ownership of "scorer".
+  NbestRescorer(const NbestRescoreOptions &opts,
+                SentenceScorerInterface *scorer):
+      opts_(opts), scorer_(scorer) { opts_.Check(); }
+
+  /// Works out the N-best paths of "clat" and adds opts.lm_scale times the
+  /// scorer's cost of each one to its graph cost (on the final weight).  The
+  /// paths are output in "nbest" as a union of linear paths, added in order of
+  /// their new total costs (graph cost plus acoustic_scale times acoustic
+  /// cost), best first.  The word labels are taken from the output side of
+  /// the lattice.  Paths that the scorer gives infinite cost are dropped.
+  /// Returns false if there were no paths left.
+  bool Rescore(const CompactLattice &clat, CompactLattice *nbest);
+
+  /// Rescores the given word sequences, outputting in "costs" the cost the
+  /// scorer gives to each (not scaled by lm_scale).  Rescore() calls this;
+  /// it is exposed for testing and for callers that have their own
+  /// N-best lists.  Calls the scorer's Reset() when it is done.
+  void ScoreSequences(const std::vector<std::vector<int32> > &word_seqs,
+                      std::vector<double> *costs);
+
+  const NbestRescoreStats &Stats() const { return stats_; }
+
+ private:
+  struct TrieNode {
+    int32 parent;  // index of the parent node, or -1 for the root.
+    int32 word;  // the word on the arc from the parent; 0 for end of sentence.
+    int32 state;  // the scorer state after this word (-1 if not yet known, or
+                  // end of sentence).
+    double cost;  // total cost from the root.
+    TrieNode(int32 parent, int32 word): parent(parent), word(word),
+                                        state(-1), cost(0.0) { }
+  };
+
+  // Scores the nodes in "nodes", whose parents must already have been scored.
+  void ScoreNodes(const std::vector<int32> &nodes);
+
+  // Sends the (state, word) pairs in pending_ to the scorer and stores the
+  // results in cache_.
+  void FlushPending();
+
+  typedef std::pair<int32, int32> StateWordPair;
+  typedef std::pair<BaseFloat, int32> CostStatePair;
+  typedef unordered_map<StateWordPair, CostStatePair,
+                        PairHasher<int32> > CacheType;
+
+  NbestRescoreOptions opts_;
+  SentenceScorerInterface *scorer_;
+  std::vector<TrieNode> trie_;
+  CacheType cache_;  // (state, word) -> (cost, next-state).
+  std::vector<StateWordPair> pending_;  // pairs not in cache_ yet.
+  NbestRescoreStats stats_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(NbestRescorer);
+};
+
+
+}  // namespace kaldi
+
+#endif  // KALDI_LAT_NBEST_RESCORE_H_
@@ -0,0 +1,142 @@
+// lat/packed-lattice-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lat/kaldi-lattice.h"
+#include "lat/packed-lattice.h"
+#include "fstext/rand-fst.h"
+
+
+namespace kaldi {
+
+// Returns a random CompactLattice whose strings have runs of repeated
+// transition-ids, as real lattices do.
+CompactLattice *RandCompactLatticeWithRuns() {
+  Lattice *fst = fst::RandPairFst<LatticeArc>();
+  CompactLattice *clat = new CompactLattice;
+  ConvertLattice(*fst, clat);
+  delete fst;
+  for (int32 s = 0; s < clat->NumStates(); s++) {
+    for (fst::MutableArcIterator<CompactLattice> aiter(clat, s);
+         !aiter.Done(); aiter.Next()) {
+      CompactLatticeArc arc = aiter.Value();
+      std::vector<int32> str;
+      int32 num_runs = Rand() % 4;
+      for (int32 r = 0; r < num_runs; r++)
+        str.insert(str.end(), 1 + Rand() % 5, Rand() % 10);
+      arc.weight = CompactLatticeWeight(arc.weight.Weight(), str);
+      aiter.SetValue(arc);
+    }
+    if (clat->Final(s) != CompactLatticeWeight::Zero() && Rand() % 2 == 0) {
+      std::vector<int32> str(1 + Rand() % 3, 1 + Rand() % 10);
+      clat->SetFinal(s, CompactLatticeWeight(clat->Final(s).Weight(), str));
+    }
+  }
+  return clat;
+}
+
+void TestPackedCompactLattice() {
+  CompactLattice *clat = RandCompactLatticeWithRuns();
+  for (int32 i = 0; i < 2; i++) {
+    bool run_length_encode = (i == 0);
+    PackedCompactLattice packed(*clat, run_length_encode);
+    KALDI_ASSERT(packed.NumStates() == clat->NumStates());
+    CompactLattice clat2;
+    packed.Unpack(&clat2);
+    KALDI_ASSERT(fst::Equal(*clat, clat2));
+  }
+  // CompactLattices are normally acceptors, but need not be.
+  if (clat->NumStates() > 0 && clat->NumArcs(0) > 0) {
+    {
+      fst::MutableArcIterator<CompactLattice> aiter(clat, 0);
+      CompactLatticeArc arc = aiter.Value();
+      arc.olabel = arc.ilabel + 1;
+      aiter.SetValue(arc);
+    }
+    PackedCompactLattice packed(*clat);
+    CompactLattice clat2;
+    packed.Unpack(&clat2);
+    KALDI_ASSERT(fst::Equal(*clat, clat2));
+  }
+  // Negative values can't be run-length encoded, but should still work.
+  if (clat->NumStates() > 0) {
+    std::vector<int32> str(3, -2);
+    clat->SetFinal(0, CompactLatticeWeight(LatticeWeight::One(), str));
+    PackedCompactLattice packed(*clat);
+    CompactLattice clat2;
+    packed.Unpack(&clat2);
+    KALDI_ASSERT(fst::Equal(*clat, clat2));
+  }
+  {
+    CompactLattice empty;
+    PackedCompactLattice packed(empty);
+    CompactLattice clat2;
+    packed.Unpack(&clat2);
+    KALDI_ASSERT(clat2.NumStates() == 0 && clat2.Start() == fst::kNoStateId);
+  }
+  delete clat;
+}
+
+// Write as CompactLattice, read as PackedCompactLattice and vice versa.
+void TestPackedCompactLatticeTable(bool binary) {
+  CompactLatticeWriter writer(binary ? "ark:tmpf" : "ark,t:tmpf");
+  int N = 10;
+  std::vector<CompactLattice*> lat_vec(N);
+  for (int i = 0; i < N; i++) {
+    std::ostringstream key;
+    key << "key" << i;
+    lat_vec[i] = RandCompactLatticeWithRuns();
+    writer.Write(key.str(), *(lat_vec[i]));
+  }
+  writer.Close();
+
+  {
+    PackedCompactLatticeWriter packed_writer(binary ? "ark:tmpf2" :
+                                             "ark,t:tmpf2");
+    RandomAccessPackedCompactLatticeReader reader("ark:tmpf");
+    for (int i = 0; i < N; i++) {
+      std::ostringstream key;
+      key << "key" << i;
+      const PackedCompactLattice &packed = reader.Value(key.str());
+      CompactLattice clat;
+      packed.Unpack(&clat);
+      KALDI_ASSERT(fst::Equal(clat, *(lat_vec[i])));
+      packed_writer.Write(key.str(), packed);
+    }
+  }
+  SequentialCompactLatticeReader reader("ark:tmpf2");
+  for (int i = 0; i < N; i++, reader.Next()) {
+    KALDI_ASSERT(!reader.Done());
+    KALDI_ASSERT(fst::Equal(reader.Value(), *(lat_vec[i])));
+    delete lat_vec[i];
+  }
+  KALDI_ASSERT(reader.Done());
+  unlink("tmpf");
+  unlink("tmpf2");
+}
+
+} // end namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 20; i++)
+    TestPackedCompactLattice();
+  for (int32 i = 0; i < 2; i++) {
+    bool binary = (i == 0);
+    TestPackedCompactLatticeTable(binary);
+  }
+  std::cout << "Test OK\n";
+}
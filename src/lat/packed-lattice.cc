@@ -0,0 +1,144 @@
+// lat/packed-lattice.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lat/packed-lattice.h"
+
+namespace kaldi {
+
+void PackedCompactLattice::Pack(const CompactLattice &clat,
+                                bool run_length_encode) {
+  typedef CompactLattice::Arc Arc;
+  typedef CompactLattice::Weight Weight;
+  states_.clear();
+  arcs_.clear();
+  strings_.clear();
+  start_ = clat.Start();
+  int32 num_states = clat.NumStates();
+  size_t num_arcs = 0;
+  run_length_encoded_ = run_length_encode;
+  for (int32 s = 0; s < num_states; s++) {
+    for (fst::ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done();
+         aiter.Next()) {
+      num_arcs++;
+      if (run_length_encoded_) {
+        const std::vector<int32> &str = aiter.Value().weight.String();
+        for (size_t i = 0; i < str.size(); i++)
+          if (str[i] < 0) run_length_encoded_ = false;
+      }
+    }
+    if (run_length_encoded_) {
+      const std::vector<int32> &str = clat.Final(s).String();
+      for (size_t i = 0; i < str.size(); i++)
+        if (str[i] < 0) run_length_encoded_ = false;
+    }
+  }
+  states_.resize(num_states);
+  arcs_.reserve(num_arcs);
+  for (int32 s = 0; s < num_states; s++) {
+    PackedState &state = states_[s];
+    state.arc_begin = arcs_.size();
+    for (fst::ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done();
+         aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      PackedArc packed_arc;
+      packed_arc.ilabel = arc.ilabel;
+      packed_arc.olabel = arc.olabel;
+      packed_arc.nextstate = arc.nextstate;
+      packed_arc.weight = arc.weight.Weight();
+      packed_arc.string_begin = strings_.size();
+      AppendString(arc.weight.String());
+      packed_arc.string_end = strings_.size();
+      arcs_.push_back(packed_arc);
+    }
+    state.arc_end = arcs_.size();
+    Weight final_weight = clat.Final(s);
+    state.final_weight = final_weight.Weight();
+    state.final_string_begin = strings_.size();
+    AppendString(final_weight.String());
+    state.final_string_end = strings_.size();
+  }
+  // The vectors may have grown by doubling; don't keep the unused space.
+  std::vector<int32>(strings_).swap(strings_);
+}
+
+void PackedCompactLattice::AppendString(const std::vector<int32> &str) {
+  if (!run_length_encoded_) {
+    strings_.insert(strings_.end(), str.begin(), str.end());
+    return;
+  }
+  size_t i = 0, size = str.size();
+  while (i < size) {
+    size_t j = i + 1;
+    while (j < size && str[j] == str[i]) j++;
+    if (j - i == 1) {
+      strings_.push_back(str[i]);
+    } else {
+      strings_.push_back(-static_cast<int32>(j - i));
+      strings_.push_back(str[i]);
+    }
+    i = j;
+  }
+}
+
+void PackedCompactLattice::GetString(int32 begin, int32 end,
+                                     std::vector<int32> *str) const {
+  str->clear();
+  if (!run_length_encoded_) {
+    str->insert(str->end(), strings_.begin() + begin, strings_.begin() + end);
+    return;
+  }
+  for (int32 i = begin; i < end; i++) {
+    if (strings_[i] < 0) {
+      KALDI_ASSERT(i + 1 < end);
+      str->insert(str->end(), -strings_[i], strings_[i + 1]);
+      i++;
+    } else {
+      str->push_back(strings_[i]);
+    }
+  }
+}
+
+void PackedCompactLattice::Unpack(CompactLattice *clat) const {
+  typedef CompactLattice::Arc Arc;
+  typedef CompactLattice::Weight Weight;
+  clat->DeleteStates();
+  int32 num_states = states_.size();
+  for (int32 s = 0; s < num_states; s++)
+    clat->AddState();
+  if (start_ != fst::kNoStateId)
+    clat->SetStart(start_);
+  std::vector<int32> str;
+  for (int32 s = 0; s < num_states; s++) {
+    const PackedState &state = states_[s];
+    clat->ReserveArcs(s, state.arc_end - state.arc_begin);
+    for (int32 a = state.arc_begin; a < state.arc_end; a++) {
+      const PackedArc &arc = arcs_[a];
+      GetString(arc.string_begin, arc.string_end, &str);
+      clat->AddArc(s, Arc(arc.ilabel, arc.olabel, Weight(arc.weight, str),
+                          arc.nextstate));
+    }
+    GetString(state.final_string_begin, state.final_string_end, &str);
+    clat->SetFinal(s, Weight(state.final_weight, str));
+  }
+}
+
+size_t PackedCompactLattice::MemorySize() const {
+  return sizeof(*this) + states_.capacity() * sizeof(PackedState) +
+      arcs_.capacity() * sizeof(PackedArc) + strings_.capacity() * sizeof(int32);
+}
+
+} // namespace kaldi
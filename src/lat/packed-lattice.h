@@ -0,0 +1,145 @@
+// lat/packed-lattice.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_LAT_PACKED_LATTICE_H_
+#define KALDI_LAT_PACKED_LATTICE_H_
+
+#include <vector>
+#include "base/kaldi-common.h"
+#include "lat/kaldi-lattice.h"
+
+namespace kaldi {
+
+/**
+   PackedCompactLattice is a read-only copy of a CompactLattice that uses much
+   less memory, for programs that keep many lattices in memory (e.g. when
+   random-accessing an archive that is not sorted).  In a CompactLattice, each
+   arc and final-prob has its own std::vector<int32> of transition-ids, which
+   means a separate heap allocation for each one, plus the vector itself.
+   Here, the arcs of all states are in one array, and all the strings are in
+   one pooled buffer and addressed by offsets.  Optionally, runs of a repeated
+   transition-id (typically from self-loops) are run-length encoded, which
+   usually shrinks the strings several fold.
+
+   You convert to and from CompactLattice with Pack() and Unpack(); the
+   conversion is exact.  Use PackedCompactLatticeHolder to read and write
+   tables in the normal lattice formats.
+*/
+class PackedCompactLattice {
+ public:
+  PackedCompactLattice(): start_(fst::kNoStateId),
+                          run_length_encoded_(false) { }
+
+  explicit PackedCompactLattice(const CompactLattice &clat,
+                                bool run_length_encode = true) {
+    Pack(clat, run_length_encode);
+  }
+
+  /// Copies "clat".  If run_length_encode == true, repeated transition-ids are
+  /// run-length encoded; this is only done if no string contains negative
+  /// values.
+  void Pack(const CompactLattice &clat, bool run_length_encode = true);
+
+  /// Outputs the lattice as a CompactLattice.
+  void Unpack(CompactLattice *clat) const;
+
+  int32 NumStates() const { return states_.size(); }
+
+  int32 NumArcs() const { return arcs_.size(); }
+
+  /// Returns the approximate number of bytes of memory used.
+  size_t MemorySize() const;
+
+ private:
+  struct PackedArc {
+    int32 ilabel;
+    int32 olabel; // usually the same as ilabel, but need not be.
+    int32 nextstate;
+    LatticeWeight weight;
+    int32 string_begin; // the string is strings_[string_begin .. string_end-1],
+    int32 string_end;   // possibly run-length encoded.
+  };
+  struct PackedState {
+    int32 arc_begin; // this state's arcs are arcs_[arc_begin .. arc_end-1].
+    int32 arc_end;
+    LatticeWeight final_weight;
+    int32 final_string_begin;
+    int32 final_string_end;
+  };
+
+  // Appends "str" to strings_, encoding it if run_length_encoded_.
+  void AppendString(const std::vector<int32> &str);
+
+  // Decodes strings_[begin .. end-1] into *str.
+  void GetString(int32 begin, int32 end, std::vector<int32> *str) const;
+
+  int32 start_;
+  // If true, a run of n >= 2 copies of x is stored in strings_ as the two
+  // elements -n, x.
+  bool run_length_encoded_;
+  std::vector<PackedState> states_;
+  std::vector<PackedArc> arcs_;
+  std::vector<int32> strings_;
+};
+
+
+/// A holder for PackedCompactLattice, which reads and writes the same formats
+/// as CompactLatticeHolder.
+class PackedCompactLatticeHolder {
+ public:
+  typedef PackedCompactLattice T;
+
+  PackedCompactLatticeHolder() { t_ = NULL; }
+
+  static bool Write(std::ostream &os, bool binary, const T &t) {
+    CompactLattice clat;
+    t.Unpack(&clat);
+    return CompactLatticeHolder::Write(os, binary, clat);
+  }
+
+  bool Read(std::istream &is) {
+    Clear();
+    CompactLatticeHolder holder;
+    if (!holder.Read(is)) return false;
+    t_ = new T(holder.Value());
+    return true;
+  }
+
+  static bool IsReadInBinary() { return true; }
+
+  const T &Value() const {
+    KALDI_ASSERT(t_ != NULL && "Called Value() on empty PackedCompactLatticeHolder");
+    return *t_;
+  }
+
+  void Clear() { if (t_) { delete t_; t_ = NULL; } }
+
+  ~PackedCompactLatticeHolder() { Clear(); }
+
+ private:
+  T *t_;
+};
+
+typedef TableWriter<PackedCompactLatticeHolder> PackedCompactLatticeWriter;
+typedef SequentialTableReader<PackedCompactLatticeHolder>
+  SequentialPackedCompactLatticeReader;
+typedef RandomAccessTableReader<PackedCompactLatticeHolder>
+  RandomAccessPackedCompactLatticeReader;
+
+} // namespace kaldi
+
+#endif  // KALDI_LAT_PACKED_LATTICE_H_
@@ -0,0 +1,142 @@
+// lat/sausages-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+
+#include "lat/kaldi-lattice.h"
+#include "lat/sausages.h"
+#include "base/timer.h"
+
+
+namespace kaldi {
+using namespace fst;
+
+// Returns a random word lattice covering "num_frames" frames, whose states
+// are at word boundaries up to "max_word_length" frames apart.  Between each
+// pair of adjacent boundaries there are "num_words" alternative words, and
+// there are a few words spanning two boundaries.
+CompactLattice *RandWordLattice(int32 num_frames, int32 max_word_length,
+                                int32 num_words) {
+  std::vector<int32> times(1, 0);
+  while (times.back() < num_frames)
+    times.push_back(std::min(num_frames,
+                             times.back() + 1 + Rand() % max_word_length));
+  CompactLattice *clat = new CompactLattice;
+  for (size_t i = 0; i < times.size(); i++)
+    clat->AddState();
+  clat->SetStart(0);
+  for (size_t i = 0; i + 1 < times.size(); i++) {
+    for (int32 j = 0; j < num_words; j++) {
+      // the word-ids include epsilon (0).
+      size_t next = (i + 2 < times.size() && Rand() % 5 == 0 ? i + 2 : i + 1);
+      std::vector<int32> string(times[next] - times[i], 1);
+      LatticeWeight w(2.0 * RandUniform(), 5.0 * RandUniform());
+      int32 word = Rand() % 10;
+      clat->AddArc(i, CompactLatticeArc(word, word,
+                                        CompactLatticeWeight(w, string),
+                                        next));
+    }
+  }
+  clat->SetFinal(times.size() - 1, CompactLatticeWeight::One());
+  Connect(clat);  // the words spanning two boundaries may skip a state.
+  return clat;
+}
+
+// For a lattice with just one path, the MBR output is that path, with no
+// risk.
+void TestMinimumBayesRiskLinear() {
+  CompactLattice *clat = RandWordLattice(50 + Rand() % 100, 10, 1);
+  std::vector<int32> words;
+  for (int32 s = 0; s < clat->NumStates(); s++)
+    for (ArcIterator<CompactLattice> aiter(*clat, s); !aiter.Done();
+         aiter.Next())
+      if (aiter.Value().ilabel != 0)
+        words.push_back(aiter.Value().ilabel);
+  MinimumBayesRisk mbr(*clat, true, 1 + Rand() % 3);
+  KALDI_ASSERT(mbr.GetOneBest() == words);
+  KALDI_ASSERT(std::abs(mbr.GetBayesRisk()) < 0.01);
+  for (size_t i = 0; i < words.size(); i++)
+    KALDI_ASSERT(ApproxEqual(mbr.GetOneBestConfidences()[i], 1.0));
+  delete clat;
+}
+
+// Checks that the output doesn't depend on the number of threads, and that
+// the posteriors in each bin sum to one.
+void TestMinimumBayesRiskThreads() {
+  CompactLattice *clat = RandWordLattice(100 + Rand() % 500, 20,
+                                         1 + Rand() % 10);
+  bool do_mbr = (Rand() % 2 == 0);
+  MinimumBayesRisk mbr1(*clat, do_mbr, 1),
+      mbr2(*clat, do_mbr, 2 + Rand() % 3);
+  KALDI_ASSERT(mbr1.GetOneBest() == mbr2.GetOneBest());
+  KALDI_ASSERT(mbr1.GetBayesRisk() == mbr2.GetBayesRisk());
+  KALDI_ASSERT(mbr1.GetSausageStats() == mbr2.GetSausageStats());
+  KALDI_ASSERT(mbr1.GetSausageTimes() == mbr2.GetSausageTimes());
+  KALDI_ASSERT(mbr1.GetOneBestConfidences() == mbr2.GetOneBestConfidences());
+  const std::vector<std::vector<std::pair<int32, BaseFloat> > > &stats =
+      mbr1.GetSausageStats();
+  for (size_t q = 0; q < stats.size(); q++) {
+    double sum = 0.0;
+    for (size_t j = 0; j < stats[q].size(); j++)
+      sum += stats[q][j].second;
+    KALDI_ASSERT(ApproxEqual(sum, 1.0, 0.01));
+  }
+  delete clat;
+}
+
+// Giving the MAP output as the hypothesis should give the same confidences
+// and times as computing it with do_mbr == false.
+void TestMinimumBayesRiskGivenWords() {
+  CompactLattice *clat = RandWordLattice(50 + Rand() % 100, 10,
+                                         1 + Rand() % 5);
+  MinimumBayesRisk mbr_map(*clat, false);
+  std::vector<int32> words(mbr_map.GetOneBest());
+  words.insert(words.begin(), 0);  // epsilons should be ignored.
+  MinimumBayesRisk mbr_words(*clat, words);
+  KALDI_ASSERT(mbr_words.GetOneBest() == mbr_map.GetOneBest());
+  KALDI_ASSERT(mbr_words.GetOneBestConfidences() ==
+               mbr_map.GetOneBestConfidences());
+  KALDI_ASSERT(mbr_words.GetOneBestTimes() == mbr_map.GetOneBestTimes());
+  delete clat;
+}
+
+// Times the computation on a long (10000 frame) lattice.
+void TestMinimumBayesRiskSpeed() {
+  CompactLattice *clat = RandWordLattice(10000, 20, 4);
+  for (int32 num_threads = 1; num_threads <= 4; num_threads *= 4) {
+    Timer timer;
+    MinimumBayesRisk mbr(*clat, true, num_threads);
+    KALDI_LOG << "MBR on " << clat->NumStates() << " word boundaries with "
+              << num_threads << " thread(s) took " << timer.Elapsed()
+              << " seconds; " << mbr.GetOneBest().size() << " words, Bayes "
+              << "risk " << mbr.GetBayesRisk();
+  }
+  delete clat;
+}
+
+} // end namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 10; i++) {
+    TestMinimumBayesRiskLinear();
+    TestMinimumBayesRiskThreads();
+    TestMinimumBayesRiskGivenWords();
+  }
+  TestMinimumBayesRiskSpeed();
+  KALDI_LOG << "Success.";
+}
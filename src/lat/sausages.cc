@@ -19,6 +19,8 @@
 
 #include "lat/sausages.h"
 #include "lat/lattice-functions.h"
+#include "thread/kaldi-barrier.h"
+#include "thread/kaldi-thread.h"
 
 namespace kaldi {
 
@@ -89,43 +91,125 @@ void MinimumBayesRisk::NormalizeEps(std::vector<int32> *vec) {
   (*vec)[0] = 0;
 }
 
-double MinimumBayesRisk::EditDistance(int32 N, int32 Q,
-                                      Vector<double> &alpha,
-                                      Matrix<double> &alpha_dash,
-                                      Vector<double> &alpha_dash_arc) {
-  alpha(1) = 0.0; // = log(1).  Line 5.
-  alpha_dash(1, 0) = 0.0; // Line 5.
-  for (int32 q = 1; q <= Q; q++) 
-    alpha_dash(1, q) = alpha_dash(1, q-1) + l(0, r(q)); // Line 7.
-  for (int32 n = 2; n <= N; n++) {
-    double alpha_n = kLogZeroDouble;
-    for (size_t i = 0; i < pre_[n].size(); i++) {
-      const Arc &arc = arcs_[pre_[n][i]];
-      alpha_n = LogAdd(alpha_n, alpha(arc.start_node) + arc.loglike);
+void MinimumBayesRisk::EditDistanceForNode(int32 n, int32 Q,
+                                            double *alpha_dash_arc) {
+  double *alpha_dash_n = alpha_dash_.RowData(n);
+  for (int32 q = 0; q <= Q; q++)
+    alpha_dash_n[q] = 0.0; // Line 11.
+  for (size_t i = 0; i < pre_[n].size(); i++) {
+    int32 a = pre_[n][i];
+    const Arc &arc = arcs_[a];
+    const double *alpha_dash_s = alpha_dash_.RowData(arc.start_node);
+    int32 w_a = arc.word;
+    double scale = arc_scale_[a];
+    alpha_dash_arc[0] = alpha_dash_s[0] + l(w_a, 0) + delta(); // line 15.
+    alpha_dash_n[0] += scale * alpha_dash_arc[0]; // line 19.
+    for (int32 q = 1; q <= Q; q++) {
+      // a1,a2,a3 are the 3 parts of min expression of line 17.
+      int32 r_q = r(q);
+      double a1 = alpha_dash_s[q-1] + l(w_a, r_q),
+          a2 = alpha_dash_s[q] + l(w_a, 0) + delta(),
+          a3 = alpha_dash_arc[q-1] + l(0, r_q);
+      alpha_dash_arc[q] = std::min(a1, std::min(a2, a3));
+      alpha_dash_n[q] += scale * alpha_dash_arc[q]; // line 19.
     }
-    alpha(n) = alpha_n; // Line 10.
-    // Line 11 omitted: matrix was initialized to zero.
-    for (size_t i = 0; i < pre_[n].size(); i++) {
-      const Arc &arc = arcs_[pre_[n][i]];
-      int32 s_a = arc.start_node, w_a = arc.word;
-      BaseFloat p_a = arc.loglike;
-      for (int32 q = 0; q <= Q; q++) {
-        if (q == 0) {
-          alpha_dash_arc(q) = // line 15.
-              alpha_dash(s_a, q) + l(w_a, 0) + delta();
-        } else {  // a1,a2,a3 are the 3 parts of min expression of line 17.
-          int32 r_q = r(q);
-          double a1 = alpha_dash(s_a, q-1) + l(w_a, r_q),
-              a2 = alpha_dash(s_a, q) + l(w_a, 0) + delta(),
-              a3 = alpha_dash_arc(q-1) + l(0, r_q);
-          alpha_dash_arc(q) = std::min(a1, std::min(a2, a3));
-        }
-        // line 19:
-        alpha_dash(n, q) += exp(alpha(s_a) + p_a - alpha(n)) * alpha_dash_arc(q);
-      }
+  }
+}
+
+void MinimumBayesRisk::ComputeBackpointers(int32 a, int32 Q,
+                                           double *alpha_dash_arc,
+                                           char *b_arc) const {
+  const Arc &arc = arcs_[a];
+  const double *alpha_dash_s = alpha_dash_.RowData(arc.start_node);
+  int32 w_a = arc.word;
+  alpha_dash_arc[0] = alpha_dash_s[0] + l(w_a, 0) + delta(); // line 14.
+  for (int32 q = 1; q <= Q; q++) { // this loop == lines 15-18.
+    int32 r_q = r(q);
+    double a1 = alpha_dash_s[q-1] + l(w_a, r_q),
+        a2 = alpha_dash_s[q] + l(w_a, 0) + delta(),
+        a3 = alpha_dash_arc[q-1] + l(0, r_q);
+    if (a1 <= a2) {
+      if (a1 <= a3) { b_arc[q] = 1; alpha_dash_arc[q] = a1; }
+      else { b_arc[q] = 3; alpha_dash_arc[q] = a3; }
+    } else {
+      if (a2 <= a3) { b_arc[q] = 2; alpha_dash_arc[q] = a2; }
+      else { b_arc[q] = 3; alpha_dash_arc[q] = a3; }
     }
   }
-  return alpha_dash(N, Q); // line 23.
+}
+
+// Computes the rows of alpha_dash_ level by level; each thread does a
+// contiguous part of each level, and then waits for the others.
+class MinimumBayesRisk::ForwardWorker: public MultiThreadable {
+ public:
+  ForwardWorker(MinimumBayesRisk *mbr, int32 Q, Barrier *barrier):
+      mbr_(mbr), Q_(Q), barrier_(barrier) { }
+  void operator() () {
+    std::vector<double> alpha_dash_arc(Q_ + 1);
+    const std::vector<int32> &level_begin = mbr_->level_begin_;
+    for (size_t l = 0; l + 1 < level_begin.size(); l++) {
+      int32 begin = level_begin[l], size = level_begin[l+1] - begin,
+          this_begin = begin + (size * thread_id_) / num_threads_,
+          this_end = begin + (size * (thread_id_ + 1)) / num_threads_;
+      for (int32 i = this_begin; i < this_end; i++)
+        mbr_->EditDistanceForNode(mbr_->level_nodes_[i], Q_,
+                                  &(alpha_dash_arc[0]));
+      barrier_->Wait();
+    }
+  }
+ private:
+  MinimumBayesRisk *mbr_;
+  int32 Q_;
+  Barrier *barrier_;
+};
+
+// Computes the backpointers b_arc for a list of arcs, each thread doing a
+// contiguous part of the list.
+class MinimumBayesRisk::BackwardWorker: public MultiThreadable {
+ public:
+  BackwardWorker(const MinimumBayesRisk *mbr, int32 Q,
+                 const std::vector<int32> *arcs, std::vector<char> *b_arc):
+      mbr_(mbr), Q_(Q), arcs_(arcs), b_arc_(b_arc) { }
+  void operator() () {
+    std::vector<double> alpha_dash_arc(Q_ + 1);
+    int32 size = arcs_->size(),
+        begin = (size * thread_id_) / num_threads_,
+        end = (size * (thread_id_ + 1)) / num_threads_;
+    for (int32 i = begin; i < end; i++)
+      mbr_->ComputeBackpointers((*arcs_)[i], Q_, &(alpha_dash_arc[0]),
+                                &((*b_arc_)[i * (Q_ + 1)]));
+  }
+ private:
+  const MinimumBayesRisk *mbr_;
+  int32 Q_;
+  const std::vector<int32> *arcs_;
+  std::vector<char> *b_arc_;
+};
+
+double MinimumBayesRisk::EditDistance(int32 N, int32 Q) {
+  alpha_dash_.Resize(N+1, Q+1, kUndefined);
+  alpha_dash_(1, 0) = 0.0; // Line 5.
+  for (int32 q = 1; q <= Q; q++) 
+    alpha_dash_(1, q) = alpha_dash_(1, q-1) + l(0, r(q)); // Line 7.
+  // The work for a level is divided between the threads; with less than about
+  // this much work per thread, the waiting would cost more than it saves.
+  const int64 kMinWorkPerThread = 20000;
+  int32 num_levels = static_cast<int32>(level_begin_.size()) - 1;
+  int64 work_per_level = (static_cast<int64>(arcs_.size()) * (Q + 1)) /
+      std::max<int32>(num_levels, 1);
+  int32 num_threads = static_cast<int32>(std::min<int64>(
+      num_threads_, work_per_level / kMinWorkPerThread));
+  if (num_threads <= 1) {
+    std::vector<double> alpha_dash_arc(Q+1);
+    for (size_t i = 0; i < level_nodes_.size(); i++) // Lines 8 to 22.
+      EditDistanceForNode(level_nodes_[i], Q, &(alpha_dash_arc[0]));
+  } else {
+    Barrier barrier(num_threads);
+    ForwardWorker worker(this, Q, &barrier);
+    // The destructor of MultiThreader waits for the threads to finish.
+    MultiThreader<ForwardWorker> m(num_threads, worker);
+  }
+  return alpha_dash_(N, Q); // line 23.
 }
 
 // Figure 5 in the paper.
@@ -135,12 +219,7 @@ void MinimumBayesRisk::AccStats() {
   int32 N = static_cast<int32>(pre_.size()) - 1,
       Q = static_cast<int32>(R_.size());
 
-  Vector<double> alpha(N+1); // index (1...N)
-  Matrix<double> alpha_dash(N+1, Q+1); // index (1...N, 0...Q)
-  Vector<double> alpha_dash_arc(Q+1); // index 0...Q
-  Matrix<double> beta_dash(N+1, Q+1); // index (1...N, 0...Q)
-  Vector<double> beta_dash_arc(Q+1); // index 0...Q
-  vector<char> b_arc(Q+1); // integer in {1,2,3}; index 1...Q
+  Vector<double> beta_dash_arc(Q+1); // index 0...Q; used for node 1.
   vector<map<int32, double> > gamma(Q+1); // temp. form of gamma.
   // index 1...Q [word] -> occ.
 
@@ -150,72 +229,109 @@ void MinimumBayesRisk::AccStats() {
   // the sausage bins, not specifically for the 1-best output.
   Vector<double> tau_b(Q+1), tau_e(Q+1);
 
-  double Ltmp = EditDistance(N, Q, alpha, alpha_dash, alpha_dash_arc); 
+  double Ltmp = EditDistance(N, Q); 
   if (L_ != 0 && Ltmp > L_) { // L_ != 0 is to rule out 1st iter.
     KALDI_WARN << "Edit distance increased: " << Ltmp << " > "
                << L_;
   }
   L_ = Ltmp;
   KALDI_VLOG(2) << "L = " << L_;
-  // omit line 10: zero when initialized.
-  beta_dash(N, Q) = 1.0; // Line 11.
-  for (int32 n = N; n >= 2; n--) {
-    for (size_t i = 0; i < pre_[n].size(); i++) {
-      const Arc &arc = arcs_[pre_[n][i]];
-      int32 s_a = arc.start_node, w_a = arc.word;
-      BaseFloat p_a = arc.loglike;
-      alpha_dash_arc(0) = alpha_dash(s_a, 0) + l(w_a, 0) + delta(); // line 14.
-      for (int32 q = 1; q <= Q; q++) { // this loop == lines 15-18.
-        int32 r_q = r(q);
-        double a1 = alpha_dash(s_a, q-1) + l(w_a, r_q),
-            a2 = alpha_dash(s_a, q) + l(w_a, 0) + delta(),
-            a3 = alpha_dash_arc(q-1) + l(0, r_q);
-        if (a1 <= a2) {
-          if (a1 <= a3) { b_arc[q] = 1; alpha_dash_arc(q) = a1; }
-          else { b_arc[q] = 3; alpha_dash_arc(q) = a3; }
-        } else {
-          if (a2 <= a3) { b_arc[q] = 2; alpha_dash_arc(q) = a2; }
-          else { b_arc[q] = 3; alpha_dash_arc(q) = a3; }
-        }
-      }
-      beta_dash_arc.SetZero(); // line 19.
-      for (int32 q = Q; q >= 1; q--) {
-        // line 21:
-        beta_dash_arc(q) += exp(alpha(s_a) + p_a - alpha(n)) * beta_dash(n, q);
-        switch (static_cast<int>(b_arc[q])) { // lines 22 and 23:
-          case 1:
-            beta_dash(s_a, q-1) += beta_dash_arc(q);
-            // next: gamma(q, w(a)) += beta_dash_arc(q)
-            AddToMap(w_a, beta_dash_arc(q), &(gamma[q]));
-            // next: accumulating times, see decl for tau_b,tau_e
-            tau_b(q) += state_times_[s_a] * beta_dash_arc(q);
-            tau_e(q) += state_times_[n] * beta_dash_arc(q);
-            break;
-          case 2:
-            beta_dash(s_a, q) += beta_dash_arc(q);
-            break;
-          case 3:
-            beta_dash_arc(q-1) += beta_dash_arc(q);
-            // next: gamma(q, epsilon) += beta_dash_arc(q)
-            AddToMap(0, beta_dash_arc(q), &(gamma[q]));
-            // next: accumulating times, see decl for tau_b,tau_e
-            // WARNING: there was an error in Appendix C.  If we followed
-            // the instructions there the next line would say state_times_[sa], but
-            // it would be wrong.  I will try to publish an erratum.
-            tau_b(q) += state_times_[n] * beta_dash_arc(q);
-            tau_e(q) += state_times_[n] * beta_dash_arc(q);
-            break;
-          default:
-            KALDI_ERR << "Invalid b_arc value"; // error in code.
+  beta_dash_.Resize(N+1, Q+1); // line 10: sets it to zero.
+  beta_dash_(N, Q) = 1.0; // Line 11.
+  // For each node n, the range of q >= 1 for which beta_dash_(n, q) may be
+  // nonzero is beta_min_q[n] ... beta_max_q[n].
+  std::vector<int32> beta_min_q(N+1, Q+1), beta_max_q(N+1, 0);
+  beta_min_q[N] = beta_max_q[N] = Q;
+
+  // The backpointers b_arc depend only on alpha_dash_, so rather than working
+  // them out one arc at a time as in the paper we work them out for a block
+  // of nodes at a time (possibly in parallel), keeping the memory for them to
+  // about kMaxBlockSize bytes; then we do the rest of the backward pass for
+  // those nodes in the usual order.
+  const int64 kMaxBlockSize = 1 << 24;
+  int64 max_block_arcs = std::max<int64>(1, kMaxBlockSize / (Q + 1));
+  std::vector<int32> block_arcs; // the arcs entering the nodes of the block.
+  vector<char> b_arc; // integer in {1,2,3}; index (block arc, 1...Q).
+  for (int32 n_end = N; n_end >= 2; ) {
+    int32 n_begin = n_end; // the block is nodes n_begin >= n > n_end.
+    block_arcs.clear();
+    while (n_end >= 2 && (block_arcs.empty() ||
+                          block_arcs.size() + pre_[n_end].size() <=
+                          max_block_arcs)) {
+      block_arcs.insert(block_arcs.end(), pre_[n_end].begin(),
+                        pre_[n_end].end());
+      n_end--;
+    }
+    b_arc.resize(block_arcs.size() * (Q + 1));
+    // Threads are only worthwhile if there is a reasonable amount of work.
+    int32 num_threads = (b_arc.size() < 100000 ? 1 : num_threads_);
+    BackwardWorker worker(this, Q, &block_arcs, &b_arc);
+    { // The destructor of MultiThreader waits for the threads to finish.
+      MultiThreader<BackwardWorker> m(num_threads, worker);
+    }
+
+    size_t block_arc = 0;
+    for (int32 n = n_begin; n > n_end; n--) {
+      const double *beta_dash_n = beta_dash_.RowData(n);
+      for (size_t i = 0; i < pre_[n].size(); i++, block_arc++) {
+        int32 a = pre_[n][i];
+        const Arc &arc = arcs_[a];
+        int32 s_a = arc.start_node, w_a = arc.word;
+        double scale = arc_scale_[a];
+        double *beta_dash_s = beta_dash_.RowData(s_a);
+        const char *this_b_arc = &(b_arc[block_arc * (Q + 1)]);
+        // beta_dash_arc(q-1) only gets contributions from line 21 and from
+        // beta_dash_arc(q) (in case 3), so we only need to keep the value
+        // carried down from q; and where beta_dash_arc(q) is zero there is
+        // nothing to add, so we only visit the range of q where row n of
+        // beta_dash_ is nonzero (plus any carry below it), which for long
+        // lattices is a small part of 1...Q.
+        double carry = 0.0; // line 19.
+        for (int32 q = beta_max_q[n]; q >= 1; q--) {
+          if (q < beta_min_q[n] && carry == 0.0) break;
+          double beta_dash_arc_q = carry + scale * beta_dash_n[q]; // line 21.
+          carry = 0.0;
+          if (beta_dash_arc_q == 0.0) continue;
+          switch (static_cast<int>(this_b_arc[q])) { // lines 22 and 23:
+            case 1:
+              beta_dash_s[q-1] += beta_dash_arc_q;
+              if (q > 1) {
+                beta_min_q[s_a] = std::min(beta_min_q[s_a], q - 1);
+                beta_max_q[s_a] = std::max(beta_max_q[s_a], q - 1);
+              }
+              // next: gamma(q, w(a)) += beta_dash_arc(q)
+              AddToMap(w_a, beta_dash_arc_q, &(gamma[q]));
+              // next: accumulating times, see decl for tau_b,tau_e
+              tau_b(q) += state_times_[s_a] * beta_dash_arc_q;
+              tau_e(q) += state_times_[n] * beta_dash_arc_q;
+              break;
+            case 2:
+              beta_dash_s[q] += beta_dash_arc_q;
+              beta_min_q[s_a] = std::min(beta_min_q[s_a], q);
+              beta_max_q[s_a] = std::max(beta_max_q[s_a], q);
+              break;
+            case 3:
+              carry = beta_dash_arc_q;
+              // next: gamma(q, epsilon) += beta_dash_arc(q)
+              AddToMap(0, beta_dash_arc_q, &(gamma[q]));
+              // next: accumulating times, see decl for tau_b,tau_e
+              // WARNING: there was an error in Appendix C.  If we followed
+              // the instructions there the next line would say state_times_[sa], but
+              // it would be wrong.  I will try to publish an erratum.
+              tau_b(q) += state_times_[n] * beta_dash_arc_q;
+              tau_e(q) += state_times_[n] * beta_dash_arc_q;
+              break;
+            default:
+              KALDI_ERR << "Invalid b_arc value"; // error in code.
+          }
         }
+        beta_dash_s[0] += carry + scale * beta_dash_n[0]; // lines 25 and 26.
       }
-      beta_dash_arc(0) += exp(alpha(s_a) + p_a - alpha(n)) * beta_dash(n, 0);
-      beta_dash(s_a, 0) += beta_dash_arc(0); // line 26.
     }
   }
   beta_dash_arc.SetZero(); // line 29.
   for (int32 q = Q; q >= 1; q--) {
-    beta_dash_arc(q) += beta_dash(1, q);
+    beta_dash_arc(q) += beta_dash_(1, q);
     beta_dash_arc(q-1) += beta_dash_arc(q);
     AddToMap(0, beta_dash_arc(q), &(gamma[q]));
     // the statements below are actually redundant because
@@ -264,9 +380,8 @@ void MinimumBayesRisk::AccStats() {
   }  
 }
 
-MinimumBayesRisk::MinimumBayesRisk(const CompactLattice &clat_in, bool do_mbr):
-    do_mbr_(do_mbr) {
-  CompactLattice clat(clat_in); // copy.
+void MinimumBayesRisk::PrepareLatticeAndInitStats(CompactLattice *clat_ptr) {
+  CompactLattice &clat = *clat_ptr;
 
   CreateSuperFinal(&clat); // Add super-final state to clat... this is
   // one of the requirements of the MBR algorithm, as mentioned in the
@@ -319,6 +434,46 @@ MinimumBayesRisk::MinimumBayesRisk(const CompactLattice &clat_in, bool do_mbr):
   // numbered state, thanks to CreateSuperFinal and the topological
   // sorting.
 
+  // Work out the quantities that don't depend on R_: alpha (lines 5 and 10 of
+  // Figure 4), the arc scales, and the levels of the nodes.
+  alpha_.resize(N+1);
+  alpha_[1] = 0.0; // = log(1).
+  std::vector<int32> level(N+1, 0);
+  int32 num_levels = 0;
+  for (int32 n = 2; n <= N; n++) {
+    double alpha_n = kLogZeroDouble;
+    level[n] = 1;
+    for (size_t i = 0; i < pre_[n].size(); i++) {
+      const Arc &arc = arcs_[pre_[n][i]];
+      alpha_n = LogAdd(alpha_n, alpha_[arc.start_node] + arc.loglike);
+      level[n] = std::max(level[n], level[arc.start_node] + 1);
+    }
+    alpha_[n] = alpha_n;
+    num_levels = std::max(num_levels, level[n]);
+  }
+  arc_scale_.resize(arcs_.size());
+  for (size_t a = 0; a < arcs_.size(); a++) {
+    const Arc &arc = arcs_[a];
+    arc_scale_[a] = exp(alpha_[arc.start_node] + arc.loglike -
+                        alpha_[arc.end_node]);
+  }
+  level_begin_.assign(num_levels + 1, 0);
+  for (int32 n = 2; n <= N; n++)
+    level_begin_[level[n]]++;
+  for (int32 l = 0; l < num_levels; l++)
+    level_begin_[l + 1] += level_begin_[l];
+  level_nodes_.resize(N > 0 ? N - 1 : 0);
+  std::vector<int32> next_pos(level_begin_.begin(), level_begin_.end() - 1);
+  for (int32 n = 2; n <= N; n++)
+    level_nodes_[next_pos[level[n] - 1]++] = n;
+}
+
+MinimumBayesRisk::MinimumBayesRisk(const CompactLattice &clat_in, bool do_mbr,
+                                   int32 num_threads):
+    do_mbr_(do_mbr), num_threads_(num_threads) {
+  CompactLattice clat(clat_in); // copy.
+  PrepareLatticeAndInitStats(&clat);
+
   { // Now set R_ to one best in the FST.
     RemoveAlignmentsFromCompactLattice(&clat); // will be more efficient
     // in best-path if we do this.
@@ -341,5 +496,17 @@ MinimumBayesRisk::MinimumBayesRisk(const CompactLattice &clat_in, bool do_mbr):
   
 }
 
+MinimumBayesRisk::MinimumBayesRisk(const CompactLattice &clat_in,
+                                   const std::vector<int32> &words,
+                                   int32 num_threads):
+    do_mbr_(false), num_threads_(num_threads) {
+  CompactLattice clat(clat_in); // copy.
+  PrepareLatticeAndInitStats(&clat);
+  R_ = words;
+  RemoveEps(&R_);
+  L_ = 0.0;
+  MbrDecode();
+}
+
 
 }  // namespace kaldi
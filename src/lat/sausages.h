@@ -61,9 +61,21 @@ class MinimumBayesRisk {
   /// to have been done already.
   /// This does the whole computation.  You get the output with
   /// GetOneBest(), GetBayesRisk(), and GetSausageStats().
-  MinimumBayesRisk(const CompactLattice &clat, bool do_mbr = true); // if do_mbr == false,
+  /// If num_threads > 1, the edit-distance computation for the states of
+  /// the lattice is shared between that many threads; the output does not
+  /// depend on num_threads.
+  MinimumBayesRisk(const CompactLattice &clat, bool do_mbr = true,
+                   int32 num_threads = 1); // if do_mbr == false,
   // it will just use the MAP recognition output, but will get the MBR stats for things
   // like confidences.
+
+  /// This version does not do MBR decoding or take the MAP output: it uses
+  /// "words" (epsilons are ignored) as the hypothesis, so GetOneBest() returns
+  /// those words and GetOneBestConfidences() and GetOneBestTimes() are for
+  /// them; e.g. the words of the oracle path in lattice-oracle.
+  MinimumBayesRisk(const CompactLattice &clat,
+                   const std::vector<int32> &words,
+                   int32 num_threads = 1);
   
   const std::vector<int32> &GetOneBest() const { // gets one-best (with no epsilons)
     return R_;
@@ -96,21 +108,41 @@ class MinimumBayesRisk {
   }  
 
  private:
+  /// Does the part of the constructor that doesn't depend on the hypothesis:
+  /// adds a super-final state to "clat" and sorts it, converts it to our
+  /// internal format and works out alpha_, arc_scale_ and the levels.
+  void PrepareLatticeAndInitStats(CompactLattice *clat);
+
   /// Minimum-Bayes-Risk Decode. Top-level algorithm.  Figure 6 of the paper.
   void MbrDecode(); 
 
   /// The basic edit-distance function l(a,b), as in the paper.
-  inline double l(int32 a, int32 b) { return (a == b ? 0.0 : 1.0); }
+  inline double l(int32 a, int32 b) const { return (a == b ? 0.0 : 1.0); }
   
   /// returns r_q, in one-based indexing, as in the paper.
-  inline int32 r(int32 q) { return R_[q-1]; }
+  inline int32 r(int32 q) const { return R_[q-1]; }
   
   
-  /// Figure 4 of the paper; called from AccStats (Fig. 5)
-  double EditDistance(int32 N, int32 Q,
-                      Vector<double> &alpha,
-                      Matrix<double> &alpha_dash,
-                      Vector<double> &alpha_dash_arc);
+  /// Figure 4 of the paper; called from AccStats (Fig. 5).  Writes to
+  /// alpha_dash_.  The forward probabilities alpha don't depend on R_, so
+  /// they are computed just once, in the constructor.
+  double EditDistance(int32 N, int32 Q);
+
+  /// Lines 11 to 20 of Figure 4 for one node n > 1: computes row n of
+  /// alpha_dash_ from the rows of its predecessors.  "alpha_dash_arc" is
+  /// temporary space of dimension Q+1.
+  void EditDistanceForNode(int32 n, int32 Q, double *alpha_dash_arc);
+
+  /// Lines 14 to 18 of Figure 5 for arc a: works out which of the three terms
+  /// of the min expression is used for each q, and puts it in b_arc[q] for
+  /// q = 1...Q.  "alpha_dash_arc" is temporary space of dimension Q+1.
+  void ComputeBackpointers(int32 a, int32 Q, double *alpha_dash_arc,
+                           char *b_arc) const;
+
+  class ForwardWorker;
+  class BackwardWorker;
+  friend class ForwardWorker;
+  friend class BackwardWorker;
 
   /// Figure 5 of the paper.  Outputs to gamma_ and L_.
   void AccStats(); 
@@ -145,6 +177,9 @@ class MinimumBayesRisk {
   /// to do MBR decoding (if false, our output is the MAP decoded output, but we
   /// output the stats too).
   bool do_mbr_;
+
+  /// The number of threads used in EditDistance() and AccStats().
+  int32 num_threads_;
   
   /// Arcs in the topologically sorted acceptor form of the word-level lattice,
   /// with one final-state.  Contains (word-symbol, log-likelihood on arc ==
@@ -157,6 +192,24 @@ class MinimumBayesRisk {
 
   std::vector<int32> state_times_; // time of each state in the word lattice,
   // indexed from 1 (same index as into pre_)
+
+  std::vector<double> alpha_; // forward log-probability of each node, indexed
+  // from 1.  alpha in the paper.
+
+  std::vector<double> arc_scale_; // for each arc a, the probability
+  // exp(alpha(s_a) + p_a - alpha(n)) of having come through a given that we
+  // are at its end node n; the factor in line 19 of Figure 4 and line 21 of
+  // Figure 5.  Indexed like arcs_.
+
+  std::vector<int32> level_nodes_; // Nodes 2...N grouped by their level (the
+  // number of arcs on the longest path to them from node 1); the nodes of
+  // level l+1 are level_nodes_[level_begin_[l] ... level_begin_[l+1] - 1].
+  // The rows of alpha_dash_ for the nodes of a level can be computed in
+  // parallel.
+  std::vector<int32> level_begin_;
+
+  Matrix<double> alpha_dash_; // index (1...N, 0...Q).  These are kept between
+  Matrix<double> beta_dash_; // iterations so we don't have to reallocate them.
   
   std::vector<int32> R_; // current 1-best word sequence, normalized to have
   // epsilons between each word and at the beginning and end.  R in paper...
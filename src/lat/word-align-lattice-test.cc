@@ -0,0 +1,203 @@
+// lat/word-align-lattice-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sstream>
+#include "hmm/transition-model.h"
+#include "tree/context-dep.h"
+#include "lat/kaldi-lattice.h"
+#include "lat/lattice-functions.h"
+#include "lat/determinize-lattice-pruned.h"
+#include "lat/word-align-lattice.h"
+
+namespace kaldi {
+
+// Phones 1 to 10 of the test model and their types in the word-boundary
+// information.
+const char *kTestWordBoundaryFile =
+    "1 nonword\n2 begin\n3 begin\n4 internal\n5 internal\n6 end\n7 end\n"
+    "8 singleton\n9 singleton\n10 singleton\n";
+
+// Returns a random pronunciation: a singleton phone, or a begin phone, up to
+// two internal phones and an end phone.
+std::vector<int32> RandPronunciation() {
+  std::vector<int32> pron;
+  if (Rand() % 2 == 0) {
+    pron.push_back(8 + Rand() % 3);
+  } else {
+    pron.push_back(2 + Rand() % 2);
+    for (int32 n = Rand() % 3; n > 0; n--)
+      pron.push_back(4 + Rand() % 2);
+    pron.push_back(6 + Rand() % 2);
+  }
+  return pron;
+}
+
+// Appends to "tids" a random sequence of transition-ids for one instance of
+// "phone" in the 3-state default topology; forward_tids[phone][h] and
+// self_loop_tids[phone][h] are transition-ids for the forward transition and
+// self-loop of HMM-state h of that phone.  If reorder is true the self-loops
+// of each state follow its forward transition.
+void AppendPhone(int32 phone, bool reorder,
+                 const std::vector<std::vector<int32> > &forward_tids,
+                 const std::vector<std::vector<int32> > &self_loop_tids,
+                 std::vector<int32> *tids) {
+  for (int32 h = 0; h < 3; h++) {
+    int32 num_self_loops = Rand() % 3;
+    if (reorder) tids->push_back(forward_tids[phone][h]);
+    for (int32 i = 0; i < num_self_loops; i++)
+      tids->push_back(self_loop_tids[phone][h]);
+    if (!reorder) tids->push_back(forward_tids[phone][h]);
+  }
+}
+
+// Returns a random lattice made from a few random paths, each a sequence of
+// words with optional silences, determinized as lattices normally are.  The
+// word label of each word is on a random one of its transition-ids.  If
+// truncate is true, some paths are cut short, as for a "forced-out" lattice.
+CompactLattice *RandWordLattice(const TransitionModel &tmodel,
+                                bool reorder, bool truncate) {
+  int32 num_phones = 10, num_words = 10;
+  std::vector<std::vector<int32> > forward_tids(num_phones + 1,
+                                                std::vector<int32>(3, 0)),
+      self_loop_tids(num_phones + 1, std::vector<int32>(3, 0));
+  // The self-loop must be of the same transition-state as the forward
+  // transition, as TestWordAlignedLattice() checks this if reorder == true.
+  for (int32 tid = 1; tid <= tmodel.NumTransitionIds(); tid++) {
+    int32 phone = tmodel.TransitionIdToPhone(tid),
+        h = tmodel.TransitionIdToHmmState(tid);
+    KALDI_ASSERT(phone <= num_phones && h < 3);
+    if (!tmodel.IsSelfLoop(tid) && forward_tids[phone][h] == 0) {
+      forward_tids[phone][h] = tid;
+      self_loop_tids[phone][h] =
+          tmodel.SelfLoopOf(tmodel.TransitionIdToTransitionState(tid));
+      KALDI_ASSERT(self_loop_tids[phone][h] != 0);
+    }
+  }
+  std::vector<std::vector<int32> > prons(num_words + 1);
+  for (int32 w = 1; w <= num_words; w++)
+    prons[w] = RandPronunciation();
+
+  Lattice lat;
+  LatticeArc::StateId start = lat.AddState();
+  lat.SetStart(start);
+  int32 num_paths = 1 + Rand() % 5;
+  for (int32 p = 0; p < num_paths; p++) {
+    std::vector<int32> tids, words;  // words[i] is the word on tids[i], or 0.
+    int32 path_words = 1 + Rand() % 4;
+    for (int32 i = 0; i <= path_words; i++) {
+      if (Rand() % 3 == 0) {  // optional silence.
+        AppendPhone(1, reorder, forward_tids, self_loop_tids, &tids);
+        words.resize(tids.size(), 0);
+      }
+      if (i == path_words) break;
+      int32 word = 1 + Rand() % num_words;
+      size_t word_start = tids.size();
+      for (size_t j = 0; j < prons[word].size(); j++)
+        AppendPhone(prons[word][j], reorder, forward_tids, self_loop_tids,
+                    &tids);
+      words.resize(tids.size(), 0);
+      words[word_start + Rand() % (tids.size() - word_start)] = word;
+    }
+    if (truncate && Rand() % 2 == 0) {
+      size_t length = 1 + Rand() % tids.size();
+      tids.resize(length);
+      words.resize(length);
+    }
+    LatticeArc::StateId cur = start;
+    for (size_t i = 0; i < tids.size(); i++) {
+      LatticeArc::StateId next = lat.AddState();
+      // words on the input side, for determinization.
+      lat.AddArc(cur, LatticeArc(words[i], tids[i],
+                                 LatticeWeight(RandUniform(), RandUniform()),
+                                 next));
+      cur = next;
+    }
+    lat.SetFinal(cur, LatticeWeight::One());
+  }
+  CompactLattice *clat = new CompactLattice;
+  fst::DeterminizeLatticePruned<LatticeWeight>(lat, 1000.0, clat);
+  return clat;
+}
+
+// Outputs the transition-ids, words and weight of the best path of "clat".
+void GetBestPath(const CompactLattice &clat, std::vector<int32> *tids,
+                 std::vector<int32> *words, LatticeWeight *weight) {
+  CompactLattice best_clat;
+  CompactLatticeShortestPath(clat, &best_clat);
+  Lattice best_lat;
+  ConvertLattice(best_clat, &best_lat);
+  KALDI_ASSERT(GetLinearSymbolSequence(best_lat, tids, words, weight));
+}
+
+// Checks properties of the output of WordAlignLattice() rather than comparing
+// it with a reference implementation: the best path keeps its transition-ids
+// and weight (the weights are random, so it is unique), and with a complete
+// lattice, it keeps its words, and TestWordAlignedLattice() checks that every
+// arc holds exactly one word, silence or nothing, and that the aligned lattice
+// is equivalent to the input.
+void TestWordAlignLattice(const TransitionModel &tmodel) {
+  WordBoundaryInfoNewOpts opts;
+  opts.reorder = (Rand() % 2 == 0);
+  if (Rand() % 2 == 0) opts.silence_label = 11;
+  if (Rand() % 2 == 0) opts.partial_word_label = 12;
+  WordBoundaryInfo info(opts);
+  std::istringstream is(kTestWordBoundaryFile);
+  info.Init(is);
+  CompiledWordBoundaryInfo compiled(tmodel, info);
+
+  bool truncate = (Rand() % 3 == 0);
+  CompactLattice *clat = RandWordLattice(tmodel, opts.reorder, truncate);
+  CompactLattice aligned;
+  bool ans = WordAlignLattice(*clat, compiled, 0, &aligned);
+
+  KALDI_ASSERT(aligned.Start() != fst::kNoStateId);
+  std::vector<int32> tids, words, aligned_tids, aligned_words;
+  LatticeWeight weight, aligned_weight;
+  GetBestPath(*clat, &tids, &words, &weight);
+  GetBestPath(aligned, &aligned_tids, &aligned_words, &aligned_weight);
+  KALDI_ASSERT(tids == aligned_tids);
+  KALDI_ASSERT(ApproxEqual(weight, aligned_weight));
+  if (!truncate) {
+    KALDI_ASSERT(ans);
+    // The aligned lattice may have silence labels that were not there before.
+    std::vector<int32> nonsilence_words;
+    for (size_t i = 0; i < aligned_words.size(); i++)
+      if (aligned_words[i] != opts.silence_label)
+        nonsilence_words.push_back(aligned_words[i]);
+    KALDI_ASSERT(words == nonsilence_words);
+    TestWordAlignedLattice(*clat, tmodel, info, aligned);
+  }
+  delete clat;
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  std::vector<int32> phones;
+  for (int32 i = 1; i <= 10; i++)
+    phones.push_back(i);
+  std::vector<int32> num_pdf_classes;
+  ContextDependency *ctx_dep =
+      GenRandContextDependencyLarge(phones, 3, 1, true, &num_pdf_classes);
+  HmmTopology topo = GetDefaultTopology(phones);
+  TransitionModel tmodel(*ctx_dep, topo);
+  delete ctx_dep;
+  for (int32 i = 0; i < 100; i++)
+    TestWordAlignLattice(tmodel);
+  std::cout << "Tests succeeded\n";
+}
@@ -56,37 +56,23 @@ class LatticeWordAligner {
     /// the output too fully.
     /// Note: the "next_state" of the arc will not be set, you have to do that
     /// yourself.
-    bool OutputArc(const WordBoundaryInfo &info,
-                   const TransitionModel &tmodel,
+    /// "compiled" is used to look up the transition-ids; the labels and the
+    /// reorder option are taken from "info".
+    bool OutputArc(const CompiledWordBoundaryInfo &compiled,
+                   const WordBoundaryInfo &info,
                    CompactLatticeArc *arc_out,
-                   bool *error) {
-      // order of this ||-expression doesn't matter for
-      // function behavior, only for efficiency, since the
-      // cases are disjoint.
-      return OutputNormalWordArc(info, tmodel, arc_out, error) ||
-          OutputSilenceArc(info, tmodel, arc_out, error) ||
-          OutputOnePhoneWordArc(info, tmodel, arc_out, error);
-    }
+                   bool *error);
 
-    bool OutputSilenceArc(const WordBoundaryInfo &info,
-                          const TransitionModel &tmodel,
-                          CompactLatticeArc *arc_out,
-                          bool *error); 
-    bool OutputOnePhoneWordArc(const WordBoundaryInfo &info,
-                               const TransitionModel &tmodel,
-                               CompactLatticeArc *arc_out,
-                               bool *error); 
-    bool OutputNormalWordArc(const WordBoundaryInfo &info,
-                             const TransitionModel &tmodel,
-                             CompactLatticeArc *arc_out,
-                             bool *error);
-    
-    bool IsEmpty() { return (transition_ids_.empty() && word_labels_.empty()); }
+    bool IsEmpty() const {
+      return (transition_ids_.empty() && word_labels_.empty());
+    }
     
     /// FinalWeight() will return "weight" if both transition_ids
     /// and word_labels are empty, otherwise it will return
     /// Weight::Zero().
-    LatticeWeight FinalWeight() { return (IsEmpty() ? weight_ : LatticeWeight::Zero()); }
+    LatticeWeight FinalWeight() const {
+      return (IsEmpty() ? weight_ : LatticeWeight::Zero());
+    }
 
     /// This function may be called when you reach the end of
     /// the lattice and this structure hasn't voluntarily
@@ -100,8 +86,8 @@ class LatticeWordAligner {
     /// will consist of partial words, and this will only
     /// happen for lattices that were somehow broken, i.e.
     /// had not reached the final state.
-    void OutputArcForce(const WordBoundaryInfo &info,
-                        const TransitionModel &tmodel,
+    void OutputArcForce(const CompiledWordBoundaryInfo &compiled,
+                        const WordBoundaryInfo &info,
                         CompactLatticeArc *arc_out,
                         bool *error);
   
@@ -115,34 +101,106 @@ class LatticeWordAligner {
       // efficiency issue.
     }
 
-    // Just need an arbitrary complete order.
+    // Just need an arbitrary complete order.  The scan_* variables are
+    // determined by transition_ids_ so we don't compare them.
     bool operator == (const ComputationState &other) const {
       return (transition_ids_ == other.transition_ids_
               && word_labels_ == other.word_labels_
               && weight_ == other.weight_);
     }
     
-    ComputationState(): weight_(LatticeWeight::One()) { } // initial state.
+    ComputationState(): weight_(LatticeWeight::One()), scan_pos_(0),
+                        scan_stage_(kScanStart), scan_phone_(0),
+                        unit_type_(WordBoundaryInfo::kNoPhone),
+                        unit_length_(0) { } // initial state.
     ComputationState(const ComputationState &other):
         transition_ids_(other.transition_ids_), word_labels_(other.word_labels_),
-        weight_(other.weight_) { }
+        weight_(other.weight_), scan_pos_(other.scan_pos_),
+        scan_stage_(other.scan_stage_), scan_phone_(other.scan_phone_),
+        unit_type_(other.unit_type_), unit_length_(other.unit_length_) { }
    private:
+    /// The stages of the automaton that finds the end of the word or silence
+    /// at the start of transition_ids_.
+    enum ScanStage {
+      kScanStart,          // Nothing scanned yet.
+      kScanNoUnit,         // The first phone can't begin a word or silence.
+      kScanToFinal,        // In a silence or one-phone word, looking for its
+                           // final transition-id.
+      kScanBeginToFinal,   // In the first phone of a longer word, looking for
+                           // its final transition-id.
+      kScanBeginSelfLoops, // After that, in its reordered self-loops.
+      kScanInternal,       // In the word-internal phones.
+      kScanEndToFinal,     // In the word-end phone, looking for its final
+                           // transition-id.
+      kScanSelfLoops,      // After the last final transition-id, in its
+                           // reordered self-loops.
+      kScanDone            // Found the end; it is unit_length_.
+    };
+
+    /// Scans the transition-ids that have not been scanned yet, stopping
+    /// once it knows where the first word or silence ends.  Each
+    /// transition-id is looked at once, so the alignment is linear in the
+    /// length of the words, where it used to be quadratic.
+    void Scan(const CompiledWordBoundaryInfo &compiled,
+              const WordBoundaryInfo &info, bool *error);
+
+    void ResetScan() {
+      scan_pos_ = 0;
+      scan_stage_ = kScanStart;
+    }
+
     std::vector<int32> transition_ids_;
     std::vector<int32> word_labels_;
     LatticeWeight weight_; // contains two floats.
+
+    size_t scan_pos_; // Number of transition-ids scanned.
+    ScanStage scan_stage_;
+    int32 scan_phone_; // The phone we're checking against (the first or last
+                       // phone of the word).
+    WordBoundaryInfo::PhoneType unit_type_; // Type of the first phone.
+    size_t unit_length_; // Number of transition-ids in the word or silence,
+                         // if scan_stage_ == kScanDone.
   };
 
 
+  struct ComputationStateHash {
+    size_t operator() (const ComputationState &state) const {
+      return state.Hash();
+    }
+  };
+  struct ComputationStateEqual {
+    bool operator () (const ComputationState &state1,
+                      const ComputationState &state2) const {
+      return state1 == state2;
+    }
+  };
+  typedef unordered_map<ComputationState, int32, ComputationStateHash,
+                        ComputationStateEqual> ComputationStateMap;
+
+  /// Returns the integer id of this computation state, adding it to
+  /// comp_states_ if we have not seen it before.  Each distinct computation
+  /// state is stored once, however many input states it is paired with.
+  int32 GetComputationStateId(const ComputationState &comp_state) {
+    ComputationStateMap::iterator iter = comp_state_map_.find(comp_state);
+    if (iter != comp_state_map_.end())
+      return iter->second;
+    int32 ans = comp_states_.size();
+    iter = comp_state_map_.insert(std::make_pair(comp_state, ans)).first;
+    comp_states_.push_back(&(iter->first));  // pointers to keys of an
+                                             // unordered_map stay valid.
+    return ans;
+  }
+
   struct Tuple {
-    Tuple(StateId input_state, ComputationState comp_state):
+    Tuple(StateId input_state, int32 comp_state):
         input_state(input_state), comp_state(comp_state) {}
     StateId input_state;
-    ComputationState comp_state;
+    int32 comp_state;  // index into comp_states_.
   };
 
   struct TupleHash {
     size_t operator() (const Tuple &state) const {
-      return state.input_state + 102763 * state.comp_state.Hash();
+      return state.input_state + 102763 * state.comp_state;
       // 102763 is just an arbitrary prime number 
     }
   };
@@ -174,10 +232,11 @@ class LatticeWordAligner {
     // final-prob of One().  [else it should be zero.  This
     // is because we called CreateSuperFinal().]
     
-    if (tuple.comp_state.IsEmpty()) { // computation state doesn't have
+    const ComputationState &comp_state = *(comp_states_[tuple.comp_state]);
+    if (comp_state.IsEmpty()) { // computation state doesn't have
       // anything pending.
       std::vector<int32> empty_vec;
-      CompactLatticeWeight cw(tuple.comp_state.FinalWeight(), empty_vec);
+      CompactLatticeWeight cw(comp_state.FinalWeight(), empty_vec);
       lat_out_->SetFinal(output_state, Plus(lat_out_->Final(output_state), cw));      
     } else {
       // computation state has something pending, i.e. input or
@@ -185,8 +244,11 @@ class LatticeWordAligner {
       // have returned false or we wouldn't have been called, so we have to
       // force it out.
       CompactLatticeArc lat_arc;
-      tuple.comp_state.OutputArcForce(info_, tmodel_, &lat_arc, &error_);
-      lat_arc.nextstate = GetStateForTuple(tuple, true); // true == add to queue.
+      ComputationState next_comp_state(comp_state);
+      next_comp_state.OutputArcForce(compiled_, info_, &lat_arc, &error_);
+      Tuple next_tuple(tuple.input_state,
+                       GetComputationStateId(next_comp_state));
+      lat_arc.nextstate = GetStateForTuple(next_tuple, true); // true == add to queue.
       // The final-prob stuff will get called again from ProcessQueueElement().
       // Note: because we did CreateSuperFinal(), this final-state on the input
       // lattice will have no output arcs (and unit final-prob), so there will be
@@ -210,10 +272,12 @@ class LatticeWordAligner {
     // epsilon-sequencing rules encoded by the filters in
     // composition.
     CompactLatticeArc lat_arc;
-    Tuple tuple2(tuple); // temp
-    if (tuple.comp_state.OutputArc(info_, tmodel_, &lat_arc, &error_)) {
-      // note: this function changes the tuple (when it returns true).
-      lat_arc.nextstate = GetStateForTuple(tuple, true); // true == add to queue,
+    // A copy, as OutputArc() changes it; if it returns false, the only change
+    // is how far it has scanned, which we keep for the successors.
+    ComputationState comp_state(*(comp_states_[tuple.comp_state]));
+    if (comp_state.OutputArc(compiled_, info_, &lat_arc, &error_)) {
+      Tuple next_tuple(tuple.input_state, GetComputationStateId(comp_state));
+      lat_arc.nextstate = GetStateForTuple(next_tuple, true); // true == add to queue,
       // if not already present.
       KALDI_ASSERT(output_state != lat_arc.nextstate);
       lat_out_->AddArc(output_state, lat_arc);
@@ -232,10 +296,10 @@ class LatticeWordAligner {
       for(fst::ArcIterator<CompactLattice> aiter(lat_, tuple.input_state);
           !aiter.Done(); aiter.Next()) {
         const CompactLatticeArc &arc = aiter.Value();
-        Tuple next_tuple(tuple);
+        ComputationState next_comp_state(comp_state);
         LatticeWeight weight;
-        next_tuple.comp_state.Advance(arc, &weight);
-        next_tuple.input_state = arc.nextstate;
+        next_comp_state.Advance(arc, &weight);
+        Tuple next_tuple(arc.nextstate, GetComputationStateId(next_comp_state));
         StateId next_output_state = GetStateForTuple(next_tuple, true); // true == add to queue,
         // if not already present.
         // We add an epsilon arc here (as the input and output happens
@@ -250,11 +314,11 @@ class LatticeWordAligner {
   }
   
   LatticeWordAligner(const CompactLattice &lat,
-                     const TransitionModel &tmodel,
-                     const WordBoundaryInfo &info,
+                     const CompiledWordBoundaryInfo &compiled,
                      int32 max_states,
                      CompactLattice *lat_out):
-      lat_(lat), tmodel_(tmodel), info_in_(info), info_(info),
+      lat_(lat), compiled_(compiled), info_in_(compiled.Info()),
+      info_(compiled.Info()),
       max_states_(max_states), lat_out_(lat_out),
       error_(false) {
     bool test = true;
@@ -307,7 +371,8 @@ class LatticeWordAligner {
       return false;
     }
     ComputationState initial_comp_state;
-    Tuple initial_tuple(lat_.Start(), initial_comp_state);
+    Tuple initial_tuple(lat_.Start(),
+                        GetComputationStateId(initial_comp_state));
     StateId start_state = GetStateForTuple(initial_tuple, true); // True = add this to queue.
     lat_out_->SetStart(start_state);
     
@@ -328,7 +393,7 @@ class LatticeWordAligner {
   }
   
   CompactLattice lat_;
-  const TransitionModel &tmodel_;
+  const CompiledWordBoundaryInfo &compiled_;
   const WordBoundaryInfo &info_in_;
   WordBoundaryInfo info_;
   int32 max_states_;
@@ -339,230 +404,189 @@ class LatticeWordAligner {
   
   
   MapType map_; // map from tuples to StateId.
+  ComputationStateMap comp_state_map_; // map from computation states to ids.
+  std::vector<const ComputationState*> comp_states_; // indexed by id; points
+                                                     // to keys of comp_state_map_.
   bool error_;
   
 };
 
-bool LatticeWordAligner::ComputationState::OutputSilenceArc(
-    const WordBoundaryInfo &info, const TransitionModel &tmodel,
-    CompactLatticeArc *arc_out,  bool *error) {
-  if (transition_ids_.empty()) return false;
-  int32 phone = tmodel.TransitionIdToPhone(transition_ids_[0]);
-  if (info.TypeOfPhone(phone) != WordBoundaryInfo::kNonWordPhone) return false;
-
-  // we assume the start of transition_ids_ is the start of the phone [silence];
-  // this is a precondition.
-  size_t len = transition_ids_.size(), i;
-  // Keep going till we reach a "final" transition-id; note, if
-  // reorder==true, we have to go a bit further after this.
-  for (i = 1; i < len; i++) {
-    int32 tid = transition_ids_[i];
-    int32 this_phone = tmodel.TransitionIdToPhone(tid);
-    if (this_phone != phone && ! *error) { // error condition: should have reached final transition-id first.
-      *error = true;
-      KALDI_WARN << "Phone changed before final transition-id found "
-          "[broken lattice or mismatched model or wrong --reorder option?]";
-    }
-    if (tmodel.IsFinal(tid))
-      break;
-  }
-  if (i == len) return false; // fell off loop.
-  i++; // go past the one for which IsFinal returned true.
-  if (info.reorder) // we have to consume the following self-loop transition-ids.
-    while (i < len && tmodel.IsSelfLoop(transition_ids_[i])) i++;
-  if (i == len) return false; // we don't know if it ends here... so can't output arc.
-
-  if (tmodel.TransitionIdToPhone(transition_ids_[i-1]) != phone
-      && ! *error) { // another check.
-    KALDI_WARN << "Phone changed unexpectedly in lattice "
-        "[broken lattice or mismatched model?]";
-  }
-  // interpret i as the number of transition-ids to consume.
-  std::vector<int32> tids_out(transition_ids_.begin(), transition_ids_.begin()+i);
-  
-  // consumed transition ids from our internal state.
-  *arc_out = CompactLatticeArc(info.silence_label, info.silence_label,
-                               CompactLatticeWeight(weight_, tids_out), fst::kNoStateId);
-  transition_ids_.erase(transition_ids_.begin(), transition_ids_.begin()+i); // delete these
-  weight_ = LatticeWeight::One(); // we just output the weight.
-  return true;
-}
-
-
-bool LatticeWordAligner::ComputationState::OutputOnePhoneWordArc(
-    const WordBoundaryInfo &info, const TransitionModel &tmodel,
-    CompactLatticeArc *arc_out,  bool *error) {
-  if (transition_ids_.empty()) return false;
-  if (word_labels_.empty()) return false;
-  int32 phone = tmodel.TransitionIdToPhone(transition_ids_[0]);
-  if (info.TypeOfPhone(phone) != WordBoundaryInfo::kWordBeginAndEndPhone)
-    return false;  
-  // we assume the start of transition_ids_ is the start of the phone.
-  // this is a precondition.
-  size_t len = transition_ids_.size(), i;
-  for (i = 1; i < len; i++) {
-    int32 tid = transition_ids_[i];
-    int32 this_phone = tmodel.TransitionIdToPhone(tid);
-    if (this_phone != phone && ! *error) { // error condition: should have reached final transition-id first.
-      KALDI_WARN << "Phone changed before final transition-id found "
-          "[broken lattice or mismatched model or wrong --reorder option?]";
-      // just continue, ignoring this-- we'll probably output something...
+void LatticeWordAligner::ComputationState::Scan(
+    const CompiledWordBoundaryInfo &compiled, const WordBoundaryInfo &info,
+    bool *error) {
+  // The checks and warnings below are those of the earlier code, which
+  // rescanned the transition-ids from the start each time it was called.
+  for (; scan_pos_ < transition_ids_.size(); scan_pos_++) {
+    const CompiledWordBoundaryInfo::TransitionInfo &t =
+        compiled.Lookup(transition_ids_[scan_pos_]);
+    switch (scan_stage_) {
+      case kScanStart:
+        scan_phone_ = t.phone;
+        unit_type_ = compiled.TypeOf(t);
+        if (unit_type_ == WordBoundaryInfo::kNonWordPhone ||
+            unit_type_ == WordBoundaryInfo::kWordBeginAndEndPhone) {
+          // we don't check whether the first transition-id of a silence or
+          // one-phone word is final.
+          scan_stage_ = kScanToFinal;
+        } else if (unit_type_ == WordBoundaryInfo::kWordBeginPhone) {
+          scan_stage_ = (t.is_final ? kScanBeginSelfLoops : kScanBeginToFinal);
+        } else {
+          scan_stage_ = kScanNoUnit;
+          return;
+        }
+        break;
+      case kScanToFinal:
+        if (t.phone != scan_phone_ && ! *error) {
+          // error condition: should have reached final transition-id first.
+          // For one-phone words we just continue, ignoring this-- we'll
+          // probably output something...
+          if (unit_type_ == WordBoundaryInfo::kNonWordPhone)
+            *error = true;
+          KALDI_WARN << "Phone changed before final transition-id found "
+              "[broken lattice or mismatched model or wrong --reorder option?]";
+        }
+        if (t.is_final)
+          scan_stage_ = kScanSelfLoops;
+        break;
+      case kScanBeginToFinal:
+        if (t.is_final)
+          scan_stage_ = kScanBeginSelfLoops;
+        break;
+      case kScanBeginSelfLoops:
+        // If reorder==true, we have to consume the self-loop transition-ids
+        // that follow the final transition.
+        if (info.reorder && t.is_self_loop)
+          break;
+        if (compiled.Lookup(transition_ids_[scan_pos_ - 1]).phone !=
+            scan_phone_ && ! *error) { // another check.
+          KALDI_WARN << "Phone changed unexpectedly in lattice "
+              "[broken lattice or mismatched model?]";
+          *error = true;
+        }
+        scan_stage_ = kScanInternal;
+        // fall through: this transition-id is in the next phone.
+      case kScanInternal: {
+        // Keep going till we hit a word-ending phone.  Note: we don't expect
+        // anything except word-internal phones here, but we'll just print a
+        // warning if we get something else.
+        WordBoundaryInfo::PhoneType type = compiled.TypeOf(t);
+        if (type != WordBoundaryInfo::kWordEndPhone) {
+          if (type != WordBoundaryInfo::kWordInternalPhone && ! *error) {
+            KALDI_WARN << "Unexpected phone " << t.phone
+                       << " found inside a word.";
+            *error = true;
+          }
+          break;
+        }
+        scan_phone_ = t.phone;
+        scan_stage_ = kScanEndToFinal;
+      }
+        // fall through: continue till we get to a "final-transition".
+      case kScanEndToFinal:
+        if (t.phone != scan_phone_ && ! *error) {
+          *error = true;
+          KALDI_WARN << "Phone changed before final transition-id found "
+              "[broken lattice or mismatched model or wrong --reorder option?]";
+        }
+        if (t.is_final)
+          scan_stage_ = kScanSelfLoops;
+        break;
+      case kScanSelfLoops:
+        if (info.reorder && t.is_self_loop)
+          break;
+        // This transition-id is the first one after the word or silence.
+        if (compiled.Lookup(transition_ids_[scan_pos_ - 1]).phone !=
+            scan_phone_ && ! *error) { // another check.
+          if (unit_type_ == WordBoundaryInfo::kWordBeginPhone) {
+            *error = true;
+            KALDI_WARN << "Phone changed while following final self-loop "
+                "[broken lattice or mismatched model or wrong --reorder option?]";
+          } else {
+            if (unit_type_ == WordBoundaryInfo::kWordBeginAndEndPhone)
+              *error = true;
+            KALDI_WARN << "Phone changed unexpectedly in lattice "
+                "[broken lattice or mismatched model?]";
+          }
+        }
+        unit_length_ = scan_pos_;
+        scan_stage_ = kScanDone;
+        return;
+      case kScanNoUnit: case kScanDone:
+        return;
     }
-    if (tmodel.IsFinal(tid))
-      break;
   }
-  if (i == len) return false; // fell off loop.
-  i++; // go past the one for which IsFinal returned true.
-  if (info.reorder) // we have to consume the following self-loop transition-ids.
-    while (i < len && tmodel.IsSelfLoop(transition_ids_[i])) i++;
-  if (i == len) return false; // we don't know if it ends here... so can't output arc.
-  
-  if (tmodel.TransitionIdToPhone(transition_ids_[i-1]) != phone
-      && ! *error) { // another check.
-    KALDI_WARN << "Phone changed unexpectedly in lattice "
-        "[broken lattice or mismatched model?]";
-    *error = true;
-  }
-  
-  // interpret i as the number of transition-ids to consume.
-  std::vector<int32> tids_out(transition_ids_.begin(), transition_ids_.begin()+i);
-  
-  // consumed transition ids from our internal state.
-  int32 word = word_labels_[0];
-  *arc_out = CompactLatticeArc(word, word,
-                               CompactLatticeWeight(weight_, tids_out), fst::kNoStateId);
-  transition_ids_.erase(transition_ids_.begin(), transition_ids_.begin()+i); // delete these
-  word_labels_.erase(word_labels_.begin(), word_labels_.begin()+1); // remove the word we output.
-  weight_ = LatticeWeight::One(); // we just output the weight.
-  return true;
 }
 
-
-/// This function tries to see if it can output a normal word arc--
-/// one with at least two phones in it.
-bool LatticeWordAligner::ComputationState::OutputNormalWordArc(
-    const WordBoundaryInfo &info, const TransitionModel &tmodel,
+bool LatticeWordAligner::ComputationState::OutputArc(
+    const CompiledWordBoundaryInfo &compiled, const WordBoundaryInfo &info,
     CompactLatticeArc *arc_out,  bool *error) {
   if (transition_ids_.empty()) return false;
-  if (word_labels_.empty()) return false;
-  int32 begin_phone = tmodel.TransitionIdToPhone(transition_ids_[0]);
-  if (info.TypeOfPhone(begin_phone) != WordBoundaryInfo::kWordBeginPhone)
-    return false;  
-  // we assume the start of transition_ids_ is the start of the phone.
-  // this is a precondition.
-  size_t len = transition_ids_.size(), i;
-
-  // Eat up the transition-ids of this word-begin phone until we get to the
-  // "final" transition-id.  [there may be self-loops following this though,
-  // if reorder==true]
-  for (i = 0; i < len && !tmodel.IsFinal(transition_ids_[i]); i++);
-  if (i == len) return false;
-  i++; // Skip over this final-transition.
-  if (info.reorder) // Skip over any reordered self-loops for this final-transition
-    for (; i < len && tmodel.IsSelfLoop(transition_ids_[i]); i++);
-  if (i == len) return false;
-  if (tmodel.TransitionIdToPhone(transition_ids_[i-1]) != begin_phone
-      && ! *error) { // another check.
-    KALDI_WARN << "Phone changed unexpectedly in lattice "
-        "[broken lattice or mismatched model?]";
-    *error = true;
-  }
-  // Now keep going till we hit a word-ending phone.
-  // Note: we don't expect anything except word-internal phones
-  // here, but we'll just print a warning if we get something
-  // else.
-  for (; i < len; i++) {
-    int32 this_phone = tmodel.TransitionIdToPhone(transition_ids_[i]);
-    if (info.TypeOfPhone(this_phone) == WordBoundaryInfo::kWordEndPhone)
-      break;
-    if (info.TypeOfPhone(this_phone) != WordBoundaryInfo::kWordInternalPhone
-        && !*error) {
-      KALDI_WARN << "Unexpected phone " << this_phone
-                 << " found inside a word.";
-      *error = true;
-    }
-  }
-  if (i == len) return false;
-
-  // OK, we hit a word-ending phone.  Continue till we get to
-  // a "final-transition".
-
-  // this variable just used for checks.
-  int32 final_phone = tmodel.TransitionIdToPhone(transition_ids_[i]); 
-  for (; i < len; i++) {
-    int32 this_phone = tmodel.TransitionIdToPhone(transition_ids_[i]);
-    if (this_phone != final_phone && ! *error) {
-      *error = true;
-      KALDI_WARN << "Phone changed before final transition-id found "
-          "[broken lattice or mismatched model or wrong --reorder option?]";
-    }
-    if (tmodel.IsFinal(transition_ids_[i])) break;
-  }
-  if (i == len) return false;
-  i++;
-  // We got to the final-transition of the final phone;
-  // if reorder==true, continue eating up the self-loop.
-  if (info.reorder == true)
-    while (i < len && tmodel.IsSelfLoop(transition_ids_[i])) i++;
-  if (i == len) return false;
-  if (tmodel.TransitionIdToPhone(transition_ids_[i-1]) != final_phone
-      && ! *error) {
-    *error = true;
-    KALDI_WARN << "Phone changed while following final self-loop "
-        "[broken lattice or mismatched model or wrong --reorder option?]";
+  // We can't output a word before we have seen its label.
+  if (word_labels_.empty() &&
+      compiled.TypeOf(compiled.Lookup(transition_ids_[0])) !=
+      WordBoundaryInfo::kNonWordPhone) return false;
+  Scan(compiled, info, error);
+  if (scan_stage_ != kScanDone) return false;
+
+  // interpret unit_length_ as the number of transition-ids to consume.
+  std::vector<int32> tids_out(transition_ids_.begin(),
+                              transition_ids_.begin() + unit_length_);
+  int32 label;
+  if (unit_type_ == WordBoundaryInfo::kNonWordPhone) {
+    label = info.silence_label;
+  } else {
+    label = word_labels_[0];
+    word_labels_.erase(word_labels_.begin(), word_labels_.begin()+1); // remove the word we output.
   }
-
-  // OK, we're ready to output the word.
-  // Interpret i as the number of transition-ids to consume.
-  std::vector<int32> tids_out(transition_ids_.begin(), transition_ids_.begin()+i);
-  
-  // consumed transition ids from our internal state.
-  int32 word = word_labels_[0];
-  *arc_out = CompactLatticeArc(word, word,
+  *arc_out = CompactLatticeArc(label, label,
                                CompactLatticeWeight(weight_, tids_out),
                                fst::kNoStateId);
-  transition_ids_.erase(transition_ids_.begin(), transition_ids_.begin()+i); // delete these
-  word_labels_.erase(word_labels_.begin(), word_labels_.begin()+1); // remove the word we output.
+  // consumed transition ids from our internal state.
+  transition_ids_.erase(transition_ids_.begin(),
+                        transition_ids_.begin() + unit_length_); // delete these
   weight_ = LatticeWeight::One(); // we just output the weight.
+  ResetScan();
   return true;
 }
 
 // Returns true if this vector of transition-ids could be a valid
 // word.  Note: the checks are not 100% exhaustive.
-static bool IsPlausibleWord(const WordBoundaryInfo &info,
-                            const TransitionModel &tmodel,
+static bool IsPlausibleWord(const CompiledWordBoundaryInfo &compiled,
+                            const WordBoundaryInfo &info,
                             const std::vector<int32> &transition_ids) {
   if (transition_ids.empty()) return false;
-  int32 first_phone = tmodel.TransitionIdToPhone(transition_ids.front()),
-      last_phone = tmodel.TransitionIdToPhone(transition_ids.back());
-  if ( (info.TypeOfPhone(first_phone) == WordBoundaryInfo::kWordBeginAndEndPhone
-        && first_phone == last_phone)
+  const CompiledWordBoundaryInfo::TransitionInfo
+      &first = compiled.Lookup(transition_ids.front()),
+      &last = compiled.Lookup(transition_ids.back());
+  if ( (compiled.TypeOf(first) == WordBoundaryInfo::kWordBeginAndEndPhone
+        && first.phone == last.phone)
        ||
-       (info.TypeOfPhone(first_phone) == WordBoundaryInfo::kWordBeginPhone &&
-        info.TypeOfPhone(last_phone) == WordBoundaryInfo::kWordEndPhone) ) {
+       (compiled.TypeOf(first) == WordBoundaryInfo::kWordBeginPhone &&
+        compiled.TypeOf(last) == WordBoundaryInfo::kWordEndPhone) ) {
     if (! info.reorder) {
-      return (tmodel.IsFinal(transition_ids.back()));
+      return last.is_final;
     } else {
       int32 i = transition_ids.size() - 1;
-      while (i > 0 && tmodel.IsSelfLoop(transition_ids[i])) i--;
-      return tmodel.IsFinal(transition_ids[i]);
+      while (i > 0 && compiled.Lookup(transition_ids[i]).is_self_loop) i--;
+      return compiled.Lookup(transition_ids[i]).is_final;
     }
   } else return false;
 }
 
     
 void LatticeWordAligner::ComputationState::OutputArcForce(
-    const WordBoundaryInfo &info, const TransitionModel &tmodel,
+    const CompiledWordBoundaryInfo &compiled, const WordBoundaryInfo &info,
     CompactLatticeArc *arc_out,  bool *error) {
 
   KALDI_ASSERT(!IsEmpty());
+  ResetScan(); // we'll output all the transition-ids.
   if (!word_labels_.empty()
       && !transition_ids_.empty()) { // We have at least one word to
     // output, and some transition-ids.  We assume that the normal OutputArc was called
     // and failed, so this means we didn't see the end of that
     // word. 
     int32 word = word_labels_[0];
-    if (! *error && !IsPlausibleWord(info, tmodel, transition_ids_)) {
+    if (! *error && !IsPlausibleWord(compiled, info, transition_ids_)) {
       *error = true;
       KALDI_WARN << "Invalid word at end of lattice [partial lattice, forced out?]";
     }
@@ -589,10 +613,12 @@ void LatticeWordAligner::ComputationState::OutputArcForce(
     word_labels_.clear();
   } else if (!transition_ids_.empty() && word_labels_.empty()) {
     // Transition-ids but no word label-- either silence or partial word.
-    int32 first_phone = tmodel.TransitionIdToPhone(transition_ids_[0]);
-    if (info.TypeOfPhone(first_phone) == WordBoundaryInfo::kNonWordPhone) {
+    const CompiledWordBoundaryInfo::TransitionInfo
+        &first = compiled.Lookup(transition_ids_[0]);
+    int32 first_phone = first.phone;
+    if (compiled.TypeOf(first) == WordBoundaryInfo::kNonWordPhone) {
       // first phone is silence...
-      if (first_phone != tmodel.TransitionIdToPhone(transition_ids_.back())
+      if (first_phone != compiled.Lookup(transition_ids_.back()).phone
           && ! *error) {
         *error = true;
         // Phone changed-- this is a code error, because the regular OutputArc
@@ -604,8 +630,8 @@ void LatticeWordAligner::ComputationState::OutputArcForce(
       if (!*error) { // Check that it ends at the end state of silence; error otherwise.
         int32 i = transition_ids_.size() - 1;
         if (info.reorder)
-          while(tmodel.IsSelfLoop(transition_ids_[i]) && i > 0) i--;
-        if (!tmodel.IsFinal(transition_ids_[i])) {
+          while(compiled.Lookup(transition_ids_[i]).is_self_loop && i > 0) i--;
+        if (!compiled.Lookup(transition_ids_[i]).is_final) {
           *error = true;
           KALDI_WARN << "Broken silence arc at end of utterance (does not "
               "reach end of silence)";
@@ -708,12 +734,38 @@ void WordBoundaryInfo::Init(std::istream &stream) {
     KALDI_ERR << "Empty word-boundary file";
 }
   
+CompiledWordBoundaryInfo::CompiledWordBoundaryInfo(
+    const TransitionModel &tmodel, const WordBoundaryInfo &info):
+    info_(info) {
+  int32 num_tids = tmodel.NumTransitionIds();
+  transitions_.resize(num_tids + 1); // transition-ids are one-based.
+  for (int32 tid = 1; tid <= num_tids; tid++) {
+    TransitionInfo &t = transitions_[tid];
+    t.phone = tmodel.TransitionIdToPhone(tid);
+    if (t.phone >= 0 &&
+        static_cast<size_t>(t.phone) < info.phone_to_type.size())
+      t.type = info.phone_to_type[t.phone];
+    else
+      t.type = -1;
+    t.is_final = tmodel.IsFinal(tid);
+    t.is_self_loop = tmodel.IsSelfLoop(tid);
+  }
+}
+
 bool WordAlignLattice(const CompactLattice &lat,
                       const TransitionModel &tmodel,
                       const WordBoundaryInfo &info,
                       int32 max_states,
                       CompactLattice *lat_out) {
-  LatticeWordAligner aligner(lat, tmodel, info, max_states, lat_out);
+  CompiledWordBoundaryInfo compiled(tmodel, info);
+  return WordAlignLattice(lat, compiled, max_states, lat_out);
+}
+
+bool WordAlignLattice(const CompactLattice &lat,
+                      const CompiledWordBoundaryInfo &info,
+                      int32 max_states,
+                      CompactLattice *lat_out) {
+  LatticeWordAligner aligner(lat, info, max_states, lat_out);
   return aligner.AlignLattice();
 }
 
@@ -168,6 +168,50 @@ struct WordBoundaryInfo {
   void SetOptions(const std::string int_list, PhoneType phone_type);
 };
 
+/// This class is a compiled form of a WordBoundaryInfo, for a particular
+/// TransitionModel.  For each transition-id it stores, in one table, the
+/// things the word-alignment code needs to know about it (its phone, the type
+/// of that phone, and whether it is a final transition or a self-loop); the
+/// word-alignment code uses these to run a small automaton over the
+/// transition-ids of each path, which finds where words and silences end.
+/// Build it once per model.  WordAlignLattice() does not change it, so one
+/// object may be shared between several threads.
+class CompiledWordBoundaryInfo {
+ public:
+  CompiledWordBoundaryInfo(const TransitionModel &tmodel,
+                           const WordBoundaryInfo &info);
+
+  struct TransitionInfo {
+    int32 phone;
+    int16 type; // a WordBoundaryInfo::PhoneType, or -1 if the phone was not
+                // in the word-boundary information.
+    bool is_final;
+    bool is_self_loop;
+  };
+
+  const TransitionInfo &Lookup(int32 trans_id) const {
+    if (static_cast<size_t>(trans_id) >= transitions_.size() || trans_id <= 0)
+      KALDI_ERR << "Transition-id " << trans_id << " is out of range "
+                << "[mismatched model?]";
+    return transitions_[trans_id];
+  }
+
+  /// Returns the type of the phone of this transition; it is an error if the
+  /// phone was not in the word-boundary information.
+  WordBoundaryInfo::PhoneType TypeOf(const TransitionInfo &t) const {
+    if (t.type < 0)
+      KALDI_ERR << "Phone " << t.phone << " was not specified in "
+          "word-boundary file (or options)";
+    return static_cast<WordBoundaryInfo::PhoneType>(t.type);
+  }
+
+  const WordBoundaryInfo &Info() const { return info_; }
+
+ private:
+  WordBoundaryInfo info_;
+  std::vector<TransitionInfo> transitions_; // indexed by transition-id.
+};
+
 /// Align lattice so that each arc has the transition-ids on it
 /// that correspond to the word that is on that arc.  [May also have
 /// epsilon arcs for optional silences.]
@@ -194,6 +238,14 @@ bool WordAlignLattice(const CompactLattice &lat,
                       int32 max_states,
                       CompactLattice *lat_out);
 
+/// This version of WordAlignLattice() is as above, but uses a
+/// CompiledWordBoundaryInfo; this is more efficient if you are going to
+/// align many lattices with the same model.
+bool WordAlignLattice(const CompactLattice &lat,
+                      const CompiledWordBoundaryInfo &info,
+                      int32 max_states,
+                      CompactLattice *lat_out);
+
 
 
 /// This function is designed to crash if something went wrong with the
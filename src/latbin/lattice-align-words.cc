@@ -23,6 +23,98 @@
 #include "lat/kaldi-lattice.h"
 #include "lat/word-align-lattice.h"
 #include "lat/lattice-functions.h"
+#include "base/timer.h"
+#include "thread/kaldi-task-sequence.h"
+
+namespace kaldi {
+
+class WordAlignLatticeTask {
+ public:
+  // Initializer takes ownership of "clat".
+  WordAlignLatticeTask(const TransitionModel &tmodel,
+                       const CompiledWordBoundaryInfo &info,
+                       std::string key,
+                       BaseFloat max_expand,
+                       bool output_if_error,
+                       bool do_test,
+                       CompactLattice *clat,
+                       CompactLatticeWriter *clat_writer,
+                       int32 *num_done,
+                       int32 *num_err,
+                       double *tot_time):
+      tmodel_(tmodel), info_(info), key_(key), max_expand_(max_expand),
+      output_if_error_(output_if_error), do_test_(do_test), clat_(clat),
+      ok_(false), elapsed_(0.0), clat_writer_(clat_writer),
+      num_done_(num_done), num_err_(num_err), tot_time_(tot_time) { }
+
+  void operator () () {
+    Timer timer;
+    int32 max_states;
+    if (max_expand_ > 0) max_states = 1000 + max_expand_ * clat_->NumStates();
+    else max_states = 0;
+
+    ok_ = WordAlignLattice(*clat_, info_, max_states, &aligned_clat_);
+
+    if (do_test_ && ok_)
+      TestWordAlignedLattice(*clat_, tmodel_, info_.Info(), aligned_clat_);
+    delete clat_; // This is no longer needed so we can delete it now.
+    clat_ = NULL;
+    if (aligned_clat_.Start() != fst::kNoStateId)
+      TopSortCompactLatticeIfNeeded(&aligned_clat_);
+    elapsed_ = timer.Elapsed();
+  }
+
+  // The output is written, and the counts updated, in the destructor, which
+  // the TaskSequencer calls in the same order as the lattices were read.
+  ~WordAlignLatticeTask() {
+    delete clat_; // in case operator () was never called.
+    KALDI_VLOG(1) << "Aligning lattice for " << key_ << " took "
+                  << elapsed_ << " seconds.";
+    *tot_time_ += elapsed_;
+    if (!ok_) {
+      (*num_err_)++;
+      if (!output_if_error_)
+        KALDI_WARN << "Lattice for " << key_
+                   << " did not align correctly, producing no output.";
+      else {
+        if (aligned_clat_.Start() != fst::kNoStateId) {
+          KALDI_WARN << "Outputting partial lattice for " << key_;
+          clat_writer_->Write(key_, aligned_clat_);
+        } else {
+          KALDI_WARN << "Empty aligned lattice for " << key_
+                     << ", producing no output.";
+        }
+      }
+    } else {
+      if (aligned_clat_.Start() == fst::kNoStateId) {
+        (*num_err_)++;
+        KALDI_WARN << "Lattice was empty for key " << key_;
+      } else {
+        (*num_done_)++;
+        KALDI_VLOG(2) << "Aligned lattice for " << key_;
+        clat_writer_->Write(key_, aligned_clat_);
+      }
+    }
+  }
+ private:
+  const TransitionModel &tmodel_;
+  const CompiledWordBoundaryInfo &info_;
+  std::string key_;
+  BaseFloat max_expand_;
+  bool output_if_error_;
+  bool do_test_;
+  CompactLattice *clat_; // The input lattice.  Owned locally.
+  CompactLattice aligned_clat_; // The output of our process.  Will be written
+  // to clat_writer_ in the destructor.
+  bool ok_;
+  double elapsed_;
+  CompactLatticeWriter *clat_writer_;
+  int32 *num_done_;
+  int32 *num_err_;
+  double *tot_time_;
+};
+
+} // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -40,7 +132,9 @@ int main(int argc, char *argv[]) {
         "Note: word-boundary file has format (on each line):\n"
         "<integer-phone-id> [begin|end|singleton|internal|nonword]\n"
         "See also: lattice-align-words-lexicon, for use in cases where phones\n"
-        "don't have word-position information.\n";
+        "don't have word-position information.\n"
+        "With --num-threads > 1, lattices are aligned in parallel (the output\n"
+        "order is unchanged).\n";
     
     ParseOptions po(usage);
     BaseFloat max_expand = 0.0;
@@ -57,6 +151,8 @@ int main(int argc, char *argv[]) {
     
     WordBoundaryInfoNewOpts opts;
     opts.Register(&po);
+    TaskSequencerConfig sequencer_config; // has --num-threads option
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
 
@@ -78,52 +174,30 @@ int main(int argc, char *argv[]) {
     CompactLatticeWriter clat_writer(lats_wspecifier); 
 
     WordBoundaryInfo info(opts, word_boundary_rxfilename);
-    
+    // Work out the type of each transition-id once, rather than for every
+    // lattice.
+    CompiledWordBoundaryInfo compiled_info(tmodel, info);
+
     int32 num_done = 0, num_err = 0;
-    
-    for (; !clat_reader.Done(); clat_reader.Next()) {
-      std::string key = clat_reader.Key();
-      const CompactLattice &clat = clat_reader.Value();
-
-      CompactLattice aligned_clat;
-      int32 max_states;
-      if (max_expand > 0) max_states = 1000 + max_expand * clat.NumStates();
-      else max_states = 0;
-      
-      bool ok = WordAlignLattice(clat, tmodel, info, max_states, &aligned_clat);
-      
-      if (do_test && ok)
-        TestWordAlignedLattice(clat, tmodel, info, aligned_clat);
-
-      if (!ok) {
-        num_err++;
-        if (!output_if_error)
-          KALDI_WARN << "Lattice for " << key
-                     << " did not align correctly, producing no output.";
-        else {
-          if (aligned_clat.Start() != fst::kNoStateId) {
-            KALDI_WARN << "Outputting partial lattice for " << key;
-            TopSortCompactLatticeIfNeeded(&aligned_clat);
-            clat_writer.Write(key, aligned_clat);
-          } else {
-            KALDI_WARN << "Empty aligned lattice for " << key
-                       << ", producing no output.";
-          }
-        }
-      } else {
-        if (aligned_clat.Start() == fst::kNoStateId) {
-          num_err++;
-          KALDI_WARN << "Lattice was empty for key " << key;
-        } else {
-          num_done++;
-          KALDI_VLOG(2) << "Aligned lattice for " << key;
-          TopSortCompactLatticeIfNeeded(&aligned_clat);
-          clat_writer.Write(key, aligned_clat);
-        }
+    double tot_time = 0.0;
+
+    {
+      TaskSequencer<WordAlignLatticeTask> sequencer(sequencer_config);
+      for (; !clat_reader.Done(); clat_reader.Next()) {
+        std::string key = clat_reader.Key();
+        // will give ownership to "task" below.
+        CompactLattice *clat = new CompactLattice(clat_reader.Value());
+        sequencer.Run(new WordAlignLatticeTask(
+            tmodel, compiled_info, key, max_expand, output_if_error, do_test,
+            clat, &clat_writer, &num_done, &num_err, &tot_time));
       }
+      sequencer.Wait();
     }
+    int32 num_lats = num_done + num_err;
     KALDI_LOG << "Successfully aligned " << num_done << " lattices; "
               << num_err << " had errors.";
+    KALDI_LOG << "Average time per lattice was "
+              << (num_lats != 0 ? tot_time / num_lats : 0.0) << " seconds.";
     return (num_done > num_err ? 0 : 1); // We changed the error condition slightly here,
     // if there are errors in the word-boundary phones we can get situations
     // where most lattices give an error.
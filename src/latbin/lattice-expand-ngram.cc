@@ -20,6 +20,7 @@
 #include "util/common-utils.h"
 #include "fstext/fstext-lib.h"
 #include "lat/kaldi-lattice.h"
+#include "lat/lattice-ngram-expand.h"
 
 int main(int argc, char *argv[]) {
   try {
@@ -32,16 +33,20 @@ int main(int argc, char *argv[]) {
 
     const char *usage =
       "Expand lattices so that each arc has a unique n-label history, for\n"
-      "a specified n (defaults to 3).\n"
+      "a specified n (defaults to 3).  With --expand-beam or --max-histories,\n"
+      "(lattice-state, history) pairs unlikely to be on good paths are not\n"
+      "expanded, which keeps the output size manageable for large n.\n"
       "Usage: lattice-expand-ngram [options] lattice-rspecifier "
       "lattice-wspecifier\n"
       "e.g.: lattice-expand-ngram --n=3 ark:lat ark:expanded_lat\n";
       
     ParseOptions po(usage);
     int32 n = 3;
+    NgramExpandOptions expand_opts;
 
     std::string word_syms_filename;
     po.Register("n", &n, "n-gram context to expand to.");
+    expand_opts.Register(&po);
     
     po.Read(argc, argv);
  
@@ -55,7 +60,7 @@ int main(int argc, char *argv[]) {
     std::string lats_rspecifier = po.GetArg(1),
       lats_wspecifier = po.GetOptArg(2);
 
-    fst::UnweightedNgramFst<CompactLatticeArc> expand_fst(n);
+    fst::UnweightedNgramFst<fst::StdArc> expand_fst(n);
 
     SequentialCompactLatticeReader lat_reader(lats_rspecifier);
     CompactLatticeWriter lat_writer(lats_wspecifier); 
@@ -67,7 +72,7 @@ int main(int argc, char *argv[]) {
       KALDI_LOG << "Processing lattice for key " << key;
       CompactLattice lat = lat_reader.Value();
       CompactLattice expanded_lat;
-      ComposeDeterministicOnDemand(lat, &expand_fst, &expanded_lat);
+      ExpandCompactLatticeNgram(lat, &expand_fst, expand_opts, &expanded_lat);
       if (expanded_lat.Start() == fst::kNoStateId) {
         KALDI_WARN << "Empty lattice for utterance " << key << std::endl;
        n_fail++;
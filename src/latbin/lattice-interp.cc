@@ -22,6 +22,7 @@
 #include "util/common-utils.h"
 #include "fstext/fstext-lib.h"
 #include "lat/kaldi-lattice.h"
+#include "lat/packed-lattice.h"
 
 int main(int argc, char *argv[]) {
   try {
@@ -60,7 +61,9 @@ int main(int argc, char *argv[]) {
         lats_wspecifier = po.GetArg(3);
     
     SequentialLatticeReader lattice_reader1(lats_rspecifier1);
-    RandomAccessCompactLatticeReader lattice_reader2(lats_rspecifier2);
+    // Read in packed form, as if the archive is not sorted the reader keeps
+    // all the lattices in memory.
+    RandomAccessPackedCompactLatticeReader lattice_reader2(lats_rspecifier2);
 
     CompactLatticeWriter compact_lattice_writer(lats_wspecifier);
 
@@ -75,7 +78,8 @@ int main(int argc, char *argv[]) {
       
       if (lattice_reader2.HasKey(key)) {
         n_processed++;
-        CompactLattice clat2 = lattice_reader2.Value(key);
+        CompactLattice clat2;
+        lattice_reader2.Value(key).Unpack(&clat2);
         RemoveAlignmentsFromCompactLattice(&clat2);
         
         Lattice lat2;
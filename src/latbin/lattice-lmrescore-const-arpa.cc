@@ -22,9 +22,88 @@
 #include "fstext/fstext-lib.h"
 #include "lat/kaldi-lattice.h"
 #include "lat/lattice-functions.h"
+#include "lat/lattice-ngram-expand.h"
 #include "lm/const-arpa-lm.h"
+#include "thread/kaldi-task-sequence.h"
 #include "util/common-utils.h"
 
+namespace kaldi {
+
+class ConstArpaRescoreTask {
+ public:
+  // Takes ownership of "clat".
+  ConstArpaRescoreTask(const ConstArpaLm &const_arpa,
+                       const NgramExpandOptions &expand_opts,
+                       BaseFloat lm_scale, const std::string &key,
+                       CompactLattice *clat,
+                       CompactLatticeWriter *compact_lattice_writer,
+                       int32 *n_done, int32 *n_fail,
+                       NgramExpandStats *stats):
+      const_arpa_(const_arpa), expand_opts_(expand_opts),
+      lm_scale_(lm_scale), key_(key), clat_(clat),
+      compact_lattice_writer_(compact_lattice_writer), n_done_(n_done),
+      n_fail_(n_fail), stats_(stats) { }
+
+  void operator () () {
+    if (lm_scale_ == 0.0) return;  // Zero scale so nothing to do.
+    // Before composing with the LM FST, we scale the lattice weights
+    // by the inverse of "lm_scale".  We'll later scale by "lm_scale".
+    // We do it this way so we can determinize and it will give the
+    // right effect (taking the "best path" through the LM) regardless
+    // of the sign of lm_scale.
+    fst::ScaleLattice(fst::GraphLatticeScale(1.0 / lm_scale_), clat_);
+    ArcSort(clat_, fst::OLabelCompare<CompactLatticeArc>());
+
+    // Wraps the ConstArpaLm format language model into FST. We re-create it
+    // for each lattice to prevent memory usage increasing with time.
+    ConstArpaLmDeterministicFst const_arpa_fst(const_arpa_);
+
+    // Composes lattice with language model.
+    CompactLattice composed_clat;
+    ExpandCompactLatticeNgram(*clat_, &const_arpa_fst, expand_opts_,
+                              &composed_clat, &stats_this_);
+    delete clat_;
+    clat_ = NULL;
+
+    // Determinizes the composed lattice.
+    Lattice composed_lat;
+    ConvertLattice(composed_clat, &composed_lat);
+    Invert(&composed_lat);
+    DeterminizeLattice(composed_lat, &determinized_clat_);
+    fst::ScaleLattice(fst::GraphLatticeScale(lm_scale_), &determinized_clat_);
+  }
+
+  ~ConstArpaRescoreTask() {
+    if (clat_ != NULL) {  // lm_scale_ was zero.
+      compact_lattice_writer_->Write(key_, *clat_);
+      delete clat_;
+      (*n_done_)++;
+    } else if (determinized_clat_.Start() == fst::kNoStateId) {
+      KALDI_WARN << "Empty lattice for utterance " << key_
+                 << " (incompatible LM?)";
+      (*n_fail_)++;
+    } else {
+      compact_lattice_writer_->Write(key_, determinized_clat_);
+      (*n_done_)++;
+    }
+    stats_->Add(stats_this_);
+  }
+ private:
+  const ConstArpaLm &const_arpa_;
+  const NgramExpandOptions &expand_opts_;
+  BaseFloat lm_scale_;
+  std::string key_;
+  CompactLattice *clat_;
+  CompactLattice determinized_clat_;
+  CompactLatticeWriter *compact_lattice_writer_;
+  int32 *n_done_;
+  int32 *n_fail_;
+  NgramExpandStats *stats_;
+  NgramExpandStats stats_this_;
+};
+
+}  // namespace kaldi
+
 int main(int argc, char *argv[]) {
   try {
     using namespace kaldi;
@@ -35,8 +114,9 @@ int main(int argc, char *argv[]) {
         "Rescores lattice with the ConstArpaLm format language model. The LM\n"
         "will be wrapped into the DeterministicOnDemandFst interface and the\n"
         "rescoring is done by composing with the wrapped LM using a special\n"
-        "type of composition algorithm. Determinization will be applied on\n"
-        "the composed lattice.\n"
+        "type of composition algorithm, which can prune as it goes (see\n"
+        "--expand-beam and --max-histories; this is useful for high-order\n"
+        "LMs).  Determinization will be applied on the composed lattice.\n"
         "\n"
         "Usage: lattice-lmrescore-const-arpa [options] lattice-rspecifier \\\n"
         "                                   const-arpa-in lattice-wspecifier\n"
@@ -45,9 +125,13 @@ int main(int argc, char *argv[]) {
       
     ParseOptions po(usage);
     BaseFloat lm_scale = 1.0;
+    NgramExpandOptions expand_opts;
+    TaskSequencerConfig sequencer_config; // has --num-threads option
     
     po.Register("lm-scale", &lm_scale, "Scaling factor for language model "
                 "costs; frequently 1.0 or -1.0");
+    expand_opts.Register(&po);
+    sequencer_config.Register(&po);
     
     po.Read(argc, argv);
 
@@ -69,51 +153,23 @@ int main(int argc, char *argv[]) {
     CompactLatticeWriter compact_lattice_writer(lats_wspecifier); 
 
     int32 n_done = 0, n_fail = 0;
-    for (; !compact_lattice_reader.Done(); compact_lattice_reader.Next()) {
-      std::string key = compact_lattice_reader.Key();
-      CompactLattice clat = compact_lattice_reader.Value();
-      compact_lattice_reader.FreeCurrent();
-
-      if (lm_scale != 0.0) {
-        // Before composing with the LM FST, we scale the lattice weights
-        // by the inverse of "lm_scale".  We'll later scale by "lm_scale".
-        // We do it this way so we can determinize and it will give the
-        // right effect (taking the "best path" through the LM) regardless
-        // of the sign of lm_scale.
-        fst::ScaleLattice(fst::GraphLatticeScale(1.0/lm_scale), &clat);
-        ArcSort(&clat, fst::OLabelCompare<CompactLatticeArc>());
-
-        // Wraps the ConstArpaLm format language model into FST. We re-create it
-        // for each lattice to prevent memory usage increasing with time.
-        ConstArpaLmDeterministicFst const_arpa_fst(const_arpa);
-
-        // Composes lattice with language model.        
-        CompactLattice composed_clat;
-        ComposeCompactLatticeDeterministic(clat,
-                                           &const_arpa_fst, &composed_clat);
-
-        // Determinizes the composed lattice.
-        Lattice composed_lat;
-        ConvertLattice(composed_clat, &composed_lat);
-        Invert(&composed_lat);
-        CompactLattice determinized_clat;
-        DeterminizeLattice(composed_lat, &determinized_clat);
-        fst::ScaleLattice(fst::GraphLatticeScale(lm_scale), &determinized_clat);
-        if (determinized_clat.Start() == fst::kNoStateId) {
-          KALDI_WARN << "Empty lattice for utterance " << key
-              << " (incompatible LM?)";
-          n_fail++;
-        } else {
-          compact_lattice_writer.Write(key, determinized_clat);
-          n_done++;
-        }
-      } else {
-        // Zero scale so nothing to do.
-        n_done++;
-        compact_lattice_writer.Write(key, clat);
+    NgramExpandStats stats;
+    {
+      TaskSequencer<ConstArpaRescoreTask> sequencer(sequencer_config);
+      for (; !compact_lattice_reader.Done(); compact_lattice_reader.Next()) {
+        std::string key = compact_lattice_reader.Key();
+        CompactLattice *clat = compact_lattice_reader.Value().Copy();
+        compact_lattice_reader.FreeCurrent();
+        sequencer.Run(new ConstArpaRescoreTask(
+            const_arpa, expand_opts, lm_scale, key, clat,
+            &compact_lattice_writer, &n_done, &n_fail, &stats));
       }
+      sequencer.Wait();
     }
 
+    KALDI_LOG << "Created " << stats.num_pairs << " (lattice-state, history) "
+              << "pairs, of which " << stats.num_pruned << " were pruned; "
+              << stats.num_lm_lookups << " LM lookups.";
     KALDI_LOG << "Done " << n_done << " lattices, failed for " << n_fail;
     return (n_done != 0 ? 0 : 1);
   } catch(const std::exception &e) {
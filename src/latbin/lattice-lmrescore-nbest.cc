@@ -0,0 +1,98 @@
+// latbin/lattice-lmrescore-nbest.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "fstext/fstext-lib.h"
+#include "lat/kaldi-lattice.h"
+#include "lat/nbest-rescore.h"
+#include "lm/const-arpa-lm.h"
+#include "util/common-utils.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+    typedef kaldi::int64 int64;
+
+    const char *usage =
+        "Rescores the N-best paths of lattices with a ConstArpaLm format\n"
+        "language model, adding lm-scale times its cost to the graph cost of\n"
+        "each path, and writes them out as lattices containing the rescored\n"
+        "paths (best first).  The paths share the LM computation for their\n"
+        "common prefixes.  To replace the LM scores rather than add to them,\n"
+        "first remove the old ones, e.g. with lattice-lmrescore-const-arpa\n"
+        "--lm-scale=-1.0.\n"
+        "\n"
+        "Usage: lattice-lmrescore-nbest [options] <lattice-rspecifier> \\\n"
+        "                         <const-arpa-in> <lattice-wspecifier>\n"
+        " e.g.: lattice-lmrescore-nbest --n=100 --acoustic-scale=0.1 \\\n"
+        "                         ark:in.lats const_arpa ark:out.lats\n"
+        "See also: lattice-to-nbest, lattice-lmrescore-const-arpa\n";
+
+    ParseOptions po(usage);
+    NbestRescoreOptions opts;
+    opts.Register(&po);
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 3) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string lats_rspecifier = po.GetArg(1),
+        lm_rxfilename = po.GetArg(2),
+        lats_wspecifier = po.GetArg(3);
+
+    ConstArpaLm const_arpa;
+    ReadKaldiObject(lm_rxfilename, &const_arpa);
+
+    SequentialCompactLatticeReader compact_lattice_reader(lats_rspecifier);
+    CompactLatticeWriter compact_lattice_writer(lats_wspecifier);
+
+    int32 n_done = 0, n_fail = 0;
+    NbestRescoreStats stats;
+    for (; !compact_lattice_reader.Done(); compact_lattice_reader.Next()) {
+      std::string key = compact_lattice_reader.Key();
+      const CompactLattice &clat = compact_lattice_reader.Value();
+
+      // We re-create the LM wrapper for each lattice to prevent memory usage
+      // increasing with time.
+      ConstArpaLmDeterministicFst const_arpa_fst(const_arpa);
+      DeterministicFstSentenceScorer scorer(&const_arpa_fst);
+      NbestRescorer rescorer(opts, &scorer);
+      CompactLattice nbest;
+      if (rescorer.Rescore(clat, &nbest)) {
+        compact_lattice_writer.Write(key, nbest);
+        n_done++;
+      } else {
+        KALDI_WARN << "No paths left after rescoring utterance " << key
+                   << " (empty lattice or incompatible LM?)";
+        n_fail++;
+      }
+      stats.Add(rescorer.Stats());
+    }
+
+    stats.Print();
+    KALDI_LOG << "Done " << n_done << " lattices, failed for " << n_fail;
+    return (n_done != 0 ? 0 : 1);
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -22,12 +22,13 @@
 #include "util/common-utils.h"
 #include "fstext/fstext-lib.h"
 #include "lat/kaldi-lattice.h"
+#include "lat/lattice-functions.h"
+#include "lat/sausages.h"
+#include "thread/kaldi-task-sequence.h"
+#include "util/edit-distance.h"
 
 namespace kaldi {
 
-using std::vector;
-using std::set;
-
 typedef unordered_set<fst::StdArc::Label> LabelSet; 
 
 void ReadSymbolList(const std::string &rxfilename,
@@ -55,168 +56,146 @@ void ReadSymbolList(const std::string &rxfilename,
   }
 }
 
-void MapWildCards(const LabelSet &wildcards, fst::StdVectorFst *ofst) {
-  // map all wildcards symbols to epsilons
-  for (fst::StateIterator<fst::StdVectorFst> siter(*ofst); !siter.Done(); siter.Next()) {
-    fst::StdArc::StateId s = siter.Value();
-    for (fst::MutableArcIterator<fst::StdVectorFst> aiter(ofst, s); !aiter.Done();  aiter.Next()) {
-      fst::StdArc arc(aiter.Value());
-      LabelSet::const_iterator it = wildcards.find(arc.ilabel);
-      if (it != wildcards.end()) {
-        KALDI_VLOG(4) << "MapWildCards: mapping symbol " << arc.ilabel
-                      << " to epsilon" << endl;
-        arc.ilabel = 0;
-      }
-      it = wildcards.find(arc.olabel);
-      if (it != wildcards.end()) {arc.olabel = 0;}
-      aiter.SetValue(arc);
-    }
-  }    
-}
+struct OracleStats {
+  int32 num_done;
+  int32 num_fail;
+  int32 tot_correct;
+  int32 tot_substitutions;
+  int32 tot_insertions;
+  int32 tot_deletions;
+  int32 tot_words;
+  OracleStats(): num_done(0), num_fail(0), tot_correct(0),
+                 tot_substitutions(0), tot_insertions(0), tot_deletions(0),
+                 tot_words(0) { }
+};
 
-// convert from Lattice to standard FST
-// also maps wildcard symbols to epsilons
-// then removes epsilons
-void ConvertLatticeToUnweightedAcceptor(const kaldi::Lattice &ilat,
-                                        const LabelSet &wildcards,
-                                        fst::StdVectorFst *ofst) {
-  // first convert from  lattice to normal FST
-  fst::ConvertLattice(ilat, ofst); 
-  // remove weights, project to output, sort according to input arg
-  fst::Map(ofst, fst::RmWeightMapper<fst::StdArc>()); 
-  fst::Project(ofst, fst::PROJECT_OUTPUT);  // The words are on the output side  
-  MapWildCards(wildcards, ofst);
-  fst::RmEpsilon(ofst);   // Don't tolerate epsilons as they make it hard to tally errors
-  fst::ArcSort(ofst, fst::StdILabelCompare());
-}
-
-void CreateEditDistance(const fst::StdVectorFst &fst1,
-                        const fst::StdVectorFst &fst2,
-                        fst::StdVectorFst *pfst) {
-  using namespace fst;
-  typedef StdArc StdArc;
-  typedef StdArc::Weight Weight;
-  typedef StdArc::Label Label;
-  Weight correct_cost(0.0);
-  Weight substitution_cost(1.0);
-  Weight insertion_cost(1.0);
-  Weight deletion_cost(1.0);
+struct OracleOutputs {
+  Int32VectorWriter *transcriptions_writer;
+  Int32Writer *edit_distance_writer;
+  CompactLatticeWriter *lats_writer;
+  BaseFloatVectorWriter *confidence_writer;
+  const fst::SymbolTable *word_syms;
+};
 
-  // create set of output symbols in fst1
-  std::vector<Label> fst1syms, fst2syms;
-  GetOutputSymbols(fst1, false /*no epsilons*/, &fst1syms);
-  GetInputSymbols(fst2, false /*no epsilons*/, &fst2syms);
+class LatticeOracleTask {
+ public:
+  // Initializer takes ownership of "clat".
+  LatticeOracleTask(std::string key,
+                    CompactLattice *clat,
+                    const std::vector<int32> &reference,
+                    const std::vector<int32> &wildcards,
+                    BaseFloat acoustic_scale,
+                    BaseFloat lm_scale,
+                    const OracleOutputs &outputs,
+                    OracleStats *stats):
+      key_(key), clat_(clat), reference_(reference), wildcards_(wildcards),
+      acoustic_scale_(acoustic_scale), lm_scale_(lm_scale),
+      outputs_(outputs), stats_(stats), edit_distance_(-1),
+      insertions_(0), deletions_(0), substitutions_(0) { }
 
-  pfst->AddState();
-  pfst->SetStart(0);
-  for (size_t i = 0; i < fst1syms.size(); i++) 
-    pfst->AddArc(0, StdArc(fst1syms[i], 0, deletion_cost, 0)); // deletions
-  
-  for (size_t i = 0; i < fst2syms.size(); i++)
-    pfst->AddArc(0, StdArc(0, fst2syms[i], insertion_cost, 0));  // insertions
- 
-  // stupid implementation O(N^2)
-  for (size_t i = 0; i < fst1syms.size(); i++) {
-    Label label1 = fst1syms[i];
-    for (size_t j = 0; j < fst2syms.size(); j++) {
-      Label label2 = fst2syms[j];
-      Weight cost( label1 == label2 ? correct_cost : substitution_cost);
-      pfst->AddArc(0, StdArc(label1, label2, cost, 0)); // substitutions
+  void operator () () {
+    // The confidences need the oracle path, for its words including any
+    // wildcards.
+    bool need_path = (outputs_.lats_writer->IsOpen() ||
+                      outputs_.confidence_writer->IsOpen());
+    edit_distance_ = CompactLatticeOracle(
+        *clat_, reference_, wildcards_, &oracle_words_,
+        (need_path ? &oracle_path_ : NULL));
+    if (edit_distance_ >= 0) {
+      // Work out the types of the errors.  The oracle words are already
+      // without wildcards; remove them from the reference too.
+      for (size_t i = 0; i < reference_.size(); i++)
+        if (reference_[i] != 0 &&
+            std::find(wildcards_.begin(), wildcards_.end(),
+                      reference_[i]) == wildcards_.end())
+          stripped_reference_.push_back(reference_[i]);
+      int32 tot_errs = LevenshteinEditDistance(stripped_reference_,
+                                               oracle_words_, &insertions_,
+                                               &deletions_, &substitutions_);
+      KALDI_ASSERT(tot_errs == edit_distance_);
     }
-  }
-  pfst->SetFinal(0, Weight::One());
-  ArcSort(pfst, StdOLabelCompare());
-}
-
-void CountErrors(fst::StdVectorFst &fst,
-                 int32 *correct,
-                 int32 *substitutions,
-                 int32 *insertions,
-                 int32 *deletions,
-                 int32 *num_words) {
-  typedef fst::StdArc::StateId StateId;
-  typedef fst::StdArc::Weight Weight;
-   *correct = *substitutions = *insertions = *deletions = *num_words = 0;
-
-  // go through the first complete path in fst (there should be only one)
-  StateId src = fst.Start(); 
-  while (fst.Final(src)== Weight::Zero()) { // while not final
-    for (fst::ArcIterator<fst::StdVectorFst> aiter(fst, src); !aiter.Done(); aiter.Next()) {
-      fst::StdArc arc = aiter.Value();
-      if (arc.ilabel == arc.olabel && arc.ilabel != 0) {
-        (*correct)++;
-        (*num_words)++;
-      } else if (arc.ilabel == 0 && arc.olabel != 0) {
-        (*deletions)++;
-        (*num_words)++;
-      } else if (arc.ilabel != 0 && arc.olabel == 0) {
-        (*insertions)++; 
-      } else if (arc.ilabel != 0 && arc.olabel != 0) {
-        (*substitutions)++;
-        (*num_words)++;
-      } else {
-        KALDI_ASSERT(arc.ilabel == 0 && arc.olabel == 0);
-      }
-      src = arc.nextstate;
-      continue; // jump to next state
+    if (outputs_.confidence_writer->IsOpen() && edit_distance_ >= 0) {
+      std::vector<int32> path_words;
+      bool ans = fst::GetLinearSymbolSequence<CompactLatticeArc, int32>(
+          oracle_path_, &path_words, NULL, NULL);
+      KALDI_ASSERT(ans);
+      fst::ScaleLattice(fst::LatticeScale(lm_scale_, acoustic_scale_), clat_);
+      // The word posteriors of the words of the oracle path.
+      MinimumBayesRisk mbr(*clat_, path_words);
+      const std::vector<BaseFloat> &conf = mbr.GetOneBestConfidences();
+      confidences_.Resize(conf.size());
+      for (size_t i = 0; i < conf.size(); i++)
+        confidences_(i) = conf[i];
     }
+    delete clat_; // This is no longer needed so we can delete it now.
+    clat_ = NULL;
   }
-}
-
 
-bool CheckFst(fst::StdVectorFst &fst, string name, string key) {
-
-#ifdef DEBUG
-  StateId numstates = fst.NumStates();
-  cerr << " "<<name<<" has "<<numstates<<" states"<<endl;
-  std::stringstream ss; ss <<name<<key<<".fst";
-  fst.Write(ss.str());
-  return(fst.Start() == fst::kNoStateId); 
-#else
-  return true;
-#endif
-}
-
-
-// Guoguo Chen added the implementation for option "write-lattices". This
-// function does a depth first search on the lattice and remove the arcs that
-// don't correctespond to the oracle path. By "remove" I actually point the next
-// state of the arc to some state that is not in the lattice and then use the
-// openfst connect function. This makes things much easier. 
-bool GetOracleLattice(Lattice *oracle_lat, 
-                      vector<int32> oracle_words, 
-                      LatticeArc::StateId bad_state,
-                      LatticeArc::StateId current_state, 
-                      int32 current_word) {
-  if (current_word == oracle_words.size()) {
-    if (oracle_lat->Final(current_state) != LatticeArc::Weight::Zero())
-      return true;
-  } else {
-    if (oracle_lat->Final(current_state) != LatticeArc::Weight::Zero())
-      return false;
+  // The output is written, and the stats updated, in the destructor, which the
+  // TaskSequencer calls in the same order as the lattices were read.
+  ~LatticeOracleTask() {
+    delete clat_; // in case operator () was never called.
+    if (outputs_.confidence_writer->IsOpen())
+      outputs_.confidence_writer->Write(key_, confidences_);
+    if (edit_distance_ < 0) {
+      KALDI_WARN << "Best-path failed for key " << key_;
+      stats_->num_fail++;
+      return;
+    }
+    int32 num_words = stripped_reference_.size();
+    if (outputs_.edit_distance_writer->IsOpen())
+      outputs_.edit_distance_writer->Write(key_, edit_distance_);
+    KALDI_LOG << "%WER " << (100.*edit_distance_) / num_words << " [ "
+              << edit_distance_ << " / " << num_words << ", " << insertions_
+              << " insertions, " << deletions_ << " deletions, "
+              << substitutions_ << " sub ]";
+    stats_->tot_correct += num_words - deletions_ - substitutions_;
+    stats_->tot_substitutions += substitutions_;
+    stats_->tot_insertions += insertions_;
+    stats_->tot_deletions += deletions_;
+    stats_->tot_words += num_words;
+    if (outputs_.transcriptions_writer->IsOpen())
+      outputs_.transcriptions_writer->Write(key_, oracle_words_);
+    if (outputs_.word_syms != NULL) {
+      std::cerr << key_ << " (oracle) ";
+      PrintWords(oracle_words_);
+      std::cerr << '\n' << key_ << " (reference) ";
+      PrintWords(stripped_reference_);
+      std::cerr << '\n';
+    }
+    if (outputs_.lats_writer->IsOpen())
+      outputs_.lats_writer->Write(key_, oracle_path_);
+    stats_->num_done++;
   }
-
-  bool status = false;
-  for (fst::MutableArcIterator<Lattice> aiter(oracle_lat, current_state);
-       !aiter.Done();
-       aiter.Next()) {
-    LatticeArc arc(aiter.Value());
-    LatticeArc::StateId nextstate = arc.nextstate;
-    if (arc.olabel == 0)
-      status = GetOracleLattice(oracle_lat, oracle_words, bad_state, nextstate, current_word) || status;
-    else if (current_word < oracle_words.size() && arc.olabel == oracle_words[current_word])
-      status = GetOracleLattice(oracle_lat, oracle_words, bad_state, nextstate, ++current_word) || status;
-    else {
-      arc.nextstate = bad_state;
-      aiter.SetValue(arc);
+ private:
+  void PrintWords(const std::vector<int32> &words) {
+    for (size_t i = 0; i < words.size(); i++) {
+      std::string s = outputs_.word_syms->Find(words[i]);
+      if (s == "")
+        KALDI_ERR << "Word-id " << words[i] << " not in symbol table.";
+      std::cerr << s << ' ';
     }
   }
 
-  if (current_state == oracle_lat->Start())
-    fst::Connect(oracle_lat);
+  std::string key_;
+  CompactLattice *clat_; // The input lattice.  Owned locally.
+  std::vector<int32> reference_;
+  const std::vector<int32> &wildcards_;
+  BaseFloat acoustic_scale_;
+  BaseFloat lm_scale_;
+  OracleOutputs outputs_;
+  OracleStats *stats_;
 
-  return status;
-}
+  // The outputs of our computation.
+  int32 edit_distance_;
+  std::vector<int32> oracle_words_;
+  std::vector<int32> stripped_reference_;
+  CompactLattice oracle_path_;
+  int32 insertions_;
+  int32 deletions_;
+  int32 substitutions_;
+  Vector<BaseFloat> confidences_;
+};
 
 }
 
@@ -224,21 +203,18 @@ int main(int argc, char *argv[]) {
   try {
     using namespace kaldi;
     typedef kaldi::int32 int32;
-    typedef kaldi::int64 int64;
-    using fst::SymbolTable;
-    using fst::VectorFst;
-    using fst::StdArc;
-    typedef fst::StdArc::Weight Weight;
-    typedef fst::StdArc::StateId StateId;
 
     const char *usage =
-        "Finds the path having the smallest edit-distance between two lattices.\n"
-        "For efficiency put the smallest lattices first (for example reference strings).\n"
+        "Finds the path having the smallest edit-distance between a lattice and\n"
+        "a reference transcription (the \"oracle\" path), by dynamic programming\n"
+        "over lattice states and reference positions.\n"
         "Usage: lattice-oracle [options] <test-lattice-rspecifier> <reference-rspecifier> "
         "<transcriptions-wspecifier> [<edit-distance-wspecifier>]\n"
         " e.g.: lattice-oracle ark:lat.1 'ark:sym2int.pl -f 2- data/lang/words.txt <data/test/text' ark,t:-\n"
         "Note: you can use this program to compute the n-best oracle WER by first piping\n"
-        "the input lattices through lattice-to-nbest and then nbest-to-lattice.\n";
+        "the input lattices through lattice-to-nbest and then nbest-to-lattice.\n"
+        "With --num-threads > 1, lattices are processed in parallel (the output\n"
+        "order is unchanged).\n";
         
     ParseOptions po(usage);
     
@@ -246,6 +222,9 @@ int main(int argc, char *argv[]) {
     std::string wild_syms_rxfilename;
     std::string wildcard_symbols;
     std::string lats_wspecifier;
+    std::string confidence_wspecifier;
+    BaseFloat acoustic_scale = 1.0, lm_scale = 1.0;
+    TaskSequencerConfig sequencer_config; // has --num-threads option
     
     po.Register("word-symbol-table", &word_syms_filename,
                 "Symbol table for words [for debug output]");
@@ -259,6 +238,16 @@ int main(int argc, char *argv[]) {
                 "option --wildcard-symbols-list.");
     po.Register("write-lattices", &lats_wspecifier, "If supplied, write 1-best "
                 "path as lattices to this wspecifier");
+    po.Register("word-confidence-wspecifier", &confidence_wspecifier,
+                "If supplied, write to this wspecifier the confidences (word "
+                "posteriors, computed with --acoustic-scale and --lm-scale) "
+                "of the words of the oracle path in each lattice, including "
+                "any wildcard words on it.");
+    po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for "
+                "acoustic likelihoods [only affects the confidences]");
+    po.Register("lm-scale", &lm_scale, "Scaling factor for language model "
+                "probabilities [only affects the confidences]");
+    sequencer_config.Register(&po);
     
     po.Read(argc, argv);
  
@@ -272,14 +261,15 @@ int main(int argc, char *argv[]) {
         transcriptions_wspecifier = po.GetArg(3),
         edit_distance_wspecifier = po.GetOptArg(4);
     
-    // will read input as  lattices
-    SequentialLatticeReader lattice_reader(lats_rspecifier);
+    // will read input as compact lattices.
+    SequentialCompactLatticeReader clat_reader(lats_rspecifier);
     RandomAccessInt32VectorReader reference_reader(reference_rspecifier);
     Int32VectorWriter transcriptions_writer(transcriptions_wspecifier);
     Int32Writer edit_distance_writer(edit_distance_wspecifier);
     
     // Guoguo Chen added the implementation for option "write-lattices".
     CompactLatticeWriter lats_writer(lats_wspecifier);
+    BaseFloatVectorWriter confidence_writer(confidence_wspecifier);
 
     fst::SymbolTable *word_syms = NULL;
     if (word_syms_filename != "") 
@@ -287,14 +277,14 @@ int main(int argc, char *argv[]) {
         KALDI_ERR << "Could not read symbol table from file "
                   << word_syms_filename;
 
-    LabelSet wildcards;
+    LabelSet wildcard_set;
     if (wild_syms_rxfilename != "") {
       KALDI_WARN << "--wildcard-symbols-list option deprecated.";
       KALDI_ASSERT(wildcard_symbols.empty() && "Do not use both "
                    "--wildcard-symbols and --wildcard-symbols-list options.");
       KALDI_ASSERT(word_syms != NULL && "--wildcard-symbols-list option "
                    "requires --word-symbol-table option");
-      ReadSymbolList(wild_syms_rxfilename, word_syms, &wildcards);
+      ReadSymbolList(wild_syms_rxfilename, word_syms, &wildcard_set);
     } else {
       std::vector<fst::StdArc::Label> wildcard_symbols_vec;
       if (!SplitStringToIntegers(wildcard_symbols, ":", false,
@@ -303,131 +293,49 @@ int main(int argc, char *argv[]) {
                   << "--wildcard-symbols option, got: " << wildcard_symbols;
       }
       for (size_t i = 0; i < wildcard_symbols_vec.size(); i++)
-        wildcards.insert(wildcard_symbols_vec[i]);
+        wildcard_set.insert(wildcard_symbols_vec[i]);
     }  
-    
-    int32 n_done = 0, n_fail = 0;
-    int32 tot_correct=0, tot_substitutions=0, tot_insertions=0, tot_deletions=0,
-        tot_words=0;
+    std::vector<int32> wildcards(wildcard_set.begin(), wildcard_set.end());
+    std::sort(wildcards.begin(), wildcards.end());
 
-    for (; !lattice_reader.Done(); lattice_reader.Next()) {
-      std::string key = lattice_reader.Key();
-      const Lattice &lat = lattice_reader.Value();
-      cerr << "Lattice "<<key<<" read."<<endl;
-
-      // remove all weights while creating a standard FST
-      VectorFst<StdArc> lattice_fst;
-      ConvertLatticeToUnweightedAcceptor(lat, wildcards, &lattice_fst);
-      CheckFst(lattice_fst, "lattice_fst_", key);
-      
-      // TODO: map certain symbols (using an FST created with CreateMapFst())
-      
-      if (!reference_reader.HasKey(key)) {
-        KALDI_WARN << "No reference present for utterance " << key;
-        n_fail++;
-        continue;
-      }
-      const std::vector<int32> &reference = reference_reader.Value(key);
-      VectorFst<StdArc> reference_fst;
-      MakeLinearAcceptor(reference, &reference_fst);
-      MapWildCards(wildcards, &reference_fst); // Remove any wildcards in reference.
-      
-      CheckFst(reference_fst, "reference_fst_", key);
-            
-      // recreate edit distance fst if necessary
-      fst::StdVectorFst edit_distance_fst;
-      CreateEditDistance(lattice_fst, reference_fst, &edit_distance_fst);
-      
-      // compose with edit distance transducer
-      VectorFst<StdArc> edit_ref_fst;
-      fst::Compose(edit_distance_fst, reference_fst, &edit_ref_fst);
-      CheckFst(edit_ref_fst, "composed_", key);
-      
-      // make sure composed FST is input sorted
-      fst::ArcSort(&edit_ref_fst, fst::StdILabelCompare());
-      
-      // compose with previous result
-      VectorFst<StdArc> result_fst;
-      fst::Compose(lattice_fst, edit_ref_fst, &result_fst);
-      CheckFst(result_fst, "result_", key);
-      
-      // find out best path
-      VectorFst<StdArc> best_path;
-      fst::ShortestPath(result_fst, &best_path);
-      CheckFst(best_path, "best_path_", key);
-
-      if (best_path.Start() == fst::kNoStateId) {
-        KALDI_WARN << "Best-path failed for key " << key;
-        n_fail++;
-      } else {
-        // count errors
-        int32 correct, substitutions, insertions, deletions, num_words;
-        CountErrors(best_path, &correct, &substitutions, &insertions, &deletions, &num_words);
-        int32 tot_errs = substitutions + insertions + deletions;
-        if (edit_distance_wspecifier != "")
-          edit_distance_writer.Write(key, tot_errs);
-        KALDI_LOG << "%WER " << (100.*tot_errs) / num_words << " [ " << tot_errs
-                  << " / " << num_words << ", " << insertions << " insertions, " << deletions
-                  << " deletions, " << substitutions << " sub ]";
-        tot_correct += correct;
-        tot_substitutions += substitutions;
-        tot_insertions += insertions;
-        tot_deletions += deletions;
-        tot_words += num_words;     
-        
-        std::vector<int32> oracle_words;
-        std::vector<int32> reference_words;
-        Weight weight;
-        GetLinearSymbolSequence(best_path, &oracle_words, &reference_words, &weight);
-        KALDI_LOG << "For utterance " << key << ", best cost " << weight;
-        if (transcriptions_wspecifier != "")
-          transcriptions_writer.Write(key, oracle_words);
-        if (word_syms != NULL) {
-          std::cerr << key << " (oracle) ";
-          for (size_t i = 0; i < oracle_words.size(); i++) {
-            std::string s = word_syms->Find(oracle_words[i]);
-            if (s == "")
-              KALDI_ERR << "Word-id " << oracle_words[i] <<" not in symbol table.";
-            std::cerr << s << ' ';
-          }
-          std::cerr << '\n' << key << " (reference) ";
-          for (size_t i = 0; i < reference_words.size(); i++) {
-            std::string s = word_syms->Find(reference_words[i]);
-            if (s == "")
-              KALDI_ERR << "Word-id " << reference_words[i]
-                        << " not in symbol table.";
-            std::cerr << s << ' ';
-          }
-          std::cerr << '\n';
-        }
+    OracleOutputs outputs;
+    outputs.transcriptions_writer = &transcriptions_writer;
+    outputs.edit_distance_writer = &edit_distance_writer;
+    outputs.lats_writer = &lats_writer;
+    outputs.confidence_writer = &confidence_writer;
+    outputs.word_syms = word_syms;
+    OracleStats stats; // updated by the tasks.
+    int32 num_no_ref = 0;
 
-        // Guoguo Chen added the implementation for option "write-lattices".
-        // Currently it's just a naive implementation: traverse the original
-        // lattice and get the path corresponding to the oracle word sequence.
-        // Note that this new lattice has the alignment information.
-        if (lats_wspecifier != "") {
-          Lattice oracle_lat = lat;
-          LatticeArc::StateId bad_state = oracle_lat.AddState();
-          if (!GetOracleLattice(&oracle_lat, oracle_words,
-                                bad_state, oracle_lat.Start(), 0)) 
-            KALDI_WARN << "Failed to find the oracle path in the original "
-                       << "lattice: " << key;
-          CompactLattice oracle_clat;
-          ConvertLattice(oracle_lat, &oracle_clat);
-          lats_writer.Write(key, oracle_clat);
+    {
+      TaskSequencer<LatticeOracleTask> sequencer(sequencer_config);
+      for (; !clat_reader.Done(); clat_reader.Next()) {
+        std::string key = clat_reader.Key();
+        if (!reference_reader.HasKey(key)) {
+          KALDI_WARN << "No reference present for utterance " << key;
+          num_no_ref++;
+          continue;
         }
+        // will give ownership to "task" below.
+        CompactLattice *clat = new CompactLattice(clat_reader.Value());
+        clat_reader.FreeCurrent();
+        sequencer.Run(new LatticeOracleTask(
+            key, clat, reference_reader.Value(key), wildcards,
+            acoustic_scale, lm_scale, outputs, &stats));
       }
-      n_done++;
+      sequencer.Wait();
     }
     if (word_syms) delete word_syms;
-    int32 tot_errs = tot_substitutions + tot_deletions + tot_insertions;
+    int32 tot_errs = stats.tot_substitutions + stats.tot_deletions +
+        stats.tot_insertions;
     // Warning: the script egs/s5/*/steps/oracle_wer.sh parses the next line.
-    KALDI_LOG << "Overall %WER " << (100.*tot_errs)/tot_words << " [ "
-              << tot_errs << " / " << tot_words << ", " << tot_insertions
-              << " insertions, " << tot_deletions << " deletions, "
-              << tot_substitutions << " substitutions ]";
-    KALDI_LOG << "Scored " << n_done << " lattices, " << n_fail
-              << " not present in ref.";
+    KALDI_LOG << "Overall %WER " << (100.*tot_errs)/stats.tot_words << " [ "
+              << tot_errs << " / " << stats.tot_words << ", "
+              << stats.tot_insertions << " insertions, "
+              << stats.tot_deletions << " deletions, "
+              << stats.tot_substitutions << " substitutions ]";
+    KALDI_LOG << "Scored " << stats.num_done << " lattices, "
+              << (stats.num_fail + num_no_ref) << " not present in ref.";
   } catch(const std::exception &e) {
     std::cerr << e.what();
     return -1;
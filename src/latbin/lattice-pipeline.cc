@@ -0,0 +1,455 @@
+// latbin/lattice-pipeline.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "base/kaldi-common.h"
+#include "base/timer.h"
+#include "util/common-utils.h"
+#include "lat/kaldi-lattice.h"
+#include "lat/lattice-functions.h"
+#include "lat/determinize-lattice-pruned.h"
+#include "lat/push-lattice.h"
+#include "lat/minimize-lattice.h"
+#include "lat/word-align-lattice.h"
+#include "lat/sausages.h"
+#include "thread/kaldi-task-sequence.h"
+
+namespace kaldi {
+
+// The operations that lattice-pipeline can apply; each corresponds to one of
+// the programs named in the usage message.
+enum LatticePipelineStage {
+  kStageScale,
+  kStageAddPenalty,
+  kStagePrune,
+  kStageDeterminize,
+  kStagePush,
+  kStageMinimize,
+  kStageAlignWords,
+  kStageCtmConf
+};
+
+struct LatticePipelineConfig {
+  BaseFloat acoustic_scale;
+  BaseFloat inv_acoustic_scale;
+  BaseFloat lm_scale;
+  BaseFloat word_ins_penalty;
+  BaseFloat prune_beam;
+  BaseFloat prune_acoustic_scale;
+  int32 prune_max_arcs_per_frame;
+  BaseFloat determinize_beam;
+  BaseFloat determinize_acoustic_scale;
+  BaseFloat max_expand;
+  bool decode_mbr;
+  BaseFloat ctm_acoustic_scale;
+  BaseFloat frame_shift;
+  std::string word_boundary_rxfilename;
+  std::string model_rxfilename;
+  fst::DeterminizeLatticePrunedOptions determinize_opts;
+  WordBoundaryInfoNewOpts word_boundary_opts;
+
+  LatticePipelineConfig(): acoustic_scale(1.0), inv_acoustic_scale(1.0),
+                           lm_scale(1.0), word_ins_penalty(0.0),
+                           prune_beam(10.0), prune_acoustic_scale(1.0),
+                           prune_max_arcs_per_frame(0),
+                           determinize_beam(10.0),
+                           determinize_acoustic_scale(1.0),
+                           max_expand(0.0), decode_mbr(true),
+                           ctm_acoustic_scale(1.0), frame_shift(0.01) {
+    determinize_opts.max_mem = 50000000;
+    determinize_opts.max_loop = 0;
+  }
+
+  void Register(ParseOptions *po) {
+    po->Register("acoustic-scale", &acoustic_scale, "Scaling factor for "
+                 "acoustic likelihoods [for the 'scale' stage]");
+    po->Register("inv-acoustic-scale", &inv_acoustic_scale, "An alternative "
+                 "way of setting the acoustic scale: you can set its inverse.");
+    po->Register("lm-scale", &lm_scale, "Scaling factor for graph/lm costs "
+                 "[for the 'scale' stage]");
+    po->Register("word-ins-penalty", &word_ins_penalty, "Word insertion "
+                 "penalty [for the 'add-penalty' stage]");
+    po->Register("prune-beam", &prune_beam, "Pruning beam [for the 'prune' "
+                 "stage]");
+    po->Register("prune-acoustic-scale", &prune_acoustic_scale, "Acoustic "
+                 "scale applied while pruning and undone afterwards, as "
+                 "lattice-prune --acoustic-scale does [for the 'prune' stage]");
+    po->Register("prune-max-arcs-per-frame", &prune_max_arcs_per_frame,
+                 "If >0, the 'prune' stage also limits the number of arcs "
+                 "crossing any frame to this, as lattice-limit-depth does.");
+    po->Register("determinize-beam", &determinize_beam, "Pruning beam [for "
+                 "the 'determinize' stage]");
+    po->Register("determinize-acoustic-scale", &determinize_acoustic_scale,
+                 "Acoustic scale applied while determinizing and undone "
+                 "afterwards, as lattice-determinize-pruned --acoustic-scale "
+                 "does [for the 'determinize' stage]");
+    po->Register("max-expand", &max_expand, "If >0, the maximum amount by "
+                 "which the 'align-words' stage will expand lattices before "
+                 "refusing to continue.  E.g. 10.");
+    po->Register("decode-mbr", &decode_mbr, "If true, the 'ctm-conf' stage "
+                 "does Minimum Bayes Risk decoding (else, Maximum a "
+                 "Posteriori)");
+    po->Register("ctm-acoustic-scale", &ctm_acoustic_scale, "Acoustic scale "
+                 "applied before computing the 1-best and confidences, as "
+                 "lattice-to-ctm-conf --acoustic-scale does [for the "
+                 "'ctm-conf' stage]");
+    po->Register("frame-shift", &frame_shift, "Time in seconds between "
+                 "frames [for the 'ctm-conf' stage].");
+    po->Register("word-boundary", &word_boundary_rxfilename, "Word-boundary "
+                 "file [required by the 'align-words' stage]");
+    po->Register("model", &model_rxfilename, "Transition model [required by "
+                 "the 'align-words' stage]");
+    word_boundary_opts.Register(po);
+  }
+};
+
+/// Parses a comma-separated list of stages; the 'ctm-conf' stage, if
+/// present, must be last, and the 'scale' stage may appear only once, since
+/// there is only one set of --acoustic-scale and --lm-scale options.
+void ParseStages(const std::string &stages_str,
+                 std::vector<LatticePipelineStage> *stages) {
+  std::vector<std::string> names;
+  SplitStringToVector(stages_str, ",", true, &names);
+  if (names.empty())
+    KALDI_ERR << "No stages specified in '" << stages_str << "'";
+  stages->clear();
+  for (size_t i = 0; i < names.size(); i++) {
+    const std::string &name = names[i];
+    LatticePipelineStage stage;
+    if (name == "scale") stage = kStageScale;
+    else if (name == "add-penalty") stage = kStageAddPenalty;
+    else if (name == "prune") stage = kStagePrune;
+    else if (name == "determinize") stage = kStageDeterminize;
+    else if (name == "push") stage = kStagePush;
+    else if (name == "minimize") stage = kStageMinimize;
+    else if (name == "align-words") stage = kStageAlignWords;
+    else if (name == "ctm-conf") stage = kStageCtmConf;
+    else
+      KALDI_ERR << "Unknown lattice-pipeline stage '" << name << "'";
+    if (stage == kStageCtmConf && i + 1 != names.size())
+      KALDI_ERR << "The 'ctm-conf' stage must be the last one.";
+    if (stage == kStageScale &&
+        std::find(stages->begin(), stages->end(), kStageScale) !=
+        stages->end())
+      KALDI_ERR << "The 'scale' stage may appear only once.";
+    stages->push_back(stage);
+  }
+}
+
+class LatticePipelineTask {
+ public:
+  // Initializer takes ownership of "clat".  Exactly one of "clat_writer" and
+  // "ctm_output" will be non-NULL.  "word_boundary_info" may be NULL if there
+  // is no align-words stage.
+  LatticePipelineTask(const LatticePipelineConfig &config,
+                      const std::vector<LatticePipelineStage> &stages,
+                      const CompiledWordBoundaryInfo *word_boundary_info,
+                      std::string key,
+                      CompactLattice *clat,
+                      CompactLatticeWriter *clat_writer,
+                      Output *ctm_output,
+                      int32 *num_done,
+                      int32 *num_err,
+                      double *tot_time):
+      config_(config), stages_(stages),
+      word_boundary_info_(word_boundary_info), key_(key), clat_(clat),
+      ok_(true), elapsed_(0.0), clat_writer_(clat_writer),
+      ctm_output_(ctm_output), num_done_(num_done), num_err_(num_err),
+      tot_time_(tot_time) { }
+
+  void operator () () {
+    Timer timer;
+    for (size_t i = 0; i < stages_.size(); i++) {
+      if (clat_->Start() == fst::kNoStateId) {
+        KALDI_WARN << "Empty lattice for " << key_ << " before stage "
+                   << (i + 1) << ", producing no output.";
+        ok_ = false;
+        break;
+      }
+      RunStage(stages_[i]);
+    }
+    elapsed_ = timer.Elapsed();
+  }
+
+  // The output is written in the destructor, which the TaskSequencer calls in
+  // the same order as the lattices were read.
+  ~LatticePipelineTask() {
+    KALDI_VLOG(1) << "Processing lattice for " << key_ << " took "
+                  << elapsed_ << " seconds.";
+    *tot_time_ += elapsed_;
+    if (ok_) (*num_done_)++;
+    else (*num_err_)++;
+    if (ctm_output_ != NULL) {
+      std::ostream &os = ctm_output_->Stream();
+      for (size_t i = 0; i < words_.size(); i++) {
+        os << key_ << " 1 " << (config_.frame_shift * times_[i].first) << ' '
+           << (config_.frame_shift * (times_[i].second - times_[i].first))
+           << ' ' << words_[i] << ' ' << conf_[i] << '\n';
+      }
+    } else if (clat_->Start() != fst::kNoStateId) {
+      clat_writer_->Write(key_, *clat_);
+    }
+    delete clat_;
+  }
+ private:
+  void RunStage(LatticePipelineStage stage) {
+    switch (stage) {
+      case kStageScale:
+        fst::ScaleLattice(fst::LatticeScale(config_.lm_scale,
+                                            config_.acoustic_scale), clat_);
+        break;
+      case kStageAddPenalty:
+        AddWordInsPenToCompactLattice(config_.word_ins_penalty, clat_);
+        break;
+      case kStagePrune:
+        fst::ScaleLattice(fst::AcousticLatticeScale(
+            config_.prune_acoustic_scale), clat_);
+        if (!PruneLatticeLimitDepth(config_.prune_beam,
+                                    config_.prune_max_arcs_per_frame, clat_)) {
+          KALDI_WARN << "Error pruning lattice for utterance " << key_;
+          ok_ = false;
+        }
+        fst::ScaleLattice(fst::AcousticLatticeScale(
+            1.0 / config_.prune_acoustic_scale), clat_);
+        break;
+      case kStageDeterminize: {
+        Lattice lat;
+        ConvertLattice(*clat_, &lat);
+        fst::ScaleLattice(fst::AcousticLatticeScale(
+            config_.determinize_acoustic_scale), &lat);
+        Invert(&lat); // to get word labels on the input side.
+        if (!TopSort(&lat)) {
+          KALDI_WARN << "Could not topologically sort lattice for " << key_
+                     << ": this probably means it has bad properties e.g. "
+                     "epsilon cycles.";
+          ok_ = false;
+        }
+        fst::ArcSort(&lat, fst::ILabelCompare<LatticeArc>());
+        if (!DeterminizeLatticePruned(lat, config_.determinize_beam, clat_,
+                                      config_.determinize_opts)) {
+          KALDI_WARN << "For key " << key_ << ", determinization did not "
+              "succeed (partial output will be pruned tighter than the "
+              "specified beam.)";
+          ok_ = false;
+        }
+        fst::ScaleLattice(fst::AcousticLatticeScale(
+            1.0 / config_.determinize_acoustic_scale), clat_);
+        break;
+      }
+      case kStagePush:
+        if (!PushCompactLatticeStrings(clat_) ||
+            !PushCompactLatticeWeights(clat_)) {
+          KALDI_WARN << "Failure in pushing lattice for " << key_;
+          ok_ = false;
+        }
+        break;
+      case kStageMinimize:
+        PushCompactLatticeStrings(clat_);
+        PushCompactLatticeWeights(clat_);
+        if (!MinimizeCompactLattice(clat_)) {
+          KALDI_WARN << "Error minimizing lattice for " << key_;
+          ok_ = false;
+        }
+        break;
+      case kStageAlignWords: {
+        KALDI_ASSERT(word_boundary_info_ != NULL);
+        int32 max_states;
+        if (config_.max_expand > 0)
+          max_states = 1000 + config_.max_expand * clat_->NumStates();
+        else
+          max_states = 0;
+        CompactLattice aligned_clat;
+        if (!WordAlignLattice(*clat_, *word_boundary_info_, max_states,
+                              &aligned_clat)) {
+          KALDI_WARN << "Lattice for " << key_ << " did not align correctly"
+                     << (aligned_clat.Start() != fst::kNoStateId ?
+                         ", continuing with partial lattice." : ".");
+          ok_ = false;
+        }
+        if (aligned_clat.Start() != fst::kNoStateId)
+          TopSortCompactLatticeIfNeeded(&aligned_clat);
+        *clat_ = aligned_clat;
+        break;
+      }
+      case kStageCtmConf: {
+        fst::ScaleLattice(fst::AcousticLatticeScale(
+            config_.ctm_acoustic_scale), clat_);
+        MinimumBayesRisk mbr(*clat_, config_.decode_mbr);
+        words_ = mbr.GetOneBest();
+        conf_ = mbr.GetOneBestConfidences();
+        times_ = mbr.GetOneBestTimes();
+        KALDI_ASSERT(conf_.size() == words_.size() &&
+                     words_.size() == times_.size());
+        break;
+      }
+      default:
+        KALDI_ERR << "Invalid stage " << stage;
+    }
+  }
+
+  const LatticePipelineConfig &config_;
+  const std::vector<LatticePipelineStage> &stages_;
+  const CompiledWordBoundaryInfo *word_boundary_info_;
+  std::string key_;
+  CompactLattice *clat_; // The lattice we're working on.  Owned locally.
+  bool ok_;
+  double elapsed_;
+  // The output of the 'ctm-conf' stage, if present.
+  std::vector<int32> words_;
+  std::vector<BaseFloat> conf_;
+  std::vector<std::pair<BaseFloat, BaseFloat> > times_;
+  CompactLatticeWriter *clat_writer_;
+  Output *ctm_output_;
+  int32 *num_done_;
+  int32 *num_err_;
+  double *tot_time_;
+};
+
+} // namespace kaldi
+
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+
+    const char *usage =
+        "Apply a sequence of lattice operations to each lattice in one process,\n"
+        "instead of piping the lattices between programs.  <stages> is a\n"
+        "comma-separated list of the following, applied in order:\n"
+        "  scale        as lattice-scale (--acoustic-scale, --inv-acoustic-scale,\n"
+        "               --lm-scale)\n"
+        "  add-penalty  as lattice-add-penalty (--word-ins-penalty)\n"
+        "  prune        as lattice-prune (--prune-beam, --prune-acoustic-scale,\n"
+        "               --prune-max-arcs-per-frame)\n"
+        "  determinize  as lattice-determinize-pruned (--determinize-beam,\n"
+        "               --determinize-acoustic-scale, --determinize.max-mem etc.)\n"
+        "  push         as lattice-push\n"
+        "  minimize     as lattice-minimize\n"
+        "  align-words  as lattice-align-words (--word-boundary, --model,\n"
+        "               --silence-label etc.)\n"
+        "  ctm-conf     as lattice-to-ctm-conf (--decode-mbr, --frame-shift,\n"
+        "               --ctm-acoustic-scale); if present it must be last, and\n"
+        "               the output is a ctm file.\n"
+        "The per-stage acoustic scales are undone after the stage, as in the\n"
+        "separate programs; only the 'scale' stage, which may appear once,\n"
+        "changes the scale of the lattice that is passed on.\n"
+        "With --num-threads > 1, lattices are processed in parallel (the output\n"
+        "order is unchanged).\n"
+        "\n"
+        "Usage: lattice-pipeline [options] <stages> <lattice-rspecifier> "
+        "(<lattice-wspecifier>|<ctm-wxfilename>)\n"
+        " e.g.: lattice-pipeline --inv-acoustic-scale=10 --word-ins-penalty=0.5 \\\n"
+        "   --prune-beam=8 --determinize-beam=6 --word-boundary=data/lang/phones/word_boundary.int \\\n"
+        "   --model=final.mdl scale,add-penalty,prune,determinize,align-words,ctm-conf \\\n"
+        "   ark:1.lats 1.ctm\n";
+
+    ParseOptions po(usage);
+    LatticePipelineConfig config;
+    config.Register(&po);
+    ParseOptions po_det("determinize", &po);
+    config.determinize_opts.Register(&po_det);
+    TaskSequencerConfig sequencer_config; // has --num-threads option
+    sequencer_config.Register(&po);
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 3) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string stages_str = po.GetArg(1),
+        lats_rspecifier = po.GetArg(2),
+        output_wspecifier = po.GetArg(3);
+
+    KALDI_ASSERT(config.acoustic_scale == 1.0 ||
+                 config.inv_acoustic_scale == 1.0);
+    if (config.inv_acoustic_scale != 1.0)
+      config.acoustic_scale = 1.0 / config.inv_acoustic_scale;
+    if (config.prune_acoustic_scale == 0.0 ||
+        config.determinize_acoustic_scale == 0.0)
+      KALDI_ERR << "Do not use a zero --prune-acoustic-scale or "
+                << "--determinize-acoustic-scale (cannot be inverted)";
+
+    std::vector<LatticePipelineStage> stages;
+    ParseStages(stages_str, &stages);
+    bool write_ctm = (stages.back() == kStageCtmConf),
+        align_words = (std::find(stages.begin(), stages.end(),
+                                 kStageAlignWords) != stages.end());
+
+    CompiledWordBoundaryInfo *word_boundary_info = NULL;
+    if (align_words) {
+      if (config.word_boundary_rxfilename == "" ||
+          config.model_rxfilename == "")
+        KALDI_ERR << "The 'align-words' stage requires the --word-boundary "
+                  << "and --model options.";
+      TransitionModel tmodel;
+      ReadKaldiObject(config.model_rxfilename, &tmodel);
+      WordBoundaryInfo info(config.word_boundary_opts,
+                            config.word_boundary_rxfilename);
+      word_boundary_info = new CompiledWordBoundaryInfo(tmodel, info);
+    }
+
+    SequentialCompactLatticeReader clat_reader(lats_rspecifier);
+    CompactLatticeWriter clat_writer;
+    Output ctm_output;
+    if (write_ctm) {
+      if (ClassifyWspecifier(output_wspecifier, NULL, NULL, NULL) !=
+          kNoWspecifier)
+        KALDI_ERR << "With the 'ctm-conf' stage, the output should be a ctm "
+                  << "file, not a wspecifier: " << output_wspecifier;
+      if (!ctm_output.Open(output_wspecifier, false, false))
+        KALDI_ERR << "Could not open ctm output " << output_wspecifier;
+      ctm_output.Stream() << std::fixed;
+      ctm_output.Stream().precision(2);
+    } else {
+      if (!clat_writer.Open(output_wspecifier))
+        KALDI_ERR << "Could not open lattice output " << output_wspecifier;
+    }
+
+    int32 num_done = 0, num_err = 0;
+    double tot_time = 0.0;
+    {
+      TaskSequencer<LatticePipelineTask> sequencer(sequencer_config);
+      for (; !clat_reader.Done(); clat_reader.Next()) {
+        std::string key = clat_reader.Key();
+        // will give ownership to "task" below.
+        CompactLattice *clat = new CompactLattice(clat_reader.Value());
+        clat_reader.FreeCurrent();
+        sequencer.Run(new LatticePipelineTask(
+            config, stages, word_boundary_info, key, clat,
+            (write_ctm ? NULL : &clat_writer),
+            (write_ctm ? &ctm_output : NULL),
+            &num_done, &num_err, &tot_time));
+      }
+      sequencer.Wait();
+    }
+    delete word_boundary_info;
+
+    int32 num_lats = num_done + num_err;
+    KALDI_LOG << "Processed " << num_lats << " lattices through "
+              << stages.size() << " stages; " << num_err << " had errors.";
+    KALDI_LOG << "Average time per lattice was "
+              << (num_lats != 0 ? tot_time / num_lats : 0.0) << " seconds.";
+    return (num_done != 0 ? 0 : 1);
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -35,7 +35,8 @@ int main(int argc, char *argv[]) {
     using fst::StdArc;
 
     const char *usage =
-        "Apply beam pruning to lattices\n"
+        "Apply beam pruning to lattices, and optionally limit the number of arcs\n"
+        "crossing each frame (as lattice-limit-depth does, but in the same pass)\n"
         "Usage: lattice-prune [options] lattice-rspecifier lattice-wspecifier\n"
         " e.g.: lattice-prune --acoustic-scale=0.1 --beam=4.0 ark:1.lats ark:pruned.lats\n";
       
@@ -43,11 +44,15 @@ int main(int argc, char *argv[]) {
     BaseFloat acoustic_scale = 1.0;
     BaseFloat inv_acoustic_scale = 1.0;
     BaseFloat beam = 10.0;
+    int32 max_arcs_per_frame = 0;
     
     po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
     po.Register("inv-acoustic-scale", &inv_acoustic_scale, "An alternative way of setting the "
                 "acoustic scale: you can set its inverse.");
     po.Register("beam", &beam, "Pruning beam [applied after acoustic scaling]");
+    po.Register("max-arcs-per-frame", &max_arcs_per_frame, "If >0, the maximum "
+                "number of arcs allowed to cross any frame after pruning (the "
+                "ones on the best paths are kept).");
     
     po.Read(argc, argv);
 
@@ -84,7 +89,7 @@ int main(int argc, char *argv[]) {
       n_arcs_in += narcs;
       n_states_in += nstates;
       CompactLattice pruned_clat(clat);
-      if (!PruneLattice(beam, &pruned_clat)) {
+      if (!PruneLatticeLimitDepth(beam, max_arcs_per_frame, &pruned_clat)) {
         KALDI_WARN << "Error pruning lattice for utterance " << key;
         n_err++;
       }
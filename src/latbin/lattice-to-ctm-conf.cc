@@ -46,6 +46,7 @@ int main(int argc, char *argv[]) {
     BaseFloat acoustic_scale = 1.0, inv_acoustic_scale = 1.0, lm_scale = 1.0;
     bool decode_mbr = true;
     BaseFloat frame_shift = 0.01;
+    int32 num_threads = 1;
 
     std::string word_syms_filename;
     po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for "
@@ -57,6 +58,9 @@ int main(int argc, char *argv[]) {
     po.Register("decode-mbr", &decode_mbr, "If true, do Minimum Bayes Risk "
                 "decoding (else, Maximum a Posteriori)");
     po.Register("frame-shift", &frame_shift, "Time in seconds between frames.\n");
+    po.Register("num-threads", &num_threads, "Number of threads to use for "
+                "the MBR computation on each lattice (only helps for long "
+                "lattices).");
     
     po.Read(argc, argv);
 
@@ -98,7 +102,7 @@ int main(int argc, char *argv[]) {
       clat_reader.FreeCurrent();
       fst::ScaleLattice(fst::LatticeScale(lm_scale, acoustic_scale), &clat);
 
-      MinimumBayesRisk mbr(clat, decode_mbr);
+      MinimumBayesRisk mbr(clat, decode_mbr, num_threads);
       
       const std::vector<BaseFloat> &conf = mbr.GetOneBestConfidences();
       const std::vector<int32> &words = mbr.GetOneBest();
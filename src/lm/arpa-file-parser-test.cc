@@ -0,0 +1,238 @@
+// lm/arpa-file-parser-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sstream>
+
+#include "lm/arpa-file-parser.h"
+
+namespace kaldi {
+
+// Collects the n-grams it is given.
+class TestableArpaFileParser: public ArpaFileParser {
+ public:
+  TestableArpaFileParser(const ArpaParseOptions &options,
+                         fst::SymbolTable *symbols):
+      ArpaFileParser(options, symbols), header_available_(false),
+      read_complete_(false) { }
+  virtual void HeaderAvailable() { header_available_ = true; }
+  virtual void ConsumeNGram(const NGram &ngram) {
+    KALDI_ASSERT(header_available_ && !read_complete_);
+    ngrams_.push_back(ngram);
+  }
+  virtual void ReadComplete() { read_complete_ = true; }
+
+  using ArpaFileParser::NgramCounts;
+
+  bool header_available_;
+  bool read_complete_;
+  std::vector<NGram> ngrams_;
+};
+
+static const char *kIntegerArpa =
+    "\\data\\\n"
+    "ngram 1=4\n"
+    "ngram 2=2\n"
+    "ngram 3=1\n"
+    "\n"
+    "\\1-grams:\n"
+    "-5.2\t4 -3.3\n"
+    "-3.4\t5\n"
+    "0.0\t1 -2.5\n"
+    "-4.3\t2\n"
+    "\n"
+    "\\2-grams:\n"
+    "-1.4\t4 5 -3.2\n"
+    "-1.3\t1 4 -4.2\n"
+    "\n"
+    "\\3-grams:\n"
+    "-0.3\t1 4 5\n"
+    "\n"
+    "\\end\\\n";
+
+static const char *kSymbolArpa =
+    "\\data\\\n"
+    "ngram 1=4\n"
+    "ngram 2=2\n"
+    "\n"
+    "\\1-grams:\n"
+    "-5.2\ta -3.3\n"
+    "-3.4\tb\n"
+    "0.0\t<s> -2.5\n"
+    "-4.3\t</s>\n"
+    "\n"
+    "\\2-grams:\n"
+    "-1.4\ta b\n"
+    "-1.3\t<s> c\n"
+    "\n"
+    "\\end\\\n";
+
+void UnitTestReadIntegers() {
+  TestableArpaFileParser parser(ArpaParseOptions(), NULL);
+  std::istringstream is(kIntegerArpa);
+  parser.Read(is, false);
+  KALDI_ASSERT(parser.read_complete_);
+  KALDI_ASSERT(parser.NgramCounts().size() == 3);
+  KALDI_ASSERT(parser.NgramCounts()[0] == 4 && parser.NgramCounts()[2] == 1);
+  KALDI_ASSERT(parser.ngrams_.size() == 7);
+
+  const NGram &first = parser.ngrams_[0];
+  KALDI_ASSERT(first.words.size() == 1 && first.words[0] == 4);
+  AssertEqual(first.logprob, -5.2f);
+  AssertEqual(first.backoff, -3.3f);
+
+  const NGram &bigram = parser.ngrams_[4];
+  KALDI_ASSERT(bigram.words.size() == 2);
+  KALDI_ASSERT(bigram.words[0] == 4 && bigram.words[1] == 5);
+  AssertEqual(bigram.backoff, -3.2f);
+
+  const NGram &last = parser.ngrams_[6];
+  KALDI_ASSERT(last.words.size() == 3 && last.words[2] == 5);
+  KALDI_ASSERT(last.backoff == 0.0);
+}
+
+void UnitTestMaxOrder() {
+  ArpaParseOptions options;
+  options.max_order = 2;
+  TestableArpaFileParser parser(options, NULL);
+  std::istringstream is(kIntegerArpa);
+  parser.Read(is, false);
+  KALDI_ASSERT(parser.read_complete_);
+  KALDI_ASSERT(parser.NgramCounts().size() == 2);
+  KALDI_ASSERT(parser.ngrams_.size() == 6);
+  KALDI_ASSERT(parser.ngrams_.back().words.size() == 2);
+}
+
+void UnitTestOovHandling() {
+  {  // Adds the words to the symbol table.
+    fst::SymbolTable symbols("test");
+    symbols.AddSymbol("<eps>");
+    symbols.AddSymbol("<s>");
+    symbols.AddSymbol("</s>");
+    ArpaParseOptions options;
+    options.oov_handling = ArpaParseOptions::kAddToSymbols;
+    TestableArpaFileParser parser(options, &symbols);
+    std::istringstream is(kSymbolArpa);
+    parser.Read(is, false);
+    KALDI_ASSERT(parser.ngrams_.size() == 6);
+    KALDI_ASSERT(symbols.Find("a") == 3 && symbols.Find("c") == 5);
+    KALDI_ASSERT(parser.ngrams_[5].words[0] == 1 &&
+                 parser.ngrams_[5].words[1] == 5);
+  }
+  {  // Replaces "c", which is not in the symbol table, with <unk>.
+    fst::SymbolTable symbols("test");
+    symbols.AddSymbol("<eps>");
+    symbols.AddSymbol("<s>");
+    symbols.AddSymbol("</s>");
+    symbols.AddSymbol("a");
+    symbols.AddSymbol("b");
+    int32 unk = symbols.AddSymbol("<unk>");
+    ArpaParseOptions options;
+    options.oov_handling = ArpaParseOptions::kReplaceWithUnk;
+    options.unk_symbol = unk;
+    TestableArpaFileParser parser(options, &symbols);
+    std::istringstream is(kSymbolArpa);
+    parser.Read(is, false);
+    KALDI_ASSERT(parser.ngrams_.size() == 6);
+    KALDI_ASSERT(parser.ngrams_[5].words[1] == unk);
+  }
+  {  // Skips the n-gram containing "c".
+    fst::SymbolTable symbols("test");
+    symbols.AddSymbol("<eps>");
+    symbols.AddSymbol("<s>");
+    symbols.AddSymbol("</s>");
+    symbols.AddSymbol("a");
+    symbols.AddSymbol("b");
+    ArpaParseOptions options;
+    options.oov_handling = ArpaParseOptions::kSkipNGram;
+    TestableArpaFileParser parser(options, &symbols);
+    std::istringstream is(kSymbolArpa);
+    parser.Read(is, false);
+    KALDI_ASSERT(parser.ngrams_.size() == 5);
+    KALDI_ASSERT(symbols.Find("c") == fst::SymbolTable::kNoSymbol);
+  }
+}
+
+// Like the older ARPA readers, the parser skips stray lines in the header
+// section and unknown section keywords, and accepts orders with no header
+// line.
+void UnitTestTolerance() {
+  const char *arpa =
+      "\\data\\\n"
+      "created by some toolkit\n"
+      "ngram 3=1\n"
+      "ngram 1=2\n"
+      "\n"
+      "\\1-grams:\n"
+      "-1.0\t1 -0.5\n"
+      "-2.0\t2\n"
+      "\n"
+      "\\comments:\n"
+      "this is not an n-gram\n"
+      "\\3-grams:\n"
+      "-0.5\t1 1 2\n"
+      "\\end\\\n";
+  TestableArpaFileParser parser(ArpaParseOptions(), NULL);
+  std::istringstream is(arpa);
+  parser.Read(is, false);
+  KALDI_ASSERT(parser.read_complete_);
+  KALDI_ASSERT(parser.NgramCounts().size() == 3);
+  KALDI_ASSERT(parser.NgramCounts()[0] == 2 && parser.NgramCounts()[1] == 0 &&
+               parser.NgramCounts()[2] == 1);
+  KALDI_ASSERT(parser.ngrams_.size() == 3);
+  KALDI_ASSERT(parser.ngrams_[2].words.size() == 3);
+}
+
+void UnitTestBadInput() {
+  const char *bad_files[] = {
+    // No \data\ section.
+    "\\1-grams:\n-1.0\t1\n\\end\\\n",
+    // Junk after the backoff weight.
+    "\\data\\\nngram 1=1\n\\1-grams:\n-1.0\t1 -0.5 x\n\\end\\\n",
+    // Too few words.
+    "\\data\\\nngram 1=1\nngram 2=1\n\\1-grams:\n-1.0\t1\n"
+    "\\2-grams:\n-1.0\t1\n\\end\\\n",
+    // Sections out of order.
+    "\\data\\\nngram 1=1\nngram 2=1\n\\2-grams:\n-1.0\t1 1\n"
+    "\\1-grams:\n-1.0\t1\n\\end\\\n",
+    // Words that are not integers, with no symbol table.
+    "\\data\\\nngram 1=1\n\\1-grams:\n-1.0\ta\n\\end\\\n"
+  };
+  for (size_t i = 0; i < sizeof(bad_files) / sizeof(bad_files[0]); i++) {
+    TestableArpaFileParser parser(ArpaParseOptions(), NULL);
+    std::istringstream is(bad_files[i]);
+    bool threw = false;
+    try {
+      parser.Read(is, false);
+    } catch(const std::exception &e) {
+      threw = true;
+    }
+    KALDI_ASSERT(threw);
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  UnitTestReadIntegers();
+  UnitTestMaxOrder();
+  UnitTestOovHandling();
+  UnitTestTolerance();
+  UnitTestBadInput();
+  std::cout << "Test OK.\n";
+  return 0;
+}
@@ -0,0 +1,264 @@
+// lm/arpa-file-parser.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cctype>
+#include <sstream>
+
+#include "lm/arpa-file-parser.h"
+#include "base/timer.h"
+#include "util/text-utils.h"
+
+namespace kaldi {
+
+static inline bool IsSpace(char c) {
+  return isspace(static_cast<unsigned char>(c)) != 0;
+}
+
+ArpaFileParser::ArpaFileParser(const ArpaParseOptions &options,
+                               fst::SymbolTable *symbols):
+    options_(options), symbols_(symbols), line_number_(0), num_skipped_(0) {
+  if (symbols_ != NULL &&
+      options_.oov_handling == ArpaParseOptions::kReplaceWithUnk &&
+      options_.unk_symbol < 0)
+    KALDI_ERR << "Replacing OOVs with <unk> requires the unk symbol to be set.";
+}
+
+std::string ArpaFileParser::LineReference() const {
+  std::ostringstream ss;
+  ss << "line " << line_number_ << " [" << line_ << "]";
+  return ss.str();
+}
+
+int32 ArpaFileParser::WordToId(const char *begin, const char *end) {
+  word_.assign(begin, end);
+  if (symbols_ == NULL) {
+    int32 id;
+    if (!ConvertStringToInteger(word_, &id) || id < 0)
+      KALDI_ERR << "Expected a non-negative integer word-id, got \"" << word_
+                << "\": " << LineReference();
+    return id;
+  }
+  int64 id = symbols_->Find(word_);
+  if (id != fst::SymbolTable::kNoSymbol)
+    return id;
+  switch (options_.oov_handling) {
+    case ArpaParseOptions::kAddToSymbols:
+      return symbols_->AddSymbol(word_);
+    case ArpaParseOptions::kReplaceWithUnk:
+      return options_.unk_symbol;
+    case ArpaParseOptions::kSkipNGram:
+      return -1;
+    default:
+      KALDI_ERR << "Word \"" << word_ << "\" is not in the symbol table: "
+                << LineReference();
+      return -1;  // Suppress compiler warning.
+  }
+}
+
+// An n-gram line is: log-probability, the words, and optionally the backoff
+// weight, separated by whitespace.  We parse it in place rather than splitting
+// it into strings, since this is where all the time goes for large files.
+bool ArpaFileParser::ParseNGramLine(int32 order) {
+  const char *cur = line_.c_str();
+  char *next;
+  while (IsSpace(*cur)) cur++;
+  ngram_.logprob = KALDI_STRTOF(cur, &next);
+  if (next == cur)
+    KALDI_ERR << "Expected a log-probability at the start of "
+              << LineReference();
+  cur = next;
+
+  bool skip = false;
+  ngram_.words.resize(order);
+  for (int32 i = 0; i < order; i++) {
+    while (IsSpace(*cur)) cur++;
+    if (*cur == '\0')
+      KALDI_ERR << "Too few words for a " << order << "-gram in "
+                << LineReference();
+    const char *end = cur;
+    while (*end != '\0' && !IsSpace(*end)) end++;
+    int32 id = WordToId(cur, end);
+    if (id < 0) skip = true;
+    ngram_.words[i] = id;
+    cur = end;
+  }
+
+  ngram_.backoff = 0.0;
+  while (IsSpace(*cur)) cur++;
+  if (*cur != '\0') {
+    ngram_.backoff = KALDI_STRTOF(cur, &next);
+    if (next == cur)
+      KALDI_ERR << "Junk at the end of " << LineReference();
+    cur = next;
+    while (IsSpace(*cur)) cur++;
+    if (*cur != '\0')
+      KALDI_ERR << "Junk at the end of " << LineReference();
+  }
+  if (KALDI_ISNAN(ngram_.logprob) || KALDI_ISINF(ngram_.logprob) ||
+      KALDI_ISNAN(ngram_.backoff) || KALDI_ISINF(ngram_.backoff))
+    KALDI_ERR << "NaN or inf detected in " << LineReference();
+  return !skip;
+}
+
+void ArpaFileParser::Read(std::istream &is, bool binary) {
+  if (binary) {
+    KALDI_ERR << "binary-mode reading is not implemented for "
+              << "ArpaFileParser.";
+  }
+  ngram_counts_.clear();
+  line_number_ = 0;
+  num_skipped_ = 0;
+  ReadStarted();
+  Timer timer;
+
+  // Skips everything before "\data\".
+  bool keyword_found = false;
+  while (std::getline(is, line_)) {
+    ++line_number_;
+    Trim(&line_);
+    if (line_ == "\\data\\") {
+      keyword_found = true;
+      break;
+    }
+  }
+  if (!keyword_found)
+    KALDI_ERR << "\\data\\ section not found in ARPA file.";
+
+  // Reads lines like "ngram 2=1000", until the first section keyword.  As in
+  // the older readers, other lines are skipped, and the orders need not be
+  // consecutive or in order; orders that are not mentioned get a count of zero.
+  bool have_line = false;
+  while (std::getline(is, line_)) {
+    ++line_number_;
+    Trim(&line_);
+    if (line_.empty()) continue;
+    if (line_[0] == '\\') {
+      have_line = true;
+      break;
+    }
+    std::string::size_type eq = line_.find('=');
+    if (line_.compare(0, 5, "ngram") != 0 || eq == std::string::npos) {
+      KALDI_WARN << "Ignoring line in \\data\\ section: " << LineReference();
+      continue;
+    }
+    std::string order_str(line_, 5, eq - 5), count_str(line_, eq + 1);
+    Trim(&order_str);
+    Trim(&count_str);
+    int32 order;
+    int64 count;
+    if (!ConvertStringToInteger(order_str, &order) ||
+        !ConvertStringToInteger(count_str, &count) || order < 1 || count < 0)
+      KALDI_ERR << "Invalid line in \\data\\ section: " << LineReference();
+    if (order > NgramOrder())
+      ngram_counts_.resize(order, 0);
+    ngram_counts_[order - 1] = count;
+  }
+  if (ngram_counts_.empty())
+    KALDI_ERR << "No n-gram counts in \\data\\ section.";
+  int32 file_order = NgramOrder();
+  if (options_.max_order > 0 && file_order > options_.max_order) {
+    KALDI_LOG << "Reading only up to " << options_.max_order << "-grams of "
+              << file_order << "-gram language model.";
+    ngram_counts_.resize(options_.max_order);
+  }
+  HeaderAvailable();
+
+  // Reads the "\N-grams:" sections; <line_> holds the keyword of the next
+  // section whenever <have_line> is true.
+  int64 num_ngrams = 0;
+  int32 cur_order = 0;
+  bool end_found = false;
+  while (have_line) {
+    have_line = false;
+    if (line_ == "\\end\\") {
+      end_found = true;
+      break;
+    }
+    int32 order;
+    std::string::size_type suffix = line_.find("-grams:");
+    bool skip_lines = false;
+    if (suffix == std::string::npos || suffix + 7 != line_.size() ||
+        !ConvertStringToInteger(line_.substr(1, suffix - 1), &order)) {
+      // The older readers skipped anything that was not a section keyword.
+      KALDI_WARN << "Ignoring lines from unknown section keyword: "
+                 << LineReference();
+      skip_lines = true;
+    } else {
+      if (order <= cur_order || order > file_order)
+        KALDI_ERR << "Unexpected section, sections must be in increasing "
+                  << "order of n-gram order: " << LineReference();
+      for (int32 o = cur_order + 1; o < order && o <= NgramOrder(); o++)
+        if (ngram_counts_[o - 1] != 0)
+          KALDI_WARN << "Missing section for " << o << "-grams.";
+      cur_order = order;
+      // Skips the lines of orders above options_.max_order.
+      skip_lines = (order > NgramOrder());
+    }
+    if (skip_lines) {
+      while (std::getline(is, line_)) {
+        ++line_number_;
+        if (!line_.empty() && line_[0] == '\\') {
+          Trim(&line_);
+          have_line = true;
+          break;
+        }
+      }
+      continue;
+    }
+    KALDI_VLOG(1) << "Reading " << order << "-grams.";
+
+    int64 count = 0;
+    while (std::getline(is, line_)) {
+      ++line_number_;
+      const char *cur = line_.c_str();
+      while (IsSpace(*cur)) cur++;
+      if (*cur == '\0') continue;
+      if (*cur == '\\') {
+        Trim(&line_);
+        have_line = true;
+        break;
+      }
+      if (ParseNGramLine(order))
+        ConsumeNGram(ngram_);
+      else
+        num_skipped_++;
+      count++;
+      if (++num_ngrams % 10000000 == 0)
+        KALDI_VLOG(1) << "Read " << num_ngrams << " n-grams, "
+                      << (num_ngrams / timer.Elapsed()) << " n-grams/sec.";
+    }
+    if (count != ngram_counts_[order - 1])
+      KALDI_WARN << "Header said there would be " << ngram_counts_[order - 1]
+                 << " n-grams of order " << order << ", but we saw " << count;
+  }
+  for (int32 o = cur_order + 1; o <= NgramOrder(); o++)
+    if (ngram_counts_[o - 1] != 0)
+      KALDI_WARN << "Missing section for " << o << "-grams.";
+  if (!end_found)
+    KALDI_WARN << "\\end\\ marker not found in ARPA file.";
+  if (num_skipped_ > 0)
+    KALDI_WARN << "Skipped " << num_skipped_ << " n-grams containing words "
+               << "not in the symbol table.";
+
+  double elapsed = timer.Elapsed();
+  KALDI_LOG << "Read " << num_ngrams << " n-grams in " << elapsed
+            << " seconds (" << (elapsed > 0.0 ? num_ngrams / elapsed : 0.0)
+            << " n-grams/sec).";
+  ReadComplete();
+}
+
+}  // namespace kaldi
@@ -0,0 +1,138 @@
+// lm/arpa-file-parser.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_LM_ARPA_FILE_PARSER_H_
+#define KALDI_LM_ARPA_FILE_PARSER_H_
+
+#include <string>
+#include <vector>
+
+#include "fst/fst-decl.h"
+#include "fst/symbol-table.h"
+#include "base/kaldi-common.h"
+
+namespace kaldi {
+
+/// Options that control how ArpaFileParser treats the words it reads.
+struct ArpaParseOptions {
+  enum OovHandling {
+    kRaiseError,      ///< Abort on a word that is not in the symbol table.
+    kAddToSymbols,    ///< Add the word to the symbol table.
+    kReplaceWithUnk,  ///< Replace the word with unk_symbol.
+    kSkipNGram        ///< Drop the n-gram (with a warning at the end).
+  };
+
+  ArpaParseOptions(): unk_symbol(-1), oov_handling(kRaiseError),
+                      max_order(0) { }
+
+  int32 unk_symbol;          ///< Only used with kReplaceWithUnk.
+  OovHandling oov_handling;  ///< Ignored if the parser has no symbol table.
+  /// If > 0, n-grams of higher order are skipped without being parsed, and
+  /// the model looks to the consumer as if it was of this order.
+  int32 max_order;
+};
+
+/// One n-gram as read from an ARPA file.  The probabilities are exactly as in
+/// the file, i.e. base-10 logs; converting them is up to the consumer.
+struct NGram {
+  std::vector<int32> words;  ///< Word ids, oldest word first.
+  float logprob;
+  float backoff;             ///< Zero if the line had no backoff weight.
+};
+
+/**
+   ArpaFileParser reads an ARPA format language model line by line and hands
+   each n-gram to the virtual function ConsumeNGram() as soon as it has been
+   parsed, so the file is never held in memory, neither as text nor as a
+   table of strings; words are turned into integer ids as they are read.  It
+   is the common front end of the programs that compile ARPA files, which
+   differ only in what they build from the n-grams.
+
+   If a symbol table is supplied the words are looked up (and possibly added)
+   in it; otherwise the words must already be integers, as produced by
+   utils/map_arpa_lm.pl.  The n-grams are delivered section by section, i.e.
+   all unigrams, then all bigrams and so on, in the order of the file.
+
+   Compressed files can be read through the usual pipe syntax for rxfilenames,
+   e.g. "gunzip -c lm.arpa.gz |".  The number of n-grams read per second is
+   logged at the end (and every ten million n-grams at verbose level 1).
+*/
+class ArpaFileParser {
+ public:
+  /// "symbols" may be NULL, in which case words must be integers.  It is not
+  /// owned, and if options.oov_handling == kAddToSymbols it is modified.
+  ArpaFileParser(const ArpaParseOptions &options, fst::SymbolTable *symbols);
+
+  virtual ~ArpaFileParser() { }
+
+  /// Reads the whole file; "binary" must be false.  The name and signature
+  /// are as for other Kaldi objects, so ReadKaldiObject() works.
+  void Read(std::istream &is, bool binary);
+
+  const ArpaParseOptions &Options() const { return options_; }
+
+ protected:
+  /// Called before anything is read.
+  virtual void ReadStarted() { }
+
+  /// Called once the "\data\" section has been read, so NgramCounts() and
+  /// NgramOrder() are valid.
+  virtual void HeaderAvailable() { }
+
+  /// Called once for every n-gram.
+  virtual void ConsumeNGram(const NGram &ngram) = 0;
+
+  /// Called after the "\end\" marker (or the end of the stream).
+  virtual void ReadComplete() { }
+
+  /// Counts from the header; element i is the number of (i+1)-grams.  If
+  /// options.max_order is set, orders above it are not included.
+  const std::vector<int64> &NgramCounts() const { return ngram_counts_; }
+
+  int32 NgramOrder() const { return ngram_counts_.size(); }
+
+  /// The symbol table passed to the constructor (may be NULL).
+  fst::SymbolTable *Symbols() { return symbols_; }
+
+  /// Returns a description of the current line, for error messages.
+  std::string LineReference() const;
+
+ private:
+  // Parses the n-gram of the given order in line_ into ngram_; returns false
+  // if the n-gram is to be skipped because of an OOV word.
+  bool ParseNGramLine(int32 order);
+
+  // Converts the word [begin, end) into an id; returns -1 if it is an OOV
+  // that is to be skipped.
+  int32 WordToId(const char *begin, const char *end);
+
+  ArpaParseOptions options_;
+  fst::SymbolTable *symbols_;
+  std::vector<int64> ngram_counts_;
+
+  int64 line_number_;
+  std::string line_;
+  std::string word_;  // Buffer, to avoid reallocating for each word.
+  NGram ngram_;
+  int64 num_skipped_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ArpaFileParser);
+};
+
+}  // namespace kaldi
+
+#endif  // KALDI_LM_ARPA_FILE_PARSER_H_
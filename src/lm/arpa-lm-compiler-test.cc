@@ -0,0 +1,92 @@
+// lm/arpa-lm-compiler-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sstream>
+
+#include "lm/arpa-lm-compiler.h"
+
+namespace kaldi {
+
+static const char *kBigramArpa =
+    "\\data\\\n"
+    "ngram 1=4\n"
+    "ngram 2=3\n"
+    "\n"
+    "\\1-grams:\n"
+    "-1.0\t</s>\n"
+    "-99\t<s> -0.5\n"
+    "-0.7\ta -0.3\n"
+    "-0.8\tb -0.2\n"
+    "\n"
+    "\\2-grams:\n"
+    "-0.2\t<s> a\n"
+    "-0.4\ta b\n"
+    "-0.6\tb </s>\n"
+    "\n"
+    "\\end\\\n";
+
+// Compiles kBigramArpa and checks the FST arc by arc, including the backoff
+// arcs, against the one we expect.
+void UnitTestCompileBigram(bool natural_base) {
+  fst::SymbolTable symbols("words");
+  symbols.AddSymbol("<eps>");
+  int32 bos = symbols.AddSymbol("<s>"), eos = symbols.AddSymbol("</s>");
+  fst::StdVectorFst fst;
+  fst.SetInputSymbols(&symbols);
+  ArpaParseOptions options;
+  options.oov_handling = ArpaParseOptions::kAddToSymbols;
+  ArpaLmCompiler compiler(options, bos, eos, natural_base, &fst);
+  std::istringstream is(kBigramArpa);
+  compiler.Read(is, false);
+
+  int32 a = fst.InputSymbols()->Find("a"), b = fst.InputSymbols()->Find("b");
+  KALDI_ASSERT(a == 3 && b == 4);
+  KALDI_ASSERT(fst.OutputSymbols() != NULL &&
+               fst.OutputSymbols()->Find("b") == b);
+
+  // States are created in the order in which the n-grams need them: the
+  // start state, the empty history, then </s>, <s>, a and b.  The <s>
+  // unigram is entered from the start state with no cost, </s> is final and
+  // has no backoff arc, and the bigrams add no states.
+  BaseFloat scale = (natural_base ? 2.302585 : 1.0);
+  fst::StdVectorFst expected;
+  for (int32 i = 0; i < 6; i++)
+    expected.AddState();
+  expected.SetStart(0);
+  expected.SetFinal(2, fst::TropicalWeight::One());
+  expected.AddArc(0, fst::StdArc(bos, bos, 0.0, 3));
+  expected.AddArc(1, fst::StdArc(eos, eos, 1.0 * scale, 2));
+  expected.AddArc(3, fst::StdArc(0, 0, 0.5 * scale, 1));
+  expected.AddArc(1, fst::StdArc(a, a, 0.7 * scale, 4));
+  expected.AddArc(4, fst::StdArc(0, 0, 0.3 * scale, 1));
+  expected.AddArc(1, fst::StdArc(b, b, 0.8 * scale, 5));
+  expected.AddArc(5, fst::StdArc(0, 0, 0.2 * scale, 1));
+  expected.AddArc(3, fst::StdArc(a, a, 0.2 * scale, 4));
+  expected.AddArc(4, fst::StdArc(b, b, 0.4 * scale, 5));
+  expected.AddArc(5, fst::StdArc(eos, eos, 0.6 * scale, 2));
+  KALDI_ASSERT(fst::Equal(fst, expected, 1.0e-06));
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  UnitTestCompileBigram(false);
+  UnitTestCompileBigram(true);
+  std::cout << "Test OK.\n";
+  return 0;
+}
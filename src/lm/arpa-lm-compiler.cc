@@ -0,0 +1,117 @@
+// lm/arpa-lm-compiler.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lm/arpa-lm-compiler.h"
+
+namespace kaldi {
+
+ArpaLmCompiler::ArpaLmCompiler(const ArpaParseOptions &options,
+                               int32 bos_symbol, int32 eos_symbol,
+                               bool natural_base, fst::StdVectorFst *fst):
+    ArpaFileParser(options, fst->MutableInputSymbols()),
+    bos_symbol_(bos_symbol), eos_symbol_(eos_symbol),
+    // -2.302585 rather than -Log(10.0), to give the same weights as the
+    // LmFstConverter that this replaces.
+    scale_(natural_base ? -2.302585 : -1.0), fst_(fst) {
+  KALDI_ASSERT(Symbols() != NULL &&
+               "ArpaLmCompiler needs an FST with an input symbol table");
+}
+
+void ArpaLmCompiler::ReadStarted() {
+  history_to_state_.clear();
+  if (fst_->Start() == fst::kNoStateId)
+    fst_->SetStart(fst_->AddState());
+}
+
+ArpaLmCompiler::StateId ArpaLmCompiler::FindOrAddState(
+    std::vector<int32>::const_iterator begin,
+    std::vector<int32>::const_iterator end, bool *created) {
+  key_.assign(begin, end);
+  HistoryMap::iterator iter = history_to_state_.find(key_);
+  if (iter != history_to_state_.end()) {
+    *created = false;
+    return iter->second;
+  }
+  StateId s = fst_->AddState();
+  history_to_state_[key_] = s;
+  *created = true;
+  return s;
+}
+
+void ArpaLmCompiler::ConsumeNGram(const NGram &ngram) {
+  const std::vector<int32> &words = ngram.words;
+  int32 order = words.size(), word = words.back();
+  bool is_highest = (order == NgramOrder()), created, dst_created = false;
+  Weight prob(scale_ * ngram.logprob),
+      bow(is_highest ? 0.0 : scale_ * ngram.backoff);
+
+  StateId src, dst = fst::kNoStateId, dbo = fst::kNoStateId;
+  if (order == 1 && word == bos_symbol_) {
+    // <s> is entered from the start state with no cost.
+    src = fst_->Start();
+    prob = Weight::One();
+  } else {
+    // The history, i.e. all words but the last.
+    src = FindOrAddState(words.begin(), words.end() - 1, &created);
+  }
+  // The destination is the n-gram itself, or for the highest order, the
+  // n-gram without its oldest word.  We make sure that all of its suffixes
+  // exist, since they are the states we back off to.
+  int32 dst_length = (is_highest && order > 1 ? order - 1 : order);
+  for (int32 length = (is_highest || order == 1 ? 1 : 2);
+       length <= dst_length; length++) {
+    dst = FindOrAddState(words.end() - length, words.end(), &dst_created);
+    dbo = FindOrAddState(words.end() - length + 1, words.end(), &created);
+  }
+
+  if (word == eos_symbol_)
+    fst_->SetFinal(dst, Weight::One());
+  fst_->AddArc(src, fst::StdArc(word, word, prob, dst));
+
+  // Newly created states get the backoff arc, unless they are final.
+  if (dst_created && dst != dbo && fst_->Final(dst) == Weight::Zero())
+    fst_->AddArc(dst, fst::StdArc(0, 0, bow, dbo));
+}
+
+void ArpaLmCompiler::ConnectUnusedStates() {
+  int32 num_connected = 0;
+  for (HistoryMap::const_iterator iter = history_to_state_.begin();
+       iter != history_to_state_.end(); ++iter) {
+    StateId s = iter->second;
+    if (iter->first.empty() || fst_->NumArcs(s) != 0 ||
+        fst_->Final(s) != Weight::Zero())
+      continue;
+    key_.assign(iter->first.begin() + 1, iter->first.end());
+    HistoryMap::const_iterator backoff = history_to_state_.find(key_);
+    if (backoff == history_to_state_.end()) continue;
+    fst_->AddArc(s, fst::StdArc(0, 0, Weight::One(), backoff->second));
+    num_connected++;
+  }
+  KALDI_LOG << "Connected " << num_connected
+            << " states without outgoing arcs.";
+}
+
+void ArpaLmCompiler::ReadComplete() {
+  ConnectUnusedStates();
+  fst_->SetOutputSymbols(fst_->InputSymbols());
+  KALDI_LOG << "Compiled " << fst_->NumStates() << " states for "
+            << history_to_state_.size() << " histories.";
+  // The keys are no longer needed.
+  HistoryMap().swap(history_to_state_);
+}
+
+}  // namespace kaldi
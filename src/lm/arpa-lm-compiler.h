@@ -0,0 +1,83 @@
+// lm/arpa-lm-compiler.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_LM_ARPA_LM_COMPILER_H_
+#define KALDI_LM_ARPA_LM_COMPILER_H_
+
+#include <vector>
+
+#include "fst/fstlib.h"
+#include "base/kaldi-common.h"
+#include "lm/arpa-file-parser.h"
+#include "util/stl-utils.h"
+
+namespace kaldi {
+
+/**
+   ArpaLmCompiler builds the grammar FST (G.fst) from an ARPA file as the file
+   is being read.  The FST has one state per history, and histories are keyed
+   on sequences of integer word-ids rather than on strings of words, and the
+   backoff state of a history is found from the key itself, so apart from the
+   FST the only thing held in memory is one small key per state.  The FST it
+   produces is the same as the one LmFstConverter produces in the IRSTLM
+   build: <s> is entered from the start state with no cost, states whose last
+   word is </s> are final, and each history has an epsilon arc to its backoff
+   history.
+
+   The FST passed to the constructor must have an input symbol table, which
+   is used (and added to, by default) to map words to ids; on completion the
+   output symbol table is set to a copy of it.
+*/
+class ArpaLmCompiler: public ArpaFileParser {
+ public:
+  ArpaLmCompiler(const ArpaParseOptions &options,
+                 int32 bos_symbol, int32 eos_symbol,
+                 bool natural_base, fst::StdVectorFst *fst);
+
+ protected:
+  virtual void ReadStarted();
+  virtual void ConsumeNGram(const NGram &ngram);
+  virtual void ReadComplete();
+
+ private:
+  typedef fst::StdArc::StateId StateId;
+  typedef fst::StdArc::Weight Weight;
+  typedef unordered_map<std::vector<int32>, StateId,
+                        VectorHasher<int32> > HistoryMap;
+
+  // Returns the state for the history [begin, end), creating it if necessary,
+  // in which case *created is set to true.
+  StateId FindOrAddState(std::vector<int32>::const_iterator begin,
+                         std::vector<int32>::const_iterator end,
+                         bool *created);
+
+  // Gives each state that has neither arcs nor a final-prob (which can happen
+  // for histories that are not themselves n-grams) an epsilon arc to its
+  // backoff state.
+  void ConnectUnusedStates();
+
+  int32 bos_symbol_;
+  int32 eos_symbol_;
+  float scale_;  // Converts log10 probabilities into costs.
+  fst::StdVectorFst *fst_;
+  HistoryMap history_to_state_;
+  std::vector<int32> key_;  // Buffer, to avoid reallocating for each lookup.
+};
+
+}  // namespace kaldi
+
+#endif  // KALDI_LM_ARPA_LM_COMPILER_H_
@@ -19,6 +19,7 @@
 
 #include <sstream>
 
+#include "lm/arpa-file-parser.h"
 #include "lm/const-arpa-lm.h"
 #include "util/stl-utils.h"
 #include "util/text-utils.h"
@@ -167,16 +168,20 @@ class LmState {
 };
 
 // Class to build ConstArpaLm from Arpa format language model. It relies on the
-// auxiliary class LmState above.
-class ConstArpaLmBuilder {
+// auxiliary class LmState above. The Arpa file is parsed by ArpaFileParser,
+// which hands us the n-grams one by one as integer sequences, so we never hold
+// the text of the language model in memory.
+class ConstArpaLmBuilder : public ArpaFileParser {
  public:
   ConstArpaLmBuilder(
       const bool natural_base, const int32 bos_symbol,
       const int32 eos_symbol, const int32 unk_symbol) :
+      ArpaFileParser(ArpaParseOptions(), NULL),
       natural_base_(natural_base), bos_symbol_(bos_symbol),
       eos_symbol_(eos_symbol), unk_symbol_(unk_symbol) {
     ngram_order_ = 0;
     num_words_ = 0;
+    max_word_id_ = 0;
     overflow_buffer_size_ = 0;
     lm_states_size_ = 0;
     max_address_offset_ = pow(2, 30) - 1;
@@ -199,9 +204,6 @@ class ConstArpaLmBuilder {
     }
   }
 
-  // Reads in the Arpa format language model, parses it and creates LmStates.
-  void Read(std::istream &is, bool binary);
-
   // Writes ConstArpaLm.
   void Write(std::ostream &os, bool binary) const;
 
@@ -214,6 +216,12 @@ class ConstArpaLmBuilder {
     max_address_offset_ = max_address_offset;
   }
 
+ protected:
+  // Callbacks from ArpaFileParser, which we use to create the LmStates.
+  virtual void HeaderAvailable();
+  virtual void ConsumeNGram(const NGram &ngram);
+  virtual void ReadComplete();
+
  private:
   struct WordsAndLmStatePairLessThan {
     bool operator()(
@@ -253,6 +261,9 @@ class ConstArpaLmBuilder {
   // array.
   int32 num_words_;
 
+  // Largest word-id seen so far while reading.
+  int32 max_word_id_;
+
   // Number of entries in the overflow buffer for pointers that couldn't be
   // represented as a 30-bit relative index.
   int32 overflow_buffer_size_;
@@ -275,194 +286,86 @@ class ConstArpaLmBuilder {
                 LmState*, VectorHasher<int32> > seq_to_state_;
 };
 
-// Reads in the Arpa format language model, parses it and puts the word sequence
-// into the corresponding LmState in <seq_to_state_>.
-void ConstArpaLmBuilder::Read(std::istream &is, bool binary) {
-  if (binary) {
-    KALDI_ERR << "binary-mode reading is not implemented for "
-        << "ConstArpaLmBuilder.";
-  }
-
-  std::string line;
-
-  // Number of n-grams from "\data\" section. Those numbers should match the
-  // actual number of n-grams from "\N-grams:" sections.
-  // Note that when we convert the words in the Arpa format language model into
-  // integers, we remove lines with OOV words. We also modify the n-gram counts
-  // in "\data\" correspondingly.
-  std::vector<int32> num_ngrams;
-
-  // Processes "\data\" section.
-  bool keyword_found = false;
-  while (getline(is, line) && !is.eof()) {
-    // The section keywords starts with backslash. We terminate the while loop
-    // if a new section is found.
-    if (!line.empty() && line[0] == '\\') {
-      if (line.find("-grams:") != std::string::npos) break;
-      if (line.find("\\end\\") != std::string::npos) break;
-    }
-
-    std::vector<std::string> col;
-    SplitStringToVector(line, " \t", true, &col);
+void ConstArpaLmBuilder::HeaderAvailable() {
+  ngram_order_ = NgramOrder();
+}
 
-    // Looks for keyword "\data\".
-    if (!keyword_found && col.size() == 1 && col[0] == "\\data\\") {
-      KALDI_LOG << "Reading \"\\data\\\" section.";
-      keyword_found = true;
+// Puts the word sequence of each n-gram into the corresponding LmState in
+// <seq_to_state_>.
+void ConstArpaLmBuilder::ConsumeNGram(const NGram &ngram) {
+  int32 cur_order = ngram.words.size();
+  if (cur_order == ngram_order_ && ngram.backoff != 0.0) {
+    KALDI_ERR << "Backoff probability detected for final-order entry: "
+        << LineReference();
+  }
+
+  // Creates LmState for the current word sequence.
+  bool is_unigram = (cur_order == 1) ? true : false;
+  float logprob = ngram.logprob;
+  float backoff_logprob = ngram.backoff;
+  if (natural_base_) {
+    logprob *= log(10);
+    backoff_logprob *= log(10);
+  }
+
+  // If <ngram_order_> is larger than 1, then we do not create LmState for
+  // the final order entry. We only keep the log probability for it.
+  LmState *lm_state = NULL;
+  if (cur_order != ngram_order_ || ngram_order_ == 1) {
+    lm_state = new LmState(is_unigram,
+                           (cur_order == ngram_order_ - 1),
+                           logprob, backoff_logprob);
+  }
+
+  // The sequence of words.
+  const std::vector<int32> &seq = ngram.words;
+
+  // If <ngram_order_> is larger than 1, then we do not insert LmState to
+  // <seq_to_state_>.
+  if (cur_order != ngram_order_ || ngram_order_ == 1) {
+    KALDI_ASSERT(lm_state != NULL);
+    KALDI_ASSERT(seq_to_state_.find(seq) == seq_to_state_.end());
+    seq_to_state_[seq] = lm_state;
+  }
+
+  // If n-gram order is larger than 1, we have to add possible child to
+  // existing LmStates. We have the following two assumptions:
+  // 1. N-grams are processed from small order to larger ones, i.e., from
+  //    1, 2, ... to the highest order.
+  // 2. If a n-gram exists in the Arpa format language model, then the
+  //    "history" n-gram also exists. For example, if "A B C" is a valid
+  //    n-gram, then "A B" is also a valid n-gram.
+  if (cur_order > 1) {
+    std::vector<int32> hist(seq.begin(), seq.begin() + cur_order - 1);
+    int32 word = seq[seq.size() - 1];
+    unordered_map<std::vector<int32>,
+                  LmState*, VectorHasher<int32> >::iterator hist_iter;
+    hist_iter = seq_to_state_.find(hist);
+    if (hist_iter == seq_to_state_.end()) {
+      KALDI_ERR << "History of n-gram does not exist in the language model: "
+          << LineReference();
     }
-
-    // Enters "\data\" section, and looks for patterns like"ngram 1=1000", which
-    // means there are 1000 unigrams.
-    if (keyword_found && col.size() == 2 && col[0] == "ngram") {
-      std::vector<std::string> sub_col;
-      SplitStringToVector(col[1], "=", true, &sub_col);
-      if (sub_col.size() == 2) {
-        int32 order, ngram_count;
-        if (!ConvertStringToInteger(sub_col[0], &order)) {
-          KALDI_ERR << "bad line: " << line << "; fail to convert "
-              << sub_col[0] << " to integer.";
-        }
-        if (!ConvertStringToInteger(sub_col[1], &ngram_count)) {
-          KALDI_ERR << "bad line: " << line << "; fail to convert "
-              << sub_col[1] << " to integer.";
-        }
-        if (num_ngrams.size() <= order) {
-          num_ngrams.resize(order + 1);
-        }
-        num_ngrams[order] = ngram_count;
-      }
+    if (cur_order != ngram_order_ || ngram_order_ == 1) {
+      KALDI_ASSERT(lm_state != NULL);
+      KALDI_ASSERT(!hist_iter->second->IsChildFinalOrder());
+      hist_iter->second->AddChild(word, lm_state);
+    } else {
+      KALDI_ASSERT(lm_state == NULL);
+      KALDI_ASSERT(hist_iter->second->IsChildFinalOrder());
+      hist_iter->second->AddChild(word, logprob);
     }
-  }
-  KALDI_ASSERT(num_ngrams.size() > 0);
-  ngram_order_ = num_ngrams.size() - 1;
-
-  // Processes "\N-grams:" section.
-  int32 max_word_id = 0;
-  for (int32 cur_order = 1; cur_order < num_ngrams.size(); ++cur_order) {
-    // Skips n-grams with zero count.
-    if (num_ngrams[cur_order] == 0) continue;
-
-    keyword_found = false;
-    int32 ngram_count = 0;
-    std::ostringstream keyword;
-    keyword << "\\" << cur_order << "-grams:";
-    // We use "do ... while" loop since one line has already been read.
-    do {
-      // The section keywords starts with backslash. We terminate the while loop
-      // if a new section is found.
-      if (!line.empty() && line[0] == '\\') {
-        if (line.find("-grams:") != std::string::npos && keyword_found) break;
-        if (line.find("\\end\\") != std::string::npos) break;
-      }
-
-      std::vector<std::string> col;
-      SplitStringToVector(line, " \t", true, &col);
-
-      // Looks for keyword "\N-gram:" if the keyword has not been located.
-      if (!keyword_found && col.size() == 1 && col[0] == keyword.str()) {
-        KALDI_LOG << "Reading \"" << keyword.str() << "\" section.";
-        ngram_count = 0;
-        keyword_found = true;
-        continue;
-      }
-
-      // Enters "\N-grams:" section if the keyword has been located.
-      if (keyword_found && col.size() > 0) {
-        KALDI_ASSERT(col.size() >= 1 + cur_order);
-        KALDI_ASSERT(col.size() <= 2 + cur_order);// backoff_logprob could be 0.
-        if (cur_order == ngram_order_ && col.size() == 2 + cur_order) {
-          KALDI_ERR << "Backoff probability detected for final-order entry \""
-              << line << "\".";
-        }
-        ngram_count++;
-
-        // If backoff_logprob is 0, it will not appear in Arpa format language
-        // model. We put it back so the processing afterwards will be easier.
-        if (col.size() == 1 + cur_order) {
-          col.push_back("0");
-        }
-
-        // Creates LmState for the current word sequence.
-        bool is_unigram = (cur_order == 1) ? true : false;
-        float logprob;
-        float backoff_logprob;
-        KALDI_ASSERT(ConvertStringToReal(col[0], &logprob));
-        KALDI_ASSERT(ConvertStringToReal(col[1 + cur_order], &backoff_logprob));
-        if (natural_base_) {
-          logprob *= log(10);
-          backoff_logprob *= log(10);
-        }
-       
-        // If <ngram_order_> is larger than 1, then we do not create LmState for
-        // the final order entry. We only keep the log probability for it.
-        LmState *lm_state = NULL;
-        if (cur_order != ngram_order_ || ngram_order_ == 1) {
-          lm_state = new LmState(is_unigram,
-                                 (cur_order == ngram_order_ - 1),
-                                 logprob, backoff_logprob);
-        }
-
-        // Figures out the sequence of words.
-        std::vector<int32> seq(cur_order, 0);
-        for (int32 index = 0; index < cur_order; ++index) {
-          int32 word;
-          if (!ConvertStringToInteger(col[1 + index], &word)) {
-            KALDI_ERR << "bad line: " << line << "; fail to convert "
-                << col[1 + index] << " to integer.";
-          }
-          seq[index] = word;
-        }
-
-        // If <ngram_order_> is larger than 1, then we do not insert LmState to
-        // <seq_to_state_>.
-        if (cur_order != ngram_order_ || ngram_order_ == 1) {
-          KALDI_ASSERT(lm_state != NULL);
-          KALDI_ASSERT(seq_to_state_.find(seq) == seq_to_state_.end());
-          seq_to_state_[seq] = lm_state;
-        }
-
-        // If n-gram order is larger than 1, we have to add possible child to
-        // existing LmStates. We have the following two assumptions:
-        // 1. N-grams are processed from small order to larger ones, i.e., from
-        //    1, 2, ... to the highest order.
-        // 2. If a n-gram exists in the Arpa format language model, then the
-        //    "history" n-gram also exists. For example, if "A B C" is a valid
-        //    n-gram, then "A B" is also a valid n-gram.
-        if (cur_order > 1) {
-          std::vector<int32> hist(seq.begin(), seq.begin() + cur_order - 1);
-          int32 word = seq[seq.size() - 1];
-          unordered_map<std::vector<int32>,
-                        LmState*, VectorHasher<int32> >::iterator hist_iter;
-          hist_iter = seq_to_state_.find(hist);
-          KALDI_ASSERT(hist_iter != seq_to_state_.end());
-          if (cur_order != ngram_order_ || ngram_order_ == 1) {
-            KALDI_ASSERT(lm_state != NULL);
-            KALDI_ASSERT(!hist_iter->second->IsChildFinalOrder());
-            hist_iter->second->AddChild(word, lm_state);
-          } else {
-            KALDI_ASSERT(lm_state == NULL);
-            KALDI_ASSERT(hist_iter->second->IsChildFinalOrder());
-            hist_iter->second->AddChild(word, logprob);
-          }
-        } else {
-          // Figures out <max_word_id>.
-          KALDI_ASSERT(seq.size() == 1);
-          if (seq[0] > max_word_id) {
-            max_word_id = seq[0];
-          }
-        }
-      }
-    } while (getline(is, line) && !is.eof());
-    if (ngram_count > num_ngrams[cur_order] ||
-        (ngram_count == 0 && num_ngrams[cur_order] != 0)) {
-      KALDI_ERR << "Header said there would be " << num_ngrams[cur_order]
-                << " n-grams of order " << cur_order << ", but we saw "
-                << ngram_count;
+  } else {
+    // Figures out <max_word_id_>.
+    KALDI_ASSERT(seq.size() == 1);
+    if (seq[0] > max_word_id_) {
+      max_word_id_ = seq[0];
     }
   }
+}
 
-  // <num_words_> is <max_word_id> plus 1.
-  num_words_ = max_word_id + 1;
+void ConstArpaLmBuilder::ReadComplete() {
+  // <num_words_> is <max_word_id_> plus 1.
+  num_words_ = max_word_id_ + 1;
 }
 
 // ConstArpaLm can be built in the following steps, assuming we have already
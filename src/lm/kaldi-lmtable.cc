@@ -24,6 +24,7 @@
  */
 
 #include "lm/kaldi-lmtable.h"
+#include "lm/arpa-lm-compiler.h"
 #include "base/kaldi-common.h"
 #include <sstream>
 
@@ -169,148 +170,16 @@ bool LmTable::ReadFstFromLmFile(std::istream &istrm,
   KALDI_ASSERT(fst);
   KALDI_ASSERT(fst->InputSymbols() && fst->OutputSymbols());
 #endif
-
-  conv_->UseNaturalLog(useNaturalOpt);
-
-  // do not use state symbol table for word histories anymore
-  string inpline;
-  size_t pos1, pos2;
-  int ilev, maxlev = 0;
-
-  // process \data\ section
-
-  while (getline(istrm, inpline) && !istrm.eof()) {
-    std::istringstream ss(inpline);
-    std::string token;
-    ss >> token >> std::ws;
-    if (token == "\\data\\" && ss.eof()) break;
-  }
-  if (istrm.eof()) {
-    KALDI_ERR << "\\data\\ token not found in arpa file.";
-  }
-
-  while (getline(istrm, inpline) && !istrm.eof()) {
-    // break out of loop if another section is found
-    if (inpline.find("-grams:") != string::npos) break;
-    if (inpline.find("\\end\\") != string::npos) break;
-
-    // look for valid "ngram N = M" lines
-    pos1 = inpline.find("ngram");
-    pos2 = inpline.find("=");
-    if (pos1 == string::npos ||  pos2 == string::npos || pos2 <= pos1) {
-      continue;  // not valid, continue looking
-    }
-    // found valid line
-    ilev = atoi(inpline.substr(pos1+5, pos2-(pos1+5)).c_str());
-    if (ilev > maxlev) {
-      maxlev = ilev;
-    }
-  }
-  if (maxlev == 0) {
-    // reached end of loop without having found any n-gram
-    KALDI_ERR << "No ngrams found in specified file";
-  }
-
-  // process "\N-grams:" sections, we may have already read a "\N-grams:" line
-  // if so, process it, otherwise get another line
-  while (inpline.find("-grams:") != string::npos
-         || (getline(istrm, inpline) && !istrm.eof()) ) {
-    // look for a valid "\N-grams:" section
-    pos1 = inpline.find("\\");
-    pos2 = inpline.find("-grams:");
-    if (pos1 == string::npos || pos2 == string::npos || pos2 <= pos1) {
-      continue;  // not valid line, continue looking for one
-    }
-    // found, set current level
-    ilev = atoi(inpline.substr(pos1+1, pos2-(pos1+1)).c_str());
-    cerr << "Processing " << ilev <<"-grams" << endl;
-
-    // process individual n-grams
-    while (getline(istrm, inpline) && !istrm.eof()) {
-      // break out of inner loop if another section is found
-      if (!inpline.empty() && inpline[0] == '\\') {
-        if (inpline.find("-grams:") != string::npos) break;
-        if (inpline.find("\\end\\") != string::npos) break;
-      }
-      // parse ngram line: first field = prob, other fields = words,
-      // last field = backoff (optional)
-      std::vector<string> ngramString;
-      float prob, bow;
-
-      // eat up space.
-      const char *cur_cstr = inpline.c_str();
-      while (*cur_cstr && isspace(*cur_cstr))
-        cur_cstr++;
-
-      if (*cur_cstr == '\0') // Ignore empty lines.
-        continue;
-      char *next_cstr;
-      // found, parse probability from first field
-      prob = KALDI_STRTOF(cur_cstr, &next_cstr);
-      if (prob != prob || prob - prob != 0) {
-        KALDI_ERR << "nan or inf detected in LM file [parsing " << (ilev)
-            << "-grams]: " << inpline;
-      }
-      if (next_cstr == cur_cstr)
-        KALDI_ERR << "Bad line in LM file [parsing "<<(ilev)<<"-grams]: "<<inpline;
-      cur_cstr = next_cstr;
-      while (*cur_cstr && isspace(*cur_cstr))
-        cur_cstr++;
-
-      for (int i = 0; i < ilev; i++) {
-
-        if (*cur_cstr == '\0')
-          KALDI_ERR << "Bad line in LM file [parsing "<<(ilev)<<"-grams]: "<<inpline;
-
-        const char *end_cstr = strpbrk(cur_cstr, " \t");
-        std::string this_word;
-        if (end_cstr == NULL) {
-          this_word = std::string(cur_cstr);
-          cur_cstr += strlen(cur_cstr);
-        } else {
-          this_word = std::string(cur_cstr, end_cstr-cur_cstr);
-          cur_cstr = end_cstr;
-          while (*cur_cstr && isspace(*cur_cstr))
-            cur_cstr++;
-        }
-
-        // words are inserted so position 1 is most recent word,
-        // and position N oldest word (IRSTLM convention)
-        ngramString.insert(ngramString.begin(), this_word);
-      }
-      // reserve an element 0 so that words go from 1, ..., ng.size-1
-      ngramString.insert(ngramString.begin(), "");
-      bow = 0;
-      if (ilev < maxlev) {
-        // try converting anything left in the line to a backoff weight
-        if (*cur_cstr != '\0') {
-          char *end_cstr;
-          bow = KALDI_STRTOF(cur_cstr, &end_cstr);
-          if (bow != bow || bow - bow != 0) {
-            KALDI_ERR << "nan or inf detected in LM file [parsing " << (ilev)
-                << "-grams]: " << inpline;
-          }
-          if (end_cstr != cur_cstr) {  // got something.
-            while (*end_cstr != '\0' && isspace(*end_cstr))
-              end_cstr++;
-            if (*end_cstr != '\0')
-              KALDI_ERR << "Junk "<<(end_cstr)<<" at end of line [parsing "<<(ilev)<<"-grams]"<<inpline;
-          } else {
-            KALDI_ERR << "Junk "<<(cur_cstr)<<" at end of line [parsing "<<(ilev)<<"-grams]"<<inpline;
-          }
-        }
-      }
-      conv_->AddArcsForNgramProb(ilev, maxlev, prob, bow,
-                                 ngramString, fst,
-                                 startSent, endSent);
-    }  // end of loop on individual n-gram lines
-  }
-
-  conv_->ConnectUnusedStates(fst);
-
-  // not used anymore: delete pStateSymbs;
-
-  // input and output symbol tables will be deleted by ~fst()
+  // The ARPA file is compiled as it is read, with words mapped to integer ids
+  // through the FST's symbol table; see ArpaLmCompiler.
+  fst::SymbolTable *symbols = fst->MutableInputSymbols();
+  ArpaParseOptions options;
+  options.oov_handling = ArpaParseOptions::kAddToSymbols;
+  ArpaLmCompiler compiler(options,
+                          symbols->AddSymbol(startSent),
+                          symbols->AddSymbol(endSent),
+                          useNaturalOpt, fst);
+  compiler.Read(istrm, false);
   return true;
 }
 
@@ -64,6 +64,7 @@ namespace kaldi {
 
 
 /// @brief Helper methods to convert toolkit internal representations into FST.
+/// Only the IRSTLM implementation uses this; the basic one uses ArpaLmCompiler.
 class LmFstConverter {
   typedef fst::StdArc::Weight LmWeight;
   typedef fst::StdArc::StateId StateId;
@@ -134,16 +135,11 @@ class LmFstConverter {
 */
 class LmTable {
  public:
-  LmTable() { conv_ = new LmFstConverter; }
-  ~LmTable() { if (conv_) delete conv_; }
-
   bool ReadFstFromLmFile(std::istream &istrm,
                          fst::StdVectorFst *pfst,
                          bool useNaturalLog,
                          const string startSent,
                          const string endSent);
- private:
-  LmFstConverter *conv_;
 };
 
 #else
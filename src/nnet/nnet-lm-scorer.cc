@@ -0,0 +1,134 @@
+// nnet/nnet-lm-scorer.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <algorithm>
+#include <limits>
+
+#include "nnet/nnet-lm-scorer.h"
+
+namespace kaldi {
+namespace nnet1 {
+
+NnetLmScorer::NnetLmScorer(const NnetLmScorerOptions &opts,
+                           const CuMatrixBase<BaseFloat> &embedding,
+                           Nnet *nnet):
+    opts_(opts), embedding_(embedding), nnet_(nnet) {
+  opts_.Check();
+  int32 embedding_dim = embedding.NumCols();
+  if (embedding_dim == 0 || nnet->InputDim() == 0 ||
+      nnet->InputDim() % embedding_dim != 0)
+    KALDI_ERR << "Network input dimension " << nnet->InputDim()
+              << " is not a multiple of the embedding dimension "
+              << embedding_dim;
+  history_length_ = nnet->InputDim() / embedding_dim;
+  vocab_size_ = std::min(embedding.NumRows(), nnet->OutputDim());
+  if (opts_.bos_symbol >= vocab_size_ || opts_.eos_symbol >= vocab_size_ ||
+      opts_.unk_symbol >= vocab_size_)
+    KALDI_ERR << "Symbols <s>, </s> and <unk> must be less than the "
+              << "vocabulary size " << vocab_size_;
+}
+
+int32 NnetLmScorer::Start() {
+  return GetState(std::vector<int32>(history_length_, opts_.bos_symbol));
+}
+
+int32 NnetLmScorer::GetState(const std::vector<int32> &history) {
+  MapType::iterator iter = state_map_.find(history);
+  if (iter != state_map_.end()) return iter->second;
+  int32 ans = histories_.size();
+  histories_.push_back(history);
+  state_map_[history] = ans;
+  return ans;
+}
+
+int32 NnetLmScorer::MapWord(int32 word) const {
+  if (word == 0) return opts_.eos_symbol;
+  if (word > 0 && word < vocab_size_) return word;
+  if (opts_.unk_symbol < 0)
+    KALDI_ERR << "Word " << word << " is outside the vocabulary of the "
+              << "network (size " << vocab_size_ << "); use --unk-symbol";
+  return opts_.unk_symbol;
+}
+
+void NnetLmScorer::ScoreBatch(const std::vector<int32> &states,
+                              const std::vector<int32> &words,
+                              std::vector<BaseFloat> *costs,
+                              std::vector<int32> *next_states) {
+  KALDI_ASSERT(states.size() == words.size());
+  int32 num_words = words.size();
+  costs->resize(num_words);
+  next_states->resize(num_words);
+  if (num_words == 0) return;
+
+  // Each distinct history in the batch is one row of the network's input.
+  unordered_map<int32, int32> state_to_row;
+  std::vector<int32> row_states;
+  std::vector<Int32Pair> elements(num_words);
+  for (int32 i = 0; i < num_words; i++) {
+    KALDI_ASSERT(states[i] >= 0 &&
+                 states[i] < static_cast<int32>(histories_.size()));
+    unordered_map<int32, int32>::iterator iter = state_to_row.find(states[i]);
+    int32 row;
+    if (iter == state_to_row.end()) {
+      row = row_states.size();
+      state_to_row[states[i]] = row;
+      row_states.push_back(states[i]);
+    } else {
+      row = iter->second;
+    }
+    elements[i].first = row;
+    elements[i].second = MapWord(words[i]);
+  }
+
+  int32 num_rows = row_states.size(), dim = embedding_.NumCols();
+  CuMatrix<BaseFloat> input(num_rows, history_length_ * dim, kUndefined);
+  std::vector<MatrixIndexT> indices(num_rows);
+  for (int32 p = 0; p < history_length_; p++) {
+    for (int32 r = 0; r < num_rows; r++)
+      indices[r] = histories_[row_states[r]][p];
+    CuSubMatrix<BaseFloat> input_part(input.ColRange(p * dim, dim));
+    input_part.CopyRows(embedding_, indices);
+  }
+  CuMatrix<BaseFloat> output;
+  nnet_->Feedforward(input, &output);
+
+  std::vector<BaseFloat> probs;
+  output.Lookup(elements, &probs);
+
+  std::vector<int32> history(history_length_);
+  for (int32 i = 0; i < num_words; i++) {
+    (*costs)[i] = -Log(std::max(probs[i], opts_.prob_floor));
+    if (words[i] == 0) {
+      (*next_states)[i] = -1;
+    } else {
+      const std::vector<int32> &prev_history = histories_[states[i]];
+      std::copy(prev_history.begin() + 1, prev_history.end(),
+                history.begin());
+      history.back() = elements[i].second;
+      (*next_states)[i] = GetState(history);
+    }
+  }
+}
+
+void NnetLmScorer::Reset() {
+  histories_.clear();
+  state_map_.clear();
+}
+
+}  // namespace nnet1
+}  // namespace kaldi
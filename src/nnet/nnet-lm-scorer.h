@@ -0,0 +1,118 @@
+// nnet/nnet-lm-scorer.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_NNET_NNET_LM_SCORER_H_
+#define KALDI_NNET_NNET_LM_SCORER_H_
+
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "itf/options-itf.h"
+#include "itf/sentence-scorer-itf.h"
+#include "util/stl-utils.h"
+#include "cudamatrix/cu-matrix.h"
+#include "nnet/nnet-nnet.h"
+
+namespace kaldi {
+namespace nnet1 {
+
+struct NnetLmScorerOptions {
+  int32 bos_symbol;
+  int32 eos_symbol;
+  int32 unk_symbol;
+  BaseFloat prob_floor;
+
+  NnetLmScorerOptions(): bos_symbol(-1), eos_symbol(-1), unk_symbol(-1),
+                         prob_floor(1.0e-20) { }
+
+  void Register(OptionsItf *po) {
+    po->Register("bos-symbol", &bos_symbol, "Integer id of the beginning of "
+                 "sentence symbol <s>, used to pad the history at the start "
+                 "of the sentence (required).");
+    po->Register("eos-symbol", &eos_symbol, "Integer id of the end of "
+                 "sentence symbol </s>, whose output gives the probability of "
+                 "the end of the sentence (required).");
+    po->Register("unk-symbol", &unk_symbol, "If >= 0, integer id of the "
+                 "symbol that is used for words outside the network's "
+                 "vocabulary (else such words are an error).");
+    po->Register("prob-floor", &prob_floor, "Floor on the probabilities "
+                 "output by the network.");
+  }
+  void Check() const {
+    KALDI_ASSERT(bos_symbol > 0 && eos_symbol > 0 && prob_floor > 0.0);
+  }
+};
+
+/**
+   NnetLmScorer is a feed-forward neural net language model (in the style of
+   Bengio et al., 2003) that can be used for N-best rescoring through
+   SentenceScorerInterface.  For a word history, the input of the network is
+   the concatenation of the rows of "embedding" for the previous (n - 1)
+   words, oldest first, padded with bos_symbol at the start of the sentence;
+   so the order n is worked out as nnet.InputDim() / embedding.NumCols() + 1.
+   The output of the network must be a distribution over word ids (i.e. it
+   should end with a softmax), and the end of the sentence is scored as
+   eos_symbol.  Word ids must be less than both embedding.NumRows() and
+   nnet.OutputDim(), unless unk_symbol is set.
+
+   Each call to ScoreBatch() does a single forward pass with a row for each
+   distinct history in the batch, and only the requested probabilities are
+   copied back from the GPU.
+*/
+class NnetLmScorer: public SentenceScorerInterface {
+ public:
+  /// Does not take ownership of "embedding" or "nnet".
+  NnetLmScorer(const NnetLmScorerOptions &opts,
+               const CuMatrixBase<BaseFloat> &embedding,
+               Nnet *nnet);
+
+  virtual int32 Start();
+
+  virtual void ScoreBatch(const std::vector<int32> &states,
+                          const std::vector<int32> &words,
+                          std::vector<BaseFloat> *costs,
+                          std::vector<int32> *next_states);
+
+  virtual void Reset();
+
+ private:
+  // Returns the state for this history, creating it if necessary.
+  int32 GetState(const std::vector<int32> &history);
+
+  // Maps a word to the id we use for it (dealing with end of sentence and
+  // out-of-vocabulary words).
+  int32 MapWord(int32 word) const;
+
+  NnetLmScorerOptions opts_;
+  const CuMatrixBase<BaseFloat> &embedding_;
+  Nnet *nnet_;
+  int32 history_length_;  // n - 1.
+  int32 vocab_size_;
+
+  std::vector<std::vector<int32> > histories_;  // indexed by state.
+  typedef unordered_map<std::vector<int32>, int32,
+                        VectorHasher<int32> > MapType;
+  MapType state_map_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(NnetLmScorer);
+};
+
+}  // namespace nnet1
+}  // namespace kaldi
+
+#endif  // KALDI_NNET_NNET_LM_SCORER_H_
@@ -33,6 +33,10 @@ namespace nnet2 {
 
 /// DecodableAmNnet is a decodable object that decodes
 /// with a neural net acoustic model of type AmNnet.
+/// If frame_subsampling_factor > 1, the network is only evaluated on every
+/// frame_subsampling_factor'th frame, and frame i of this object corresponds to
+/// frame i * frame_subsampling_factor of the input; you would normally wrap it
+/// in class DecodableSubsampled (decoder/decodable-subsampled.h) to decode.
 
 class DecodableAmNnet: public DecodableInterface {
  public:
@@ -41,7 +45,8 @@ class DecodableAmNnet: public DecodableInterface {
                   const CuMatrixBase<BaseFloat> &feats,
                   bool pad_input = true, // if !pad_input, the NumIndices()
                                          // will be < feats.NumRows().
-                  BaseFloat prob_scale = 1.0):
+                  BaseFloat prob_scale = 1.0,
+                  int32 frame_subsampling_factor = 1):
       trans_model_(trans_model) {
     // Note: we could make this more memory-efficient by doing the
     // computation in smaller chunks than the whole utterance, and not
@@ -54,9 +59,12 @@ class DecodableAmNnet: public DecodableInterface {
                  << "empty output.";
       return;
     }
-    CuMatrix<BaseFloat> log_probs(num_rows, trans_model.NumPdfs());
+    CuMatrix<BaseFloat> log_probs(
+        NumSubsampledFrames(num_rows, frame_subsampling_factor),
+        trans_model.NumPdfs());
     // the following function is declared in nnet-compute.h
-    NnetComputation(am_nnet.GetNnet(), feats, pad_input, &log_probs);
+    NnetComputationSubsampled(am_nnet.GetNnet(), feats, pad_input,
+                              frame_subsampling_factor, &log_probs);
     log_probs.ApplyFloor(1.0e-20); // Avoid log of zero which leads to NaN.
     log_probs.ApplyLog();
     CuVector<BaseFloat> priors(am_nnet.Priors());
@@ -101,6 +109,7 @@ class DecodableAmNnet: public DecodableInterface {
 /// that processes different utterances with multiple threads.  It needs to do
 /// the computation in a different place than the initializer, since the
 /// initializer gets called in the main thread of the program.
+/// frame_subsampling_factor has the same meaning as for DecodableAmNnet.
 
 class DecodableAmNnetParallel: public DecodableInterface {
  public:
@@ -109,17 +118,19 @@ class DecodableAmNnetParallel: public DecodableInterface {
       const AmNnet &am_nnet,
       const CuMatrix<BaseFloat> *feats,
       bool pad_input = true,
-      BaseFloat prob_scale = 1.0):
+      BaseFloat prob_scale = 1.0,
+      int32 frame_subsampling_factor = 1):
       trans_model_(trans_model), am_nnet_(am_nnet), feats_(feats),
-      pad_input_(pad_input), prob_scale_(prob_scale) {
-    KALDI_ASSERT(feats_ != NULL);
+      pad_input_(pad_input), prob_scale_(prob_scale),
+      frame_subsampling_factor_(frame_subsampling_factor) {
+    KALDI_ASSERT(feats_ != NULL && frame_subsampling_factor_ > 0);
   }
 
   void Compute() {
-    log_probs_.Resize(feats_->NumRows(), trans_model_.NumPdfs());
+    log_probs_.Resize(NumFramesReady(), trans_model_.NumPdfs());
     // the following function is declared in nnet-compute.h
-    NnetComputation(am_nnet_.GetNnet(), *feats_,
-                    pad_input_, &log_probs_);
+    NnetComputationSubsampled(am_nnet_.GetNnet(), *feats_, pad_input_,
+                              frame_subsampling_factor_, &log_probs_);
     log_probs_.ApplyFloor(1.0e-20); // Avoid log of zero which leads to NaN.
     log_probs_.ApplyLog();
     CuVector<BaseFloat> priors(am_nnet_.Priors());
@@ -144,13 +155,13 @@ class DecodableAmNnetParallel: public DecodableInterface {
 
   int32 NumFramesReady() const {
     if (feats_) {
-      if (pad_input_) return feats_->NumRows();
-      else {
-        int32 ans = feats_->NumRows() - am_nnet_.GetNnet().LeftContext() -
+      int32 ans = feats_->NumRows();
+      if (!pad_input_) {
+        ans -= am_nnet_.GetNnet().LeftContext() +
             am_nnet_.GetNnet().RightContext();
         if (ans < 0) ans = 0;
-        return ans;
       }
+      return NumSubsampledFrames(ans, frame_subsampling_factor_);
     } else {
       return log_probs_.NumRows();
     }
@@ -174,6 +185,7 @@ class DecodableAmNnetParallel: public DecodableInterface {
   const CuMatrix<BaseFloat> *feats_;
   bool pad_input_;
   BaseFloat prob_scale_;
+  int32 frame_subsampling_factor_;
   KALDI_DISALLOW_COPY_AND_ASSIGN(DecodableAmNnetParallel);
 };
 
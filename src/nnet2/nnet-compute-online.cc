@@ -20,6 +20,7 @@
 // limitations under the License.
 
 #include "nnet2/nnet-compute-online.h"
+#include "base/kaldi-profile.h"
 #include <vector>
 
 namespace kaldi {
@@ -34,6 +35,7 @@ NnetOnlineComputer::NnetOnlineComputer(const Nnet &nnet, bool pad_input)
 
 void NnetOnlineComputer::Compute(const CuMatrixBase<BaseFloat> &input,
                                  CuMatrix<BaseFloat> *output) {
+  KALDI_PROFILE_SCOPE("NnetOnlineComputer::Compute");
   KALDI_ASSERT(output != NULL);
   KALDI_ASSERT(!finished_);
   int32 dim = input.NumCols();
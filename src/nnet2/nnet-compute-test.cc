@@ -80,6 +80,39 @@ void UnitTestNnetCompute() {
   delete nnet;
 }
 
+void UnitTestNnetComputeSubsampled() {
+  int32 input_dim = 10 + rand() % 40, output_dim = 100 + rand() % 500,
+      frame_subsampling_factor = 1 + rand() % 4;
+  bool pad_input = (rand() % 2 == 0);
+
+  Nnet *nnet = GenRandomNnet(input_dim, output_dim);
+  int32 num_feats = 5 + rand() % 1000;
+  CuMatrix<BaseFloat> input(num_feats, input_dim);
+  input.SetRandn();
+
+  int32 num_output_rows = num_feats -
+      (pad_input ? 0 : nnet->LeftContext() + nnet->RightContext());
+  if (num_output_rows <= 0) {
+    delete nnet;
+    return;
+  }
+  CuMatrix<BaseFloat> output1(num_output_rows, output_dim);
+  NnetComputation(*nnet, input, pad_input, &output1);
+
+  CuMatrix<BaseFloat> output2(
+      NumSubsampledFrames(num_output_rows, frame_subsampling_factor),
+      output_dim);
+  NnetComputationSubsampled(*nnet, input, pad_input, frame_subsampling_factor,
+                            &output2);
+  for (int32 i = 0; i < output2.NumRows(); i++) {
+    CuSubVector<BaseFloat> vec1(output1, i * frame_subsampling_factor),
+        vec2(output2, i);
+    AssertEqual(vec1, vec2);
+  }
+  KALDI_LOG << "OK";
+  delete nnet;
+}
+
 }  // namespace nnet2
 }  // namespace kaldi
 
@@ -92,6 +125,8 @@ int main() {
 
   for (int32 i = 0; i < 10; i++) 
     UnitTestNnetCompute();
+  for (int32 i = 0; i < 10; i++) 
+    UnitTestNnetComputeSubsampled();
   return 0;
 }
   
@@ -18,6 +18,7 @@
 // limitations under the License.
 
 #include "nnet2/nnet-compute.h"
+#include "base/kaldi-profile.h"
 #include "hmm/posterior.h"
 
 namespace kaldi {
@@ -160,11 +161,71 @@ void NnetComputation(const Nnet &nnet,
                      const CuMatrixBase<BaseFloat> &input,  // features
                      bool pad_input,
                      CuMatrixBase<BaseFloat> *output) {
+  KALDI_PROFILE_SCOPE("NnetComputation");
   NnetComputer nnet_computer(nnet, input, pad_input, NULL);
   nnet_computer.Propagate();
   output->CopyFromMat(nnet_computer.GetOutput());
 }
 
+void NnetComputationSubsampled(const Nnet &nnet,
+                               const CuMatrixBase<BaseFloat> &input,
+                               bool pad_input,
+                               int32 frame_subsampling_factor,
+                               CuMatrixBase<BaseFloat> *output) {
+  KALDI_ASSERT(frame_subsampling_factor > 0);
+  if (frame_subsampling_factor == 1) {
+    NnetComputation(nnet, input, pad_input, output);
+    return;
+  }
+  if (input.NumCols() != nnet.InputDim()) {
+    KALDI_ERR << "Feature dimension is " << input.NumCols()
+              << " but network expects " << nnet.InputDim();
+  }
+  int32 left_context = nnet.LeftContext(),
+      right_context = nnet.RightContext(),
+      num_splice = 1 + left_context + right_context,
+      num_frames_out = input.NumRows() -
+          (pad_input ? 0 : left_context + right_context),
+      num_rows_out = NumSubsampledFrames(num_frames_out,
+                                         frame_subsampling_factor);
+  KALDI_ASSERT(num_frames_out > 0 &&
+               output->NumRows() == num_rows_out &&
+               output->NumCols() == nnet.OutputDim());
+
+  KALDI_PROFILE_SCOPE("NnetComputationSubsampled");
+  // We process at most this many chunks (output frames) at a time, to bound
+  // the memory used for the spliced input.
+  const int32 max_chunks = 512;
+  for (int32 start = 0; start < num_rows_out; start += max_chunks) {
+    int32 num_chunks = std::min(max_chunks, num_rows_out - start);
+    std::vector<MatrixIndexT> indexes(num_chunks * num_splice);
+    for (int32 c = 0; c < num_chunks; c++) {
+      int32 t = (start + c) * frame_subsampling_factor;
+      for (int32 s = 0; s < num_splice; s++) {
+        // With padding, output frame t is centered on input frame t; the
+        // first and last frames are duplicated as in class NnetComputer.
+        int32 r = t + s - (pad_input ? left_context : 0);
+        if (r < 0) r = 0;
+        if (r >= input.NumRows()) r = input.NumRows() - 1;
+        indexes[c * num_splice + s] = r;
+      }
+    }
+    std::vector<ChunkInfo> chunk_info;
+    nnet.ComputeChunkInfo(num_splice, num_chunks, &chunk_info);
+
+    CuMatrix<BaseFloat> cur_data(num_chunks * num_splice, input.NumCols(),
+                                 kUndefined), next_data;
+    cur_data.CopyRows(input, indexes);
+    for (int32 c = 0; c < nnet.NumComponents(); c++) {
+      nnet.GetComponent(c).Propagate(chunk_info[c], chunk_info[c+1],
+                                     cur_data, &next_data);
+      cur_data.Swap(&next_data);
+    }
+    KALDI_ASSERT(cur_data.NumRows() == num_chunks);
+    output->RowRange(start, num_chunks).CopyFromMat(cur_data);
+  }
+}
+
 BaseFloat NnetGradientComputation(const Nnet &nnet,
                                   const CuMatrixBase<BaseFloat> &input,
                                   bool pad_input,
@@ -46,6 +46,32 @@ void NnetComputation(const Nnet &nnet,
                      bool pad_input,
                      CuMatrixBase<BaseFloat> *output); // posteriors.
 
+/**
+  This is like NnetComputation(), but it only evaluates the network on every
+  frame_subsampling_factor'th output frame (frames 0, n, 2n, ...), so output
+  should have (num-output-frames + n - 1) / n rows, where num-output-frames is
+  input.NumRows() if pad_input == true, and input.NumRows() - nnet.LeftContext()
+  - nnet.RightContext() otherwise.  Each selected frame is computed as a
+  separate chunk with its own context, in the same way as training examples
+  are, so for networks whose splicing is all done near the input, the cost of
+  the remaining layers is reduced by about a factor of n.  See class
+  DecodableSubsampled in decoder/decodable-subsampled.h for how to decode with
+  the output.
+*/
+void NnetComputationSubsampled(const Nnet &nnet,
+                               const CuMatrixBase<BaseFloat> &input,
+                               bool pad_input,
+                               int32 frame_subsampling_factor,
+                               CuMatrixBase<BaseFloat> *output);
+
+/// Returns the number of output rows that NnetComputationSubsampled() will
+/// produce for a given number of (non-subsampled) output frames.
+inline int32 NumSubsampledFrames(int32 num_frames,
+                                 int32 frame_subsampling_factor) {
+  KALDI_ASSERT(frame_subsampling_factor > 0);
+  return (num_frames + frame_subsampling_factor - 1) / frame_subsampling_factor;
+}
+
 /** Does the neural net computation and backprop, given input and labels.
     Note: if pad_input==true the number of rows of input should be the
     same as the number of labels, and if false, you should omit
@@ -67,6 +67,9 @@ void UnitTestNnetDecodable() {
   opts.acoustic_scale = 0.1;
 
   opts.pad_input = (rand() % 2 == 0);
+  opts.subsample_config.frame_subsampling_factor = 1 + rand() % 3;
+  opts.subsample_config.interpolate = (rand() % 2 == 0);
+  int32 factor = opts.subsample_config.frame_subsampling_factor;
 
   int32 num_input_frames = 400;
   Matrix<BaseFloat> input_feats(num_input_frames, input_dim);
@@ -80,20 +83,39 @@ void UnitTestNnetDecodable() {
   DecodableAmNnet offline_decodable(trans_model, am_nnet,
                                     CuMatrix<BaseFloat>(input_feats),
                                     opts.pad_input,
-                                    opts.acoustic_scale);
+                                    opts.acoustic_scale,
+                                    factor);
 
-  KALDI_ASSERT(online_decodable.NumFramesReady() ==
+  KALDI_ASSERT(NumSubsampledFrames(online_decodable.NumFramesReady(),
+                                   factor) ==
                offline_decodable.NumFramesReady());
   int32 num_frames = online_decodable.NumFramesReady(),
       num_tids = trans_model.NumTransitionIds();
+  // This is what the offline decoders see.
+  DecodableSubsampled subsampled_decodable(&offline_decodable,
+                                           opts.subsample_config, num_frames);
+  KALDI_ASSERT(subsampled_decodable.NumFramesReady() == num_frames);
   
   for (int32 i = 0; i < 50; i++) {
 
     int32 t = rand() % num_frames, tid = 1 + rand() % num_tids;
     BaseFloat l1 = online_decodable.LogLikelihood(t, tid),
-        l2 = offline_decodable.LogLikelihood(t, tid);
+        l2 = subsampled_decodable.LogLikelihood(t, tid);
     KALDI_ASSERT(ApproxEqual(l1, l2));
   }
+
+  // Access the frames in order, as a decoder would, and check that the
+  // log-likelihoods we don't need any more get released.
+  DecodableNnet2Online online_decodable2(am_nnet, trans_model,
+                                         opts, &matrix_feature);
+  for (int32 t = 0; t < num_frames; t++) {
+    int32 tid = 1 + rand() % num_tids;
+    BaseFloat l1 = online_decodable2.LogLikelihood(t, tid),
+        l2 = subsampled_decodable.LogLikelihood(t, tid);
+    KALDI_ASSERT(ApproxEqual(l1, l2));
+  }
+  KALDI_ASSERT(online_decodable2.MaxRowsStored() <=
+               opts.max_nnet_batch_size + 1);
 }
 
 } // namespace nnet2
@@ -35,8 +35,17 @@ DecodableNnet2Online::DecodableNnet2Online(
     left_context_(nnet.GetNnet().LeftContext()),
     right_context_(nnet.GetNnet().RightContext()),
     num_pdfs_(nnet.GetNnet().OutputDim()),
-    begin_frame_(-1) {
+    factor_(opts.subsample_config.frame_subsampling_factor),
+    computer_(nnet.GetNnet(), opts.pad_input),
+    num_frames_input_(0),
+    flushed_(false),
+    begin_row_(0),
+    end_row_(0),
+    min_row_needed_(0),
+    max_rows_stored_(0),
+    recomputed_begin_row_(0) {
   KALDI_ASSERT(opts_.max_nnet_batch_size > 0);
+  opts_.subsample_config.Check();
   log_priors_ = nnet_.Priors();
   KALDI_ASSERT(log_priors_.Dim() == trans_model_.NumPdfs() &&
                "Priors in neural network not set up (or mismatch "
@@ -48,10 +57,28 @@ DecodableNnet2Online::DecodableNnet2Online(
 
 BaseFloat DecodableNnet2Online::LogLikelihood(int32 frame, int32 index) {
   ComputeForFrame(frame);
-  int32 pdf_id = trans_model_.TransitionIdToPdf(index);
-  KALDI_ASSERT(frame >= begin_frame_ &&
-               frame < begin_frame_ + scaled_loglikes_.NumRows());
-  return scaled_loglikes_(frame - begin_frame_, pdf_id);
+  int32 pdf_id = trans_model_.TransitionIdToPdf(index),
+      row = frame / factor_, r = frame % factor_;
+  if (row >= begin_row_)
+    min_row_needed_ = row;
+  BaseFloat ans = StoredLogLikelihood(row, pdf_id);
+  // As in DecodableSubsampled, the last evaluated frame's score is repeated
+  // for the frames after it.
+  int32 next_frame = (row + 1) * factor_;
+  if (!opts_.subsample_config.interpolate || r == 0 ||
+      next_frame >= NumFramesReady())
+    return ans;
+  ComputeForFrame(next_frame);
+  BaseFloat next = StoredLogLikelihood(row + 1, pdf_id);
+  return ans + (next - ans) * r / static_cast<BaseFloat>(factor_);
+}
+
+BaseFloat DecodableNnet2Online::StoredLogLikelihood(int32 row,
+                                                    int32 pdf_id) const {
+  if (row >= begin_row_)
+    return scaled_loglikes_(row % scaled_loglikes_.NumRows(), pdf_id);
+  else
+    return recomputed_loglikes_(row - recomputed_begin_row_, pdf_id);
 }
 
 
@@ -68,38 +95,106 @@ int32 DecodableNnet2Online::NumFramesReady() const {
   if (features_ready == 0)
     return 0;
   bool input_finished = features_->IsLastFrame(features_ready - 1);
+  int32 ans;
   if (opts_.pad_input) {
     // normal case... we'll pad with duplicates of first + last frame to get the
     // required left and right context.
-    if (input_finished) return features_ready;
-    else return std::max<int32>(0, features_ready - right_context_);
+    if (input_finished) ans = features_ready;
+    else ans = std::max<int32>(0, features_ready - right_context_);
   } else {
-    return std::max<int32>(0, features_ready - right_context_ - left_context_);
+    ans = std::max<int32>(0, features_ready - right_context_ - left_context_);
   }
+  if (opts_.subsample_config.interpolate && !input_finished && ans > 0) {
+    // Interpolated frames need the following evaluated frame, so until the
+    // input has finished we stop at the last evaluated frame.
+    ans = (ans - 1) / factor_ * factor_ + 1;
+  }
+  return ans;
 }
 
 void DecodableNnet2Online::ComputeForFrame(int32 frame) {
-  int32 features_ready = features_->NumFramesReady();
-  bool input_finished = features_->IsLastFrame(features_ready - 1);  
+  int32 factor = factor_, row = frame / factor;
   KALDI_ASSERT(frame >= 0);
-  if (frame >= begin_frame_ &&
-      frame < begin_frame_ + scaled_loglikes_.NumRows())
+  if (row >= begin_row_ && row < end_row_)
     return;
-  KALDI_ASSERT(frame < NumFramesReady());
+  if (row < begin_row_) {
+    // The decoder has gone back to a frame we already released.
+    if (row >= recomputed_begin_row_ &&
+        row < recomputed_begin_row_ + recomputed_loglikes_.NumRows())
+      return;
+    int32 num_rows = std::min<int32>(begin_row_ - row,
+                                     opts_.max_nnet_batch_size);
+    KALDI_VLOG(3) << "Recomputing " << num_rows << " rows of log-likelihoods "
+                  << "starting from frame " << (row * factor);
+    ComputeFromWindow(row, num_rows, &recomputed_loglikes_);
+    recomputed_begin_row_ = row;
+    return;
+  }
+  int32 frames_ready = NumFramesReady();
+  KALDI_ASSERT(frame < frames_ready);
+
+  if (factor == 1) {
+    int32 features_ready = features_->NumFramesReady();
+    bool input_finished = features_->IsLastFrame(features_ready - 1);
+    while (end_row_ <= row) {
+      CuMatrix<BaseFloat> cu_posteriors;
+      if (num_frames_input_ < features_ready) {
+        int32 num_frames = std::min<int32>(features_ready - num_frames_input_,
+                                           opts_.max_nnet_batch_size);
+        Matrix<BaseFloat> features(num_frames, feat_dim_);
+        for (int32 t = 0; t < num_frames; t++) {
+          SubVector<BaseFloat> feat_row(features, t);
+          features_->GetFrame(num_frames_input_ + t, &feat_row);
+        }
+        CuMatrix<BaseFloat> cu_features;
+        cu_features.Swap(&features);  // Copy to GPU, if we're using one.
+        computer_.Compute(cu_features, &cu_posteriors);
+        num_frames_input_ += num_frames;
+      } else {
+        // NumFramesReady() would not have allowed this frame unless the input
+        // was finished.
+        KALDI_ASSERT(input_finished && !flushed_);
+        computer_.Flush(&cu_posteriors);
+        flushed_ = true;
+      }
+      if (cu_posteriors.NumRows() != 0) {
+        Matrix<BaseFloat> loglikes;
+        ComputeScaledLoglikes(&cu_posteriors, &loglikes);
+        AppendRows(loglikes);
+      }
+    }
+  } else {
+    // With frame subsampling we compute every factor'th frame from its own
+    // window of features.
+    int32 rows_ready = NumSubsampledFrames(frames_ready, factor),
+        num_rows = std::min<int32>(rows_ready - end_row_,
+                                   opts_.max_nnet_batch_size);
+    Matrix<BaseFloat> loglikes;
+    ComputeFromWindow(end_row_, num_rows, &loglikes);
+    AppendRows(loglikes);
+  }
+  KALDI_ASSERT(row < end_row_);
+}
+
+void DecodableNnet2Online::ComputeFromWindow(int32 begin_row, int32 num_rows,
+                                             Matrix<BaseFloat> *loglikes) {
+  int32 factor = factor_,
+      features_ready = features_->NumFramesReady();
+  bool input_finished = features_->IsLastFrame(features_ready - 1);
+  KALDI_ASSERT(num_rows > 0);
+  int32 begin_frame = begin_row * factor,
+      last_frame = (begin_row + num_rows - 1) * factor;
+  KALDI_ASSERT(last_frame < NumFramesReady());
 
-  int32 input_frame_begin;
+  int32 input_frame_begin, input_frame_end;
   if (opts_.pad_input)
-    input_frame_begin = frame - left_context_;
+    input_frame_begin = begin_frame - left_context_;
   else
-    input_frame_begin = frame;
-  int32 max_possible_input_frame_end = features_ready;
-  if (input_finished && opts_.pad_input)
-    max_possible_input_frame_end += right_context_;
-  int32 input_frame_end = std::min<int32>(max_possible_input_frame_end,
-                                          input_frame_begin +
-                                          left_context_ + right_context_ +
-                                          opts_.max_nnet_batch_size);
-  KALDI_ASSERT(input_frame_end > input_frame_begin);
+    input_frame_begin = begin_frame;
+  input_frame_end = input_frame_begin + left_context_ + right_context_ +
+      last_frame - begin_frame + 1;
+  KALDI_ASSERT(input_frame_end <= features_ready ||
+               (input_finished && opts_.pad_input));
   Matrix<BaseFloat> features(input_frame_end - input_frame_begin,
                              feat_dim_);
   for (int32 t = input_frame_begin; t < input_frame_end; t++) {
@@ -114,31 +209,52 @@ void DecodableNnet2Online::ComputeForFrame(int32 frame) {
   }
   CuMatrix<BaseFloat> cu_features; 
   cu_features.Swap(&features);  // Copy to GPU, if we're using one.
-  
 
-  int32 num_frames_out = input_frame_end - input_frame_begin -
-      left_context_ - right_context_;
-  
-  CuMatrix<BaseFloat> cu_posteriors(num_frames_out, num_pdfs_);
+  CuMatrix<BaseFloat> cu_posteriors(num_rows, num_pdfs_);
   
   // The "false" below tells it not to pad the input: we've already done
   // any padding that we needed to do.
-  NnetComputation(nnet_.GetNnet(), cu_features,
-                  false, &cu_posteriors);
-  
-  cu_posteriors.ApplyFloor(1.0e-20); // Avoid log of zero which leads to NaN.
-  cu_posteriors.ApplyLog();
+  NnetComputationSubsampled(nnet_.GetNnet(), cu_features,
+                            false, factor, &cu_posteriors);
+  ComputeScaledLoglikes(&cu_posteriors, loglikes);
+}
+
+void DecodableNnet2Online::ComputeScaledLoglikes(
+    CuMatrix<BaseFloat> *posteriors,
+    Matrix<BaseFloat> *loglikes) const {
+  posteriors->ApplyFloor(1.0e-20); // Avoid log of zero which leads to NaN.
+  posteriors->ApplyLog();
   // subtract log-prior (divide by prior)
-  cu_posteriors.AddVecToRows(-1.0, log_priors_);
+  posteriors->AddVecToRows(-1.0, log_priors_);
   // apply probability scale.
-  cu_posteriors.Scale(opts_.acoustic_scale);
+  posteriors->Scale(opts_.acoustic_scale);
 
   // Transfer the scores the CPU for faster access by the
   // decoding process.
-  scaled_loglikes_.Resize(0, 0);
-  cu_posteriors.Swap(&scaled_loglikes_);
+  loglikes->Resize(0, 0);
+  posteriors->Swap(loglikes);
+}
 
-  begin_frame_ = frame;
+void DecodableNnet2Online::AppendRows(const MatrixBase<BaseFloat> &loglikes) {
+  int32 num_new_rows = loglikes.NumRows();
+  // Release the rows that the decoder has finished with.
+  begin_row_ = std::max(begin_row_, std::min(min_row_needed_, end_row_));
+  int32 num_rows_kept = end_row_ - begin_row_,
+      capacity = scaled_loglikes_.NumRows();
+  if (num_rows_kept + num_new_rows > capacity) {
+    int32 new_capacity = std::max(2 * capacity, num_rows_kept + num_new_rows);
+    Matrix<BaseFloat> new_loglikes(new_capacity, num_pdfs_, kUndefined);
+    for (int32 i = begin_row_; i < end_row_; i++)
+      new_loglikes.Row(i % new_capacity).CopyFromVec(
+          scaled_loglikes_.Row(i % capacity));
+    scaled_loglikes_.Swap(&new_loglikes);
+    capacity = new_capacity;
+  }
+  for (int32 r = 0; r < num_new_rows; r++)
+    scaled_loglikes_.Row((end_row_ + r) % capacity).CopyFromVec(
+        loglikes.Row(r));
+  end_row_ += num_new_rows;
+  max_rows_stored_ = std::max(max_rows_stored_, end_row_ - begin_row_);
 }
 
 } // namespace nnet2
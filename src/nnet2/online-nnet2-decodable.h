@@ -25,19 +25,20 @@
 #include "itf/decodable-itf.h"
 #include "nnet2/am-nnet.h"
 #include "nnet2/nnet-compute.h"
+#include "nnet2/nnet-compute-online.h"
 #include "hmm/transition-model.h"
+#include "decoder/decodable-subsampled.h"
 
 namespace kaldi {
 namespace nnet2 {
 
-// Note: see also nnet-compute-online.h, which provides a different
-// (lower-level) interface and more efficient for progressive evaluation of an
-// nnet throughout an utterance, with re-use of already-computed activations.
-
 struct DecodableNnet2OnlineOptions {
   BaseFloat acoustic_scale;
   bool pad_input;
   int32 max_nnet_batch_size;
+  // --frame-subsampling-factor and --subsampling-interpolate; these mean the
+  // same as for DecodableSubsampled, which the offline decoders use.
+  DecodableSubsampledConfig subsample_config;
   
   DecodableNnet2OnlineOptions():
       acoustic_scale(0.1),
@@ -54,7 +55,7 @@ struct DecodableNnet2OnlineOptions {
                  "Maximum batch size we use in neural-network decodable object, "
                  "in cases where we are not constrained by currently available "
                  "frames (this will rarely make a difference)");
-                 
+    subsample_config.Register(po);
   }
 };
 
@@ -63,6 +64,21 @@ struct DecodableNnet2OnlineOptions {
    This Decodable object for class nnet2::AmNnet takes feature input from class
    OnlineFeatureInterface, unlike, say, class DecodableAmNnet which takes
    feature input from a matrix.
+
+   The log-likelihoods are computed in chunks of up to
+   opts.max_nnet_batch_size frames as the decoder asks for them, using class
+   NnetOnlineComputer so that the context frames at chunk boundaries are not
+   recomputed, and they are stored in a ring buffer.  Frames before the most
+   recent frame the decoder has asked for are released when we need room, so
+   the buffer only grows to about the amount by which the computation runs ahead
+   of the decoder.  If a frame that has already been released is asked for
+   again, it is recomputed (this is not expected to happen with the standard
+   decoders, which access frames in order).
+
+   With frame subsampling, the scores of the frames in between evaluated frames
+   are worked out as in class DecodableSubsampled; if they are interpolated,
+   NumFramesReady() holds back the frames before the last evaluated frame
+   until the next one is available, or the input has ended.
 */
 
 class DecodableNnet2Online: public DecodableInterface {
@@ -82,12 +98,37 @@ class DecodableNnet2Online: public DecodableInterface {
   
   /// Indices are one-based!  This is for compatibility with OpenFst.
   virtual int32 NumIndices() const { return trans_model_.NumTransitionIds(); }
+
+  /// Returns the largest number of rows of log-likelihoods we have stored at
+  /// any one time (the high-water mark of the ring buffer); multiply by
+  /// NumPdfs() * sizeof(BaseFloat) to get it in bytes.  Each row covers
+  /// opts.subsample_config.frame_subsampling_factor frames.
+  int32 MaxRowsStored() const { return max_rows_stored_; }
   
  private:
 
   /// If the neural-network outputs for this frame are not cached, it computes
   /// them (and possibly for some succeeding frames)
   void ComputeForFrame(int32 frame);
+
+  /// Returns the scaled log-likelihood of this pdf for row "row" of the output,
+  /// which must have been computed by ComputeForFrame().
+  BaseFloat StoredLogLikelihood(int32 row, int32 pdf_id) const;
+
+  /// Computes num_rows rows of output starting at row begin_row (row i is for
+  /// frame i * factor_) from a window of the features, without using
+  /// computer_.  Puts the scaled log-likelihoods in "loglikes".
+  void ComputeFromWindow(int32 begin_row, int32 num_rows,
+                         Matrix<BaseFloat> *loglikes);
+
+  /// Turns the nnet output into scaled log-likelihoods, transferring them to
+  /// system memory.
+  void ComputeScaledLoglikes(CuMatrix<BaseFloat> *posteriors,
+                             Matrix<BaseFloat> *loglikes) const;
+
+  /// Appends rows to the ring buffer, growing it if there is not enough room
+  /// once the rows we no longer need are released.
+  void AppendRows(const MatrixBase<BaseFloat> &loglikes);
   
   OnlineFeatureInterface *features_;
   const AmNnet &nnet_;
@@ -99,19 +140,33 @@ class DecodableNnet2Online: public DecodableInterface {
   int32 right_context_;  // Right context of the network (cached here)
   int32 num_pdfs_;  // Number of pdfs, equals output-dim of the network (cached
                     // here)
+  int32 factor_;  // opts_.subsample_config.frame_subsampling_factor (cached
+                  // here)
+
+  // This does the computation if factor_ == 1.  (With frame subsampling we
+  // compute separate windows of frames instead, as computing consecutive frames
+  // would defeat the purpose).
+  NnetOnlineComputer computer_;
+  int32 num_frames_input_;  // Number of feature frames given to computer_.
+  bool flushed_;  // True if we've called computer_.Flush().
   
-  int32 begin_frame_;  // First frame for which scaled_loglikes_ is valid
-                       // (i.e. the first frame of the batch of frames for
-                       // which we've computed the output).
-  
-  // scaled_loglikes_ contains the neural network pseudo-likelihoods: the log of
-  // (prob divided by the prior), scaled by opts.acoustic_scale).  We may
-  // compute this using the GPU, but we transfer it back to the system memory
-  // when we store it here.  These scores are only kept for a subset of frames,
-  // starting at begin_frame_, whose length depends how many frames were ready
-  // at the time we called LogLikelihood(), and will never exceed
-  // opts_.max_nnet_batch_size.
+  // scaled_loglikes_ is a ring buffer containing the neural network
+  // pseudo-likelihoods: the log of (prob divided by the prior), scaled by
+  // opts.acoustic_scale.  We may compute this using the GPU, but we transfer it
+  // back to the system memory when we store it here.  Row i of the output
+  // (which is for frame i * factor_) is stored at row
+  // i % scaled_loglikes_.NumRows(), for begin_row_ <= i < end_row_.
   Matrix<BaseFloat> scaled_loglikes_;
+  int32 begin_row_;  // First row still stored in scaled_loglikes_.
+  int32 end_row_;  // One past the last row we've computed.
+  int32 min_row_needed_;  // Rows before this (the row of the most recent frame
+                          // asked for) may be released.
+  int32 max_rows_stored_;  // High-water mark of end_row_ - begin_row_.
+
+  // Rows recomputed because they were asked for after being released; the
+  // first one is recomputed_begin_row_.
+  Matrix<BaseFloat> recomputed_loglikes_;
+  int32 recomputed_begin_row_;
 
   KALDI_DISALLOW_COPY_AND_ASSIGN(DecodableNnet2Online);
 };
@@ -25,6 +25,7 @@
 #include "hmm/transition-model.h"
 #include "fstext/fstext-lib.h"
 #include "decoder/decoder-wrappers.h"
+#include "decoder/decodable-subsampled.h"
 #include "nnet2/decodable-am-nnet.h"
 #include "base/timer.h"
 #include "thread/kaldi-task-sequence.h"
@@ -48,11 +49,15 @@ int main(int argc, char *argv[]) {
     bool allow_partial = false;
     BaseFloat acoustic_scale = 0.1;
     LatticeFasterDecoderConfig config;
+    EpsilonClosureConfig epsilon_closure_config;
     TaskSequencerConfig sequencer_config; // has --num-threads option
+    DecodableSubsampledConfig subsample_config;
     
     std::string word_syms_filename;
     sequencer_config.Register(&po);
     config.Register(&po);
+    epsilon_closure_config.Register(&po);
+    subsample_config.Register(&po);
     po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
     po.Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
     po.Register("allow-partial", &allow_partial, "If true, produce output even if end state was not reached.");
@@ -107,10 +112,13 @@ int main(int argc, char *argv[]) {
     kaldi::int64 frame_count = 0;
     int num_done = 0, num_err = 0;
     VectorFst<StdArc> *decode_fst = NULL;
+    EpsilonClosureTable *epsilon_closure_table = NULL;
     if (ClassifyRspecifier(fst_in_str, NULL, NULL) == kNoRspecifier) {
       SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
 
       decode_fst = fst::ReadFstKaldi(fst_in_str);
+      epsilon_closure_table =
+          NewEpsilonClosureTable(*decode_fst, epsilon_closure_config);
 
       {
     
@@ -123,13 +131,19 @@ int main(int argc, char *argv[]) {
             continue;
           }
           bool pad_input = true;
-          DecodableAmNnetParallel *nnet_decodable = new DecodableAmNnetParallel(
+          DecodableInterface *nnet_decodable = new DecodableAmNnetParallel(
               trans_model, am_nnet,
               new CuMatrix<BaseFloat>(features),
-              pad_input, acoustic_scale);
+              pad_input, acoustic_scale,
+              subsample_config.frame_subsampling_factor);
+          if (subsample_config.frame_subsampling_factor != 1)
+            nnet_decodable = new DecodableSubsampled(
+                nnet_decodable, subsample_config, features.NumRows(),
+                true);  // takes ownership of the DecodableAmNnetParallel.
 
           LatticeFasterDecoder *decoder = new LatticeFasterDecoder(*decode_fst,
                                                                    config);
+          decoder->SetEpsilonClosureTable(epsilon_closure_table);
 
           DecodeUtteranceLatticeFasterClass *task =
               new DecodeUtteranceLatticeFasterClass(
@@ -166,10 +180,15 @@ int main(int argc, char *argv[]) {
             new LatticeFasterDecoder(config, fst_reader.Value().Copy());
 
         bool pad_input = true;
-        DecodableAmNnetParallel *nnet_decodable = new DecodableAmNnetParallel(
+        DecodableInterface *nnet_decodable = new DecodableAmNnetParallel(
             trans_model, am_nnet,
             new CuMatrix<BaseFloat>(features),
-            pad_input, acoustic_scale);
+            pad_input, acoustic_scale,
+            subsample_config.frame_subsampling_factor);
+        if (subsample_config.frame_subsampling_factor != 1)
+          nnet_decodable = new DecodableSubsampled(
+              nnet_decodable, subsample_config, features.NumRows(),
+              true);  // takes ownership of the DecodableAmNnetParallel.
 
         DecodeUtteranceLatticeFasterClass *task =
             new DecodeUtteranceLatticeFasterClass(
@@ -185,6 +204,7 @@ int main(int argc, char *argv[]) {
     }
     sequencer.Wait(); // Waits for all tasks to be done.
     if (decode_fst != NULL) delete decode_fst;   
+    delete epsilon_closure_table;
     
     double elapsed = timer.Elapsed();
     KALDI_LOG << "Time taken "<< elapsed
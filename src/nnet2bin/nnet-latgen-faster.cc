@@ -26,6 +26,7 @@
 #include "hmm/transition-model.h"
 #include "fstext/fstext-lib.h"
 #include "decoder/decoder-wrappers.h"
+#include "decoder/decodable-subsampled.h"
 #include "nnet2/decodable-am-nnet.h"
 #include "base/timer.h"
 
@@ -40,7 +41,10 @@ int main(int argc, char *argv[]) {
     using fst::StdArc;
 
     const char *usage =
-        "Generate lattices using neural net model.\n"
+        "Generate lattices using neural net model.  With --segment-length > 0,\n"
+        "long utterances are decoded as overlapping windows in parallel (see\n"
+        "--segment-threads) and the lattices are joined; each window's lattice\n"
+        "is determinized, but the joined lattice is not determinized again.\n"
         "Usage: nnet-latgen-faster [options] <nnet-in> <fst-in|fsts-rspecifier> <features-rspecifier>"
         " <lattice-wspecifier> [ <words-wspecifier> [<alignments-wspecifier>] ]\n";
     ParseOptions po(usage);
@@ -48,9 +52,15 @@ int main(int argc, char *argv[]) {
     bool allow_partial = false;
     BaseFloat acoustic_scale = 0.1;
     LatticeFasterDecoderConfig config;
+    EpsilonClosureConfig epsilon_closure_config;
+    DecodableSubsampledConfig subsample_config;
+    SegmentedDecodingConfig segment_config;
     
     std::string word_syms_filename;
     config.Register(&po);
+    epsilon_closure_config.Register(&po);
+    subsample_config.Register(&po);
+    segment_config.Register(&po);
     po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
     po.Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
     po.Register("allow-partial", &allow_partial, "If true, produce output even if end state was not reached.");
@@ -79,6 +89,9 @@ int main(int argc, char *argv[]) {
     }
 
     bool determinize = config.determinize_lattice;
+    segment_config.Check();
+    if (segment_config.segment_length > 0 && !determinize)
+      KALDI_ERR << "--segment-length > 0 requires --determinize-lattice=true";
     CompactLatticeWriter compact_lattice_writer;
     LatticeWriter lattice_writer;
     if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier)
@@ -106,9 +119,12 @@ int main(int argc, char *argv[]) {
       
       // Input FST is just one FST, not a table of FSTs.
       VectorFst<StdArc> *decode_fst = fst::ReadFstKaldi(fst_in_str);
+      EpsilonClosureTable *epsilon_closure_table =
+          NewEpsilonClosureTable(*decode_fst, epsilon_closure_config);
 
       {
         LatticeFasterDecoder decoder(*decode_fst, config);
+        decoder.SetEpsilonClosureTable(epsilon_closure_table);
     
         for (; !feature_reader.Done(); feature_reader.Next()) {
           std::string utt = feature_reader.Key();
@@ -119,14 +135,26 @@ int main(int argc, char *argv[]) {
             continue;
           }
           bool pad_input = true;
-          DecodableAmNnet nnet_decodable(trans_model,
-                                         am_nnet,
-                                         features,
-                                         pad_input,
-                                         acoustic_scale);
+          DecodableAmNnet nnet_decodable(
+              trans_model, am_nnet, features, pad_input, acoustic_scale,
+              subsample_config.frame_subsampling_factor);
+          DecodableSubsampled subsampled_decodable(
+              &nnet_decodable, subsample_config, features.NumRows());
+          DecodableInterface &decodable =
+              (subsample_config.frame_subsampling_factor == 1 ?
+               static_cast<DecodableInterface&>(nnet_decodable) :
+               subsampled_decodable);
           double like;
-          if (DecodeUtteranceLatticeFaster(
-                  decoder, nnet_decodable, trans_model, word_syms, utt,
+          bool segmented = (segment_config.segment_length > 0 &&
+                            features.NumRows() > segment_config.segment_length);
+          if (segmented ?
+              DecodeUtteranceLatticeFasterSegmented(
+                  *decode_fst, config, segment_config, decodable, trans_model,
+                  word_syms, utt, acoustic_scale, allow_partial,
+                  &alignment_writer, &words_writer, &compact_lattice_writer,
+                  &like) :
+              DecodeUtteranceLatticeFaster(
+                  decoder, decodable, trans_model, word_syms, utt,
                   acoustic_scale, determinize, allow_partial, &alignment_writer,
                   &words_writer, &compact_lattice_writer, &lattice_writer,
                   &like)) {
@@ -137,6 +165,7 @@ int main(int argc, char *argv[]) {
         }
       }
       delete decode_fst; // delete this only after decoder goes out of scope.
+      delete epsilon_closure_table;
     } else { // We have different FSTs for different utterances.
       SequentialTableReader<fst::VectorFstHolder> fst_reader(fst_in_str);
       RandomAccessBaseFloatCuMatrixReader feature_reader(feature_rspecifier);          
@@ -158,14 +187,26 @@ int main(int argc, char *argv[]) {
         LatticeFasterDecoder decoder(fst_reader.Value(), config);
 
         bool pad_input = true;
-        DecodableAmNnet nnet_decodable(trans_model,
-                                       am_nnet,
-                                       features,
-                                       pad_input,
-                                       acoustic_scale);
+        DecodableAmNnet nnet_decodable(
+            trans_model, am_nnet, features, pad_input, acoustic_scale,
+            subsample_config.frame_subsampling_factor);
+        DecodableSubsampled subsampled_decodable(
+            &nnet_decodable, subsample_config, features.NumRows());
+        DecodableInterface &decodable =
+            (subsample_config.frame_subsampling_factor == 1 ?
+             static_cast<DecodableInterface&>(nnet_decodable) :
+             subsampled_decodable);
         double like;
-        if (DecodeUtteranceLatticeFaster(
-                decoder, nnet_decodable, trans_model, word_syms, utt,
+        bool segmented = (segment_config.segment_length > 0 &&
+                          features.NumRows() > segment_config.segment_length);
+        if (segmented ?
+            DecodeUtteranceLatticeFasterSegmented(
+                fst_reader.Value(), config, segment_config, decodable,
+                trans_model, word_syms, utt, acoustic_scale, allow_partial,
+                &alignment_writer, &words_writer, &compact_lattice_writer,
+                &like) :
+            DecodeUtteranceLatticeFaster(
+                decoder, decodable, trans_model, word_syms, utt,
                 acoustic_scale, determinize, allow_partial, &alignment_writer,
                 &words_writer, &compact_lattice_writer, &lattice_writer,
                 &like)) {
@@ -0,0 +1,125 @@
+// nnetbin/nnet-lm-rescore-nbest.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "base/timer.h"
+#include "lat/kaldi-lattice.h"
+#include "lat/nbest-rescore.h"
+#include "nnet/nnet-nnet.h"
+#include "nnet/nnet-lm-scorer.h"
+#include "cudamatrix/cu-device.h"
+
+int main(int argc, char *argv[]) {
+  using namespace kaldi;
+  using namespace kaldi::nnet1;
+  typedef kaldi::int32 int32;
+  try {
+    const char *usage =
+        "Rescores the N-best paths of lattices with a feed-forward neural net\n"
+        "language model, adding lm-scale times its cost to the graph cost of\n"
+        "each path, and writes them out as lattices containing the rescored\n"
+        "paths (best first).  The network's input is the concatenation of the\n"
+        "embeddings (rows of <embedding-in>) of the previous words, and its\n"
+        "output is a softmax over the words; see nnet/nnet-lm-scorer.h.\n"
+        "\n"
+        "Usage: nnet-lm-rescore-nbest [options] <nnet-in> <embedding-in> \\\n"
+        "                      <lattice-rspecifier> <lattice-wspecifier>\n"
+        " e.g.: nnet-lm-rescore-nbest --bos-symbol=1 --eos-symbol=2 \\\n"
+        "        --acoustic-scale=0.1 lm.nnet embedding.mat ark:in.lats \\\n"
+        "        ark:out.lats\n"
+        "See also: lattice-lmrescore-nbest\n";
+
+    ParseOptions po(usage);
+    NbestRescoreOptions rescore_opts;
+    NnetLmScorerOptions scorer_opts;
+    rescore_opts.Register(&po);
+    scorer_opts.Register(&po);
+
+    std::string use_gpu="no";
+    po.Register("use-gpu", &use_gpu, "yes|no|optional, only has effect if compiled with CUDA");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 4) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string nnet_rxfilename = po.GetArg(1),
+        embedding_rxfilename = po.GetArg(2),
+        lats_rspecifier = po.GetArg(3),
+        lats_wspecifier = po.GetArg(4);
+
+#if HAVE_CUDA==1
+    CuDevice::Instantiate().SelectGpuId(use_gpu);
+#endif
+
+    Nnet nnet;
+    nnet.Read(nnet_rxfilename);
+    nnet.SetDropoutRetention(1.0);
+    Component::ComponentType last_type =
+        nnet.GetComponent(nnet.NumComponents() - 1).GetType();
+    if (last_type != Component::kSoftmax)
+      KALDI_WARN << "Last component of the network is "
+                 << Component::TypeToMarker(last_type)
+                 << ", not a softmax; its outputs will be treated as "
+                 << "probabilities.";
+
+    CuMatrix<BaseFloat> embedding;
+    {
+      Matrix<BaseFloat> embedding_host;
+      ReadKaldiObject(embedding_rxfilename, &embedding_host);
+      embedding = embedding_host;
+    }
+
+    NnetLmScorer scorer(scorer_opts, embedding, &nnet);
+    NbestRescorer rescorer(rescore_opts, &scorer);
+
+    SequentialCompactLatticeReader compact_lattice_reader(lats_rspecifier);
+    CompactLatticeWriter compact_lattice_writer(lats_wspecifier);
+
+    Timer timer;
+    int32 n_done = 0, n_fail = 0;
+    for (; !compact_lattice_reader.Done(); compact_lattice_reader.Next()) {
+      std::string key = compact_lattice_reader.Key();
+      CompactLattice nbest;
+      if (rescorer.Rescore(compact_lattice_reader.Value(), &nbest)) {
+        compact_lattice_writer.Write(key, nbest);
+        n_done++;
+      } else {
+        KALDI_WARN << "No paths left after rescoring utterance " << key
+                   << " (empty lattice?)";
+        n_fail++;
+      }
+    }
+
+    rescorer.Stats().Print();
+    KALDI_LOG << "Done " << n_done << " lattices, failed for " << n_fail
+              << ", in " << timer.Elapsed() << " seconds.";
+#if HAVE_CUDA==1
+    if (kaldi::g_kaldi_verbose_level >= 1) {
+      CuDevice::Instantiate().PrintProfile();
+    }
+#endif
+    return (n_done != 0 ? 0 : 1);
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -33,12 +33,31 @@ SingleUtteranceNnet2Decoder::SingleUtteranceNnet2Decoder(
     feature_pipeline_(feature_pipeline),
     tmodel_(tmodel),
     decodable_(model, tmodel, config.decodable_opts, feature_pipeline),
-    decoder_(fst, config.decoder_opts) {
+    decoder_(fst, config.decoder_opts),
+    determinizer_(tmodel, config.decoder_opts.lattice_beam,
+                  config.decoder_opts.det_opts),
+    determinized_frames_(0) {
+  config_.incremental_opts.Check();
   decoder_.InitDecoding();
 }
 
 void SingleUtteranceNnet2Decoder::AdvanceDecoding() {
   decoder_.AdvanceDecoding(&decodable_);
+  const LatticeIncrementalDeterminizerConfig &opts = config_.incremental_opts;
+  if (opts.determinize_period > 0) {
+    int32 end_frame = decoder_.NumFramesDecoded() - opts.determinize_delay;
+    if (end_frame >= determinized_frames_ + opts.determinize_period) {
+      Lattice chunk;
+      if (decoder_.GetRawLatticeChunk(determinized_frames_, end_frame,
+                                      &chunk)) {
+        if (!determinizer_.AcceptChunk(&chunk))
+          KALDI_WARN << "Determinization finished earlier than the beam "
+                     << "for frames " << determinized_frames_ << " to "
+                     << end_frame;
+        determinized_frames_ = end_frame;
+      }
+    }
+  }
 }
 
 void SingleUtteranceNnet2Decoder::FinalizeDecoding() {
@@ -53,12 +72,22 @@ void SingleUtteranceNnet2Decoder::GetLattice(bool end_of_utterance,
                                              CompactLattice *clat) const {
   if (NumFramesDecoded() == 0)
     KALDI_ERR << "You cannot get a lattice if you decoded no frames.";
-  Lattice raw_lat;
-  decoder_.GetRawLattice(&raw_lat, end_of_utterance);
-
   if (!config_.decoder_opts.determinize_lattice)
     KALDI_ERR << "--determinize-lattice=false option is not supported at the moment";
 
+  if (config_.incremental_opts.determinize_period > 0) {
+    // Only the frames not yet given to determinizer_ remain to be
+    // determinized.
+    Lattice last_chunk;
+    if (decoder_.GetRawLatticeFinalChunk(determinized_frames_,
+                                         end_of_utterance, &last_chunk))
+      determinizer_.GetLattice(&last_chunk, clat);
+    else
+      clat->DeleteStates();
+    return;
+  }
+  Lattice raw_lat;
+  decoder_.GetRawLattice(&raw_lat, end_of_utterance);
   BaseFloat lat_beam = config_.decoder_opts.lattice_beam;
   DeterminizeLatticePhonePrunedWrapper(
       tmodel_, &raw_lat, lat_beam, clat, config_.decoder_opts.det_opts);
@@ -32,6 +32,7 @@
 #include "online2/online-nnet2-feature-pipeline.h"
 #include "online2/online-endpoint.h"
 #include "decoder/lattice-faster-online-decoder.h"
+#include "lat/determinize-lattice-incremental.h"
 #include "hmm/transition-model.h"
 #include "hmm/posterior.h"
 
@@ -51,12 +52,14 @@ struct OnlineNnet2DecodingConfig {
   
   LatticeFasterDecoderConfig decoder_opts;
   nnet2::DecodableNnet2OnlineOptions decodable_opts;
+  LatticeIncrementalDeterminizerConfig incremental_opts;
   
   OnlineNnet2DecodingConfig() {  decodable_opts.acoustic_scale = 0.1; }
   
   void Register(OptionsItf *po) {
     decoder_opts.Register(po);
     decodable_opts.Register(po);
+    incremental_opts.Register(po);
   }
 };
 
@@ -74,7 +77,8 @@ class SingleUtteranceNnet2Decoder {
                               const fst::Fst<fst::StdArc> &fst,
                               OnlineNnet2FeaturePipeline *feature_pipeline);
   
-  /// advance the decoding as far as we can.
+  /// advance the decoding as far as we can.  If --determinize-period > 0,
+  /// this also determinizes the part of the lattice that has become stable.
   void AdvanceDecoding();
 
   /// Finalizes the decoding. Cleans up and prunes remaining tokens, so the
@@ -118,6 +122,11 @@ class SingleUtteranceNnet2Decoder {
   nnet2::DecodableNnet2Online decodable_;
   
   LatticeFasterOnlineDecoder decoder_;
+
+  // Used if config_.incremental_opts.determinize_period > 0; the lattice up
+  // to frame determinized_frames_ has been given to determinizer_.
+  LatticeIncrementalDeterminizer determinizer_;
+  int32 determinized_frames_;
   
 };
 
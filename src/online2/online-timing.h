@@ -38,6 +38,8 @@ class OnlineTimer;
 /// class OnlineTimingStats stores statistics from timing of online decoding,
 /// which will enable the Print() function to print out the averate real-time
 /// factor and average delay per utterance.  See class OnlineTimer.
+/// For a per-stage breakdown of where the time goes, compile with
+/// -DKALDI_PROFILE; see base/kaldi-profile.h.
 class OnlineTimingStats {
  public:
   OnlineTimingStats();
@@ -17,6 +17,8 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <iomanip>
+
 #include "feat/wave-reader.h"
 #include "online2/online-nnet2-decoding.h"
 #include "online2/onlinebin-util.h"
@@ -90,7 +92,11 @@ int main(int argc, char *argv[]) {
         "The spk2utt-rspecifier can just be <utterance-id> <utterance-id> if\n"
         "you want to decode utterance by utterance.\n"
         "See egs/rm/s5/local/run_online_decoding_nnet2.sh for example\n"
-        "See also online2-wav-nnet2-latgen-threaded\n";
+        "See also online2-wav-nnet2-latgen-threaded\n"
+        "With --segment-on-endpoint=true, each recording is cut into segments\n"
+        "wherever an endpoint is detected; the decoder is restarted (keeping the\n"
+        "iVector and CMVN adaptation state) and a lattice is written for each\n"
+        "segment, with key <utterance-id>-<start>-<end> (times in centiseconds).\n";
     
     ParseOptions po(usage);
     
@@ -105,6 +111,8 @@ int main(int argc, char *argv[]) {
 
     BaseFloat chunk_length_secs = 0.05;
     bool do_endpointing = false;
+    bool segment_on_endpoint = false;
+    std::string segments_wxfilename;
     bool online = true;
     
     po.Register("chunk-length", &chunk_length_secs,
@@ -114,6 +122,16 @@ int main(int argc, char *argv[]) {
                 "Symbol table for words [for debug output]");
     po.Register("do-endpointing", &do_endpointing,
                 "If true, apply endpoint detection");
+    po.Register("segment-on-endpoint", &segment_on_endpoint,
+                "If true, instead of stopping decoding at an endpoint, start "
+                "a new segment there and continue decoding the rest of the "
+                "recording (implies --do-endpointing=true).  Use this to decode "
+                "long recordings in bounded memory.");
+    po.Register("write-segments", &segments_wxfilename,
+                "If set (and --segment-on-endpoint=true), write the segments "
+                "in the format <segment-id> <utterance-id> <start-time> "
+                "<end-time>, with times in seconds, like a data-dir segments "
+                "file.");
     po.Register("online", &online,
                 "You can set this to false to disable online iVector estimation "
                 "and have all the data for each utterance used, even at "
@@ -150,6 +168,10 @@ int main(int argc, char *argv[]) {
       feature_info.ivector_extractor_info.greedy_ivector_extractor = true;
       chunk_length_secs = -1.0;
     }
+    if (segment_on_endpoint)
+      do_endpointing = true;
+    else if (segments_wxfilename != "")
+      KALDI_ERR << "--write-segments requires --segment-on-endpoint=true";
     
     TransitionModel trans_model;
     nnet2::AmNnet nnet;
@@ -175,6 +197,11 @@ int main(int argc, char *argv[]) {
     SequentialTokenVectorReader spk2utt_reader(spk2utt_rspecifier);
     RandomAccessTableReader<WaveHolder> wav_reader(wav_rspecifier);
     CompactLatticeWriter clat_writer(clat_wspecifier);
+    Output segments_output;
+    if (segments_wxfilename != "" &&
+        !segments_output.Open(segments_wxfilename, false, false))
+      KALDI_ERR << "Could not open " << segments_wxfilename
+                << " to write segments.";
     
     OnlineTimingStats timing_stats;
     
@@ -195,20 +222,7 @@ int main(int argc, char *argv[]) {
         // take the first channel).
         SubVector<BaseFloat> data(wave_data.Data(), 0);
 
-        OnlineNnet2FeaturePipeline feature_pipeline(feature_info);
-        feature_pipeline.SetAdaptationState(adaptation_state);
-
-        OnlineSilenceWeighting silence_weighting(
-            trans_model,
-            feature_info.silence_weighting_config);
-        
-        SingleUtteranceNnet2Decoder decoder(nnet2_decoding_config,
-                                            trans_model,
-                                            nnet,
-                                            *decode_fst,
-                                            &feature_pipeline);
         OnlineTimer decoding_timer(utt);
-        
         BaseFloat samp_freq = wave_data.SampFreq();
         int32 chunk_length;
         if (chunk_length_secs > 0) {
@@ -217,58 +231,109 @@ int main(int argc, char *argv[]) {
         } else {
           chunk_length = std::numeric_limits<int32>::max();
         }
+        int32 frame_shift_samp = static_cast<int32>(
+            samp_freq * feature_info.FrameShiftInSeconds() + 0.5);
+        KALDI_ASSERT(frame_shift_samp > 0);
+
+        // Each iteration of this loop decodes one segment, starting at sample
+        // segment_start; without --segment-on-endpoint there is only one.
+        int32 segment_start = 0;
+        while (true) {
+          OnlineNnet2FeaturePipeline feature_pipeline(feature_info);
+          feature_pipeline.SetAdaptationState(adaptation_state);
+
+          OnlineSilenceWeighting silence_weighting(
+              trans_model,
+              feature_info.silence_weighting_config);
+        
+          SingleUtteranceNnet2Decoder decoder(nnet2_decoding_config,
+                                              trans_model,
+                                              nnet,
+                                              *decode_fst,
+                                              &feature_pipeline);
         
-        int32 samp_offset = 0;
-        std::vector<std::pair<int32, BaseFloat> > delta_weights;
+          int32 samp_offset = segment_start;
+          bool endpoint_detected = false;
+          std::vector<std::pair<int32, BaseFloat> > delta_weights;
         
-        while (samp_offset < data.Dim()) {
-          int32 samp_remaining = data.Dim() - samp_offset;
-          int32 num_samp = chunk_length < samp_remaining ? chunk_length
-                                                         : samp_remaining;
+          while (samp_offset < data.Dim()) {
+            int32 samp_remaining = data.Dim() - samp_offset;
+            int32 num_samp = chunk_length < samp_remaining ? chunk_length
+                                                           : samp_remaining;
           
-          SubVector<BaseFloat> wave_part(data, samp_offset, num_samp);
-          feature_pipeline.AcceptWaveform(samp_freq, wave_part);
+            SubVector<BaseFloat> wave_part(data, samp_offset, num_samp);
+            feature_pipeline.AcceptWaveform(samp_freq, wave_part);
 
-          samp_offset += num_samp;
-          decoding_timer.WaitUntil(samp_offset / samp_freq);
-          if (samp_offset == data.Dim()) {
-            // no more input. flush out last frames
-            feature_pipeline.InputFinished();
-          }
+            samp_offset += num_samp;
+            decoding_timer.WaitUntil(samp_offset / samp_freq);
+            if (samp_offset == data.Dim()) {
+              // no more input. flush out last frames
+              feature_pipeline.InputFinished();
+            }
     
-          if (silence_weighting.Active()) {
-            silence_weighting.ComputeCurrentTraceback(decoder.Decoder());
-            silence_weighting.GetDeltaWeights(feature_pipeline.NumFramesReady(),
-                                              &delta_weights);
-            feature_pipeline.UpdateFrameWeights(delta_weights);
-          }
+            if (silence_weighting.Active()) {
+              silence_weighting.ComputeCurrentTraceback(decoder.Decoder());
+              silence_weighting.GetDeltaWeights(
+                  feature_pipeline.NumFramesReady(), &delta_weights);
+              feature_pipeline.UpdateFrameWeights(delta_weights);
+            }
           
-          decoder.AdvanceDecoding();
+            decoder.AdvanceDecoding();
           
-          if (do_endpointing && decoder.EndpointDetected(endpoint_config))
-            break;
-        }
-        decoder.FinalizeDecoding();
+            if (do_endpointing && decoder.EndpointDetected(endpoint_config)) {
+              endpoint_detected = true;
+              break;
+            }
+          }
+          decoder.FinalizeDecoding();
+
+          CompactLattice clat;
+          bool end_of_utterance = true;
+          decoder.GetLattice(end_of_utterance, &clat);
 
-        CompactLattice clat;
-        bool end_of_utterance = true;
-        decoder.GetLattice(end_of_utterance, &clat);
+          // The segment ends after the last frame we decoded; any audio we
+          // gave the feature pipeline after that goes to the next segment.
+          int32 segment_end = data.Dim();
+          if (endpoint_detected)
+            segment_end = std::min(data.Dim(), segment_start +
+                                   std::max(1, decoder.NumFramesDecoded()) *
+                                   frame_shift_samp);
+          std::string key = utt;
+          if (segment_on_endpoint) {
+            int32 start_cs = static_cast<int32>(
+                100.0 * segment_start / samp_freq + 0.5),
+                end_cs = static_cast<int32>(
+                    100.0 * segment_end / samp_freq + 0.5);
+            std::ostringstream os;
+            os << utt << '-' << std::setfill('0') << std::setw(7) << start_cs
+               << '-' << std::setw(7) << end_cs;
+            key = os.str();
+            if (segments_output.IsOpen())
+              segments_output.Stream() << key << ' ' << utt << ' '
+                                       << (segment_start / samp_freq) << ' '
+                                       << (segment_end / samp_freq) << '\n';
+          }
         
-        GetDiagnosticsAndPrintOutput(utt, word_syms, clat,
-                                     &num_frames, &tot_like);
+          GetDiagnosticsAndPrintOutput(key, word_syms, clat,
+                                       &num_frames, &tot_like);
         
-        decoding_timer.OutputStats(&timing_stats);
+          // In an application you might avoid updating the adaptation state
+          // if you felt the utterance had low confidence.  See
+          // lat/confidence.h
+          feature_pipeline.GetAdaptationState(&adaptation_state);
         
-        // In an application you might avoid updating the adaptation state if
-        // you felt the utterance had low confidence.  See lat/confidence.h
-        feature_pipeline.GetAdaptationState(&adaptation_state);
-        
-        // we want to output the lattice with un-scaled acoustics.
-        BaseFloat inv_acoustic_scale =
-            1.0 / nnet2_decoding_config.decodable_opts.acoustic_scale;
-        ScaleLattice(AcousticLatticeScale(inv_acoustic_scale), &clat);
+          // we want to output the lattice with un-scaled acoustics.
+          BaseFloat inv_acoustic_scale =
+              1.0 / nnet2_decoding_config.decodable_opts.acoustic_scale;
+          ScaleLattice(AcousticLatticeScale(inv_acoustic_scale), &clat);
 
-        clat_writer.Write(utt, clat);
+          clat_writer.Write(key, clat);
+          if (!segment_on_endpoint || !endpoint_detected ||
+              segment_end >= data.Dim())
+            break;
+          segment_start = segment_end;
+        }
+        decoding_timer.OutputStats(&timing_stats);
         KALDI_LOG << "Decoded utterance " << utt;
         num_done++;
       }